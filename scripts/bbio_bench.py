@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+
+############################### bbio_bench.py ###############################
+"""
+Measures the per-command cost and the throughput of the BBIO protocol layer.
+
+Before to launch this test just reset HydraBus board(to be sure it is in a clean state)
+Nothing needs to be connected on SPI1, MISO reads whatever level is floating.
+
+Examples Windows with HydraBus on COM4 (for Linux use /dev/ttyACM0 ...)
+python bbio_bench.py COM4
+python bbio_bench.py COM4 2000 >> bbio_bench.txt
+
+Benchmarks:
+  mode       BBIO reset + SPI mode entry round trip
+  cs         SPI CS low/high, 1 byte command / 1 byte answer (dispatch cost)
+  bulk-N     SPI bulk transfer of N bytes (1 command byte + N bytes each way)
+  wr-N       SPI write-then-read of N bytes written and N bytes read
+
+The same workloads run without board against a mock BSP with
+"make -C src/host bench", see src/host/bench_bbio.c. This script also runs
+against the simulator: start src/host/host_sim -p and pass the pty printed.
+"""
+
+import serial
+import time
+import sys
+
+BBIO_RESET = b'\x00'
+BBIO_SPI = b'\x01'
+BBIO_RESET_HW = b'\x0f'
+BBIO_SPI_CS_LOW = b'\x02'
+BBIO_SPI_CS_HIGH = b'\x03'
+BBIO_SPI_WRITE_READ = 0x04
+BBIO_SPI_BULK_TRANSFER = 0x10
+
+
+def read_exact(port, size):
+    data = port.read(size)
+    if len(data) != size:
+        raise IOError("Timeout, expected %d bytes got %d" % (size, len(data)))
+    return data
+
+
+def enter_bbio(port):
+    for i in range(20):
+        port.write(BBIO_RESET)
+    time.sleep(0.1)
+    if b'BBIO1' not in port.read(port.in_waiting):
+        raise IOError("Cannot enter BBIO mode")
+
+
+def enter_spi(port):
+    port.write(BBIO_SPI)
+    if read_exact(port, 4) != b'SPI1':
+        raise IOError("Cannot enter BBIO SPI mode")
+
+
+def leave(port):
+    port.write(BBIO_RESET)
+    read_exact(port, 5)
+    port.write(BBIO_RESET_HW)
+    time.sleep(0.1)
+    port.reset_input_buffer()
+
+
+def report(name, count, tx_bytes, rx_bytes, t):
+    print("%-10s %8d cmds %8.2f us/cmd %10.2f KB/s TX %10.2f KB/s RX" % (
+        name, count, t * 1e6 / count,
+        tx_bytes / t / 1024, rx_bytes / t / 1024))
+
+
+def bench_mode(port, count):
+    t1 = time.perf_counter()
+    for i in range(count):
+        port.write(BBIO_RESET)
+        read_exact(port, 5)
+        enter_spi(port)
+    t2 = time.perf_counter()
+    report("mode", count, 2 * count, 9 * count, t2 - t1)
+
+
+def bench_cs(port, count):
+    t1 = time.perf_counter()
+    for i in range(count // 2):
+        port.write(BBIO_SPI_CS_LOW)
+        read_exact(port, 1)
+        port.write(BBIO_SPI_CS_HIGH)
+        read_exact(port, 1)
+    t2 = time.perf_counter()
+    report("cs", count, count, count, t2 - t1)
+
+
+def bench_bulk(port, count, size):
+    cmd = bytes([BBIO_SPI_BULK_TRANSFER | (size - 1)]) + bytes(size)
+    t1 = time.perf_counter()
+    for i in range(count):
+        port.write(cmd)
+        read_exact(port, 1 + size)
+    t2 = time.perf_counter()
+    report("bulk-%d" % size, count, count * len(cmd), count * (1 + size), t2 - t1)
+
+
+def bench_write_read(port, count, size):
+    cmd = bytes([BBIO_SPI_WRITE_READ, size >> 8, size & 0xff,
+                 size >> 8, size & 0xff]) + bytes(size)
+    t1 = time.perf_counter()
+    for i in range(count):
+        port.write(cmd)
+        if read_exact(port, 1 + size)[0] != 1:
+            raise IOError("write-then-read error")
+    t2 = time.perf_counter()
+    report("wr-%d" % size, count, count * len(cmd), count * (1 + size), t2 - t1)
+
+
+def main():
+
+    port = sys.argv[1]
+    try:
+        serialPort = serial.Serial(port, 115200, serial.EIGHTBITS, serial.PARITY_NONE, serial.STOPBITS_ONE, timeout=1)
+    except:
+        print("Couldn't open serial port %s" % port)
+        exit()
+
+    count = 1000
+    if len(sys.argv) > 2:
+        count = int(sys.argv[2])
+
+    print('COM port: %s count: %d' % (port, count))
+
+    serialPort.reset_input_buffer()
+    enter_bbio(serialPort)
+    enter_spi(serialPort)
+
+    bench_mode(serialPort, count // 10)
+    bench_cs(serialPort, count)
+    for size in (1, 4, 16):
+        bench_bulk(serialPort, count, size)
+    for size in (64, 256, 1024, 4096):
+        bench_write_read(serialPort, max(count // (size // 64), 10), size)
+
+    leave(serialPort)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+
+############################### sd_transfer.py ###############################
+"""
+Copies files from/to the HydraBus SD card using the BBIO SD transfer mode.
+
+Interrupted transfers are resumed: get appends to an existing local file,
+put starts from the size of the file already on the card.
+
+Examples Windows with HydraBus on COM4 (for Linux use /dev/ttyACM0 ...)
+python sd_transfer.py COM4 get capture.bin
+python sd_transfer.py COM4 put capture.bin
+"""
+
+import os
+import serial
+import struct
+import sys
+import time
+import zlib
+
+BBIO_RESET = b'\x00'
+BBIO_SD_XFER = b'\x19'
+BBIO_RESET_HW = b'\x0f'
+BBIO_SD_XFER_STAT = 0x02
+BBIO_SD_XFER_GET = 0x03
+BBIO_SD_XFER_PUT = 0x04
+
+FRAME_SYNC = 0xA5
+CHANNEL_DATA = 0
+CHANNEL_END = 1
+CHUNK = 8192
+
+
+def read_exact(port, size):
+    data = port.read(size)
+    if len(data) != size:
+        raise IOError("Timeout, expected %d bytes got %d" % (size, len(data)))
+    return data
+
+
+def read_status(port):
+    ok, value = struct.unpack('>BI', read_exact(port, 5))
+    return ok == 1, value
+
+
+def name_arg(name):
+    name = name.encode()
+    return bytes([len(name)]) + name
+
+
+def enter(port):
+    for i in range(20):
+        port.write(BBIO_RESET)
+    time.sleep(0.1)
+    if b'BBIO1' not in port.read(port.in_waiting):
+        raise IOError("Cannot enter BBIO mode")
+    port.write(BBIO_SD_XFER)
+    if read_exact(port, 4) != b'SDX1':
+        raise IOError("Cannot enter SD transfer mode")
+
+
+def leave(port):
+    port.write(BBIO_RESET)
+    read_exact(port, 5)
+    port.write(BBIO_RESET_HW)
+    time.sleep(0.1)
+    port.reset_input_buffer()
+
+
+def remote_size(port, name):
+    port.write(bytes([BBIO_SD_XFER_STAT]) + name_arg(name))
+    ok, value = read_status(port)
+    return value if ok else 0
+
+
+def get(port, name):
+    offset = os.path.getsize(name) if os.path.exists(name) else 0
+    port.write(bytes([BBIO_SD_XFER_GET]) + name_arg(name) + struct.pack('>I', offset))
+    ok, size = read_status(port)
+    if not ok:
+        raise IOError("Cannot open %s: FRESULT %d" % (name, size))
+    with open(name, 'ab') as f:
+        while True:
+            sync, channel, length = struct.unpack('>BBH', read_exact(port, 4))
+            if sync != FRAME_SYNC:
+                raise IOError("Framing error")
+            payload = read_exact(port, length)
+            if channel == CHANNEL_END:
+                if payload[0] != 0:
+                    raise IOError("Read error: FRESULT %d" % payload[0])
+                break
+            data, crc = payload[:-4], struct.unpack('>I', payload[-4:])[0]
+            if zlib.crc32(data) != crc:
+                raise IOError("CRC error at offset %d, run again to resume" % f.tell())
+            f.write(data)
+    return size - offset
+
+
+def put(port, name):
+    offset = remote_size(port, name)
+    size = os.path.getsize(name)
+    if offset > size:
+        offset = 0
+    port.write(bytes([BBIO_SD_XFER_PUT]) + name_arg(name) +
+               struct.pack('>II', offset, size - offset))
+    ok, value = read_status(port)
+    if not ok:
+        raise IOError("Cannot open %s: FRESULT %d" % (name, value))
+    if offset == size:
+        read_status(port)
+        return 0
+    with open(name, 'rb') as f:
+        f.seek(offset)
+        remaining = size - offset
+        while remaining > 0:
+            data = f.read(CHUNK)
+            remaining -= len(data)
+            payload = data + struct.pack('>I', zlib.crc32(data))
+            port.write(struct.pack('>BBH', FRAME_SYNC, CHANNEL_DATA, len(payload)) + payload)
+            status = read_exact(port, 1)
+            if status == b'\x01' and remaining > 0:
+                continue
+            value = struct.unpack('>I', read_exact(port, 4))[0]
+            if status != b'\x01':
+                raise IOError("Write error, resume from offset %d" % value)
+    return size - offset
+
+
+def main():
+    if len(sys.argv) != 4 or sys.argv[2] not in ('get', 'put'):
+        print(__doc__)
+        exit()
+
+    port = sys.argv[1]
+    try:
+        serialPort = serial.Serial(port, 115200, serial.EIGHTBITS, serial.PARITY_NONE, serial.STOPBITS_ONE, timeout=5)
+    except:
+        print("Couldn't open serial port %s" % port)
+        exit()
+
+    serialPort.reset_input_buffer()
+    enter(serialPort)
+    t1 = time.perf_counter()
+    if sys.argv[2] == 'get':
+        size = get(serialPort, sys.argv[3])
+    else:
+        size = put(serialPort, sys.argv[3])
+    t2 = time.perf_counter()
+    print("%d bytes in %.2f s (%.2f KB/s)" % (size, t2 - t1, size / (t2 - t1) / 1024))
+    leave(serialPort)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+
+############################### usb_bulk_bench.py ###############################
+"""
+Loopback and throughput test of the vendor bulk interface of USB1.
+
+The firmware must be built with HYDRAFW_USB_BULK=1. The bulk interface runs
+a BBIO session, the same commands as on the CDC console but each block goes
+as one USB transfer. Needs pyusb (python -m pip install pyusb) and, on
+Linux, access rights to the device.
+
+With a CDC port given as last argument the same test is also run on the
+console for comparison.
+
+Tests:
+  loopback N   BBIO SPI1 write-then-read of 4096 bytes blocks, N times.
+               Connect MOSI (PB5) to MISO (PB4): the data read is checked.
+  get FILE     BBIO SD transfer GET of FILE from the SD card, data frames
+               are checked (CRC32) and dropped.
+
+Examples
+python usb_bulk_bench.py loopback 1000
+python usb_bulk_bench.py get capture.bin /dev/ttyACM0
+"""
+
+import serial
+import struct
+import sys
+import time
+import zlib
+
+import usb.core
+import usb.util
+
+VENDOR_ID = 0x1d50
+PRODUCT_ID = 0x60a7
+BULK_INTERFACE = 2
+BULK_EP = 3
+PACKET_SIZE = 64
+
+BBIO_RESET = b'\x00'
+BBIO_SPI = b'\x01'
+BBIO_SD_XFER = b'\x19'
+BBIO_SPI_WRITE_READ = 0x04
+BBIO_SD_XFER_GET = 0x03
+
+FRAME_SYNC = 0xA5
+CHANNEL_END = 1
+BLOCK = 4096
+
+
+class BulkPort:
+    """Byte stream over the bulk endpoints, with the pyserial calls used here"""
+
+    def __init__(self, timeout=1):
+        self.dev = usb.core.find(idVendor=VENDOR_ID, idProduct=PRODUCT_ID)
+        if self.dev is None:
+            raise IOError("HydraBus not found")
+        if self.dev.is_kernel_driver_active(BULK_INTERFACE):
+            self.dev.detach_kernel_driver(BULK_INTERFACE)
+        usb.util.claim_interface(self.dev, BULK_INTERFACE)
+        self.timeout = int(timeout * 1000)
+        self.buf = b''
+
+    def write(self, data):
+        self.dev.write(BULK_EP, data, self.timeout)
+        # A transfer filling its last packet is ended by a ZLP
+        if len(data) % PACKET_SIZE == 0:
+            self.dev.write(BULK_EP, b'', self.timeout)
+
+    def _fill(self, timeout):
+        try:
+            self.buf += bytes(self.dev.read(BULK_EP | 0x80, 16384, timeout))
+        except usb.core.USBTimeoutError:
+            return False
+        return True
+
+    def read(self, size):
+        while len(self.buf) < size and self._fill(self.timeout):
+            pass
+        data, self.buf = self.buf[:size], self.buf[size:]
+        return data
+
+    def reset_input_buffer(self):
+        while self._fill(100):
+            pass
+        self.buf = b''
+
+    def close(self):
+        usb.util.release_interface(self.dev, BULK_INTERFACE)
+        usb.util.dispose_resources(self.dev)
+
+
+def read_exact(port, size):
+    data = port.read(size)
+    if len(data) != size:
+        raise IOError("Timeout, expected %d bytes got %d" % (size, len(data)))
+    return data
+
+
+def enter_bbio(port):
+    for i in range(20):
+        port.write(BBIO_RESET)
+    time.sleep(0.1)
+    data = port.read(5 * 20)
+    if b'BBIO1' not in data:
+        raise IOError("Cannot enter BBIO mode")
+    port.reset_input_buffer()
+
+
+def enter(port, mode, header):
+    enter_bbio(port)
+    port.write(mode)
+    if read_exact(port, 4) != header:
+        raise IOError("Cannot enter %s mode" % header.decode())
+
+
+def leave(port):
+    port.write(BBIO_RESET)
+    read_exact(port, 5)
+
+
+def report(name, size, t):
+    print("%-8s %10d bytes %8.2f s %10.2f KB/s" % (name, size, t, size / t / 1024))
+
+
+def loopback(port, count):
+    enter(port, BBIO_SPI, b'SPI1')
+    cmd = bytes([BBIO_SPI_WRITE_READ, BLOCK >> 8, BLOCK & 0xff,
+                 BLOCK >> 8, BLOCK & 0xff])
+    errors = 0
+    t1 = time.perf_counter()
+    for i in range(count):
+        data = bytes((i + j) & 0xff for j in range(BLOCK))
+        port.write(cmd + data)
+        answer = read_exact(port, 1 + BLOCK)
+        if answer[0] != 1:
+            raise IOError("write-then-read error")
+        if answer[1:] != data:
+            errors += 1
+    t2 = time.perf_counter()
+    leave(port)
+    report("loopback", 2 * count * BLOCK, t2 - t1)
+    if errors:
+        print("%d/%d blocks differ, is MOSI connected to MISO?" % (errors, count))
+
+
+def get(port, name):
+    enter(port, BBIO_SD_XFER, b'SDX1')
+    name = name.encode()
+    port.write(bytes([BBIO_SD_XFER_GET, len(name)]) + name + struct.pack('>I', 0))
+    ok, size = struct.unpack('>BI', read_exact(port, 5))
+    if ok != 1:
+        raise IOError("Cannot open %s: FRESULT %d" % (name.decode(), size))
+    t1 = time.perf_counter()
+    while True:
+        sync, channel, length = struct.unpack('>BBH', read_exact(port, 4))
+        if sync != FRAME_SYNC:
+            raise IOError("Framing error")
+        payload = read_exact(port, length)
+        if channel == CHANNEL_END:
+            if payload[0] != 0:
+                raise IOError("Read error: FRESULT %d" % payload[0])
+            break
+        if zlib.crc32(payload[:-4]) != struct.unpack('>I', payload[-4:])[0]:
+            raise IOError("CRC error")
+    t2 = time.perf_counter()
+    leave(port)
+    report("get", size, t2 - t1)
+
+
+def run(port, args):
+    if args[0] == 'loopback':
+        loopback(port, int(args[1]))
+    else:
+        get(port, args[1])
+
+
+def main():
+    if len(sys.argv) < 3 or sys.argv[1] not in ('loopback', 'get'):
+        print(__doc__)
+        exit()
+
+    print("USB bulk:")
+    port = BulkPort()
+    port.reset_input_buffer()
+    run(port, sys.argv[1:3])
+    port.close()
+
+    if len(sys.argv) > 3:
+        print("CDC %s:" % sys.argv[3])
+        try:
+            serialPort = serial.Serial(sys.argv[3], 115200, serial.EIGHTBITS, serial.PARITY_NONE, serial.STOPBITS_ONE, timeout=1)
+        except:
+            print("Couldn't open serial port %s" % sys.argv[3])
+            exit()
+        serialPort.reset_input_buffer()
+        run(serialPort, sys.argv[1:3])
+        serialPort.close()
+
+if __name__ == '__main__':
+    main()
@@ -18,11 +18,13 @@
 
 #include "stdint.h"
 #include "alloc.h"
+#include "profile.h"
 
 /* Taken from linux kernel */
 #define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
 
-static uint8_t pool_buf[POOL_BUFFER_SIZE];
+/* Aligned for DMA bursts (SDIO uses 4 words bursts) */
+static uint8_t pool_buf[POOL_BUFFER_SIZE] __attribute__((aligned(16)));
 static pool_t ram_pool;
 
 /**
@@ -106,7 +108,13 @@ void * pool_alloc_blocks(uint8_t num_blocks)
 void * pool_alloc_bytes(uint32_t num_bytes)
 {
 	uint32_t blocks_needed = DIV_ROUND_UP(num_bytes, POOL_BLOCK_SIZE);
-	return pool_alloc_blocks(blocks_needed);
+	uint32_t start;
+	void *buf;
+
+	start = prof_start();
+	buf = pool_alloc_blocks(blocks_needed);
+	prof_record(PROF_POOL_ALLOC, start);
+	return buf;
 }
 
 /**
@@ -126,7 +134,7 @@ void pool_free(void * ptr)
 		return;
 	}
 
-	block_index = ((int)ptr-(int)ram_pool.pool)/ram_pool.block_size;
+	block_index = ((uint8_t *)ptr - (uint8_t *)ram_pool.pool) / ram_pool.block_size;
 	num_blocks = ram_pool.blocks[block_index];
 
 	for(i = 0; i< num_blocks; i++) {
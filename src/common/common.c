@@ -27,9 +27,11 @@
 #include <stdarg.h>
 
 #include "bsp_gpio.h"
+#include "bsp_resource.h"
 #include "microsd.h"
 #include "hydrabus_sd.h"
 #include "debug.h"
+#include "profile.h"
 
 #define HYDRAFW_VERSION "HydraFW (HydraBus) " HYDRAFW_GIT_TAG " " HYDRAFW_CHECKIN_DATE
 #define TEST_WA_SIZE    THD_WORKING_AREA_SIZE(256)
@@ -71,7 +73,11 @@ void print(void *user, const char *str)
 
 void cprint(t_hydra_console *con, const char *data, const uint32_t size)
 {
+	uint32_t start;
+
+	start = prof_start();
 	stream_write(con, data, size);
+	prof_record(PROF_CPRINT, start);
 }
 
 void print_hex(t_hydra_console *con, uint8_t* data, uint8_t size)
@@ -110,12 +116,15 @@ void cprintf(t_hydra_console *con, const char *fmt, ...)
 	int real_size;
 #define CPRINTF_BUFF_SIZE (511)
 	char cprintf_buff[CPRINTF_BUFF_SIZE+1];
+	uint32_t start;
 
+	start = prof_start();
 	va_start(va_args, fmt);
 	real_size = vsnprintf(cprintf_buff, CPRINTF_BUFF_SIZE, fmt, va_args);
 	va_end(va_args);
 
 	stream_write(con, cprintf_buff, real_size);
+	prof_record(PROF_CPRINTF, start);
 }
 
 /**
@@ -242,6 +251,76 @@ void cmd_show_system(t_hydra_console *con)
 #endif
 }
 
+void cmd_show_resources(t_hydra_console *con)
+{
+	char name[BSP_RES_NAME_MAX];
+	const char *owner;
+	int i, nb;
+
+	nb = 0;
+	for (i = 0; i < BSP_RES_NB; i++) {
+		owner = bsp_resource_owner(i);
+		if (owner == NULL)
+			continue;
+		if (nb++ == 0)
+			cprintf(con, "Resource Owner\r\n");
+		bsp_resource_name(i, name);
+		cprintf(con, "%-8s %s\r\n", name, owner);
+	}
+	if (nb == 0)
+		cprintf(con, "No resource in use.\r\n");
+}
+
+/* Prints cycles as microseconds with two decimals */
+static void print_prof_us(t_hydra_console *con, uint32_t cycles)
+{
+	uint64_t us100;
+
+	us100 = ((uint64_t)cycles * 100) / (STM32_HCLK / 1000000);
+	cprintf(con, " %7lu.%02lu", (uint32_t)(us100 / 100), (uint32_t)(us100 % 100));
+}
+
+/* Percentiles are bucket upper bounds, accurate within a factor of 2 */
+static void cmd_show_profile(t_hydra_console *con)
+{
+	prof_stat_t stat;
+	int i;
+
+	cprintf(con, "Probe        Count      Min(us)     Avg(us)     P50(us)     P90(us)     P99(us)     Max(us)\r\n");
+	for (i = 0; i < PROF_NB; i++) {
+		prof_get(i, &stat);
+		cprintf(con, "%-9s %8lu", prof_name(i), stat.count);
+		if (stat.count == 0) {
+			cprintf(con, "\r\n");
+			continue;
+		}
+		print_prof_us(con, stat.min);
+		print_prof_us(con, (uint32_t)(stat.total / stat.count));
+		print_prof_us(con, prof_percentile(&stat, 50));
+		print_prof_us(con, prof_percentile(&stat, 90));
+		print_prof_us(con, prof_percentile(&stat, 99));
+		print_prof_us(con, stat.max);
+		cprintf(con, "\r\n");
+	}
+}
+
+/* Reports the last peripheral/pin conflict of this console, if any */
+bool print_resource_conflict(t_hydra_console *con)
+{
+	char name[BSP_RES_NAME_MAX];
+	bsp_resource_t res;
+	const char *owner;
+
+	if (!bsp_resource_get_conflict(&res))
+		return FALSE;
+
+	bsp_resource_name(res, name);
+	owner = bsp_resource_owner(res);
+	cprintf(con, "Error: %s is in use by %s.\r\n", name,
+		owner == NULL ? "another console" : owner);
+	return TRUE;
+}
+
 static void cmd_show_debug(t_hydra_console *con)
 {
 	if (debug_flags & DEBUG_TOKENLINE)
@@ -263,6 +342,10 @@ int cmd_show(t_hydra_console *con, t_tokenline_parsed *p)
 		cmd_show_threads(con);
 	else if (p->tokens[1] == T_SD)
 		cmd_show_sd(con);
+	else if (p->tokens[1] == T_RESOURCES)
+		cmd_show_resources(con);
+	else if (p->tokens[1] == T_PROFILE)
+		cmd_show_profile(con);
 	else if (p->tokens[1] == T_DEBUG)
 		cmd_show_debug(con);
 	else
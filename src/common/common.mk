@@ -6,7 +6,11 @@ COMMONSRC = common/common.c \
             common/usb2cfg.c \
             common/script.c \
             common/alloc.c \
-			common/debug.c
+			common/debug.c \
+            common/crc32.c \
+            common/frame.c \
+            common/usb_bulk.c \
+            common/profile.c
 
 # Required include directories
 COMMONINC = ./common
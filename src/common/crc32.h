@@ -0,0 +1,30 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CRC32_H_
+#define _CRC32_H_
+
+#include <stdint.h>
+
+/*
+ * CRC-32 as used by zlib/Ethernet (poly 0xEDB88320 reflected).
+ * Start with crc = 0 and chain calls to process data in chunks.
+ */
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t len);
+
+#endif /* _CRC32_H_ */
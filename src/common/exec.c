@@ -29,6 +29,8 @@
 
 #include "common.h"
 #include "debug.h"
+#include "bsp_resource.h"
+#include "profile.h"
 
 uint32_t debug_flags = 0;
 
@@ -66,6 +68,9 @@ int mode_exit(t_hydra_console *con, t_tokenline_parsed *p)
 	tl_set_prompt(con->tl, PROMPT);
 	ret = tl_mode_pop(con->tl);
 
+	/* End of the mode session, drop its peripheral and pin leases */
+	bsp_resource_release_all();
+
 	return ret;
 }
 
@@ -105,9 +110,11 @@ static int cmd_debug(t_hydra_console *con, t_tokenline_parsed *p)
 {
 	uint32_t tmp_debug;
 	int action, t;
+	bool profile;
 
 	tmp_debug = 0;
 	action = 0;
+	profile = FALSE;
 	for (t = 0; p->tokens[t]; t++) {
 		switch (p->tokens[t]) {
 		case T_TOKENLINE:
@@ -129,8 +136,22 @@ static int cmd_debug(t_hydra_console *con, t_tokenline_parsed *p)
 		case T_POKE:
 			t = cmd_debug_poke(con, p, t);
 			break;
+		case T_PROFILE:
+			profile = TRUE;
+			break;
+		case T_RESET:
+			action = p->tokens[t];
+			break;
 		}
 	}
+	if (profile) {
+		if (action != T_RESET) {
+			cprintf(con, "Please specify 'reset'.\r\n");
+			return FALSE;
+		}
+		prof_reset();
+		return TRUE;
+	}
 	if (tmp_debug && !action) {
 		cprintf(con, "Please specify either 'on' or 'off'.\r\n");
 		return FALSE;
@@ -227,8 +248,10 @@ static struct cmd_map {
 void execute(void *user, t_tokenline_parsed *p)
 {
 	t_hydra_console *con;
+	uint32_t start;
 	int i;
 
+	start = prof_start();
 	con = user;
 
 	if (debug_flags & DEBUG_TOKENLINE)
@@ -249,9 +272,15 @@ void execute(void *user, t_tokenline_parsed *p)
 		}
 	}
 
+	print_resource_conflict(con);
+	/* Top level commands only keep leases of hardware left running */
+	if (!con->console_mode)
+		bsp_resource_release_all();
+
 	if (con->log_file.obj.fs) {
 		/* Flush cached logging output. */
 		file_sync(&(con->log_file));
 	}
+	prof_record(PROF_EXECUTE, start);
 }
 
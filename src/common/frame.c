@@ -0,0 +1,99 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame.h"
+
+static frame_status_t frame_read(const frame_transport_t *tr, uint8_t *buf,
+				 uint32_t len, uint32_t timeout_ms)
+{
+	uint32_t n;
+
+	while (len > 0) {
+		n = tr->read(tr->priv, buf, len, timeout_ms);
+		if (n == 0)
+			return FRAME_TIMEOUT;
+		buf += n;
+		len -= n;
+	}
+	return FRAME_OK;
+}
+
+static void frame_flush(const frame_transport_t *tr)
+{
+	if (tr->flush != NULL)
+		tr->flush(tr->priv);
+}
+
+frame_status_t frame_send(const frame_transport_t *tr, uint8_t channel,
+			  uint8_t *frame, uint32_t len)
+{
+	uint32_t size;
+
+	if (len > FRAME_MAX_PAYLOAD)
+		return FRAME_OVERFLOW;
+
+	frame[0] = FRAME_SYNC;
+	frame[1] = channel;
+	frame[2] = len >> 8;
+	frame[3] = len & 0xff;
+
+	size = len + FRAME_HDR_SIZE;
+	if (tr->write(tr->priv, frame, size) != size)
+		return FRAME_ERROR;
+
+	/* A full last packet does not end the transfer on the host side */
+	if (tr->packet_size > 0 && (size % tr->packet_size) == 0)
+		tr->write(tr->priv, NULL, 0);
+
+	return FRAME_OK;
+}
+
+frame_status_t frame_recv(const frame_transport_t *tr, uint8_t *channel,
+			  uint8_t *buf, uint32_t max, uint32_t *len,
+			  uint32_t timeout_ms)
+{
+	uint8_t hdr[FRAME_HDR_SIZE];
+	frame_status_t status;
+	uint32_t size;
+
+	*len = 0;
+	status = frame_read(tr, hdr, FRAME_HDR_SIZE, timeout_ms);
+	if (status != FRAME_OK)
+		return status;
+
+	if (hdr[0] != FRAME_SYNC) {
+		frame_flush(tr);
+		return FRAME_ERROR;
+	}
+
+	size = (hdr[2] << 8) | hdr[3];
+	if (size > max) {
+		frame_flush(tr);
+		return FRAME_OVERFLOW;
+	}
+
+	status = frame_read(tr, buf, size, timeout_ms);
+	if (status != FRAME_OK) {
+		frame_flush(tr);
+		return status;
+	}
+
+	*channel = hdr[1];
+	*len = size;
+	return FRAME_OK;
+}
@@ -0,0 +1,76 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FRAME_H_
+#define _FRAME_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Transport independent framing used by the vendor bulk interface.
+ *
+ * A frame is a 4 bytes header followed by the payload:
+ *   [0] FRAME_SYNC
+ *   [1] channel
+ *   [2] payload length MSB
+ *   [3] payload length LSB
+ * Each frame is sent as a single transfer. On packet based transports a
+ * zero-length packet terminates frames which are a multiple of the packet
+ * size, so the host gets exactly one frame per URB.
+ *
+ * This file has no ChibiOS dependency so it can be built on a host and run
+ * over a loopback transport.
+ */
+#define FRAME_SYNC		(0xA5)
+#define FRAME_HDR_SIZE		(4)
+#define FRAME_MAX_PAYLOAD	(0xFFFF)
+
+typedef enum {
+	FRAME_OK = 0,
+	FRAME_TIMEOUT,
+	FRAME_ERROR,
+	FRAME_OVERFLOW,
+} frame_status_t;
+
+typedef struct {
+	void *priv;
+	/* Packet size, 0 for byte stream transports without ZLP */
+	uint16_t packet_size;
+	/* Returns up to len bytes, 0 on timeout */
+	uint32_t (*read)(void *priv, uint8_t *buf, uint32_t len, uint32_t timeout_ms);
+	/* Sends buf as one transfer, len 0 sends a zero-length packet */
+	uint32_t (*write)(void *priv, const uint8_t *buf, uint32_t len);
+	/* Drops pending input after a framing error, may be NULL */
+	void (*flush)(void *priv);
+} frame_transport_t;
+
+/*
+ * frame must have FRAME_HDR_SIZE bytes of headroom before the len bytes
+ * of payload, the header is built in place to avoid a copy.
+ */
+frame_status_t frame_send(const frame_transport_t *tr, uint8_t channel,
+			  uint8_t *frame, uint32_t len);
+/*
+ * Receives one frame, the payload is stored at buf (without header).
+ */
+frame_status_t frame_recv(const frame_transport_t *tr, uint8_t *channel,
+			  uint8_t *buf, uint32_t max, uint32_t *len,
+			  uint32_t timeout_ms);
+
+#endif /* _FRAME_H_ */
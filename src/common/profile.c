@@ -0,0 +1,109 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "profile.h"
+
+static const char * const prof_names[PROF_NB] = {
+	"execute",
+	"bbio-spi",
+	"bbio-i2c",
+	"bbio-uart",
+	"bbio-raw",
+	"cprint",
+	"cprintf",
+	"pool",
+	"spi",
+	"i2c",
+	"uart",
+};
+
+static prof_stat_t prof_stats[PROF_NB];
+
+/*
+ * Called from any context, the update is done with interrupts masked
+ * as probes can be hit from both consoles.
+ */
+void prof_record(prof_probe_t probe, uint32_t start)
+{
+	prof_stat_t *stat;
+	uint32_t delta, primask;
+	uint8_t bucket;
+
+	delta = bsp_get_cyclecounter() - start;
+	bucket = (delta == 0) ? 0 : (31 - __CLZ(delta));
+	stat = &prof_stats[probe];
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if (stat->count == 0 || delta < stat->min)
+		stat->min = delta;
+	if (delta > stat->max)
+		stat->max = delta;
+	stat->count++;
+	stat->total += delta;
+	stat->hist[bucket]++;
+	__set_PRIMASK(primask);
+}
+
+void prof_reset(void)
+{
+	uint32_t primask;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	memset(prof_stats, 0, sizeof(prof_stats));
+	__set_PRIMASK(primask);
+}
+
+const char *prof_name(prof_probe_t probe)
+{
+	return prof_names[probe];
+}
+
+void prof_get(prof_probe_t probe, prof_stat_t *stat)
+{
+	uint32_t primask;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	*stat = prof_stats[probe];
+	__set_PRIMASK(primask);
+}
+
+uint32_t prof_percentile(const prof_stat_t *stat, uint8_t percent)
+{
+	uint32_t target, sum;
+	int i;
+
+	if (stat->count == 0)
+		return 0;
+
+	target = ((uint64_t)stat->count * percent + 99) / 100;
+	sum = 0;
+	for (i = 0; i < PROF_BUCKETS - 1; i++) {
+		sum += stat->hist[i];
+		if (sum >= target)
+			break;
+	}
+	/* Bucket bound, never above the largest value seen */
+	if (i == PROF_BUCKETS - 1 || ((2U << i) - 1) > stat->max)
+		return stat->max;
+	return (2U << i) - 1;
+}
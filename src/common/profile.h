@@ -0,0 +1,66 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <stdint.h>
+#include "bsp.h"
+
+/*
+ * Hot path profiler based on the DWT cycle counter.
+ * Each probe keeps count, min, max, total and a log2 histogram of the
+ * cycles spent between prof_start() and prof_record().
+ */
+typedef enum {
+	PROF_EXECUTE = 0,
+	PROF_BBIO_SPI,
+	PROF_BBIO_I2C,
+	PROF_BBIO_UART,
+	PROF_BBIO_RAWWIRE,
+	PROF_CPRINT,
+	PROF_CPRINTF,
+	PROF_POOL_ALLOC,
+	PROF_SPI,
+	PROF_I2C,
+	PROF_UART,
+	PROF_NB
+} prof_probe_t;
+
+/* Bucket n counts the deltas in [2^n, 2^(n+1)) cycles */
+#define PROF_BUCKETS	(32)
+
+typedef struct {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+	uint32_t hist[PROF_BUCKETS];
+} prof_stat_t;
+
+#define prof_start() bsp_get_cyclecounter()
+void prof_record(prof_probe_t probe, uint32_t start);
+
+void prof_reset(void);
+const char *prof_name(prof_probe_t probe);
+/* Copy of the probe statistics taken with interrupts disabled */
+void prof_get(prof_probe_t probe, prof_stat_t *stat);
+/* Upper bound in cycles of the bucket holding the given percentile */
+uint32_t prof_percentile(const prof_stat_t *stat, uint8_t percent);
+
+#endif /* _PROFILE_H_ */
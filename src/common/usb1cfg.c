@@ -16,6 +16,7 @@
 */
 
 #include "hal.h"
+#include "usb_bulk.h"
 
 extern SerialUSBDriver SDU1;
 
@@ -29,15 +30,31 @@ extern SerialUSBDriver SDU1;
 #define USBD1_DATA_AVAILABLE_EP         1
 #define USBD1_INTERRUPT_REQUEST_EP      2
 
+#ifdef HYDRABUS_USB_BULK
+/* CDC (IAD) + vendor bulk interface */
+#define VCOM_CONFIGURATION_SIZE         98
+#define VCOM_NUM_INTERFACES             3
+#else
+#define VCOM_CONFIGURATION_SIZE         67
+#define VCOM_NUM_INTERFACES             2
+#endif
+
 /*
  * USB Device Descriptor.
  */
 static const uint8_t vcom_device_descriptor_data[18] = {
 	USB_DESC_DEVICE(
+#ifdef HYDRABUS_USB_BULK
+		0x0200,        /* bcdUSB (2.0), required for IAD.  */
+		0xEF,          /* bDeviceClass (Miscellaneous).    */
+		0x02,          /* bDeviceSubClass (Common Class).  */
+		0x01,          /* bDeviceProtocol (IAD).           */
+#else
 		0x0110,        /* bcdUSB (1.1).                    */
 		0x02,          /* bDeviceClass (CDC).              */
 		0x02,          /* bDeviceSubClass.                 */
 		0x00,          /* bDeviceProtocol.                 */
+#endif
 		0x40,          /* bMaxPacketSize.                  */
 		VENDOR_ID,     /* idVendor.                        */
 		PRODUCT_ID,    /* idProduct.                       */
@@ -57,15 +74,25 @@ static const USBDescriptor vcom_device_descriptor = {
 };
 
 /* Configuration Descriptor tree for a CDC.*/
-static const uint8_t vcom_configuration_descriptor_data[67] = {
+static const uint8_t vcom_configuration_descriptor_data[VCOM_CONFIGURATION_SIZE] = {
 	/* Configuration Descriptor.*/
 	USB_DESC_CONFIGURATION(
-		67,            /* wTotalLength.                    */
-		0x02,          /* bNumInterfaces.                  */
+		VCOM_CONFIGURATION_SIZE, /* wTotalLength.          */
+		VCOM_NUM_INTERFACES, /* bNumInterfaces.            */
 		0x01,          /* bConfigurationValue.             */
 		0,             /* iConfiguration.                  */
 		0xC0,          /* bmAttributes (self powered).     */
 		50),           /* bMaxPower (100mA).               */
+#ifdef HYDRABUS_USB_BULK
+	/* Interface Association Descriptor for the CDC function.*/
+	USB_DESC_INTERFACE_ASSOCIATION(
+		0x00,          /* bFirstInterface.                 */
+		0x02,          /* bInterfaceCount.                 */
+		0x02,          /* bFunctionClass (CDC).            */
+		0x02,          /* bFunctionSubClass (ACM).         */
+		0x01,          /* bFunctionProtocol (AT commands). */
+		0),            /* iFunction.                       */
+#endif
 	/* Interface Descriptor.*/
 	USB_DESC_INTERFACE(
 		0x00,          /* bInterfaceNumber.                */
@@ -134,6 +161,29 @@ static const uint8_t vcom_configuration_descriptor_data[67] = {
 		0x02,          /* bmAttributes (Bulk). */
 		0x0040,        /* wMaxPacketSize. */
 		0x00)          /* bInterval. */
+#ifdef HYDRABUS_USB_BULK
+	/* Vendor bulk Interface Descriptor.*/
+	,USB_DESC_INTERFACE(
+		0x02,          /* bInterfaceNumber. */
+		0x00,          /* bAlternateSetting. */
+		0x02,          /* bNumEndpoints. */
+		0xFF,          /* bInterfaceClass (Vendor Specific). */
+		0x00,          /* bInterfaceSubClass. */
+		0x00,          /* bInterfaceProtocol. */
+		0x00),         /* iInterface. */
+	/* Endpoint 3 OUT Descriptor.*/
+	USB_DESC_ENDPOINT(
+		USB_BULK_EP,   /* bEndpointAddress.*/
+		0x02,          /* bmAttributes (Bulk). */
+		USB_BULK_PACKET_SIZE, /* wMaxPacketSize. */
+		0x00),         /* bInterval. */
+	/* Endpoint 3 IN Descriptor.*/
+	USB_DESC_ENDPOINT(
+		USB_BULK_EP|0x80, /* bEndpointAddress.*/
+		0x02,          /* bmAttributes (Bulk). */
+		USB_BULK_PACKET_SIZE, /* wMaxPacketSize. */
+		0x00)          /* bInterval. */
+#endif
 };
 
 /*
@@ -315,6 +365,34 @@ static const USBEndpointConfig ep2config = {
 	NULL
 };
 
+#ifdef HYDRABUS_USB_BULK
+/**
+ * @brief   IN EP3 state.
+ */
+static USBInEndpointState ep3instate;
+
+/**
+ * @brief   OUT EP3 state.
+ */
+static USBOutEndpointState ep3outstate;
+
+/**
+ * @brief   EP3 initialization structure (vendor bulk IN and OUT).
+ */
+static const USBEndpointConfig ep3config = {
+	USB_EP_MODE_TYPE_BULK,
+	NULL,
+	usb_bulk_in_cb,
+	usb_bulk_out_cb,
+	USB_BULK_PACKET_SIZE,
+	USB_BULK_PACKET_SIZE,
+	&ep3instate,
+	&ep3outstate,
+	2,
+	NULL
+};
+#endif
+
 /*
  * Handles the USB driver global events.
  */
@@ -331,9 +409,15 @@ static void usb_event(USBDriver *usbp, usbevent_t event)
 		   must be used.*/
 		usbInitEndpointI(usbp, USBD1_DATA_REQUEST_EP, &ep1config);
 		usbInitEndpointI(usbp, USBD1_INTERRUPT_REQUEST_EP, &ep2config);
+#ifdef HYDRABUS_USB_BULK
+		usbInitEndpointI(usbp, USB_BULK_EP, &ep3config);
+#endif
 
 		/* Resetting the state of the CDC subsystem.*/
 		sduConfigureHookI(&SDU1);
+#ifdef HYDRABUS_USB_BULK
+		usb_bulk_configure_hookI(usbp);
+#endif
 
 		chSysUnlockFromISR();
 		return;
@@ -346,6 +430,9 @@ static void usb_event(USBDriver *usbp, usbevent_t event)
 
     /* Disconnection event on suspend.*/
     sduSuspendHookI(&SDU1);
+#ifdef HYDRABUS_USB_BULK
+    usb_bulk_suspend_hookI(usbp);
+#endif
 
     chSysUnlockFromISR();
     return;
@@ -354,6 +441,9 @@ static void usb_event(USBDriver *usbp, usbevent_t event)
 
     /* Disconnection event on suspend.*/
     sduWakeupHookI(&SDU1);
+#ifdef HYDRABUS_USB_BULK
+    usb_bulk_wakeup_hookI(usbp);
+#endif
 
     chSysUnlockFromISR();
     return;
@@ -0,0 +1,348 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "usb_bulk.h"
+
+#ifdef HYDRABUS_USB_BULK
+
+/*
+ * OUT transfers are received in a ring of USB_BULK_RX_BUFFERS buffers so
+ * the host can queue the next transfer while the previous one is consumed.
+ * A transfer ends on a short packet or a zero-length packet.
+ */
+static uint8_t rx_buf[USB_BULK_RX_BUFFERS][USB_BULK_RX_SIZE] __attribute__ ((section(".ram4")));
+static uint8_t tx_buf[USB_BULK_TX_SIZE] __attribute__ ((section(".ram4")));
+
+static struct {
+	bool active;
+	int8_t fill;	/* Buffer armed for reception, -1 if all are full */
+	uint8_t rd;	/* Buffer being consumed */
+	uint32_t pos;	/* Read position in rx_buf[rd] */
+	uint32_t len[USB_BULK_RX_BUFFERS];
+	uint32_t tx_len;	/* Bytes of usb_bulk_channel in tx_buf */
+	thread_reference_t rx_thread;
+	thread_reference_t tx_thread;
+} bulk;
+
+static void tx_flush(void);
+
+static void rx_startI(USBDriver *usbp, uint8_t idx)
+{
+	bulk.fill = idx;
+	usbStartReceiveI(usbp, USB_BULK_EP, rx_buf[idx], USB_BULK_RX_SIZE);
+}
+
+static void rx_releaseS(uint8_t idx)
+{
+	bulk.len[idx] = 0;
+	bulk.pos = 0;
+	bulk.rd = (idx + 1) % USB_BULK_RX_BUFFERS;
+
+	/* All buffers were full, the freed one is next in the ring */
+	if (bulk.fill < 0 && bulk.active)
+		rx_startI(&USBD1, idx);
+}
+
+void usb_bulk_configure_hookI(USBDriver *usbp)
+{
+	int i;
+
+	for (i = 0; i < USB_BULK_RX_BUFFERS; i++)
+		bulk.len[i] = 0;
+	bulk.rd = 0;
+	bulk.pos = 0;
+	bulk.active = true;
+	rx_startI(usbp, 0);
+}
+
+void usb_bulk_suspend_hookI(USBDriver *usbp)
+{
+	(void)usbp;
+
+	bulk.active = false;
+	osalThreadResumeI(&bulk.rx_thread, MSG_RESET);
+	osalThreadResumeI(&bulk.tx_thread, MSG_RESET);
+}
+
+void usb_bulk_wakeup_hookI(USBDriver *usbp)
+{
+	bulk.active = (usbGetDriverStateI(usbp) == USB_ACTIVE);
+}
+
+void usb_bulk_in_cb(USBDriver *usbp, usbep_t ep)
+{
+	(void)usbp;
+	(void)ep;
+
+	osalSysLockFromISR();
+	osalThreadResumeI(&bulk.tx_thread, MSG_OK);
+	osalSysUnlockFromISR();
+}
+
+void usb_bulk_out_cb(USBDriver *usbp, usbep_t ep)
+{
+	uint32_t size;
+	uint8_t idx, next;
+
+	osalSysLockFromISR();
+	if (bulk.fill < 0) {
+		osalSysUnlockFromISR();
+		return;
+	}
+	idx = bulk.fill;
+	size = usbGetReceiveTransactionSizeX(usbp, ep);
+	if (size == 0) {
+		/* Zero-length packet terminating a frame, nothing to queue */
+		rx_startI(usbp, idx);
+	} else {
+		bulk.len[idx] = size;
+		next = (idx + 1) % USB_BULK_RX_BUFFERS;
+		if (bulk.len[next] == 0)
+			rx_startI(usbp, next);
+		else
+			bulk.fill = -1;
+		osalThreadResumeI(&bulk.rx_thread, MSG_OK);
+	}
+	osalSysUnlockFromISR();
+}
+
+bool usb_bulk_is_active(void)
+{
+	return bulk.active;
+}
+
+/*
+ * Returns up to len bytes of the current OUT transfer, 0 on timeout or
+ * if the interface is not configured.
+ */
+uint32_t usb_bulk_read(uint8_t *buf, uint32_t len, uint32_t timeout_ms)
+{
+	uint32_t n;
+	uint8_t rd;
+
+	/* The host may wait for the answer before sending more */
+	tx_flush();
+
+	osalSysLock();
+	while (bulk.len[bulk.rd] == 0) {
+		if (!bulk.active ||
+		    osalThreadSuspendTimeoutS(&bulk.rx_thread,
+					      TIME_MS2I(timeout_ms)) != MSG_OK) {
+			osalSysUnlock();
+			return 0;
+		}
+	}
+	rd = bulk.rd;
+	osalSysUnlock();
+
+	n = bulk.len[rd] - bulk.pos;
+	if (n > len)
+		n = len;
+	memcpy(buf, &rx_buf[rd][bulk.pos], n);
+	bulk.pos += n;
+
+	if (bulk.pos == bulk.len[rd]) {
+		osalSysLock();
+		rx_releaseS(rd);
+		osalSysUnlock();
+	}
+	return n;
+}
+
+/*
+ * Sends buf as a single IN transfer directly from the caller buffer and
+ * waits for completion. len 0 sends a zero-length packet.
+ */
+static uint32_t tx_send(const uint8_t *buf, uint32_t len)
+{
+	msg_t msg;
+
+	osalSysLock();
+	if (!bulk.active) {
+		osalSysUnlock();
+		return 0;
+	}
+	usbStartTransmitI(&USBD1, USB_BULK_EP, buf, len);
+	msg = osalThreadSuspendS(&bulk.tx_thread);
+	osalSysUnlock();
+
+	return (msg == MSG_OK) ? len : 0;
+}
+
+/* Stream data ends its transfer with a ZLP when it fills the last packet */
+static uint32_t tx_send_stream(const uint8_t *buf, uint32_t len)
+{
+	if (tx_send(buf, len) != len)
+		return 0;
+	if ((len % USB_BULK_PACKET_SIZE) == 0)
+		tx_send(NULL, 0);
+	return len;
+}
+
+static void tx_flush(void)
+{
+	uint32_t len;
+
+	len = bulk.tx_len;
+	bulk.tx_len = 0;
+	if (len > 0)
+		tx_send_stream(tx_buf, len);
+}
+
+/* Pending output of usb_bulk_channel is sent first to keep the order */
+uint32_t usb_bulk_write(const uint8_t *buf, uint32_t len)
+{
+	tx_flush();
+	return tx_send(buf, len);
+}
+
+/* Drops all the received data not read yet */
+void usb_bulk_flush(void)
+{
+	osalSysLock();
+	while (bulk.len[bulk.rd] != 0)
+		rx_releaseS(bulk.rd);
+	osalSysUnlock();
+}
+
+static uint32_t transport_read(void *priv, uint8_t *buf, uint32_t len,
+			       uint32_t timeout_ms)
+{
+	(void)priv;
+	return usb_bulk_read(buf, len, timeout_ms);
+}
+
+static uint32_t transport_write(void *priv, const uint8_t *buf, uint32_t len)
+{
+	(void)priv;
+	return usb_bulk_write(buf, len);
+}
+
+static void transport_flush(void *priv)
+{
+	(void)priv;
+	usb_bulk_flush();
+}
+
+const frame_transport_t usb_bulk_transport = {
+	.priv = NULL,
+	.packet_size = USB_BULK_PACKET_SIZE,
+	.read = transport_read,
+	.write = transport_write,
+	.flush = transport_flush,
+};
+
+static size_t channel_write(void *ip, const uint8_t *bp, size_t n)
+{
+	(void)ip;
+
+	if (bulk.tx_len + n > USB_BULK_TX_SIZE)
+		tx_flush();
+	/* Large blocks are sent as is from the caller buffer */
+	if (n > USB_BULK_TX_SIZE)
+		return tx_send_stream(bp, n);
+	memcpy(&tx_buf[bulk.tx_len], bp, n);
+	bulk.tx_len += n;
+	return n;
+}
+
+static size_t channel_writet(void *ip, const uint8_t *bp, size_t n,
+			     sysinterval_t timeout)
+{
+	(void)timeout;
+	return channel_write(ip, bp, n);
+}
+
+/*
+ * Reads up to n bytes, waiting at most timeout for each OUT transfer.
+ * TIME_INFINITE waits for the n bytes as long as the interface is up.
+ */
+static size_t channel_readt(void *ip, uint8_t *bp, size_t n,
+			    sysinterval_t timeout)
+{
+	uint32_t timeout_ms, len;
+	size_t done;
+
+	(void)ip;
+
+	timeout_ms = (timeout == TIME_INFINITE) ? USB_BULK_POLL_MS :
+		     TIME_I2MS(timeout);
+	done = 0;
+	while (done < n) {
+		if (!usb_bulk_is_active()) {
+			/* Do not spin while the host is not there */
+			tx_flush();
+			osalThreadSleepMilliseconds(USB_BULK_POLL_MS);
+			break;
+		}
+		len = usb_bulk_read(bp + done, n - done, timeout_ms);
+		if (len == 0 && timeout != TIME_INFINITE)
+			break;
+		done += len;
+	}
+	return done;
+}
+
+static size_t channel_read(void *ip, uint8_t *bp, size_t n)
+{
+	return channel_readt(ip, bp, n, TIME_INFINITE);
+}
+
+static msg_t channel_putt(void *ip, uint8_t b, sysinterval_t timeout)
+{
+	(void)timeout;
+	return (channel_write(ip, &b, 1) == 1) ? MSG_OK : MSG_RESET;
+}
+
+static msg_t channel_put(void *ip, uint8_t b)
+{
+	return channel_putt(ip, b, TIME_INFINITE);
+}
+
+static msg_t channel_gett(void *ip, sysinterval_t timeout)
+{
+	uint8_t b;
+
+	if (channel_readt(ip, &b, 1, timeout) != 1)
+		return (timeout == TIME_INFINITE) ? MSG_RESET : MSG_TIMEOUT;
+	return b;
+}
+
+static msg_t channel_get(void *ip)
+{
+	return channel_gett(ip, TIME_INFINITE);
+}
+
+static const struct BaseChannelVMT channel_vmt = {
+	.write = channel_write,
+	.read = channel_read,
+	.put = channel_put,
+	.get = channel_get,
+	.putt = channel_putt,
+	.gett = channel_gett,
+	.writet = channel_writet,
+	.readt = channel_readt,
+};
+
+BaseChannel usb_bulk_channel = {
+	.vmt = &channel_vmt,
+};
+
+#endif /* HYDRABUS_USB_BULK */
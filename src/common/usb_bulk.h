@@ -0,0 +1,57 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _USB_BULK_H_
+#define _USB_BULK_H_
+
+#include "hal.h"
+#include "frame.h"
+
+/*
+ * Vendor class bulk interface on USB1, enabled with HYDRAFW_USB_BULK=1.
+ * It lives next to the CDC console and uses its own endpoint pair.
+ */
+#define USB_BULK_EP		(3)
+#define USB_BULK_PACKET_SIZE	(64)
+/* Size of one OUT transfer, must be a multiple of USB_BULK_PACKET_SIZE */
+#define USB_BULK_RX_SIZE	(2048)
+#define USB_BULK_RX_BUFFERS	(2)
+/* Output of usb_bulk_channel is gathered up to this size per IN transfer */
+#define USB_BULK_TX_SIZE	(512)
+/* Wait between checks of the interface state when nothing is received */
+#define USB_BULK_POLL_MS	(100)
+
+void usb_bulk_configure_hookI(USBDriver *usbp);
+void usb_bulk_suspend_hookI(USBDriver *usbp);
+void usb_bulk_wakeup_hookI(USBDriver *usbp);
+void usb_bulk_in_cb(USBDriver *usbp, usbep_t ep);
+void usb_bulk_out_cb(USBDriver *usbp, usbep_t ep);
+
+bool usb_bulk_is_active(void);
+uint32_t usb_bulk_read(uint8_t *buf, uint32_t len, uint32_t timeout_ms);
+uint32_t usb_bulk_write(const uint8_t *buf, uint32_t len);
+void usb_bulk_flush(void);
+
+extern const frame_transport_t usb_bulk_transport;
+/*
+ * Byte stream over usb_bulk_transport for the BBIO console. Writes are
+ * gathered and sent before the next read or transport transfer.
+ */
+extern BaseChannel usb_bulk_channel;
+
+#endif /* _USB_BULK_H_ */
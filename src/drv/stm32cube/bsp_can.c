@@ -14,6 +14,7 @@ limitations under the License.
 */
 #include "bsp_can.h"
 #include "bsp_can_conf.h"
+#include "bsp_resource.h"
 #include "stm32.h"
 
 /*
@@ -25,6 +26,12 @@ Warning in order to use this driver all GPIOs peripherals shall be enabled.
 static CAN_HandleTypeDef can_handle[NB_CAN];
 static mode_config_proto_t* can_mode_conf[NB_CAN];
 
+/* Peripheral, TX, RX (see bsp_can_conf.h) */
+static const uint8_t can_res[NB_CAN][3] = {
+	{ BSP_RES_CAN1, BSP_RES_PB(9), BSP_RES_PB(8) },
+	{ BSP_RES_CAN2, BSP_RES_PB(6), BSP_RES_PB(5) }
+};
+
 /**
   * @brief  Init low level hardware: GPIO, CLOCK, NVIC...
   * @param  dev_num: CAN dev num
@@ -268,6 +275,9 @@ bsp_status_t bsp_can_init(bsp_dev_can_t dev_num, mode_config_proto_t* mode_conf)
 	CAN_HandleTypeDef* hcan;
 	bsp_status_t status;
 
+	if(bsp_resource_claim(can_res[dev_num], sizeof(can_res[0])) != BSP_OK)
+		return BSP_BUSY;
+
 	can_mode_conf[dev_num] = mode_conf;
 	hcan = &can_handle[dev_num];
 
@@ -427,6 +437,9 @@ bsp_status_t bsp_can_deinit(bsp_dev_can_t dev_num)
 	CAN_HandleTypeDef* hcan;
 	bsp_status_t status;
 
+	if(bsp_resource_release(can_res[dev_num], sizeof(can_res[0])) != BSP_OK)
+		return BSP_BUSY;
+
 	hcan = &can_handle[dev_num];
 
 	/* Stop the CAN controller */
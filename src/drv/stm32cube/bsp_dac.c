@@ -12,15 +12,29 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include "ch.h"
 #include "bsp_dac.h"
 #include "bsp_dac_conf.h"
+#include "bsp_resource.h"
 #include "stm32.h"
 
+#include <string.h>
+
 #define NB_DAC (BSP_DEV_DAC_END)
 static DAC_HandleTypeDef dac_handle[NB_DAC];
 static DAC_ChannelConfTypeDef dac_chan_conf[NB_DAC];
 
+/* Waveform DMA stream of each DAC (see bsp_dac_conf.h) */
+static const uint8_t dac_wave_res[NB_DAC] = { BSP_RES_DMA1_S5, BSP_RES_DMA1_S6 };
+
+/* Timer triggered circular DMA waveform playback */
+static struct {
+	uint32_t nb_samples;
+	bsp_dac_wave_stats_t stats;
+} wave[NB_DAC];
+
 void bsp_dac_timer_stop(bsp_dev_dac_t dev_num);
+uint32_t bsp_dac_trigger(bsp_dev_dac_t dev_num);
 
 /** \brief DAC GPIO HW DeInit.
  *
@@ -104,6 +118,9 @@ bsp_status_t bsp_dac_init(bsp_dev_dac_t dev_num)
 	DAC_HandleTypeDef* hdac;
 	DAC_ChannelConfTypeDef* hdac_chan;
 
+	if(wave[dev_num].nb_samples != 0)
+		bsp_dac_wave_stop(dev_num, NULL);
+
 	/* Configure the DAC peripheral */
 	__DAC_CLK_ENABLE();
 
@@ -136,6 +153,31 @@ bsp_status_t bsp_dac_init(bsp_dev_dac_t dev_num)
 	return BSP_OK;
 }
 
+static DMA_Stream_TypeDef *dac_dma_stream(bsp_dev_dac_t dev_num)
+{
+	return (dev_num == BSP_DEV_DAC2) ? BSP_DAC2_DMA_STREAM : BSP_DAC1_DMA_STREAM;
+}
+
+static uint32_t dac_dma_flags(bsp_dev_dac_t dev_num)
+{
+	return (dev_num == BSP_DEV_DAC2) ? BSP_DAC2_DMA_FLAGS : BSP_DAC1_DMA_FLAGS;
+}
+
+/* Stops the waveform DMA stream and the DAC DMA requests */
+static void dac_dma_stop(bsp_dev_dac_t dev_num)
+{
+	DMA_Stream_TypeDef *stream = dac_dma_stream(dev_num);
+
+	if(dev_num == BSP_DEV_DAC2)
+		DAC->CR &= ~DAC_CR_DMAEN2;
+	else
+		DAC->CR &= ~DAC_CR_DMAEN1;
+
+	stream->CR &= ~DMA_SxCR_EN;
+	while(stream->CR & DMA_SxCR_EN);
+	DMA1->HIFCR = dac_dma_flags(dev_num);
+}
+
 /** \brief De-initialize the DAC timer & device.
  *
  * \param dev_num bsp_dev_dac_t: DAC dev num.
@@ -144,6 +186,9 @@ bsp_status_t bsp_dac_init(bsp_dev_dac_t dev_num)
  */
 bsp_status_t bsp_dac_deinit(bsp_dev_dac_t dev_num)
 {
+	if(wave[dev_num].nb_samples != 0)
+		bsp_dac_wave_stop(dev_num, NULL);
+
 	bsp_dac_timer_stop(dev_num);
 
 	/* DeInit the low level hardware: GPIO, CLOCK, NVIC... */
@@ -191,17 +236,8 @@ bsp_status_t bsp_dac_write_u12(bsp_dev_dac_t dev_num, uint16_t data)
 	return status;
 }
 
-/**
-  * @brief TIM6/7 Configuration Init
-  * @note TIM6/7 configuration is based on APB1 frequency(42MHz)
-  * @note Internal triangle counter is incremented
-  * @note three APB1 clock cycles after each trigger event
-  * @note Final Triangle Freq Hz=((42MHz/3)/(2^(MAMPx[3:0]+1)) / ((TIM6.Period+1)/3)
-  * @note TIM6/7.Period shall be min 3
-  * \param dev_num bsp_dev_dac_t: DAC dev num.
-  * @retval None
-  */
-void bsp_dac_timer_init(bsp_dev_dac_t dev_num)
+/* Starts TIM6/7 with an update (TRGO) every (prescaler+1)*(period+1) clocks */
+static void dac_timer_start(bsp_dev_dac_t dev_num, uint32_t prescaler, uint32_t period)
 {
 	static TIM_HandleTypeDef  htim;
 	TIM_MasterConfigTypeDef sMasterConfig;
@@ -221,10 +257,8 @@ void bsp_dac_timer_init(bsp_dev_dac_t dev_num)
 		return;
 	}
 
-	/* 2047 = 20Hz Triangle Frequency */
-	/* 1 about 10.25KHz Triangle Frequency */
-	htim.Init.Period = 2048-1; /*  Corresponding to 5Hz Triangle Frequency (DAC_DORx is updated after 3 APB1 cycles) */
-	htim.Init.Prescaler = 0;
+	htim.Init.Period = period;
+	htim.Init.Prescaler = prescaler;
 	htim.Init.ClockDivision = 0;
 	htim.Init.CounterMode = TIM_COUNTERMODE_UP;
 	HAL_TIM_Base_Init(&htim);
@@ -239,6 +273,24 @@ void bsp_dac_timer_init(bsp_dev_dac_t dev_num)
 	HAL_TIM_Base_Start(&htim);
 }
 
+/**
+  * @brief TIM6/7 Configuration Init
+  * @note TIM6/7 configuration is based on APB1 frequency(42MHz)
+  * @note Internal triangle counter is incremented
+  * @note three APB1 clock cycles after each trigger event
+  * @note Final Triangle Freq Hz=((42MHz/3)/(2^(MAMPx[3:0]+1)) / ((TIM6.Period+1)/3)
+  * @note TIM6/7.Period shall be min 3
+  * \param dev_num bsp_dev_dac_t: DAC dev num.
+  * @retval None
+  */
+void bsp_dac_timer_init(bsp_dev_dac_t dev_num)
+{
+	/* 2047 = 20Hz Triangle Frequency */
+	/* 1 about 10.25KHz Triangle Frequency */
+	/* 2048-1 corresponds to 5Hz Triangle Frequency (DAC_DORx is updated after 3 APB1 cycles) */
+	dac_timer_start(dev_num, 0, 2048-1);
+}
+
 /**
   * @brief  TIM6/7 Configuration Stop
   * \param dev_num bsp_dev_dac_t: DAC dev num.
@@ -302,6 +354,9 @@ bsp_status_t bsp_dac_triangle(bsp_dev_dac_t dev_num)
 	DAC_HandleTypeDef* hdac;
 	DAC_ChannelConfTypeDef* hdac_chan;
 
+	if(wave[dev_num].nb_samples != 0)
+		bsp_dac_wave_stop(dev_num, NULL);
+
 	/* Configure the DAC peripheral */
 	__DAC_CLK_ENABLE();
 
@@ -352,6 +407,9 @@ bsp_status_t bsp_dac_noise(bsp_dev_dac_t dev_num)
 	DAC_HandleTypeDef* hdac;
 	DAC_ChannelConfTypeDef* hdac_chan;
 
+	if(wave[dev_num].nb_samples != 0)
+		bsp_dac_wave_stop(dev_num, NULL);
+
 	/* Configure the DAC peripheral */
 	__DAC_CLK_ENABLE();
 
@@ -389,3 +447,174 @@ bsp_status_t bsp_dac_noise(bsp_dev_dac_t dev_num)
 
 	return BSP_OK;
 }
+
+/** \brief Play a waveform from memory using timer triggered circular DMA
+ *
+ * The buffer is played in a loop until bsp_dac_wave_stop() and must stay
+ * allocated meanwhile. For streaming, each half of the buffer can be
+ * refilled once bsp_dac_wave_wait() returns it.
+ *
+ * \param dev_num bsp_dev_dac_t: DAC dev num.
+ * \param buffer const uint16_t*: 12bits right aligned samples
+ * \param nb_samples uint32_t: number of samples (2 to 65535)
+ * \param rate uint32_t*: requested sample rate in Hz, updated to the actual rate
+ * \return bsp_status_t: status of the start.
+ *
+ */
+bsp_status_t bsp_dac_wave_start(bsp_dev_dac_t dev_num, const uint16_t *buffer, uint32_t nb_samples, uint32_t *rate)
+{
+	DMA_Stream_TypeDef *stream = dac_dma_stream(dev_num);
+	uint32_t dac_chan_num, div, period;
+	DAC_HandleTypeDef* hdac;
+	DAC_ChannelConfTypeDef* hdac_chan;
+
+	if(*rate == 0 || *rate > BSP_DAC_WAVE_MAX_RATE)
+		return BSP_ERROR;
+	if(nb_samples < 2 || nb_samples > 0xffff)
+		return BSP_ERROR;
+
+	if(bsp_resource_claim(&dac_wave_res[dev_num], 1) != BSP_OK)
+		return BSP_BUSY;
+
+	/* Sample rate = timer clock / (div * period), period fits in 16bits */
+	div = (BSP_DAC_TIMER_FREQ / *rate) / 0x10000 + 1;
+	period = (BSP_DAC_TIMER_FREQ / div) / *rate;
+	*rate = BSP_DAC_TIMER_FREQ / (div * period);
+
+	/* Configure the DAC peripheral */
+	__DAC_CLK_ENABLE();
+	BSP_DAC_DMA_CLK_ENABLE();
+	bsp_dac_timer_stop(dev_num);
+	dac_dma_stop(dev_num);
+
+	/* Init the DAC GPIO */
+	dac_gpio_hw_init(dev_num);
+
+	hdac = &dac_handle[dev_num];
+	hdac_chan = &dac_chan_conf[dev_num];
+
+	hdac->Instance =  DAC;
+	if(HAL_DAC_Init(hdac) != HAL_OK) {
+		bsp_resource_release(&dac_wave_res[dev_num], 1);
+		return BSP_ERROR;
+	}
+
+	/* Configure DAC regular channel, also clears triangle/noise generation */
+	dac_chan_num = get_dac_chan_num(dev_num);
+	hdac_chan->DAC_Trigger = bsp_dac_trigger(dev_num);
+	hdac_chan->DAC_OutputBuffer = DAC_OUTPUTBUFFER_ENABLE;
+	if(HAL_DAC_ConfigChannel(hdac, hdac_chan, dac_chan_num) != HAL_OK) {
+		bsp_resource_release(&dac_wave_res[dev_num], 1);
+		return BSP_ERROR;
+	}
+
+	/* First sample is output before the first trigger */
+	HAL_DAC_SetValue(hdac, dac_chan_num, DAC_ALIGN_12B_R, buffer[0] & 0x0FFF);
+
+	if(dev_num == BSP_DEV_DAC2)
+		stream->PAR = (uint32_t)&DAC->DHR12R2;
+	else
+		stream->PAR = (uint32_t)&DAC->DHR12R1;
+	stream->M0AR = (uint32_t)buffer;
+	stream->NDTR = nb_samples;
+	stream->FCR = 0;
+	stream->CR = BSP_DAC_DMA_CHANNEL | DMA_SxCR_PL_1 |
+		     DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 |
+		     DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_DIR_0;
+	stream->CR |= DMA_SxCR_EN;
+
+	if(dev_num == BSP_DEV_DAC2) {
+		DAC->SR = DAC_SR_DMAUDR2;
+		DAC->CR |= DAC_CR_DMAEN2;
+	} else {
+		DAC->SR = DAC_SR_DMAUDR1;
+		DAC->CR |= DAC_CR_DMAEN1;
+	}
+
+	/* Enable DAC channel */
+	if(HAL_DAC_Start(hdac, dac_chan_num) != HAL_OK) {
+		dac_dma_stop(dev_num);
+		bsp_resource_release(&dac_wave_res[dev_num], 1);
+		return BSP_ERROR;
+	}
+
+	wave[dev_num].nb_samples = nb_samples;
+	memset(&wave[dev_num].stats, 0, sizeof(bsp_dac_wave_stats_t));
+
+	/* Playback outlives the command, the stream stays leased until stop */
+	bsp_resource_keep(&dac_wave_res[dev_num], 1);
+
+	dac_timer_start(dev_num, div - 1, period - 1);
+
+	return BSP_OK;
+}
+
+/** \brief Wait until half of the waveform buffer has been played
+ *
+ * When both halves were played since the last call the half not being
+ * played is returned and an underrun is counted.
+ *
+ * \param dev_num bsp_dev_dac_t: DAC dev num.
+ * \param timeout sysinterval_t: maximum time to wait
+ * \return int: half free for refill (0: first, 1: second), -1 on timeout
+ *
+ */
+int bsp_dac_wave_wait(bsp_dev_dac_t dev_num, sysinterval_t timeout)
+{
+	DMA_Stream_TypeDef *stream = dac_dma_stream(dev_num);
+	uint32_t ht, tc, flags;
+	systime_t start;
+
+	if(wave[dev_num].nb_samples == 0)
+		return -1;
+
+	if(dev_num == BSP_DEV_DAC2) {
+		ht = DMA_HISR_HTIF6;
+		tc = DMA_HISR_TCIF6;
+	} else {
+		ht = DMA_HISR_HTIF5;
+		tc = DMA_HISR_TCIF5;
+	}
+
+	start = chVTGetSystemTime();
+	while(!(DMA1->HISR & (ht | tc))) {
+		if(chVTTimeElapsedSinceX(start) >= timeout)
+			return -1;
+		chThdSleep(1);
+	}
+	flags = DMA1->HISR & (ht | tc);
+	DMA1->HIFCR = flags;
+
+	if(flags == (ht | tc))
+		wave[dev_num].stats.underruns++;
+	wave[dev_num].stats.halves++;
+
+	/* NDTR counts down, the other half is the one being played */
+	return (stream->NDTR > wave[dev_num].nb_samples / 2) ? 1 : 0;
+}
+
+/** \brief Stop waveform playback, the output keeps the last sample.
+ *
+ * \param dev_num bsp_dev_dac_t: DAC dev num.
+ * \param stats bsp_dac_wave_stats_t*: statistics output, can be NULL
+ *
+ */
+void bsp_dac_wave_stop(bsp_dev_dac_t dev_num, bsp_dac_wave_stats_t *stats)
+{
+	uint32_t udr;
+
+	bsp_dac_timer_stop(dev_num);
+	dac_dma_stop(dev_num);
+
+	udr = (dev_num == BSP_DEV_DAC2) ? DAC_SR_DMAUDR2 : DAC_SR_DMAUDR1;
+	if(DAC->SR & udr) {
+		DAC->SR = udr;
+		wave[dev_num].stats.dma_errors++;
+	}
+
+	bsp_resource_release(&dac_wave_res[dev_num], 1);
+	wave[dev_num].nb_samples = 0;
+
+	if(stats != NULL)
+		*stats = wave[dev_num].stats;
+}
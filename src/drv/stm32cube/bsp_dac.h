@@ -29,6 +29,15 @@ typedef enum {
 	BSP_DAC_12BITS = 1, /* Use 12bits */
 } bsp_dac_nb_bits_t;
 
+/* Highest waveform sample rate, DAC settling time is about 1us */
+#define BSP_DAC_WAVE_MAX_RATE	(1000000)
+
+typedef struct {
+	uint32_t halves;	/* Half buffers handed back for refill */
+	uint32_t underruns;	/* Half buffers played again before being refilled */
+	uint32_t dma_errors;	/* DAC DMA underruns, sample rate too high */
+} bsp_dac_wave_stats_t;
+
 bsp_status_t bsp_dac_init(bsp_dev_dac_t dev_num);
 bsp_status_t bsp_dac_deinit(bsp_dev_dac_t dev_num);
 void bsp_dac_disable(void);
@@ -37,4 +46,8 @@ bsp_status_t bsp_dac_write_u12(bsp_dev_dac_t dev_num, uint16_t data);
 bsp_status_t bsp_dac_triangle(bsp_dev_dac_t dev_num);
 bsp_status_t bsp_dac_noise(bsp_dev_dac_t dev_num);
 
+bsp_status_t bsp_dac_wave_start(bsp_dev_dac_t dev_num, const uint16_t *buffer, uint32_t nb_samples, uint32_t *rate);
+int bsp_dac_wave_wait(bsp_dev_dac_t dev_num, sysinterval_t timeout);
+void bsp_dac_wave_stop(bsp_dev_dac_t dev_num, bsp_dac_wave_stats_t *stats);
+
 #endif /* _BSP_DAC_H_ */
@@ -27,21 +27,20 @@ limitations under the License.
 #define BSP_DAC2_PORT         GPIOA
 #define BSP_DAC2_PIN          GPIO_PIN_5 // PA.5
 
-/* Definition for DAC1 DMA Channel =>
-Conflict with mcuconf.h => #define STM32_UART_USART2_RX_DMA_STREAM STM32_DMA_STREAM_ID(1, 5)
-*/
-/*
-#define DAC1_DMA_CHANNEL	DMA_CHANNEL_7
-#define DAC1_DMA_STREAM		DMA1_Stream5
-#define DAC1_DMA_CLK_ENABLE()	__DMA1_CLK_ENABLE()
-*/
-/* Definition for DAC2 DMA Channel =>
-Conflict with mcuconf.h => #define STM32_UART_USART2_TX_DMA_STREAM STM32_DMA_STREAM_ID(1, 6)
-  */
-/*
-#define DAC2_DMA_CHANNEL	DMA_CHANNEL_7
-#define DAC2_DMA_STREAM		DMA1_Stream6
-#define DAC2_DMA_CLK_ENABLE()	__DMA1_CLK_ENABLE()
+/* Definition for DAC1/DAC2 waveform DMA (DMA1 Stream5/6 Channel7) =>
+Free in mcuconf.h as long as STM32_UART_USE_USART2 and STM32_I2C_USE_I2C1
+are FALSE (USART2 RX/TX and I2C1 TX DMA streams)
 */
+#define BSP_DAC1_DMA_STREAM	DMA1_Stream5
+#define BSP_DAC2_DMA_STREAM	DMA1_Stream6
+#define BSP_DAC_DMA_CHANNEL	DMA_CHANNEL_7
+#define BSP_DAC_DMA_CLK_ENABLE()	__DMA1_CLK_ENABLE()
+#define BSP_DAC1_DMA_FLAGS	(DMA_HISR_FEIF5 | DMA_HISR_DMEIF5 | DMA_HISR_TEIF5 | \
+				 DMA_HISR_HTIF5 | DMA_HISR_TCIF5)
+#define BSP_DAC2_DMA_FLAGS	(DMA_HISR_FEIF6 | DMA_HISR_DMEIF6 | DMA_HISR_TEIF6 | \
+				 DMA_HISR_HTIF6 | DMA_HISR_TCIF6)
+
+/* TIM6/7 kernel clock (APB1 prescaler is not 1) */
+#define BSP_DAC_TIMER_FREQ	(bsp_get_apb1_freq() * 2)
 
 #endif /* _BSP_DAC_CONF_H_ */
@@ -16,9 +16,34 @@ limitations under the License.
 #include "common.h"
 #include "bsp_freq.h"
 #include "bsp_freq_conf.h"
+#include "bsp_resource.h"
+
+#include <string.h>
 
 #define NB_FREQ (BSP_DEV_freq_END)
 
+/* Timer, capture DMA, input pin (see bsp_freq_conf.h) */
+static const uint8_t freq_res[] = { BSP_RES_FREQ1, BSP_RES_DMA2_S2, BSP_RES_PC(6) };
+
+/* Continuous capture ring, one (period, high time) pair per rising edge */
+static struct {
+	uint16_t *buffer;
+	uint32_t nb_samples;
+	uint32_t pos;
+	uint32_t scale;
+	bool skip;
+	/* Accumulators for the current gate */
+	uint32_t edges;
+	volatile uint32_t errors;	/* Updated from the timer interrupt */
+	uint64_t sum;
+	uint64_t sum_high;
+	uint32_t min;
+	uint32_t max;
+	uint32_t ref;
+	int64_t sum_d;
+	uint64_t sum_d2;
+} capture;
+
 
 /** \brief FREQ GPIO HW DeInit.
  *
@@ -54,6 +79,29 @@ static void freq_gpio_hw_init(bsp_dev_freq_t dev_num)
 	}
 }
 
+/* Stops the timer, capture DMA and releases the input pin */
+static void freq_stop(bsp_dev_freq_t dev_num)
+{
+	TIM_HandleTypeDef  htim;
+
+	/* The capture DMA stream is only used while capture runs */
+	if(capture.buffer != NULL) {
+		BSP_FREQ1_TIMER->DIER &= ~(TIM_DIER_CC1DE | TIM_DIER_UIE);
+		nvicDisableVector(BSP_FREQ1_UP_IRQ_NUMBER);
+		BSP_FREQ1_DMA_STREAM->CR &= ~DMA_SxCR_EN;
+		while(BSP_FREQ1_DMA_STREAM->CR & DMA_SxCR_EN);
+		BSP_FREQ1_TIMER->DCR = 0;
+		capture.buffer = NULL;
+	}
+
+	htim.Instance = BSP_FREQ1_TIMER;
+	HAL_TIM_IC_Stop(&htim, TIM_CHANNEL_1);
+	HAL_TIM_IC_Stop(&htim, TIM_CHANNEL_2);
+
+	/* DeInit the low level hardware: GPIO, CLOCK, NVIC... */
+	freq_gpio_hw_deinit(dev_num);
+}
+
 /** \brief Init FREQ device.
  *
  * \param dev_num bsp_dev_freq_t: FREQ dev num.
@@ -67,7 +115,10 @@ bsp_status_t bsp_freq_init(bsp_dev_freq_t dev_num, uint16_t scale)
 	TIM_SlaveConfigTypeDef slave_conf;
 	uint32_t channel;
 
-	bsp_freq_deinit(dev_num);
+	if(bsp_resource_claim(freq_res, sizeof(freq_res)) != BSP_OK)
+		return BSP_BUSY;
+
+	freq_stop(dev_num);
 
 	/* Configure the FREQ (TIM8) peripheral */
 	__TIM8_CLK_ENABLE();
@@ -134,14 +185,10 @@ bsp_status_t bsp_freq_init(bsp_dev_freq_t dev_num, uint16_t scale)
  */
 bsp_status_t bsp_freq_deinit(bsp_dev_freq_t dev_num)
 {
-	TIM_HandleTypeDef  htim;
-
-	htim.Instance = BSP_FREQ1_TIMER;
-	HAL_TIM_IC_Stop(&htim, TIM_CHANNEL_1);
-	HAL_TIM_IC_Stop(&htim, TIM_CHANNEL_2);
+	if(bsp_resource_release(freq_res, sizeof(freq_res)) != BSP_OK)
+		return BSP_BUSY;
 
-	/* DeInit the low level hardware: GPIO, CLOCK, NVIC... */
-	freq_gpio_hw_deinit(dev_num);
+	freq_stop(dev_num);
 
 	return BSP_OK;
 }
@@ -265,3 +312,290 @@ bsp_status_t bsp_freq_get_baudrate(bsp_dev_freq_t dev_num, uint32_t *baudrate)
 
 	return BSP_OK;
 }
+
+/** \brief Start capturing the duration of each level of the input
+ *
+ * The counter is reset on both edges of the input (TI1F_ED) which channel 1
+ * also captures, so each DMA transfer is the time since the previous edge.
+ * The first sample is the time since the start, durations longer than
+ * 0xffff ticks wrap. Capture stops when the buffer is full.
+ *
+ * \param dev_num bsp_dev_freq_t: FREQ dev num.
+ * \param scale uint16_t: timer prescaler, one tick is scale/168MHz
+ * \param buffer uint16_t*: durations in ticks
+ * \param nb_samples uint16_t: number of durations to capture
+ * \param level uint8_t*: input level before the first edge
+ * \return bsp_status_t: status of the init.
+ *
+ */
+bsp_status_t bsp_freq_edges_start(bsp_dev_freq_t dev_num, uint16_t scale,
+				  uint16_t *buffer, uint16_t nb_samples, uint8_t *level)
+{
+	DMA_Stream_TypeDef *stream = BSP_FREQ1_DMA_STREAM;
+
+	if(bsp_freq_init(dev_num, scale) != BSP_OK) {
+		return BSP_ERROR;
+	}
+
+	/* IC1 on TRC, counter reset on TI1 edge detector */
+	BSP_FREQ1_TIMER->CCER &= ~(TIM_CCER_CC1E | TIM_CCER_CC2E);
+	BSP_FREQ1_TIMER->CCMR1 = (BSP_FREQ1_TIMER->CCMR1 & ~TIM_CCMR1_CC1S) |
+				 TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC1S_1;
+	BSP_FREQ1_TIMER->SMCR = TIM_TS_TI1F_ED | TIM_SLAVEMODE_RESET;
+
+	BSP_FREQ1_DMA_CLK_ENABLE();
+	stream->CR &= ~DMA_SxCR_EN;
+	while(stream->CR & DMA_SxCR_EN);
+	BSP_FREQ1_DMA_CLEAR_FLAGS();
+
+	stream->PAR = (uint32_t)&BSP_FREQ1_TIMER->CCR1;
+	stream->M0AR = (uint32_t)buffer;
+	stream->NDTR = nb_samples;
+	stream->FCR = 0;
+	stream->CR = BSP_FREQ1_DMA_CHANNEL | DMA_SxCR_PL_1 |
+		     DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 | DMA_SxCR_MINC;
+	stream->CR |= DMA_SxCR_EN;
+
+	*level = (BSP_FREQ1_PORT->IDR & BSP_FREQ1_PIN) ? 1 : 0;
+
+	BSP_FREQ1_TIMER->SR = 0;
+	BSP_FREQ1_TIMER->DIER |= TIM_DIER_CC1DE | TIM_DIER_UIE;
+	nvicEnableVector(BSP_FREQ1_UP_IRQ_NUMBER, BSP_FREQ1_UP_IRQ_PRIORITY);
+	BSP_FREQ1_TIMER->CCER |= TIM_CCER_CC1E;
+	BSP_FREQ1_TIMER->CR1 |= TIM_CR1_CEN;
+
+	return BSP_OK;
+}
+
+/** \brief Number of durations captured since bsp_freq_edges_start()
+ *
+ * \param dev_num bsp_dev_freq_t: FREQ dev num.
+ * \param nb_samples uint16_t: size given to bsp_freq_edges_start()
+ * \return uint16_t: durations available in the buffer
+ *
+ */
+uint16_t bsp_freq_edges_count(bsp_dev_freq_t dev_num, uint16_t nb_samples)
+{
+	(void)dev_num;
+
+	return nb_samples - BSP_FREQ1_DMA_STREAM->NDTR;
+}
+
+static void freq_capture_reset(void)
+{
+	capture.edges = 0;
+	capture.sum = 0;
+	capture.sum_high = 0;
+	capture.min = 0xffffffff;
+	capture.max = 0;
+	capture.sum_d = 0;
+	capture.sum_d2 = 0;
+}
+
+/** \brief TIM8 update interrupt, counts each counter overflow.
+ *
+ * Only overflows raise it during capture (URS set), a period out of range
+ * raises it once per counter wrap.
+ */
+OSAL_IRQ_HANDLER(BSP_FREQ1_UP_IRQ_HANDLER)
+{
+	OSAL_IRQ_PROLOGUE();
+
+	if(BSP_FREQ1_TIMER->SR & TIM_SR_UIF) {
+		BSP_FREQ1_TIMER->SR = ~TIM_SR_UIF;
+		capture.errors++;
+	}
+
+	OSAL_IRQ_EPILOGUE();
+}
+
+/** \brief Start continuous FREQ capture
+ *
+ * The timer runs in reset slave mode, so CCR1 holds the last period and
+ * CCR2 the last high time. On each rising edge a DMA burst copies both
+ * registers into a circular buffer which is drained by
+ * bsp_freq_capture_poll().
+ *
+ * \param dev_num bsp_dev_freq_t: FREQ dev num.
+ * \param buffer uint16_t*: ring buffer, 2 half-words per sample
+ * \param nb_samples uint32_t: number of samples in the ring buffer
+ * \return bsp_status_t: status of the init.
+ *
+ */
+bsp_status_t bsp_freq_capture_start(bsp_dev_freq_t dev_num, uint16_t *buffer, uint32_t nb_samples)
+{
+	DMA_Stream_TypeDef *stream = BSP_FREQ1_DMA_STREAM;
+	TIM_HandleTypeDef htim;
+	uint32_t freq, duty;
+	bsp_status_t status;
+
+	/* Coarse measurement to select a prescaler leaving 2x headroom */
+	status = bsp_freq_get_values(dev_num, &freq, &duty);
+	if(status != BSP_OK) {
+		return status;
+	}
+	if(freq == 0) {
+		freq = 1;
+	}
+	capture.scale = (uint32_t)(BSP_FREQ_BASE_FREQ / freq) / 0x8000 + 1;
+	if(capture.scale > 0xffff) {
+		capture.scale = 0xffff;
+	}
+
+	if(bsp_freq_init(dev_num, capture.scale) != BSP_OK) {
+		return BSP_ERROR;
+	}
+
+	capture.buffer = buffer;
+	capture.nb_samples = nb_samples;
+	capture.pos = 0;
+	/* First sample is taken before the counter was reset by an edge */
+	capture.skip = TRUE;
+	capture.errors = 0;
+	freq_capture_reset();
+
+	BSP_FREQ1_DMA_CLK_ENABLE();
+	stream->CR &= ~DMA_SxCR_EN;
+	while(stream->CR & DMA_SxCR_EN);
+	BSP_FREQ1_DMA_CLEAR_FLAGS();
+
+	stream->PAR = (uint32_t)&BSP_FREQ1_TIMER->DMAR;
+	stream->M0AR = (uint32_t)buffer;
+	stream->NDTR = nb_samples * 2;
+	stream->FCR = 0;
+	stream->CR = BSP_FREQ1_DMA_CHANNEL | DMA_SxCR_PL_1 |
+		     DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 |
+		     DMA_SxCR_MINC | DMA_SxCR_CIRC;
+	stream->CR |= DMA_SxCR_EN;
+
+	/* Only counter overflows raise UIF, not slave mode resets */
+	BSP_FREQ1_TIMER->CR1 |= TIM_CR1_URS;
+	BSP_FREQ1_TIMER->DCR = TIM_DMABURSTLENGTH_2TRANSFERS | TIM_DMABASE_CCR1;
+	BSP_FREQ1_TIMER->SR = 0;
+	BSP_FREQ1_TIMER->DIER |= TIM_DIER_CC1DE;
+
+	htim.Instance = BSP_FREQ1_TIMER;
+	HAL_TIM_IC_Start(&htim, TIM_CHANNEL_2);
+	HAL_TIM_IC_Start(&htim, TIM_CHANNEL_1);
+
+	return BSP_OK;
+}
+
+/** \brief Drain new samples from the continuous capture ring
+ *
+ * Must be called often enough for the ring not to wrap between calls.
+ * Samples overwritten by the DMA are lost but do not bias the result as
+ * each one is a full period measurement.
+ *
+ * \param dev_num bsp_dev_freq_t: FREQ dev num.
+ * \return void
+ *
+ */
+void bsp_freq_capture_poll(bsp_dev_freq_t dev_num)
+{
+	uint32_t head, period, high;
+	int32_t d;
+	(void)dev_num;
+
+	if(capture.buffer == NULL) {
+		return;
+	}
+
+	head = (capture.nb_samples * 2 - BSP_FREQ1_DMA_STREAM->NDTR) / 2;
+	if(head >= capture.nb_samples) {
+		head = 0;
+	}
+
+	while(capture.pos != head) {
+		period = capture.buffer[capture.pos * 2] + 2;
+		high = capture.buffer[capture.pos * 2 + 1] + 2;
+		if(++capture.pos == capture.nb_samples) {
+			capture.pos = 0;
+		}
+
+		if(capture.skip) {
+			capture.skip = FALSE;
+			continue;
+		}
+
+		if(capture.edges == 0) {
+			capture.ref = period;
+		}
+		capture.edges++;
+		capture.sum += period;
+		capture.sum_high += high;
+		if(period < capture.min) {
+			capture.min = period;
+		}
+		if(period > capture.max) {
+			capture.max = period;
+		}
+		d = (int32_t)period - (int32_t)capture.ref;
+		capture.sum_d += d;
+		capture.sum_d2 += (uint64_t)((int64_t)d * d);
+	}
+}
+
+static uint32_t freq_ticks_to_ns(uint64_t ticks)
+{
+	uint64_t ns;
+
+	/* One tick is scale/168MHz, 125/21 ns */
+	ns = (ticks * capture.scale * 125) / 21;
+	return (ns > 0xffffffff) ? 0xffffffff : (uint32_t)ns;
+}
+
+static float freq_sqrtf(float v)
+{
+	float x = v;
+	int i;
+
+	if(v <= 0) {
+		return 0;
+	}
+	for(i = 0; i < 20; i++) {
+		x = (x + v / x) / 2;
+	}
+	return x;
+}
+
+/** \brief Get statistics for the current gate and start a new one
+ *
+ * \param dev_num bsp_dev_freq_t: FREQ dev num.
+ * \param stats bsp_freq_stats_t*: statistics output
+ * \return void
+ *
+ */
+void bsp_freq_capture_get_stats(bsp_dev_freq_t dev_num, bsp_freq_stats_t *stats)
+{
+	uint64_t num, den;
+	float mean, var, stddev;
+
+	bsp_freq_capture_poll(dev_num);
+
+	memset(stats, 0, sizeof(bsp_freq_stats_t));
+	stats->edges = capture.edges;
+	chSysLock();
+	stats->errors = capture.errors;
+	capture.errors = 0;
+	chSysUnlock();
+
+	if(capture.edges > 0 && capture.sum > 0) {
+		/* Reciprocal counting: edges over the sum of their periods */
+		num = (uint64_t)BSP_FREQ_BASE_FREQ * capture.edges;
+		den = capture.sum * capture.scale;
+		stats->freq = num / den;
+		stats->freq_frac = ((num % den) * 1000) / den;
+		stats->duty = (capture.sum_high * 1000) / capture.sum;
+		stats->period_min = freq_ticks_to_ns(capture.min);
+		stats->period_max = freq_ticks_to_ns(capture.max);
+
+		mean = (float)capture.sum_d / capture.edges;
+		var = (float)capture.sum_d2 / capture.edges - mean * mean;
+		/* ps per tick is scale * 125000 / 21 */
+		stddev = freq_sqrtf(var) * capture.scale * 125000.0f / 21;
+		stats->period_stddev = (stddev > 4e9f) ? 0xffffffff : (uint32_t)stddev;
+	}
+
+	freq_capture_reset();
+}
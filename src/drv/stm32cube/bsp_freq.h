@@ -26,6 +26,18 @@ typedef enum {
 	BSP_DEV_FREQ_END
 } bsp_dev_freq_t;
 
+/* Continuous capture statistics over one gate time */
+typedef struct {
+	uint32_t freq;		/* Reciprocal frequency, integer part (Hz) */
+	uint32_t freq_frac;	/* Fractional part (mHz) */
+	uint32_t duty;		/* Duty cycle (0.1%) */
+	uint32_t period_min;	/* Shortest period (ns) */
+	uint32_t period_max;	/* Longest period (ns) */
+	uint32_t period_stddev;	/* Period standard deviation (ps) */
+	uint32_t edges;		/* Number of periods measured */
+	uint32_t errors;	/* Timer overflows (period out of range) */
+} bsp_freq_stats_t;
+
 bsp_status_t bsp_freq_init(bsp_dev_freq_t dev_num, uint16_t scale);
 bsp_status_t bsp_freq_deinit(bsp_dev_freq_t dev_num);
 
@@ -34,4 +46,12 @@ uint32_t bsp_freq_getchannel(bsp_dev_freq_t dev_num, uint8_t channel);
 bsp_status_t bsp_freq_get_values(bsp_dev_freq_t dev_num, uint32_t *freq, uint32_t *duty);
 bsp_status_t bsp_freq_get_baudrate(bsp_dev_freq_t dev_num, uint32_t *baudrate);
 
+bsp_status_t bsp_freq_capture_start(bsp_dev_freq_t dev_num, uint16_t *buffer, uint32_t nb_samples);
+void bsp_freq_capture_poll(bsp_dev_freq_t dev_num);
+void bsp_freq_capture_get_stats(bsp_dev_freq_t dev_num, bsp_freq_stats_t *stats);
+
+bsp_status_t bsp_freq_edges_start(bsp_dev_freq_t dev_num, uint16_t scale,
+				  uint16_t *buffer, uint16_t nb_samples, uint8_t *level);
+uint16_t bsp_freq_edges_count(bsp_dev_freq_t dev_num, uint16_t nb_samples);
+
 #endif /* _BSP_FREQ_H_ */
@@ -25,4 +25,19 @@ limitations under the License.
 #define BSP_FREQ1_PIN	GPIO_PIN_6 // PC.6
 #define BSP_FREQ1_CHAN	TIM_CHANNEL_1
 
+/* Definition for FREQ1 continuous capture DMA (TIM8_CH1) =>
+Free in mcuconf.h as long as STM32_ADC_USE_ADC2 is FALSE (DMA2 Stream2)
+*/
+#define BSP_FREQ1_DMA_CHANNEL	DMA_CHANNEL_7
+#define BSP_FREQ1_DMA_STREAM	DMA2_Stream2
+#define BSP_FREQ1_DMA_CLK_ENABLE()	__DMA2_CLK_ENABLE()
+#define BSP_FREQ1_DMA_CLEAR_FLAGS()	(DMA2->LIFCR = DMA_LIFCR_CFEIF2 | \
+					 DMA_LIFCR_CDMEIF2 | DMA_LIFCR_CTEIF2 | \
+					 DMA_LIFCR_CHTIF2 | DMA_LIFCR_CTCIF2)
+
+/* TIM8 update interrupt counts the continuous capture overflows */
+#define BSP_FREQ1_UP_IRQ_HANDLER	VectorF0 /* TIM8_UP_TIM13_IRQn */
+#define BSP_FREQ1_UP_IRQ_NUMBER		TIM8_UP_TIM13_IRQn
+#define BSP_FREQ1_UP_IRQ_PRIORITY	10
+
 #endif /* _BSP_FREQ_CONF_H_ */
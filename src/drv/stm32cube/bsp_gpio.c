@@ -13,6 +13,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "bsp_gpio.h"
+#include "bsp_resource.h"
 
 /** \brief Init GPIO
  *
@@ -29,6 +30,12 @@ bsp_status_t bsp_gpio_init(bsp_gpio_port_t gpio_port, uint16_t gpio_pin,
 	uint32_t gpio_pull;
 	GPIO_InitTypeDef gpio_init;
 	GPIO_TypeDef *hal_gpio_port;
+	uint8_t res;
+
+	/* Pins stay leased until the mode or command using them ends */
+	res = BSP_RES_PIN((gpio_port - BSP_GPIO_PORTA) / 0x400, gpio_pin);
+	if(bsp_resource_claim(&res, 1) != BSP_OK)
+		return BSP_BUSY;
 
 	hal_gpio_port =(GPIO_TypeDef*)gpio_port;
 	/* Safe mode for GPIO */
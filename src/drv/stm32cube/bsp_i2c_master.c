@@ -15,6 +15,8 @@ limitations under the License.
 #include "bsp.h"
 #include "bsp_i2c_master.h"
 #include "bsp_i2c_conf.h"
+#include "bsp_resource.h"
+#include "profile.h"
 
 #define BSP_I2C_DELAY_HC_50KHZ   (1680) /* 50KHz*2 (Half Clock) in number of cycles @168MHz */
 #define BSP_I2C_DELAY_HC_100KHZ  (840) /* 100KHz*2 (Half Clock) in number of cycles @168MHz */
@@ -33,6 +35,9 @@ static int i2c_speed_delay;
 static bool i2c_started;
 static uint32_t i2c_clock_strech_timeout;
 
+/* Peripheral, SCL, SDA (see bsp_i2c_conf.h) */
+static const uint8_t i2c_res[] = { BSP_RES_I2C1, BSP_RES_PB(6), BSP_RES_PB(7) };
+
 /* Set SCL LOW = 0/GND (0/GND => Set pin = logic reversed in open drain) */
 #define set_scl_low() (gpio_set_pin(BSP_I2C1_SCL_SDA_GPIO_PORT, BSP_I2C1_SCL_PIN))
 /* Set SCL HIGH / Floating Input (HIGH => clr pin = logic reversed in open drain) */
@@ -98,7 +103,10 @@ bsp_status_t bsp_i2c_master_init(bsp_dev_i2c_t dev_num, mode_config_proto_t* mod
 {
 	uint32_t gpio_scl_sda_pull;
 
-	bsp_i2c_master_deinit(dev_num);
+	if(bsp_resource_claim(i2c_res, sizeof(i2c_res)) != BSP_OK)
+		return BSP_BUSY;
+
+	i2c_gpio_hw_deinit(dev_num);
 
 	/* I2C peripheral configuration */
 	if(mode_conf->config.i2c.dev_speed < I2C_SPEED_MAX)
@@ -140,12 +148,46 @@ bsp_status_t bsp_i2c_master_init(bsp_dev_i2c_t dev_num, mode_config_proto_t* mod
  */
 bsp_status_t bsp_i2c_master_deinit(bsp_dev_i2c_t dev_num)
 {
+	if(bsp_resource_release(i2c_res, sizeof(i2c_res)) != BSP_OK)
+		return BSP_BUSY;
+
 	/* DeInit the low level hardware: GPIO, CLOCK, NVIC... */
 	i2c_gpio_hw_deinit(dev_num);
 
 	return BSP_OK;
 }
 
+/** \brief Change the bus speed without reconfiguring the GPIO.
+ *
+ * \param dev_num bsp_dev_i2c_t: I2C dev num.
+ * \param speed uint8_t: speed index (BSP_I2C_SPEED_xxx).
+ * \return bsp_status_t: status of the change.
+ *
+ */
+bsp_status_t bsp_i2c_master_set_speed(bsp_dev_i2c_t dev_num, uint8_t speed)
+{
+	(void)dev_num;
+
+	if(speed >= I2C_SPEED_MAX)
+		return BSP_ERROR;
+
+	i2c_speed_delay = i2c_speed[speed];
+	return BSP_OK;
+}
+
+/** \brief Check that nothing holds SDA or SCL low.
+ *
+ * \param dev_num bsp_dev_i2c_t: I2C dev num.
+ * \return bool: TRUE when both lines are released and high.
+ *
+ */
+bool bsp_i2c_bus_idle(bsp_dev_i2c_t dev_num)
+{
+	(void)dev_num;
+
+	return (get_sda() && get_scl()) ? TRUE : FALSE;
+}
+
 /** \brief Sends START BIT in blocking mode and set the status.
  *
  * \param dev_num bsp_dev_i2c_t: I2C dev num.
@@ -256,6 +298,9 @@ bsp_status_t bsp_i2c_master_write_u8(bsp_dev_i2c_t dev_num, uint8_t tx_data, uin
 	int i;
 	unsigned char ack_val;
 	bsp_status_t status;
+	uint32_t start;
+
+	start = prof_start();
 
 	/* Write 8 bits */
 	for(i = 0; i < 8; i++) {
@@ -268,7 +313,7 @@ bsp_status_t bsp_i2c_master_write_u8(bsp_dev_i2c_t dev_num, uint8_t tx_data, uin
 
 		status = i2c_master_set_scl_float_and_wait_ready();
 		if (status != BSP_OK) {
-			return status;
+			goto out;
 		}
 
 		set_scl_low();
@@ -281,7 +326,7 @@ bsp_status_t bsp_i2c_master_write_u8(bsp_dev_i2c_t dev_num, uint8_t tx_data, uin
 
 	status = i2c_master_set_scl_float_and_wait_ready();
 	if (status != BSP_OK) {
-		return status;
+		goto out;
 	}
 
 	ack_val = get_sda();
@@ -294,7 +339,10 @@ bsp_status_t bsp_i2c_master_write_u8(bsp_dev_i2c_t dev_num, uint8_t tx_data, uin
 	else
 		*tx_ack_flag = FALSE;
 
-	return BSP_OK;
+	status = BSP_OK;
+out:
+	prof_record(PROF_I2C, start);
+	return status;
 }
 
 /** \brief Write ACK or NACK at end of Read.
@@ -340,6 +388,9 @@ bsp_status_t bsp_i2c_master_read_u8(bsp_dev_i2c_t dev_num, uint8_t* rx_data)
 	unsigned char data;
 	int i;
 	bsp_status_t status;
+	uint32_t start;
+
+	start = prof_start();
 
 	/* Read 8 bits */
 	data = 0;
@@ -349,7 +400,7 @@ bsp_status_t bsp_i2c_master_read_u8(bsp_dev_i2c_t dev_num, uint8_t* rx_data)
 
 		status = i2c_master_set_scl_float_and_wait_ready();
 		if (status != BSP_OK) {
-			return status;
+			goto out;
 		}
 
 		data <<= 1;
@@ -363,5 +414,8 @@ bsp_status_t bsp_i2c_master_read_u8(bsp_dev_i2c_t dev_num, uint8_t* rx_data)
 
 	/* Do not Send ACK / NACK because sent by bsp_i2c_read_ack() */
 
-	return BSP_OK;
+	status = BSP_OK;
+out:
+	prof_record(PROF_I2C, start);
+	return status;
 }
\ No newline at end of file
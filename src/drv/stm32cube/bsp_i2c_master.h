@@ -27,8 +27,16 @@ typedef enum {
 #include "bsp.h"
 #include "mode_config.h"
 
+/* Index of the speeds accepted by bsp_i2c_master_set_speed() */
+#define BSP_I2C_SPEED_50KHZ	(0)
+#define BSP_I2C_SPEED_100KHZ	(1)
+#define BSP_I2C_SPEED_400KHZ	(2)
+#define BSP_I2C_SPEED_1MHZ	(3)
+
 bsp_status_t bsp_i2c_master_init(bsp_dev_i2c_t dev_num, mode_config_proto_t* mode_conf);
 bsp_status_t bsp_i2c_master_deinit(bsp_dev_i2c_t dev_num);
+bsp_status_t bsp_i2c_master_set_speed(bsp_dev_i2c_t dev_num, uint8_t speed);
+bool bsp_i2c_bus_idle(bsp_dev_i2c_t dev_num);
 
 bsp_status_t bsp_i2c_start(bsp_dev_i2c_t dev_num);
 bsp_status_t bsp_i2c_stop(bsp_dev_i2c_t dev_num);
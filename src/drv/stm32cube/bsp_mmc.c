@@ -26,6 +26,13 @@ static MMC_HandleTypeDef mmc_handle[NB_MMC];
 static mode_config_proto_t* mmc_mode_conf[NB_MMC];
 static volatile uint16_t dummy_read;
 
+/* Multi-block DMA transfer in progress */
+typedef struct {
+	uint32_t nb_blocks;
+	uint8_t write;
+} mmc_xfer_t;
+static mmc_xfer_t mmc_xfer[NB_MMC];
+
 /**
   * @brief  Init MMC device.
   * @param  dev_num: MMC dev num.
@@ -220,3 +227,170 @@ bsp_status_t bsp_mmc_read_block(bsp_dev_sdio_t dev_num, uint8_t* rx_data, uint32
 
 	return status;
 }
+
+static bsp_status_t mmc_blocks_start(bsp_dev_sdio_t dev_num, uint8_t* data,
+				     uint32_t block_number, uint32_t nb_blocks,
+				     uint8_t write)
+{
+	MMC_HandleTypeDef* hmmc;
+	SDIO_DataInitTypeDef config;
+	uint32_t errorstate;
+	uint32_t add = block_number;
+
+	hmmc = &mmc_handle[dev_num];
+
+	if(hmmc->State != HAL_MMC_STATE_READY || nb_blocks == 0) {
+		return BSP_ERROR;
+	}
+	if((block_number + nb_blocks) > hmmc->MmcCard.LogBlockNbr) {
+		return BSP_ERROR;
+	}
+	if(hmmc->MmcCard.CardType != MMC_HIGH_CAPACITY_CARD) {
+		add *= MMC_BLOCKSIZE;
+	}
+
+	hmmc->Instance->DCTRL = 0U;
+
+	errorstate = SDMMC_CmdBlockLength(hmmc->Instance, MMC_BLOCKSIZE);
+	if(errorstate != HAL_MMC_ERROR_NONE) {
+		__HAL_MMC_CLEAR_FLAG(hmmc, SDMMC_STATIC_FLAGS);
+		return BSP_ERROR;
+	}
+
+	/* Card expects the write command before the data path is armed */
+	if(write) {
+		if(nb_blocks > 1) {
+			errorstate = SDMMC_CmdWriteMultiBlock(hmmc->Instance, add);
+		} else {
+			errorstate = SDMMC_CmdWriteSingleBlock(hmmc->Instance, add);
+		}
+		if(errorstate != HAL_MMC_ERROR_NONE) {
+			__HAL_MMC_CLEAR_FLAG(hmmc, SDMMC_STATIC_FLAGS);
+			return BSP_ERROR;
+		}
+	}
+
+	bsp_sdio_dma_start(dev_num, data, write);
+	__HAL_MMC_DMA_ENABLE(hmmc);
+
+	config.DataTimeOut   = SDMMC_DATATIMEOUT;
+	config.DataLength    = MMC_BLOCKSIZE * nb_blocks;
+	config.DataBlockSize = SDIO_DATABLOCK_SIZE_512B;
+	config.TransferDir   = write ? SDIO_TRANSFER_DIR_TO_CARD : SDIO_TRANSFER_DIR_TO_SDIO;
+	config.TransferMode  = SDIO_TRANSFER_MODE_BLOCK;
+	config.DPSM          = SDIO_DPSM_ENABLE;
+	(void)SDIO_ConfigData(hmmc->Instance, &config);
+
+	if(!write) {
+		if(nb_blocks > 1) {
+			errorstate = SDMMC_CmdReadMultiBlock(hmmc->Instance, add);
+		} else {
+			errorstate = SDMMC_CmdReadSingleBlock(hmmc->Instance, add);
+		}
+		if(errorstate != HAL_MMC_ERROR_NONE) {
+			hmmc->Instance->DCTRL = 0U;
+			bsp_sdio_dma_stop(dev_num);
+			__HAL_MMC_CLEAR_FLAG(hmmc, SDMMC_STATIC_FLAGS);
+			return BSP_ERROR;
+		}
+	}
+
+	mmc_xfer[dev_num].nb_blocks = nb_blocks;
+	mmc_xfer[dev_num].write = write;
+	hmmc->State = HAL_MMC_STATE_BUSY;
+
+	return BSP_OK;
+}
+
+/**
+  * @brief  Start a multi-block read (CMD18) by DMA, returns immediately.
+  * @param  dev_num: MMC dev num.
+  * @param  rx_data: Destination buffer (nb_blocks*512 bytes).
+  * @param  block_number: First block to read.
+  * @param  nb_blocks: Number of blocks to read.
+  * @retval status of the command, call bsp_mmc_blocks_wait() when BSP_OK.
+  */
+bsp_status_t bsp_mmc_read_blocks_start(bsp_dev_sdio_t dev_num, uint8_t* rx_data,
+				       uint32_t block_number, uint32_t nb_blocks)
+{
+	return mmc_blocks_start(dev_num, rx_data, block_number, nb_blocks, 0);
+}
+
+/**
+  * @brief  Start a multi-block write (CMD25) by DMA, returns immediately.
+  * @param  dev_num: MMC dev num.
+  * @param  tx_data: Source buffer (nb_blocks*512 bytes).
+  * @param  block_number: First block to write.
+  * @param  nb_blocks: Number of blocks to write.
+  * @retval status of the command, call bsp_mmc_blocks_wait() when BSP_OK.
+  */
+bsp_status_t bsp_mmc_write_blocks_start(bsp_dev_sdio_t dev_num, uint8_t* tx_data,
+					uint32_t block_number, uint32_t nb_blocks)
+{
+	return mmc_blocks_start(dev_num, tx_data, block_number, nb_blocks, 1);
+}
+
+/**
+  * @brief  Wait for the end of a transfer started by bsp_mmc_*_blocks_start().
+  * Sends CMD12 for multi-block transfers and waits for the end of
+  * programming after a write.
+  * @param  dev_num: MMC dev num.
+  * @retval status of the transfer.
+  */
+bsp_status_t bsp_mmc_blocks_wait(bsp_dev_sdio_t dev_num)
+{
+	MMC_HandleTypeDef* hmmc;
+	bsp_status_t status = BSP_OK;
+	uint32_t tickstart;
+
+	hmmc = &mmc_handle[dev_num];
+
+	if(hmmc->State != HAL_MMC_STATE_BUSY) {
+		return BSP_ERROR;
+	}
+
+	tickstart = HAL_GetTick();
+	while(!__HAL_MMC_GET_FLAG(hmmc, SDIO_FLAG_DCRCFAIL | SDIO_FLAG_DTIMEOUT |
+				  SDIO_FLAG_RXOVERR | SDIO_FLAG_TXUNDERR |
+				  SDIO_FLAG_DATAEND)) {
+		if((HAL_GetTick() - tickstart) >= MMC_TIMEOUT_MAX) {
+			status = BSP_TIMEOUT;
+			break;
+		}
+	}
+	if(__HAL_MMC_GET_FLAG(hmmc, SDIO_FLAG_DCRCFAIL | SDIO_FLAG_DTIMEOUT |
+			      SDIO_FLAG_RXOVERR | SDIO_FLAG_TXUNDERR)) {
+		status = BSP_ERROR;
+	}
+
+	/* DMA FIFO is flushed to memory after DATAEND on reads */
+	if(status == BSP_OK && !mmc_xfer[dev_num].write) {
+		while(!bsp_sdio_dma_done(dev_num)) {
+			if((HAL_GetTick() - tickstart) >= MMC_TIMEOUT_MAX) {
+				status = BSP_TIMEOUT;
+				break;
+			}
+		}
+	}
+
+	if(mmc_xfer[dev_num].nb_blocks > 1) {
+		if(SDMMC_CmdStopTransfer(hmmc->Instance) != HAL_MMC_ERROR_NONE) {
+			status = BSP_ERROR;
+		}
+	}
+
+	hmmc->Instance->DCTRL = 0U;
+	bsp_sdio_dma_stop(dev_num);
+	__HAL_MMC_CLEAR_FLAG(hmmc, SDMMC_STATIC_FLAGS);
+	hmmc->State = HAL_MMC_STATE_READY;
+
+	if(mmc_xfer[dev_num].write) {
+		while(HAL_MMC_GetCardState(hmmc) != HAL_MMC_CARD_TRANSFER) {
+			if((HAL_GetTick() - tickstart) >= MMC_TIMEOUT_MAX) {
+				return BSP_TIMEOUT;
+			}
+		}
+	}
+
+	return status;
+}
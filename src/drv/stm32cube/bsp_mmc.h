@@ -35,6 +35,9 @@ bsp_status_t bsp_mmc_deinit(bsp_dev_sdio_t dev_num);
 
 bsp_status_t bsp_mmc_write_block(bsp_dev_sdio_t dev_num, uint8_t* tx_data, uint32_t block_number);
 bsp_status_t bsp_mmc_read_block(bsp_dev_sdio_t dev_num, uint8_t* rx_data, uint32_t block_number);
+bsp_status_t bsp_mmc_read_blocks_start(bsp_dev_sdio_t dev_num, uint8_t* rx_data, uint32_t block_number, uint32_t nb_blocks);
+bsp_status_t bsp_mmc_write_blocks_start(bsp_dev_sdio_t dev_num, uint8_t* tx_data, uint32_t block_number, uint32_t nb_blocks);
+bsp_status_t bsp_mmc_blocks_wait(bsp_dev_sdio_t dev_num);
 uint32_t *bsp_mmc_get_cid(bsp_dev_sdio_t dev_num);
 uint32_t *bsp_mmc_get_csd(bsp_dev_sdio_t dev_num);
 bsp_status_t bsp_mmc_get_info(bsp_dev_sdio_t dev_num, bsp_mmc_info_t * mmc_info);
@@ -17,9 +17,34 @@ limitations under the License.
 
 #include "bsp_pwm.h"
 #include "bsp_pwm_conf.h"
+#include "bsp_resource.h"
+
+#include <string.h>
 
 #define NB_PWM (BSP_DEV_PWM_END)
 
+static const struct {
+	GPIO_TypeDef *port;
+	uint16_t pin;
+	uint32_t chan;
+	uint8_t res;
+} pwm_dev[NB_PWM] = {
+	{ BSP_PWM1_PORT, BSP_PWM1_PIN, BSP_PWM1_CHAN, BSP_RES_PB(11) },
+	{ BSP_PWM2_PORT, BSP_PWM2_PIN, BSP_PWM2_CHAN, BSP_RES_PB(10) },
+	{ BSP_PWM3_PORT, BSP_PWM3_PIN, BSP_PWM3_CHAN, BSP_RES_PB(3) },
+	{ BSP_PWM4_PORT, BSP_PWM4_PIN, BSP_PWM4_CHAN, BSP_RES_PA(15) },
+};
+
+static const uint8_t pwm_res = BSP_RES_PWM;
+static const uint8_t pwm_dma_res = BSP_RES_DMA1_S1;
+
+/* Duty cycle of each channel, kept to rescale it on frequency change */
+static uint32_t pwm_duty[NB_PWM];
+/* Channels with output enabled */
+static uint8_t pwm_active;
+/* DMA sequence running */
+static bool pwm_seq;
+
 /** \brief PWM GPIO HW DeInit.
  *
  * \param dev_num bsp_dev_pwm_t: PWM dev num
@@ -28,9 +53,7 @@ limitations under the License.
  */
 static void pwm_gpio_hw_deinit(bsp_dev_pwm_t dev_num)
 {
-	(void)dev_num;
-
-	HAL_GPIO_DeInit(BSP_PWM1_PORT, BSP_PWM1_PIN);
+	HAL_GPIO_DeInit(pwm_dev[dev_num].port, pwm_dev[dev_num].pin);
 }
 
 /** \brief PWM GPIO HW Init.
@@ -43,15 +66,13 @@ static void pwm_gpio_hw_init(bsp_dev_pwm_t dev_num)
 {
 	GPIO_InitTypeDef gpio_init;
 
-	if(dev_num == BSP_DEV_PWM1) {
-		/* BSP_PWM1 pin configuration */
-		gpio_init.Mode = GPIO_MODE_AF_PP;
-		gpio_init.Pull  = GPIO_PULLUP;
-		gpio_init.Speed = GPIO_SPEED_FAST; /* Max 50MHz */
-		gpio_init.Alternate = GPIO_AF1_TIM2;
-		gpio_init.Pin = BSP_PWM1_PIN;
-		HAL_GPIO_Init(BSP_PWM1_PORT, &gpio_init);
-	}
+	/* BSP_PWMx pin configuration, TIM2 is AF1 on all PWM pins */
+	gpio_init.Mode = GPIO_MODE_AF_PP;
+	gpio_init.Pull  = GPIO_PULLUP;
+	gpio_init.Speed = GPIO_SPEED_FAST; /* Max 50MHz */
+	gpio_init.Alternate = BSP_PWM1_AF;
+	gpio_init.Pin = pwm_dev[dev_num].pin;
+	HAL_GPIO_Init(pwm_dev[dev_num].port, &gpio_init);
 }
 
 /** \brief
@@ -62,17 +83,10 @@ static void pwm_gpio_hw_init(bsp_dev_pwm_t dev_num)
  */
 static uint32_t get_pwm_chan_num(bsp_dev_pwm_t dev_num)
 {
-	uint32_t pwm_chan_num;
+	if(dev_num >= NB_PWM)
+		return BSP_PWM1_CHAN;
 
-	switch(dev_num) {
-	case BSP_DEV_PWM1:
-		pwm_chan_num = BSP_PWM1_CHAN;
-		break;
-	default:
-		pwm_chan_num = BSP_PWM1_CHAN;
-		break;
-	}
-	return pwm_chan_num;
+	return pwm_dev[dev_num].chan;
 }
 
 /** \brief
@@ -108,7 +122,29 @@ static __IO uint32_t* get_ccrx_chan_num(uint32_t chan_num)
 	return CCRx;
 }
 
+/* CCR value for a duty cycle in BSP_PWM_DUTY_MAX units at the current frequency */
+static uint32_t pwm_duty_ccr(uint32_t duty)
+{
+	if(duty > BSP_PWM_DUTY_MAX)
+		duty = BSP_PWM_DUTY_MAX;
+
+	return ((uint64_t)duty * (TIM2->ARR + 1)) >> 16;
+}
+
+static void pwm_channel_stop(bsp_dev_pwm_t dev_num)
+{
+	TIM_HandleTypeDef htim;
+
+	memset(&htim, 0, sizeof(htim));
+	htim.Instance = TIM2;
+	HAL_TIM_PWM_Stop(&htim, get_pwm_chan_num(dev_num));
+	pwm_active &= ~(1 << dev_num);
+}
+
 /** \brief Init PWM device.
+ *
+ * The TIM2 timebase is only initialized with the first channel, other
+ * channels keep running.
  *
  * \param dev_num bsp_dev_pwm_t: PWM dev num.
  * \return bsp_status_t: status of the init.
@@ -120,7 +156,16 @@ bsp_status_t bsp_pwm_init(bsp_dev_pwm_t dev_num)
 	TIM_OC_InitTypeDef pwm_conf;
 	uint32_t channel;
 
-	bsp_pwm_deinit(dev_num);
+	if(dev_num >= NB_PWM)
+		return BSP_ERROR;
+
+	if(bsp_resource_claim(&pwm_res, 1) != BSP_OK ||
+	   bsp_resource_claim(&pwm_dev[dev_num].res, 1) != BSP_OK)
+		return BSP_BUSY;
+
+	if(pwm_seq)
+		bsp_pwm_seq_stop();
+	pwm_channel_stop(dev_num);
 
 	/* Configure the PWM (TIM2) peripheral */
 	__TIM2_CLK_ENABLE();
@@ -129,14 +174,17 @@ bsp_status_t bsp_pwm_init(bsp_dev_pwm_t dev_num)
 	pwm_gpio_hw_init(dev_num);
 
 	/* Init TIM */
+	memset(&htim, 0, sizeof(htim));
 	htim.Instance = TIM2;
 	htim.State = HAL_TIM_STATE_RESET;
 	htim.Init.Period = 0;
 	htim.Init.Prescaler = 0;
 	htim.Init.ClockDivision = 0;
 	htim.Init.CounterMode = TIM_COUNTERMODE_UP;
-	if(HAL_TIM_PWM_Init(&htim) != HAL_OK) {
-		return BSP_ERROR;
+	if(pwm_active == 0) {
+		if(HAL_TIM_PWM_Init(&htim) != HAL_OK) {
+			return BSP_ERROR;
+		}
 	}
 
 	/* TIMx PWM configuration */
@@ -152,6 +200,7 @@ bsp_status_t bsp_pwm_init(bsp_dev_pwm_t dev_num)
 	if(HAL_TIM_PWM_ConfigChannel(&htim, &pwm_conf, channel) != HAL_OK) {
 		return BSP_ERROR;
 	}
+	pwm_duty[dev_num] = 0;
 
 	return BSP_OK;
 }
@@ -164,16 +213,22 @@ bsp_status_t bsp_pwm_init(bsp_dev_pwm_t dev_num)
  */
 bsp_status_t bsp_pwm_deinit(bsp_dev_pwm_t dev_num)
 {
-	TIM_HandleTypeDef  htim;
-	uint32_t channel;
+	if(dev_num >= NB_PWM)
+		return BSP_ERROR;
 
-	channel = get_pwm_chan_num(dev_num);
-	htim.Instance = TIM2;
-	HAL_TIM_PWM_Stop(&htim, channel);
+	if(bsp_resource_release(&pwm_dev[dev_num].res, 1) != BSP_OK)
+		return BSP_BUSY;
+
+	if(pwm_seq)
+		bsp_pwm_seq_stop();
+	pwm_channel_stop(dev_num);
 
 	/* DeInit the low level hardware: GPIO, CLOCK, NVIC... */
 	pwm_gpio_hw_deinit(dev_num);
 
+	if(pwm_active == 0)
+		bsp_resource_release(&pwm_res, 1);
+
 	return BSP_OK;
 }
 
@@ -187,12 +242,31 @@ bsp_status_t bsp_pwm_deinit(bsp_dev_pwm_t dev_num)
  */
 bsp_status_t bsp_pwm_update(bsp_dev_pwm_t dev_num, uint32_t frequency, uint32_t duty_cycle_percent)
 {
-	TIM_HandleTypeDef  htim;
+	bsp_status_t status;
+
+	if(duty_cycle_percent > 100)
+		return BSP_ERROR;
+
+	status = bsp_pwm_set_frequency(frequency);
+	if(status != BSP_OK)
+		return status;
+
+	return bsp_pwm_set_duty(dev_num, (duty_cycle_percent * BSP_PWM_DUTY_MAX) / 100);
+}
+
+/** \brief  Set the frequency shared by all PWM channels.
+ *
+ * Duty cycles of the running channels are kept and all counters restart
+ * in phase.
+ *
+ * \param frequency uint32_t: PWM frequency in Hz (1Hz to 42MHz).
+ * \return bsp_status_t: status of the update.
+ *
+ */
+bsp_status_t bsp_pwm_set_frequency(uint32_t frequency)
+{
 	uint32_t apb1_freq;
-	uint32_t channel;
-	uint32_t arr;
-	float duty_cycle;
-	__IO uint32_t* CCRx;
+	int i;
 
 	apb1_freq = bsp_get_apb1_freq();
 
@@ -202,41 +276,218 @@ bsp_status_t bsp_pwm_update(bsp_dev_pwm_t dev_num, uint32_t frequency, uint32_t
 	if(frequency > apb1_freq)
 		return BSP_ERROR;
 
-	if(duty_cycle_percent > 100)
-		return BSP_ERROR;
+	if(pwm_seq)
+		bsp_pwm_seq_stop();
 
-	channel = get_pwm_chan_num(dev_num);
+	/* Configure PWM Frequency */
+	TIM2->ARR = ((apb1_freq * 2) / frequency) - 1;
+	for(i = 0; i < NB_PWM; i++) {
+		if(pwm_active & (1 << i))
+			*get_ccrx_chan_num(get_pwm_chan_num(i)) = pwm_duty_ccr(pwm_duty[i]);
+	}
 
-	/* Configure TIMx PWM on Timer2 */
-	htim.Instance = TIM2;
+	/* Reset CNT and load the preloaded CCRx */
+	TIM2->EGR = TIM_EGR_UG;
 
-	/* Stop PWM */
-	if(HAL_TIM_PWM_Stop(&htim, channel) != HAL_OK) {
+	return BSP_OK;
+}
+
+/** \brief  Set duty cycle and start the PWM output.
+ *
+ * \param dev_num bsp_dev_pwm_t: PWM dev num.
+ * \param duty uint32_t: duty cycle (0 to BSP_PWM_DUTY_MAX)
+ * \return bsp_status_t: status of the update.
+ *
+ */
+bsp_status_t bsp_pwm_set_duty(bsp_dev_pwm_t dev_num, uint32_t duty)
+{
+	TIM_HandleTypeDef htim;
+	uint32_t channel;
+
+	if(dev_num >= NB_PWM || duty > BSP_PWM_DUTY_MAX)
 		return BSP_ERROR;
+
+	if(pwm_seq)
+		bsp_pwm_seq_stop();
+
+	channel = get_pwm_chan_num(dev_num);
+	pwm_duty[dev_num] = duty;
+	*get_ccrx_chan_num(channel) = pwm_duty_ccr(duty);
+
+	if(!(pwm_active & (1 << dev_num))) {
+		/* Start PWM */
+		memset(&htim, 0, sizeof(htim));
+		htim.Instance = TIM2;
+		if(HAL_TIM_PWM_Start(&htim, channel) != HAL_OK) {
+			return BSP_ERROR;
+		}
+		pwm_active |= 1 << dev_num;
 	}
 
-	/* Configure PWM Frequency */
-	arr = ((apb1_freq * 2) / frequency) - 1;
-	htim.Instance->ARR = arr;
+	return BSP_OK;
+}
+
+/** \brief  Number of duty cycle steps at the current frequency.
+ *
+ * \return uint32_t: ARR + 1
+ *
+ */
+uint32_t bsp_pwm_get_resolution(void)
+{
+	return TIM2->ARR + 1;
+}
 
-	/* Configure PWM Duty Cycle in % */
-	duty_cycle = duty_cycle_percent;
-	duty_cycle = (duty_cycle / 100.0f) * (float)(arr + 1);
+bool bsp_pwm_is_active(bsp_dev_pwm_t dev_num)
+{
+	return (pwm_active & (1 << dev_num)) ? TRUE : FALSE;
+}
 
-	CCRx = get_ccrx_chan_num(channel);
-	*CCRx = (uint32_t)duty_cycle;
+/** \brief  Start a duty cycle sequence loaded by DMA at each update event
+ *
+ * Each step lasts one PWM period. table holds steps rows of duty cycles
+ * (BSP_PWM_DUTY_MAX units), one per device of dev_mask (PWM1 first). It
+ * is converted in place to TIM2 CCRx burst rows and must hold steps
+ * times the number of CCR registers from the lowest to the highest
+ * channel of dev_mask (CCR1 = PWM4 to CCR4 = PWM1), channels of this
+ * range outside dev_mask keep their duty cycle.
+ *
+ * \param dev_mask uint8_t: devices driven by the sequence (bit 0: PWM1)
+ * \param table uint32_t*: sequence, must stay allocated until stopped
+ * \param steps uint32_t: number of steps (min 2)
+ * \param size uint32_t: table size in words
+ * \param loop bool: TRUE to restart at the end, FALSE to hold the last step
+ * \return bsp_status_t: status of the start.
+ *
+ */
+bsp_status_t bsp_pwm_seq_start(uint8_t dev_mask, uint32_t *table, uint32_t steps, uint32_t size, bool loop)
+{
+	DMA_Stream_TypeDef *stream = BSP_PWM_DMA_STREAM;
+	uint32_t src[NB_PWM], row[4];
+	uint32_t first, last, width, nb, i, j, k, c;
 
-	/* Reset CNT */
-	htim.Instance->CNT = 0;
+	dev_mask &= (1 << NB_PWM) - 1;
+	if(dev_mask == 0 || steps < 2)
+		return BSP_ERROR;
 
-	/* Start PWM */
-	if(HAL_TIM_PWM_Start(&htim, channel) != HAL_OK) {
+	/* CCR registers range written by each DMA burst */
+	first = 3;
+	last = 0;
+	nb = 0;
+	for(i = 0; i < NB_PWM; i++) {
+		if(!(dev_mask & (1 << i)))
+			continue;
+		c = get_pwm_chan_num(i) >> 2;
+		if(c < first)
+			first = c;
+		if(c > last)
+			last = c;
+		nb++;
+	}
+	width = last - first + 1;
+	if(steps * width > size)
 		return BSP_ERROR;
+
+	if(bsp_resource_claim(&pwm_dma_res, 1) != BSP_OK)
+		return BSP_BUSY;
+
+	if(pwm_seq)
+		bsp_pwm_seq_stop();
+
+	/* Expand rows to the CCR range, last row first as rows only grow */
+	for(k = steps; k-- > 0; ) {
+		for(j = 0; j < nb; j++)
+			src[j] = table[k * nb + j];
+		for(c = 0; c < width; c++)
+			row[c] = (&TIM2->CCR1)[first + c];
+		for(i = 0, j = 0; i < NB_PWM; i++) {
+			if(dev_mask & (1 << i))
+				row[(get_pwm_chan_num(i) >> 2) - first] = pwm_duty_ccr(src[j++]);
+		}
+		memcpy(&table[k * width], row, width * sizeof(uint32_t));
+	}
+
+	/*
+	 * The first step is loaded by an update event, DMA writes the next ones.
+	 * CCR preload is enabled so each DMA write is used at the next update.
+	 */
+	memcpy(row, table, width * sizeof(uint32_t));
+	memmove(table, &table[width], (steps - 1) * width * sizeof(uint32_t));
+	memcpy(&table[(steps - 1) * width], row, width * sizeof(uint32_t));
+
+	TIM2->CR1 &= ~TIM_CR1_CEN;
+	for(c = 0; c < width; c++)
+		(&TIM2->CCR1)[first + c] = row[c];
+	for(i = 0; i < NB_PWM; i++) {
+		if(dev_mask & (1 << i)) {
+			TIM2->CCER |= TIM_CCER_CC1E << get_pwm_chan_num(i);
+			pwm_active |= 1 << i;
+		}
 	}
 
+	BSP_PWM_DMA_CLK_ENABLE();
+	stream->CR &= ~DMA_SxCR_EN;
+	while(stream->CR & DMA_SxCR_EN);
+	BSP_PWM_DMA_CLEAR_FLAGS();
+
+	stream->PAR = (uint32_t)&TIM2->DMAR;
+	stream->M0AR = (uint32_t)table;
+	stream->NDTR = (loop ? steps : steps - 1) * width;
+	stream->FCR = 0;
+	stream->CR = BSP_PWM_DMA_CHANNEL | DMA_SxCR_PL_1 |
+		     DMA_SxCR_MSIZE_1 | DMA_SxCR_PSIZE_1 |
+		     DMA_SxCR_MINC | DMA_SxCR_DIR_0 |
+		     (loop ? DMA_SxCR_CIRC : 0);
+	stream->CR |= DMA_SxCR_EN;
+
+	/*
+	 * UDE is set before UG: UG latches the first step and its DMA request
+	 * writes the second one, so the first step lasts a single period.
+	 */
+	TIM2->DCR = ((width - 1) << 8) | (TIM_DMABASE_CCR1 + first);
+	TIM2->DIER |= TIM_DIER_UDE;
+	TIM2->EGR = TIM_EGR_UG;
+	TIM2->SR = 0;
+	pwm_seq = TRUE;
+	TIM2->CR1 |= TIM_CR1_CEN;
+
+	/* A looping sequence outlives the command, keep the stream until stop */
+	if(loop)
+		bsp_resource_keep(&pwm_dma_res, 1);
+
 	return BSP_OK;
 }
 
+/** \brief  Check if a sequence started without loop has been played.
+ *
+ * \return bool: TRUE when the last step is written to the CCR preload
+ * registers (used from the next update event) or no sequence runs
+ *
+ */
+bool bsp_pwm_seq_done(void)
+{
+	if(!pwm_seq)
+		return TRUE;
+
+	return (BSP_PWM_DMA_STREAM->CR & DMA_SxCR_EN) ? FALSE : TRUE;
+}
+
+/** \brief  Stop the DMA sequence, channels keep the current step.
+ *
+ */
+void bsp_pwm_seq_stop(void)
+{
+	DMA_Stream_TypeDef *stream = BSP_PWM_DMA_STREAM;
+
+	TIM2->DIER &= ~TIM_DIER_UDE;
+	TIM2->DCR = 0;
+	stream->CR &= ~DMA_SxCR_EN;
+	while(stream->CR & DMA_SxCR_EN);
+	BSP_PWM_DMA_CLEAR_FLAGS();
+
+	bsp_resource_release(&pwm_dma_res, 1);
+	pwm_seq = FALSE;
+}
+
 /** \brief  Get PWM frequency and duty cycle.
  *
  * \param dev_num bsp_dev_pwm_t: PWM dev num.
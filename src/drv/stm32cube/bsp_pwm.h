@@ -18,15 +18,31 @@ limitations under the License.
 #include "bsp.h"
 #include "mode_config.h"
 
+/* All channels share the TIM2 counter, rising edges are aligned */
 typedef enum {
 	BSP_DEV_PWM1 = 0, /* PB11 */
+	BSP_DEV_PWM2 = 1, /* PB10 */
+	BSP_DEV_PWM3 = 2, /* PB3 */
+	BSP_DEV_PWM4 = 3, /* PA15 */
 	BSP_DEV_PWM_END
 } bsp_dev_pwm_t;
 
+/* Duty cycle fixed point unit, 1 << 16 is 100% */
+#define BSP_PWM_DUTY_MAX	(1 << 16)
+
 bsp_status_t bsp_pwm_init(bsp_dev_pwm_t dev_num);
 bsp_status_t bsp_pwm_deinit(bsp_dev_pwm_t dev_num);
 
 bsp_status_t bsp_pwm_update(bsp_dev_pwm_t dev_num, uint32_t frequency, uint32_t duty_cycle);
 void bsp_pwm_get(bsp_dev_pwm_t dev_num, uint32_t* frequency, uint32_t* duty_cycle_percent);
 
+bsp_status_t bsp_pwm_set_frequency(uint32_t frequency);
+bsp_status_t bsp_pwm_set_duty(bsp_dev_pwm_t dev_num, uint32_t duty);
+uint32_t bsp_pwm_get_resolution(void);
+bool bsp_pwm_is_active(bsp_dev_pwm_t dev_num);
+
+bsp_status_t bsp_pwm_seq_start(uint8_t dev_mask, uint32_t *table, uint32_t steps, uint32_t size, bool loop);
+bool bsp_pwm_seq_done(void);
+void bsp_pwm_seq_stop(void);
+
 #endif /* _BSP_PWM_H_ */
@@ -23,4 +23,32 @@ limitations under the License.
 #define BSP_PWM1_PIN	GPIO_PIN_11 // PB.11
 #define BSP_PWM1_CHAN	TIM_CHANNEL_4
 
+/* PWM2 -> PB10 (shared with SPI2 SCK)
+*/
+#define BSP_PWM2_PORT	GPIOB
+#define BSP_PWM2_PIN	GPIO_PIN_10 // PB.10
+#define BSP_PWM2_CHAN	TIM_CHANNEL_3
+
+/* PWM3 -> PB3 (shared with SPI1 SCK)
+*/
+#define BSP_PWM3_PORT	GPIOB
+#define BSP_PWM3_PIN	GPIO_PIN_3 // PB.3
+#define BSP_PWM3_CHAN	TIM_CHANNEL_2
+
+/* PWM4 -> PA15 (shared with SPI1 NSS)
+*/
+#define BSP_PWM4_PORT	GPIOA
+#define BSP_PWM4_PIN	GPIO_PIN_15 // PA.15
+#define BSP_PWM4_CHAN	TIM_CHANNEL_1
+
+/* Definition for PWM sequence DMA (TIM2_UP) =>
+Free in mcuconf.h as long as STM32_UART_USE_USART3 is FALSE (DMA1 Stream1)
+*/
+#define BSP_PWM_DMA_CHANNEL	DMA_CHANNEL_3
+#define BSP_PWM_DMA_STREAM	DMA1_Stream1
+#define BSP_PWM_DMA_CLK_ENABLE()	__DMA1_CLK_ENABLE()
+#define BSP_PWM_DMA_CLEAR_FLAGS()	(DMA1->LIFCR = DMA_LIFCR_CFEIF1 | \
+					 DMA_LIFCR_CDMEIF1 | DMA_LIFCR_CTEIF1 | \
+					 DMA_LIFCR_CHTIF1 | DMA_LIFCR_CTCIF1)
+
 #endif /* _BSP_PWM_CONF_H_ */
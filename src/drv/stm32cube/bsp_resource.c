@@ -0,0 +1,193 @@
+/*
+HydraBus/HydraNFC - Copyright (C) 2014-2023 Benjamin VERNOUX
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "ch.h"
+#include "bsp_resource.h"
+
+#include <string.h>
+
+static const char * const periph_names[BSP_RES_PERIPH_NB] = {
+	"SPI1", "SPI2", "I2C1", "UART1", "UART2", "CAN1", "CAN2",
+	"TIM1", "FREQ1", "DMA2S2", "DMA1S5", "DMA1S6",
+	"PWM", "DMA1S1"
+};
+
+static thread_t *res_owner[BSP_RES_NB];
+/* Leases not dropped by bsp_resource_release_all() */
+static bool res_kept[BSP_RES_NB];
+
+static thread_t *conflict_thread;
+static uint8_t conflict_res;
+
+/*
+ * Before the kernel is started there is no current thread, claims are
+ * accepted without creating a lease.
+ */
+bsp_status_t bsp_resource_claim(const uint8_t *res, uint8_t nb)
+{
+	thread_t *self;
+	uint8_t i;
+
+	self = chThdGetSelfX();
+	if (self == NULL)
+		return BSP_OK;
+
+	chSysLock();
+	for (i = 0; i < nb; i++) {
+		if (res_owner[res[i]] != NULL && res_owner[res[i]] != self) {
+			conflict_thread = self;
+			conflict_res = res[i];
+			chSysUnlock();
+			return BSP_BUSY;
+		}
+	}
+	for (i = 0; i < nb; i++)
+		res_owner[res[i]] = self;
+	chSysUnlock();
+
+	return BSP_OK;
+}
+
+/*
+ * Free resources are accepted so deinit can be called before init,
+ * resources leased by another thread are left untouched.
+ */
+bsp_status_t bsp_resource_release(const uint8_t *res, uint8_t nb)
+{
+	thread_t *self;
+	uint8_t i;
+
+	self = chThdGetSelfX();
+	if (self == NULL)
+		return BSP_OK;
+
+	chSysLock();
+	for (i = 0; i < nb; i++) {
+		if (res_owner[res[i]] != NULL && res_owner[res[i]] != self) {
+			conflict_thread = self;
+			conflict_res = res[i];
+			chSysUnlock();
+			return BSP_BUSY;
+		}
+	}
+	for (i = 0; i < nb; i++) {
+		res_owner[res[i]] = NULL;
+		res_kept[res[i]] = FALSE;
+	}
+	chSysUnlock();
+
+	return BSP_OK;
+}
+
+/*
+ * For hardware left running once the command returns (DMA playback),
+ * the lease then lasts until released or until the owner terminates.
+ */
+bsp_status_t bsp_resource_keep(const uint8_t *res, uint8_t nb)
+{
+	thread_t *self;
+	uint8_t i;
+
+	self = chThdGetSelfX();
+	if (self == NULL)
+		return BSP_OK;
+
+	chSysLock();
+	for (i = 0; i < nb; i++) {
+		if (res_owner[res[i]] != self) {
+			chSysUnlock();
+			return BSP_ERROR;
+		}
+	}
+	for (i = 0; i < nb; i++)
+		res_kept[res[i]] = TRUE;
+	chSysUnlock();
+
+	return BSP_OK;
+}
+
+static void resource_release_owner(void *owner, bool keep)
+{
+	int i;
+
+	chSysLock();
+	for (i = 0; i < BSP_RES_NB; i++) {
+		if (res_owner[i] != owner || (keep && res_kept[i]))
+			continue;
+		res_owner[i] = NULL;
+		res_kept[i] = FALSE;
+	}
+	if (conflict_thread == owner)
+		conflict_thread = NULL;
+	chSysUnlock();
+}
+
+void bsp_resource_release_owner(void *owner)
+{
+	resource_release_owner(owner, FALSE);
+}
+
+void bsp_resource_release_all(void)
+{
+	resource_release_owner(chThdGetSelfX(), TRUE);
+}
+
+bool bsp_resource_get_conflict(bsp_resource_t *res)
+{
+	bool conflict = FALSE;
+
+	chSysLock();
+	if (conflict_thread == chThdGetSelfX()) {
+		*res = conflict_res;
+		conflict_thread = NULL;
+		conflict = TRUE;
+	}
+	chSysUnlock();
+
+	return conflict;
+}
+
+void bsp_resource_name(bsp_resource_t res, char name[BSP_RES_NAME_MAX])
+{
+	uint8_t pin;
+
+	if (res < BSP_RES_PERIPH_NB) {
+		strncpy(name, periph_names[res], BSP_RES_NAME_MAX - 1);
+		name[BSP_RES_NAME_MAX - 1] = 0;
+	} else {
+		pin = res - BSP_RES_PERIPH_NB;
+		name[0] = 'P';
+		name[1] = 'A' + (pin / 16);
+		pin %= 16;
+		if (pin >= 10) {
+			name[2] = '1';
+			name[3] = '0' + (pin - 10);
+			name[4] = 0;
+		} else {
+			name[2] = '0' + pin;
+			name[3] = 0;
+		}
+	}
+}
+
+/* Returns the name of the thread holding res, NULL if it is free */
+const char *bsp_resource_owner(bsp_resource_t res)
+{
+	thread_t *owner;
+
+	owner = res_owner[res];
+	if (owner == NULL)
+		return NULL;
+	return (owner->name == NULL) ? "?" : owner->name;
+}
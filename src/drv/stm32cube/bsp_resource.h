@@ -0,0 +1,73 @@
+/*
+HydraBus/HydraNFC - Copyright (C) 2014-2023 Benjamin VERNOUX
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef _BSP_RESOURCE_H_
+#define _BSP_RESOURCE_H_
+
+#include "bsp.h"
+
+/*
+ * Peripheral and pin ownership.
+ * A resource is leased by the calling thread (one per console), a lease is
+ * renewed by the same thread and refused with BSP_BUSY for other threads.
+ */
+typedef enum {
+	BSP_RES_SPI1 = 0,
+	BSP_RES_SPI2,
+	BSP_RES_I2C1,
+	BSP_RES_UART1,
+	BSP_RES_UART2,
+	BSP_RES_CAN1,
+	BSP_RES_CAN2,
+	BSP_RES_TIM1,		/* BSP_TIM1 (TIM4) bit-bang timebase */
+	BSP_RES_FREQ1,		/* TIM8 input capture */
+	BSP_RES_DMA2_S2,	/* DMA2 Stream2 */
+	BSP_RES_DMA1_S5,	/* DMA1 Stream5 */
+	BSP_RES_DMA1_S6,	/* DMA1 Stream6 */
+	BSP_RES_PWM,		/* TIM2 PWM timebase */
+	BSP_RES_DMA1_S1,	/* DMA1 Stream1 */
+	BSP_RES_PERIPH_NB,
+	/* GPIO pins PA0..PD15 follow the peripherals */
+	BSP_RES_NB = BSP_RES_PERIPH_NB + (4 * 16)
+} bsp_resource_t;
+
+/* port: 0 (GPIOA) to 3 (GPIOD), pin: 0 to 15 */
+#define BSP_RES_PIN(port, pin)	(BSP_RES_PERIPH_NB + ((port) * 16) + (pin))
+#define BSP_RES_PA(pin)		BSP_RES_PIN(0, pin)
+#define BSP_RES_PB(pin)		BSP_RES_PIN(1, pin)
+#define BSP_RES_PC(pin)		BSP_RES_PIN(2, pin)
+#define BSP_RES_PD(pin)		BSP_RES_PIN(3, pin)
+
+/* Claim/release a list of resources, all or nothing */
+bsp_status_t bsp_resource_claim(const uint8_t *res, uint8_t nb);
+bsp_status_t bsp_resource_release(const uint8_t *res, uint8_t nb);
+
+/* Keep leases of the calling thread past bsp_resource_release_all() */
+bsp_status_t bsp_resource_keep(const uint8_t *res, uint8_t nb);
+
+/*
+ * Release everything leased by the calling thread except kept leases,
+ * or everything leased by owner
+ */
+void bsp_resource_release_all(void);
+void bsp_resource_release_owner(void *owner);
+
+/* Last conflict seen by the calling thread, cleared when read */
+bool bsp_resource_get_conflict(bsp_resource_t *res);
+
+#define BSP_RES_NAME_MAX	(8)
+void bsp_resource_name(bsp_resource_t res, char name[BSP_RES_NAME_MAX]);
+const char *bsp_resource_owner(bsp_resource_t res);
+
+#endif /* _BSP_RESOURCE_H_ */
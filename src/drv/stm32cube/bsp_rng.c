@@ -15,9 +15,24 @@ limitations under the License.
 */
 #include "common.h"
 #include "bsp_rng.h"
+#include "bsp_rng_conf.h"
+
+#include <string.h>
 
 RNG_HandleTypeDef hrng;
 
+/* Interrupt driven double buffer streaming */
+static struct {
+	uint32_t *buffer[2];
+	uint32_t nb_words;
+	uint32_t pos;
+	volatile uint8_t fill;	/* Buffer written by the IRQ */
+	volatile uint8_t ready;	/* Bit mask of buffers waiting for the reader */
+	uint8_t read;		/* Next buffer handed to the reader */
+	binary_semaphore_t sem;
+	bsp_rng_stats_t stats;
+} stream;
+
 /** \brief Init RNG device.
  *
  * \return bsp_status_t: status of the init.
@@ -72,3 +87,114 @@ uint32_t bsp_rng_read()
 	return hrng.Instance->DR;
 }
 
+
+/** \brief RNG interrupt handler, fills the streaming buffers.
+ *
+ */
+OSAL_IRQ_HANDLER(BSP_RNG_IRQ_HANDLER)
+{
+	uint32_t sr;
+
+	OSAL_IRQ_PROLOGUE();
+
+	sr = RNG->SR;
+	if(sr & RNG_SR_SEIS) {
+		/* Seed error, restart the RNG and drop the partial buffer */
+		RNG->SR = ~RNG_SR_SEIS;
+		RNG->CR &= ~RNG_CR_RNGEN;
+		RNG->CR |= RNG_CR_RNGEN;
+		stream.pos = 0;
+		stream.stats.seed_errors++;
+	} else if(sr & RNG_SR_CEIS) {
+		RNG->SR = ~RNG_SR_CEIS;
+		stream.stats.clock_errors++;
+	} else if(sr & RNG_SR_DRDY) {
+		stream.buffer[stream.fill][stream.pos++] = RNG->DR;
+		if(stream.pos == stream.nb_words) {
+			stream.pos = 0;
+			stream.ready |= 1 << stream.fill;
+			stream.fill ^= 1;
+			if(stream.ready & (1 << stream.fill)) {
+				/* Reader still owns next buffer, resumed on release */
+				RNG->CR &= ~RNG_CR_IE;
+				stream.stats.stalls++;
+			}
+			osalSysLockFromISR();
+			chBSemSignalI(&stream.sem);
+			osalSysUnlockFromISR();
+		}
+	}
+
+	OSAL_IRQ_EPILOGUE();
+}
+
+/** \brief Start streaming random numbers into two buffers.
+ *
+ * \param buffer0 uint32_t*: first buffer
+ * \param buffer1 uint32_t*: second buffer
+ * \param nb_words uint32_t: size of each buffer in 32-bit words
+ * \return bsp_status_t: status of the init.
+ *
+ */
+bsp_status_t bsp_rng_stream_start(uint32_t *buffer0, uint32_t *buffer1, uint32_t nb_words)
+{
+	stream.buffer[0] = buffer0;
+	stream.buffer[1] = buffer1;
+	stream.nb_words = nb_words;
+	stream.pos = 0;
+	stream.fill = 0;
+	stream.ready = 0;
+	stream.read = 0;
+	memset(&stream.stats, 0, sizeof(bsp_rng_stats_t));
+	chBSemObjectInit(&stream.sem, TRUE);
+
+	bsp_rng_init();
+	nvicEnableVector(BSP_RNG_IRQ_NUMBER, BSP_RNG_IRQ_PRIORITY);
+	RNG->CR |= RNG_CR_IE;
+
+	return BSP_OK;
+}
+
+/** \brief Wait for the next filled buffer.
+ *
+ * \param timeout sysinterval_t: maximum time to wait
+ * \return uint32_t*: filled buffer or NULL on timeout
+ *
+ */
+uint32_t *bsp_rng_stream_get(sysinterval_t timeout)
+{
+	while(!(stream.ready & (1 << stream.read))) {
+		if(chBSemWaitTimeout(&stream.sem, timeout) != MSG_OK) {
+			return NULL;
+		}
+	}
+	return stream.buffer[stream.read];
+}
+
+/** \brief Give the buffer returned by bsp_rng_stream_get() back to the RNG.
+ *
+ */
+void bsp_rng_stream_release(void)
+{
+	osalSysLock();
+	stream.ready &= ~(1 << stream.read);
+	stream.read ^= 1;
+	RNG->CR |= RNG_CR_IE;
+	osalSysUnlock();
+}
+
+/** \brief Stop streaming and get error statistics.
+ *
+ * \param stats bsp_rng_stats_t*: statistics output, can be NULL
+ *
+ */
+void bsp_rng_stream_stop(bsp_rng_stats_t *stats)
+{
+	RNG->CR &= ~RNG_CR_IE;
+	nvicDisableVector(BSP_RNG_IRQ_NUMBER);
+	bsp_rng_deinit();
+
+	if(stats != NULL) {
+		*stats = stream.stats;
+	}
+}
@@ -19,9 +19,20 @@ limitations under the License.
 #include "bsp.h"
 #include "stm32.h"
 
+typedef struct {
+	uint32_t seed_errors;	/* Seed error (SEIS), buffer in progress discarded */
+	uint32_t clock_errors;	/* Clock error (CEIS) */
+	uint32_t stalls;	/* RNG stopped because both buffers were full */
+} bsp_rng_stats_t;
+
 bsp_status_t bsp_rng_init(void);
 bsp_status_t bsp_rng_deinit(void);
 
 uint32_t bsp_rng_read(void);
 
+bsp_status_t bsp_rng_stream_start(uint32_t *buffer0, uint32_t *buffer1, uint32_t nb_words);
+uint32_t *bsp_rng_stream_get(sysinterval_t timeout);
+void bsp_rng_stream_release(void);
+void bsp_rng_stream_stop(bsp_rng_stats_t *stats);
+
 #endif /* _BSP_RNG_H_ */
@@ -0,0 +1,24 @@
+/*
+HydraBus/HydraNFC - Copyright (C) 2014 Benjamin VERNOUX
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _BSP_RNG_CONF_H_
+#define _BSP_RNG_CONF_H_
+
+/* RNG data ready / error interrupt (HASH_RNG_IRQn shared vector) */
+#define BSP_RNG_IRQ_HANDLER	Vector180
+#define BSP_RNG_IRQ_NUMBER	HASH_RNG_IRQn
+#define BSP_RNG_IRQ_PRIORITY	10
+
+#endif /* _BSP_RNG_CONF_H_ */
@@ -20,6 +20,7 @@ limitations under the License.
 Warning in order to use this driver all GPIOs peripherals shall be enabled.
 */
 #define SDIO_TIMEOUT_MAX (0x100000) // About 10sec (see common/chconf.h/CH_CFG_ST_FREQUENCY)
+#define SDIO_XFER_TIMEOUT (10000) // About 1sec (see common/chconf.h/CH_CFG_ST_FREQUENCY)
 #define NB_SDIO (1)
 
 static mode_config_proto_t* sdio_mode_conf[NB_SDIO];
@@ -321,6 +322,153 @@ bsp_status_t bsp_sdio_read_data(bsp_dev_sdio_t dev_num, uint8_t cmdid, uint32_t
 	}
 }
 
+/**
+  * @brief  Arm the SDIO DMA stream in peripheral flow control mode, the SDIO
+  * data path decides the end of transfer. Memory side is accessed by bytes
+  * so the buffer has no alignment constraint.
+  * @param  dev_num: SDIO dev num.
+  * @param  data: Buffer to transfer.
+  * @param  write: 1 for memory to card, 0 for card to memory.
+  * @retval None
+  */
+void bsp_sdio_dma_start(bsp_dev_sdio_t dev_num, uint8_t *data, uint8_t write)
+{
+	DMA_Stream_TypeDef *stream = BSP_SDIO_DMA_STREAM;
+	(void) dev_num;
+
+	BSP_SDIO_DMA_CLK_ENABLE();
+	stream->CR &= ~DMA_SxCR_EN;
+	while(stream->CR & DMA_SxCR_EN);
+	BSP_SDIO_DMA_CLEAR_FLAGS();
+
+	stream->PAR = (uint32_t)&SDIO->FIFO;
+	stream->M0AR = (uint32_t)data;
+	stream->FCR = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH_0 | DMA_SxFCR_FTH_1;
+	stream->CR = BSP_SDIO_DMA_CHANNEL | DMA_SxCR_PL_1 |
+		     DMA_SxCR_PBURST_0 | DMA_SxCR_PSIZE_1 |
+		     DMA_SxCR_MINC | DMA_SxCR_PFCTRL |
+		     (write ? DMA_SxCR_DIR_0 : 0);
+	stream->CR |= DMA_SxCR_EN;
+}
+
+/**
+  * @brief  Check if the SDIO DMA has flushed all data.
+  * @param  dev_num: SDIO dev num.
+  * @retval TRUE when the transfer is complete.
+  */
+bool bsp_sdio_dma_done(bsp_dev_sdio_t dev_num)
+{
+	(void) dev_num;
+	return BSP_SDIO_DMA_TC() ? TRUE : FALSE;
+}
+
+/**
+  * @brief  Disable the SDIO DMA stream.
+  * @param  dev_num: SDIO dev num.
+  * @retval None
+  */
+void bsp_sdio_dma_stop(bsp_dev_sdio_t dev_num)
+{
+	(void) dev_num;
+	BSP_SDIO_DMA_STREAM->CR &= ~DMA_SxCR_EN;
+	while(BSP_SDIO_DMA_STREAM->CR & DMA_SxCR_EN);
+	BSP_SDIO_DMA_CLEAR_FLAGS();
+}
+
+/**
+  * @brief  Data command of arbitrary length using DMA (e.g. SDIO CMD53).
+  * @param  dev_num: SDIO dev num.
+  * @param  cmdid: Command index.
+  * @param  argument: Command argument.
+  * @param  resp_type: Response type (see bsp_sdio_send_command()).
+  * @param  data: Data buffer, a read may write up to 3 bytes past length.
+  * @param  length: Number of bytes to transfer.
+  * @param  block_size: Block size (power of 2 up to 2048), 0 for SDIO
+  * multibyte mode where length is 1 to 512 bytes.
+  * @param  write: 1 to send data to the card, 0 to receive.
+  * @retval status of the transfer.
+  */
+bsp_status_t bsp_sdio_transfer(bsp_dev_sdio_t dev_num, uint8_t cmdid, uint32_t argument,
+			       uint8_t resp_type, uint8_t *data, uint32_t length,
+			       uint16_t block_size, uint8_t write)
+{
+	SDIO_DataInitTypeDef config;
+	bsp_status_t status = BSP_OK;
+	uint32_t tickstart;
+	uint8_t i;
+
+	if(length == 0) {
+		return BSP_ERROR;
+	}
+	if(block_size == 0) {
+		if(length > BSP_SDIO_BLOCK_LEN) {
+			return BSP_ERROR;
+		}
+		config.DataBlockSize = 0;
+		config.TransferMode  = SDIO_TRANSFER_MODE_STREAM;
+	} else {
+		for(i = 0; (1U << i) < block_size; i++);
+		if((1U << i) != block_size || i > 11 || (length % block_size) != 0) {
+			return BSP_ERROR;
+		}
+		config.DataBlockSize = i << SDIO_DCTRL_DBLOCKSIZE_Pos;
+		config.TransferMode  = SDIO_TRANSFER_MODE_BLOCK;
+	}
+	config.DataTimeOut   = SDIO_TIMEOUT_MAX;
+	config.DataLength    = length;
+	config.TransferDir   = write ? SDIO_TRANSFER_DIR_TO_CARD : SDIO_TRANSFER_DIR_TO_SDIO;
+	config.DPSM          = SDIO_DPSM_ENABLE;
+
+	SDIO->DCTRL = 0;
+
+	/* Data path shall not start before the card has accepted a write */
+	if(write) {
+		status = bsp_sdio_send_command(dev_num, cmdid, argument, resp_type);
+		if(status != BSP_OK) {
+			return status;
+		}
+	}
+
+	bsp_sdio_dma_start(dev_num, data, write);
+	__SDIO_DMA_ENABLE(SDIO);
+	if(block_size == 0) {
+		SDIO->DCTRL |= SDIO_DCTRL_SDIOEN;
+	}
+	(void)SDIO_ConfigData(SDIO, &config);
+
+	if(!write) {
+		status = bsp_sdio_send_command(dev_num, cmdid, argument, resp_type);
+	}
+
+	tickstart = HAL_GetTick();
+	while(status == BSP_OK &&
+	      !__SDIO_GET_FLAG(SDIO, SDIO_FLAG_RXOVERR | SDIO_FLAG_TXUNDERR |
+			       SDIO_FLAG_DCRCFAIL | SDIO_FLAG_DTIMEOUT | SDIO_FLAG_DATAEND)) {
+		if((HAL_GetTick() - tickstart) >= SDIO_XFER_TIMEOUT) {
+			status = BSP_TIMEOUT;
+		}
+	}
+	if(__SDIO_GET_FLAG(SDIO, SDIO_FLAG_DTIMEOUT)) {
+		status = BSP_TIMEOUT;
+	} else if(__SDIO_GET_FLAG(SDIO, SDIO_FLAG_RXOVERR | SDIO_FLAG_TXUNDERR | SDIO_FLAG_DCRCFAIL)) {
+		status = BSP_ERROR;
+	}
+
+	/* DMA FIFO is flushed to memory after DATAEND on reads */
+	while(status == BSP_OK && !write && !bsp_sdio_dma_done(dev_num)) {
+		if((HAL_GetTick() - tickstart) >= SDIO_XFER_TIMEOUT) {
+			status = BSP_TIMEOUT;
+		}
+	}
+
+	SDIO->DCTRL = 0;
+	bsp_sdio_dma_stop(dev_num);
+	__SDIO_CLEAR_FLAG(SDIO, SDIO_STATIC_CMD_FLAGS);
+	__SDIO_CLEAR_FLAG(SDIO, SDIO_STATIC_DATA_FLAGS);
+
+	return status;
+}
+
 bsp_status_t bsp_sdio_change_bus_width(bsp_dev_sdio_t dev_num, uint8_t bus_size)
 {
 	bsp_status_t status;
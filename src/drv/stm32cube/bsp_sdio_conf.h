@@ -31,4 +31,16 @@ limitations under the License.
 #define BSP_SDIO_D0_PORT       GPIOC
 #define BSP_SDIO_D0_PIN        GPIO_PIN_8  /* PC.08 */
 
+/* SDIO DMA (DMA2 Stream3 Channel4) =>
+Shared with the ChibiOS SDC driver (STM32_SDC_SDIO_DMA_STREAM in mcuconf.h),
+only free while SDCD1 is stopped.
+*/
+#define BSP_SDIO_DMA_CHANNEL	DMA_CHANNEL_4
+#define BSP_SDIO_DMA_STREAM	DMA2_Stream3
+#define BSP_SDIO_DMA_CLK_ENABLE()	__DMA2_CLK_ENABLE()
+#define BSP_SDIO_DMA_TC()	(DMA2->LISR & DMA_LISR_TCIF3)
+#define BSP_SDIO_DMA_CLEAR_FLAGS()	(DMA2->LIFCR = DMA_LIFCR_CFEIF3 | \
+					 DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CTEIF3 | \
+					 DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTCIF3)
+
 #endif /* _BSP_SDIO_CONF_H_ */
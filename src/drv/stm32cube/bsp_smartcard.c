@@ -12,6 +12,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include "common.h"
 #include "bsp_smartcard.h"
 #include "bsp_smartcard_conf.h"
 #include "bsp_gpio.h"
@@ -29,6 +30,15 @@ static SMARTCARD_HandleTypeDef smartcard_handle[NB_SMARTCARD];
 static mode_config_proto_t* smartcard_mode_conf[NB_SMARTCARD];
 static volatile uint16_t dummy_read;
 
+/* Interrupt driven receive ring */
+#define SMARTCARD_RX_BUFFER_SIZE (512)
+static struct {
+	uint8_t buffer[SMARTCARD_RX_BUFFER_SIZE];
+	volatile uint16_t head;
+	uint16_t tail;
+	binary_semaphore_t sem;
+} smartcard_rx;
+
 extern uint8_t reverse_u8(uint8_t value);
 extern uint32_t HAL_RCC_GetPCLK2Freq(void);
 
@@ -209,6 +219,8 @@ bsp_status_t bsp_smartcard_deinit(bsp_dev_smartcard_t dev_num)
 
 	hsmartcard = &smartcard_handle[dev_num];
 
+	nvicDisableVector(BSP_SMARTCARD1_IRQ_NUMBER);
+
 	/* De-initialize the SMARTCARD comunication bus */
 	status = (bsp_status_t) HAL_SMARTCARD_DeInit(hsmartcard);
 
@@ -307,6 +319,122 @@ bsp_status_t bsp_smartcard_rxne(bsp_dev_smartcard_t dev_num)
 }
 
 
+/**
+  * @brief  SMARTCARD1 interrupt handler, stores received bytes in the ring.
+  *         Characters with a parity error are dropped, the card repeats
+  *         them after the NACK.
+  */
+OSAL_IRQ_HANDLER(BSP_SMARTCARD1_IRQ_HANDLER)
+{
+	uint32_t sr;
+	uint8_t data;
+	uint16_t next;
+
+	OSAL_IRQ_PROLOGUE();
+
+	sr = BSP_SMARTCARD1->SR;
+	data = BSP_SMARTCARD1->DR;
+	if((sr & USART_SR_RXNE) && !(sr & USART_SR_PE)) {
+		next = (smartcard_rx.head + 1) % SMARTCARD_RX_BUFFER_SIZE;
+		if(next != smartcard_rx.tail) {
+			smartcard_rx.buffer[smartcard_rx.head] = data;
+			smartcard_rx.head = next;
+		}
+		osalSysLockFromISR();
+		chBSemSignalI(&smartcard_rx.sem);
+		osalSysUnlockFromISR();
+	}
+
+	OSAL_IRQ_EPILOGUE();
+}
+
+/**
+  * @brief  Switch reception to interrupt mode.
+  *         bsp_smartcard_read_u8() shall not be used until
+  *         bsp_smartcard_irq_stop() is called.
+  * @param  dev_num: SMARTCARD dev num.
+  */
+void bsp_smartcard_irq_start(bsp_dev_smartcard_t dev_num)
+{
+	SMARTCARD_HandleTypeDef* hsmartcard;
+	hsmartcard = &smartcard_handle[dev_num];
+
+	CLEAR_BIT(hsmartcard->Instance->CR1, USART_CR1_RXNEIE);
+	smartcard_rx.head = 0;
+	smartcard_rx.tail = 0;
+	chBSemObjectInit(&smartcard_rx.sem, TRUE);
+	__HAL_SMARTCARD_FLUSH_DRREGISTER(hsmartcard);
+
+	nvicEnableVector(BSP_SMARTCARD1_IRQ_NUMBER, BSP_SMARTCARD1_IRQ_PRIORITY);
+	SET_BIT(hsmartcard->Instance->CR1, USART_CR1_RXNEIE);
+}
+
+/**
+  * @brief  Switch reception back to polling mode.
+  * @param  dev_num: SMARTCARD dev num.
+  */
+void bsp_smartcard_irq_stop(bsp_dev_smartcard_t dev_num)
+{
+	SMARTCARD_HandleTypeDef* hsmartcard;
+	hsmartcard = &smartcard_handle[dev_num];
+
+	CLEAR_BIT(hsmartcard->Instance->CR1, USART_CR1_RXNEIE);
+	nvicDisableVector(BSP_SMARTCARD1_IRQ_NUMBER);
+}
+
+/**
+  * @brief  Sends bytes in interrupt mode. The bytes echoed on the shared
+  *         I/O line are discarded.
+  * @param  dev_num: SMARTCARD dev num.
+  * @param  tx_data: data to send.
+  * @param  nb_data: Number of data to send.
+  * @retval status of the transfer.
+  */
+bsp_status_t bsp_smartcard_irq_write(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint16_t nb_data)
+{
+	SMARTCARD_HandleTypeDef* hsmartcard;
+	hsmartcard = &smartcard_handle[dev_num];
+
+	bsp_status_t status;
+	CLEAR_BIT(hsmartcard->Instance->CR1, USART_CR1_RXNEIE);
+	status = (bsp_status_t) HAL_SMARTCARD_Transmit(hsmartcard, tx_data, nb_data, SMARTCARDx_TIMEOUT_MAX);
+
+	__HAL_SMARTCARD_FLUSH_DRREGISTER(hsmartcard);
+	dummy_read = hsmartcard->Instance->SR;
+	dummy_read = hsmartcard->Instance->DR;
+	smartcard_rx.tail = smartcard_rx.head;
+	chBSemReset(&smartcard_rx.sem, TRUE);
+	SET_BIT(hsmartcard->Instance->CR1, USART_CR1_RXNEIE);
+
+	return status;
+}
+
+/**
+  * @brief  Read bytes received in interrupt mode.
+  * @param  dev_num: SMARTCARD dev num.
+  * @param  rx_data: Data to receive.
+  * @param  nb_data: Number of data to receive.
+  * @param  timeout: Maximum time to wait for each byte
+  * @retval status of the transfer.
+  */
+bsp_status_t bsp_smartcard_irq_read(bsp_dev_smartcard_t dev_num, uint8_t* rx_data, uint16_t nb_data, uint32_t timeout)
+{
+	uint16_t i;
+	(void)dev_num;
+
+	for(i = 0; i < nb_data; i++) {
+		while(smartcard_rx.tail == smartcard_rx.head) {
+			if(chBSemWaitTimeout(&smartcard_rx.sem, timeout) != MSG_OK) {
+				return BSP_TIMEOUT;
+			}
+		}
+		rx_data[i] = smartcard_rx.buffer[smartcard_rx.tail];
+		smartcard_rx.tail = (smartcard_rx.tail + 1) % SMARTCARD_RX_BUFFER_SIZE;
+	}
+
+	return BSP_OK;
+}
+
 /** @brief  Get Smartcard RST pin value
   * @param  dev_num: smartcard device
   * @retval state: RST pin value
@@ -32,6 +32,11 @@ bsp_status_t bsp_smartcard_read_u8(bsp_dev_smartcard_t dev_num, uint8_t* rx_data
 bsp_status_t bsp_smartcard_write_read_u8(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint8_t nb_data);
 bsp_status_t bsp_smartcard_rxne(bsp_dev_smartcard_t dev_num);
 
+void bsp_smartcard_irq_start(bsp_dev_smartcard_t dev_num);
+void bsp_smartcard_irq_stop(bsp_dev_smartcard_t dev_num);
+bsp_status_t bsp_smartcard_irq_write(bsp_dev_smartcard_t dev_num, uint8_t* tx_data, uint16_t nb_data);
+bsp_status_t bsp_smartcard_irq_read(bsp_dev_smartcard_t dev_num, uint8_t* rx_data, uint16_t nb_data, uint32_t timeout);
+
 uint32_t bsp_smartcard_get_final_baudrate(bsp_dev_smartcard_t dev_num);
 
 uint8_t bsp_smartcard_get_cd(bsp_dev_smartcard_t dev_num);
@@ -20,6 +20,9 @@ limitations under the License.
 #define BSP_SMARTCARD1             USART1
 #define BSP_SMARTCARD1_GPIO_SPEED  GPIO_SPEED_FAST
 #define BSP_SMARTCARD1_AF          GPIO_AF7_USART1
+#define BSP_SMARTCARD1_IRQ_HANDLER  VectorD4 /* USART1_IRQn */
+#define BSP_SMARTCARD1_IRQ_NUMBER   USART1_IRQn
+#define BSP_SMARTCARD1_IRQ_PRIORITY 12
 
 /* SMARTCARD1 VCC */
 #define BSP_SMARTCARD1_VCC_PORT    GPIOA
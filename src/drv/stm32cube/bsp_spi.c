@@ -14,6 +14,8 @@ limitations under the License.
 */
 #include "bsp_spi.h"
 #include "bsp_spi_conf.h"
+#include "bsp_resource.h"
+#include "profile.h"
 
 /*
 Warning in order to use this driver all GPIOs peripherals shall be enabled.
@@ -23,6 +25,12 @@ Warning in order to use this driver all GPIOs peripherals shall be enabled.
 static SPI_HandleTypeDef spi_handle[NB_SPI];
 static mode_config_proto_t* spi_mode_conf[NB_SPI];
 
+/* Peripheral, NSS, SCK, MISO, MOSI (see bsp_spi_conf.h) */
+static const uint8_t spi_res[NB_SPI][5] = {
+	{ BSP_RES_SPI1, BSP_RES_PA(15), BSP_RES_PB(3), BSP_RES_PB(4), BSP_RES_PB(5) },
+	{ BSP_RES_SPI2, BSP_RES_PC(1), BSP_RES_PB(10), BSP_RES_PC(2), BSP_RES_PC(3) }
+};
+
 /**
   * @brief  Init low level hardware: GPIO, CLOCK, NVIC...
   * @param  dev_num: SPI dev num
@@ -156,6 +164,9 @@ bsp_status_t bsp_spi_init(bsp_dev_spi_t dev_num, mode_config_proto_t* mode_conf)
 	uint32_t cpha;
 	uint32_t gpio_sck_miso_mosi_pull;
 
+	if(bsp_resource_claim(spi_res[dev_num], sizeof(spi_res[0])) != BSP_OK)
+		return BSP_BUSY;
+
 	spi_mode_conf[dev_num] = mode_conf;
 	hspi = &spi_handle[dev_num];
 
@@ -234,6 +245,9 @@ bsp_status_t bsp_spi_deinit(bsp_dev_spi_t dev_num)
 	SPI_HandleTypeDef* hspi;
 	bsp_status_t status;
 
+	if(bsp_resource_release(spi_res[dev_num], sizeof(spi_res[0])) != BSP_OK)
+		return BSP_BUSY;
+
 	hspi = &spi_handle[dev_num];
 
 	/* De-initialize the SPI comunication bus */
@@ -311,10 +325,14 @@ bsp_status_t bsp_spi_write_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t n
 	hspi = &spi_handle[dev_num];
 
 	bsp_status_t status;
+	uint32_t start;
+
+	start = prof_start();
 	status = (bsp_status_t) HAL_SPI_Transmit(hspi, tx_data, nb_data, SPIx_TIMEOUT_MAX);
 	if(status != BSP_OK) {
 		spi_error(dev_num);
 	}
+	prof_record(PROF_SPI, start);
 	return status;
 }
 
@@ -331,10 +349,14 @@ bsp_status_t bsp_spi_read_u8(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint8_t nb
 	hspi = &spi_handle[dev_num];
 
 	bsp_status_t status;
+	uint32_t start;
+
+	start = prof_start();
 	status = (bsp_status_t) HAL_SPI_Receive(hspi, rx_data, nb_data, SPIx_TIMEOUT_MAX);
 	if(status != BSP_OK) {
 		spi_error(dev_num);
 	}
+	prof_record(PROF_SPI, start);
 	return status;
 }
 
@@ -351,10 +373,14 @@ bsp_status_t bsp_spi_write_read_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint
 	hspi = &spi_handle[dev_num];
 
 	bsp_status_t status;
+	uint32_t start;
+
+	start = prof_start();
 	status = (bsp_status_t) HAL_SPI_TransmitReceive(hspi, tx_data, rx_data, nb_data, SPIx_TIMEOUT_MAX);
 	if(status != BSP_OK) {
 		spi_error(dev_num);
 	}
+	prof_record(PROF_SPI, start);
 	return status;
 }
 
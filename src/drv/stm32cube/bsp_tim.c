@@ -15,9 +15,11 @@ limitations under the License.
 */
 #include "bsp_tim.h"
 #include "bsp_tim_conf.h"
+#include "bsp_resource.h"
 
 /* BSP_TIM */
 static TIM_HandleTypeDef bsp_htim;
+static const uint8_t tim_res[] = { BSP_RES_TIM1 };
 
 /** \brief Init & Start TIMER device.
  *
@@ -30,6 +32,10 @@ static TIM_HandleTypeDef bsp_htim;
  */
 void bsp_tim_init(uint32_t tim_period, uint32_t prescaler, uint32_t clock_division, uint32_t counter_mode)
 {
+	/* The conflict is reported by bsp_resource_get_conflict() */
+	if(bsp_resource_claim(tim_res, sizeof(tim_res)) != BSP_OK)
+		return;
+
 	bsp_htim.Instance = BSP_TIM1;
 
 	bsp_htim.Init.Period = tim_period - 1;
@@ -51,6 +57,9 @@ void bsp_tim_init(uint32_t tim_period, uint32_t prescaler, uint32_t clock_divisi
  */
 void bsp_tim_deinit(void)
 {
+	if(bsp_resource_release(tim_res, sizeof(tim_res)) != BSP_OK)
+		return;
+
 	bsp_htim.Instance = BSP_TIM1;
 
 	HAL_TIM_Base_Stop(&bsp_htim);
@@ -79,6 +88,63 @@ void bsp_tim_set_prescaler(uint32_t prescaler)
 	HAL_TIM_Base_Start(&bsp_htim);
 }
 
+/* Split update_freq into period and prescaler, keep the period as large as possible for accuracy */
+static void bsp_tim_freq_to_div(uint32_t update_freq, uint32_t *period, uint32_t *prescaler)
+{
+	uint32_t ticks;
+
+	if(update_freq == 0) {
+		update_freq = 1;
+	}
+	ticks = BSP_TIM1_CLK_FREQ / update_freq;
+	if(ticks < 2) {
+		ticks = 2;
+	}
+	*prescaler = (ticks / 0x10000) + 1;
+	*period = ticks / *prescaler;
+}
+
+/** \brief Init & Start TIMER device with an update event rate.
+ *
+ * \param update_freq uint32_t: Update events per second, up to BSP_TIM1_CLK_FREQ/2.
+ * \return uint32_t: Update events per second actually programmed.
+ *
+ */
+uint32_t bsp_tim_init_freq(uint32_t update_freq)
+{
+	uint32_t period, prescaler;
+
+	bsp_tim_freq_to_div(update_freq, &period, &prescaler);
+	bsp_tim_init(period, prescaler, TIM_CLOCKDIVISION_DIV1, TIM_COUNTERMODE_UP);
+
+	return BSP_TIM1_CLK_FREQ / (period * prescaler);
+}
+
+/** \brief Change update event rate of a running TIMER device.
+ *
+ * \param update_freq uint32_t: Update events per second, up to BSP_TIM1_CLK_FREQ/2.
+ * \return uint32_t: Update events per second actually programmed.
+ *
+ */
+uint32_t bsp_tim_set_freq(uint32_t update_freq)
+{
+	uint32_t period, prescaler;
+
+	bsp_tim_freq_to_div(update_freq, &period, &prescaler);
+
+	bsp_htim.Instance = BSP_TIM1;
+
+	HAL_TIM_Base_Stop(&bsp_htim);
+	HAL_TIM_Base_DeInit(&bsp_htim);
+	bsp_htim.Init.Period = period - 1;
+	bsp_htim.Init.Prescaler = prescaler - 1;
+	HAL_TIM_Base_Init(&bsp_htim);
+	BSP_TIM1->SR &= ~TIM_SR_UIF;  //clear overflow flag
+	HAL_TIM_Base_Start(&bsp_htim);
+
+	return BSP_TIM1_CLK_FREQ / (period * prescaler);
+}
+
 /* Start the TIM Base generation. */
 void bsp_tim_start(void)
 {
@@ -51,6 +51,12 @@ void bsp_tim_init(uint32_t tim_period, uint32_t prescaler, uint32_t clock_divisi
 /* Set Prescaler of TIMER device */
 void bsp_tim_set_prescaler(uint32_t prescaler);
 
+/* Init & Start TIMER device with an update event rate */
+uint32_t bsp_tim_init_freq(uint32_t update_freq);
+
+/* Change update event rate of TIMER device */
+uint32_t bsp_tim_set_freq(uint32_t update_freq);
+
 /* Stop, DeInit and Disable TIMER device */
 void bsp_tim_deinit(void);
 
@@ -21,5 +21,6 @@ limitations under the License.
 #define BSP_TIM1             TIM4
 #define BSP_TIM1_CLK_ENABLE  __TIM4_CLK_ENABLE
 #define BSP_TIM1_CLK_DISABLE  __TIM4_CLK_DISABLE
+#define BSP_TIM1_CLK_FREQ     (84000000) /* APB1 timers clock */
 
 #endif /* _BSP_TIM_CONF_H_ */
@@ -14,6 +14,8 @@ limitations under the License.
 */
 #include "bsp_uart.h"
 #include "bsp_uart_conf.h"
+#include "bsp_resource.h"
+#include "profile.h"
 
 /*
 Warning in order to use this driver all GPIOs peripherals shall be enabled.
@@ -29,6 +31,12 @@ static UART_HandleTypeDef uart_handle[NB_UART];
 static mode_config_proto_t* uart_mode_conf[NB_UART];
 static volatile uint16_t dummy_read;
 
+/* Peripheral, TX, RX (see bsp_uart_conf.h) */
+static const uint8_t uart_res[NB_UART][3] = {
+	{ BSP_RES_UART1, BSP_RES_PA(9), BSP_RES_PA(10) },
+	{ BSP_RES_UART2, BSP_RES_PA(2), BSP_RES_PA(3) }
+};
+
 /**
   * @brief  Init low level hardware: GPIO, CLOCK, NVIC...
   * @param  dev_num: UART dev num
@@ -133,6 +141,9 @@ bsp_status_t bsp_uart_init(bsp_dev_uart_t dev_num, mode_config_proto_t* mode_con
 	UART_HandleTypeDef* huart;
 	bsp_status_t status;
 
+	if(bsp_resource_claim(uart_res[dev_num], sizeof(uart_res[0])) != BSP_OK)
+		return BSP_BUSY;
+
 	uart_mode_conf[dev_num] = mode_conf;
 	huart = &uart_handle[dev_num];
 
@@ -222,6 +233,9 @@ bsp_status_t bsp_uart_deinit(bsp_dev_uart_t dev_num)
 	UART_HandleTypeDef* huart;
 	bsp_status_t status;
 
+	if(bsp_resource_release(uart_res[dev_num], sizeof(uart_res[0])) != BSP_OK)
+		return BSP_BUSY;
+
 	huart = &uart_handle[dev_num];
 
 	/* De-initialize the UART comunication bus */
@@ -246,10 +260,14 @@ bsp_status_t bsp_uart_write_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, uint8_t
 	huart = &uart_handle[dev_num];
 
 	bsp_status_t status;
+	uint32_t start;
+
+	start = prof_start();
 	status = (bsp_status_t) HAL_UART_Transmit(huart, tx_data, nb_data, UARTx_TIMEOUT_MAX);
 	if(status != BSP_OK) {
 		uart_error(dev_num);
 	}
+	prof_record(PROF_UART, start);
 	return status;
 }
 
@@ -268,6 +286,9 @@ bsp_status_t bsp_uart_read_u8(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint8_t
 	huart = &uart_handle[dev_num];
 
 	bsp_status_t status;
+	uint32_t start;
+
+	start = prof_start();
 	status = (bsp_status_t) HAL_UART_Receive(huart, rx_data, *nb_data, timeout);
 	switch(status){
 	case BSP_OK:
@@ -281,6 +302,7 @@ bsp_status_t bsp_uart_read_u8(bsp_dev_uart_t dev_num, uint8_t* rx_data, uint8_t
 		*nb_data = 0;
 		uart_error(dev_num);
 	}
+	prof_record(PROF_UART, start);
 	return status;
 }
 
@@ -297,12 +319,16 @@ bsp_status_t bsp_uart_write_read_u8(bsp_dev_uart_t dev_num, uint8_t* tx_data, ui
 	huart = &uart_handle[dev_num];
 
 	bsp_status_t status;
+	uint32_t start;
+
+	start = prof_start();
 	status = (bsp_status_t) HAL_UART_Transmit(huart, tx_data, nb_data, UARTx_TIMEOUT_MAX);
 	if(status == BSP_OK) {
 		status = (bsp_status_t) HAL_UART_Receive(huart, rx_data, nb_data, UARTx_TIMEOUT_MAX);
 	} else {
 		uart_error(dev_num);
 	}
+	prof_record(PROF_UART, start);
 	return status;
 }
 
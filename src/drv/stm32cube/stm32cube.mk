@@ -17,6 +17,7 @@ STM32CUBESRC = ./drv/stm32cube/bsp.c \
                ./drv/stm32cube/bsp_sdio.c \
                ./drv/stm32cube/bsp_mmc.c \
                ./drv/stm32cube/bsp_sd.c \
+               ./drv/stm32cube/bsp_resource.c \
                ./drv/stm32cube/bsp_fault_handler.c \
                ./drv/stm32cube/bsp_print_dbg.c
 
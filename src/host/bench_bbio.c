@@ -0,0 +1,298 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host benchmark of the BBIO protocol layer: cmd_bbio() and the BBIO SPI
+ * mode are run on a command stream held in memory against the mock BSP,
+ * and the frame layer over a memory loopback. The workloads are the ones
+ * of scripts/bbio_bench.py so that the protocol cost can be followed
+ * without a board. The replies are checked, a mismatch fails the run.
+ *
+ * Usage: bench_bbio [count]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "stub_bsp.h"
+#include "hydrabus_bbio.h"
+#include "profile.h"
+#include "frame.h"
+
+int cmd_bbio(t_hydra_console *con);
+
+#define BBIO_SPI_WRITE_READ_CMD		(0x04)
+#define BBIO_SPI_BULK_CMD		(0x10)
+
+static t_mode_config mode;
+static host_stream_t stream;
+static t_hydra_console con = {
+	.sdu = &stream,
+	.mode = &mode,
+};
+
+static uint8_t *in_buf;
+static uint32_t in_len;
+static uint8_t *out_buf;
+static uint32_t out_size;
+static int failures;
+
+static void in_put(const uint8_t *data, uint32_t len)
+{
+	memcpy(&in_buf[in_len], data, len);
+	in_len += len;
+}
+
+static void in_byte(uint8_t data)
+{
+	in_put(&data, 1);
+}
+
+static void report(const char *name, uint32_t count, uint64_t tx_bytes,
+		   uint64_t rx_bytes, uint32_t ns)
+{
+	prof_stat_t stat;
+	double t = ns / 1e9;
+
+	prof_get(PROF_BBIO_SPI, &stat);
+	printf("%-10s %8u cmds %8.3f us/cmd %10.2f KB/s TX %10.2f KB/s RX",
+	       name, count, t * 1e6 / count,
+	       tx_bytes / t / 1024, rx_bytes / t / 1024);
+	if (stat.count > 0)
+		printf("  spi p50 %u ns p99 %u ns",
+		       prof_percentile(&stat, 50), prof_percentile(&stat, 99));
+	printf("\n");
+}
+
+static void check(const char *name, int ok)
+{
+	if (!ok) {
+		printf("FAIL %s\n", name);
+		failures++;
+	}
+}
+
+/* Runs cmd_bbio() on the input built, returns the time spent in ns */
+static uint32_t run(void)
+{
+	uint32_t start;
+
+	host_stream_init(&stream, in_buf, in_len, out_buf, out_size);
+	host_ubtn_stream = &stream;
+	prof_reset();
+	start = host_get_ns();
+	cmd_bbio(&con);
+	return host_get_ns() - start;
+}
+
+/* SPI mode entry from BBIO and reset */
+static void bench_mode(uint32_t count)
+{
+	uint32_t i, ns;
+
+	in_len = 0;
+	for (i = 0; i < count; i++) {
+		in_byte(BBIO_SPI);
+		in_byte(BBIO_RESET);
+	}
+	ns = run();
+	report("mode", count, 2 * count, 9 * count, ns);
+	check("mode", stream.out_len == 5 + 9 * count &&
+	      memcmp(out_buf, "BBIO1SPI1BBIO1", 14) == 0);
+}
+
+/* CS low/high, one byte command and answer */
+static void bench_cs(uint32_t count)
+{
+	uint32_t i, ns;
+
+	in_len = 0;
+	in_byte(BBIO_SPI);
+	for (i = 0; i < count; i++)
+		in_byte((i & 1) ? BBIO_SPI_CS_HIGH : BBIO_SPI_CS_LOW);
+	in_byte(BBIO_RESET);
+	ns = run();
+	report("cs", count, count, count, ns);
+	check("cs", stream.out_len == 5 + 4 + count + 5 &&
+	      out_buf[9] == 0x01 &&
+	      host_spi[BSP_DEV_SPI1].cs == ((count - 1) & 1));
+}
+
+/* Bulk transfers of len bytes, MISO is MOSI inverted */
+static void bench_bulk(uint32_t count, uint8_t len)
+{
+	uint8_t data[16];
+	char name[16];
+	uint32_t i, j, ns;
+	int ok;
+
+	in_len = 0;
+	in_byte(BBIO_SPI);
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < len; j++)
+			data[j] = i + j;
+		in_byte(BBIO_SPI_BULK_CMD | (len - 1));
+		in_put(data, len);
+	}
+	in_byte(BBIO_RESET);
+	ns = run();
+	snprintf(name, sizeof(name), "bulk-%d", len);
+	report(name, count, (uint64_t)(len + 1) * count,
+	       (uint64_t)(len + 1) * count, ns);
+
+	ok = stream.out_len == 5 + 4 + (len + 1) * count + 5;
+	for (j = 0; ok && j < len; j++)
+		ok = out_buf[10 + j] == (uint8_t)~j;
+	check(name, ok);
+}
+
+/* Write then read of len bytes with CS */
+static void bench_write_read(uint32_t count, uint32_t len)
+{
+	uint8_t hdr[5];
+	char name[16];
+	uint32_t i, ns;
+
+	hdr[0] = BBIO_SPI_WRITE_READ_CMD;
+	hdr[1] = len >> 8;
+	hdr[2] = len & 0xff;
+	hdr[3] = len >> 8;
+	hdr[4] = len & 0xff;
+
+	in_len = 0;
+	in_byte(BBIO_SPI);
+	for (i = 0; i < count; i++) {
+		in_put(hdr, sizeof(hdr));
+		memset(&in_buf[in_len], i, len);
+		in_len += len;
+	}
+	in_byte(BBIO_RESET);
+	ns = run();
+	snprintf(name, sizeof(name), "wr-%d", len);
+	report(name, count, (uint64_t)(len + 5) * count,
+	       (uint64_t)(len + 1) * count, ns);
+	check(name, stream.out_len == 5 + 4 + (len + 1) * count + 5 &&
+	      out_buf[9] == 0x01 && out_buf[10] == HOST_SPI_IDLE &&
+	      host_spi[BSP_DEV_SPI1].cs == 1);
+}
+
+/* Frame layer over a memory loopback with 64 bytes packets */
+typedef struct {
+	uint8_t buf[FRAME_HDR_SIZE + 4096];
+	uint32_t len;
+	uint32_t pos;
+	uint32_t zlp;
+} loopback_t;
+
+static uint32_t loopback_read(void *priv, uint8_t *buf, uint32_t len,
+			      uint32_t timeout_ms)
+{
+	loopback_t *lb = priv;
+
+	(void)timeout_ms;
+	len = MIN(len, lb->len - lb->pos);
+	memcpy(buf, &lb->buf[lb->pos], len);
+	lb->pos += len;
+	return len;
+}
+
+static uint32_t loopback_write(void *priv, const uint8_t *buf, uint32_t len)
+{
+	loopback_t *lb = priv;
+
+	if (len == 0) {
+		lb->zlp++;
+		return 0;
+	}
+	memcpy(lb->buf, buf, len);
+	lb->len = len;
+	lb->pos = 0;
+	return len;
+}
+
+static void bench_frame(uint32_t count, uint32_t len)
+{
+	static loopback_t lb;
+	static uint8_t frame[FRAME_HDR_SIZE + 4096];
+	static uint8_t payload[4096];
+	const frame_transport_t tr = {
+		.priv = &lb,
+		.packet_size = 64,
+		.read = loopback_read,
+		.write = loopback_write,
+		.flush = NULL,
+	};
+	char name[16];
+	uint32_t i, rx_len, start, ns;
+	uint8_t channel;
+	int ok;
+
+	ok = 1;
+	memset(&lb, 0, sizeof(lb));
+	prof_reset();
+	start = host_get_ns();
+	for (i = 0; i < count; i++) {
+		frame[FRAME_HDR_SIZE] = i;
+		ok &= frame_send(&tr, 1, frame, len) == FRAME_OK;
+		ok &= frame_recv(&tr, &channel, payload, sizeof(payload),
+				 &rx_len, 0) == FRAME_OK;
+		ok &= channel == 1 && rx_len == len && payload[0] == (uint8_t)i;
+	}
+	ns = host_get_ns() - start;
+	snprintf(name, sizeof(name), "frame-%d", len);
+	report(name, count, (uint64_t)(len + FRAME_HDR_SIZE) * count,
+	       (uint64_t)len * count, ns);
+	/* Header and payload fill a multiple of 64 bytes: ZLP each frame */
+	check(name, ok && lb.zlp == (((len + FRAME_HDR_SIZE) % 64) ? 0 : count));
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t count = 10000;
+
+	if (argc > 1)
+		count = strtoul(argv[1], NULL, 0);
+	if (count == 0)
+		count = 1;
+
+	pool_init();
+	in_buf = malloc(count * (4096 + 5) + 16);
+	out_size = 64 * 1024;
+	out_buf = malloc(out_size);
+	if (in_buf == NULL || out_buf == NULL)
+		return 1;
+
+	bench_mode(count);
+	bench_cs(count);
+	bench_bulk(count, 1);
+	bench_bulk(count, 16);
+	bench_write_read(count, 64);
+	bench_write_read(count, 512);
+	bench_write_read(count, 4096);
+	bench_frame(count, 60);
+	bench_frame(count, 4092);
+
+	free(in_buf);
+	free(out_buf);
+	if (failures) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+	return 0;
+}
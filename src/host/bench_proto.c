@@ -0,0 +1,346 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host benchmark of the serprog and SUMP protocol layers: the unmodified
+ * bbio_mode_serprog() and sump() are run on a command stream held in
+ * memory against the mock BSP, serprog also over a pipe fed by a child
+ * process to include the cost of the system calls. The workloads are the
+ * ones of flashrom (queries, page reads and programs) and of a SUMP
+ * client (identification, setup and capture). The replies are checked,
+ * a mismatch fails the run.
+ *
+ * Usage: bench_proto [count]
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "stub_bsp.h"
+#include "hydrabus_serprog.h"
+#include "hydrabus_sump.h"
+
+static t_mode_config mode;
+static host_stream_t stream;
+static t_hydra_console con = {
+	.sdu = &stream,
+	.mode = &mode,
+};
+
+static uint8_t *in_buf;
+static uint32_t in_len;
+static uint8_t *out_buf;
+static uint32_t out_size;
+static int failures;
+
+static void in_put(const uint8_t *data, uint32_t len)
+{
+	memcpy(&in_buf[in_len], data, len);
+	in_len += len;
+}
+
+static void in_byte(uint8_t data)
+{
+	in_put(&data, 1);
+}
+
+static void report(const char *name, uint32_t count, uint64_t tx_bytes,
+		   uint64_t rx_bytes, uint32_t ns)
+{
+	double t = ns / 1e9;
+
+	printf("%-17s %8u cmds %8.3f us/cmd %10.2f KB/s TX %10.2f KB/s RX\n",
+	       name, count, t * 1e6 / count,
+	       tx_bytes / t / 1024, rx_bytes / t / 1024);
+}
+
+static void check(const char *name, int ok)
+{
+	if (!ok) {
+		printf("FAIL %s\n", name);
+		failures++;
+	}
+}
+
+/* Runs the protocol on the input built, returns the time spent in ns */
+static uint32_t run(void (*proto)(t_hydra_console *con))
+{
+	uint32_t start;
+
+	host_stream_init(&stream, in_buf, in_len, out_buf, out_size);
+	host_ubtn_stream = &stream;
+	start = host_get_ns();
+	proto(&con);
+	return host_get_ns() - start;
+}
+
+/*
+ * Same over a pipe written by a child process, the replies go to
+ * /dev/null and only their length is kept
+ */
+static uint32_t run_pipe(void (*proto)(t_hydra_console *con))
+{
+	uint32_t start, ns;
+	int fds[2], null_fd, status;
+	pid_t pid;
+
+	null_fd = open("/dev/null", O_WRONLY);
+	if (null_fd < 0 || pipe(fds) != 0)
+		exit(1);
+	pid = fork();
+	if (pid < 0)
+		exit(1);
+	if (pid == 0) {
+		close(fds[0]);
+		if (write(fds[1], in_buf, in_len) != (ssize_t)in_len)
+			_exit(1);
+		_exit(0);
+	}
+	close(fds[1]);
+
+	host_stream_init_fd(&stream, fds[0], null_fd);
+	host_ubtn_stream = &stream;
+	start = host_get_ns();
+	proto(&con);
+	ns = host_get_ns() - start;
+
+	close(fds[0]);
+	close(null_fd);
+	waitpid(pid, &status, 0);
+	return ns;
+}
+
+/* serprog: 24 bits little endian lengths of S_CMD_O_SPIOP */
+static void in_spiop(uint32_t to_tx, uint32_t to_rx)
+{
+	uint8_t hdr[7];
+
+	hdr[0] = S_CMD_O_SPIOP;
+	hdr[1] = to_tx & 0xff;
+	hdr[2] = (to_tx >> 8) & 0xff;
+	hdr[3] = to_tx >> 16;
+	hdr[4] = to_rx & 0xff;
+	hdr[5] = (to_rx >> 8) & 0xff;
+	hdr[6] = to_rx >> 16;
+	in_put(hdr, sizeof(hdr));
+}
+
+/* Programmer name query, dispatch and reply cost */
+static void bench_serprog_query(uint32_t count)
+{
+	uint32_t i, ns;
+
+	in_len = 0;
+	for (i = 0; i < count; i++)
+		in_byte(S_CMD_Q_PGMNAME);
+	ns = run(bbio_mode_serprog);
+	report("sp-pgmname", count, count, 17 * count, ns);
+	check("sp-pgmname", stream.out_len == 17 * count &&
+	      out_buf[0] == S_ACK[0] && memcmp(&out_buf[1], "Hydrabus", 8) == 0);
+}
+
+/* Synchronisation NOP as sent by flashrom on open */
+static void bench_serprog_sync(uint32_t count)
+{
+	uint32_t i, ns;
+
+	in_len = 0;
+	for (i = 0; i < count; i++)
+		in_byte(S_CMD_SYNCNOP);
+	ns = run(bbio_mode_serprog);
+	report("sp-syncnop", count, count, 2 * count, ns);
+	check("sp-syncnop", stream.out_len == 2 * count &&
+	      out_buf[0] == S_NAK[0] && out_buf[1] == S_ACK[0]);
+}
+
+/* Read of len bytes: READ opcode and 24 bits address then len bytes */
+static void build_serprog_read(uint32_t count, uint32_t len)
+{
+	uint32_t i;
+
+	in_len = 0;
+	for (i = 0; i < count; i++) {
+		in_spiop(4, len);
+		in_byte(0x03);
+		in_byte(i >> 8);
+		in_byte(i);
+		in_byte(0);
+	}
+}
+
+static void bench_serprog_read(uint32_t count, uint32_t len)
+{
+	char name[16];
+	uint32_t ns;
+
+	build_serprog_read(count, len);
+	ns = run(bbio_mode_serprog);
+	snprintf(name, sizeof(name), "sp-read-%d", len);
+	report(name, count, 11 * count, (uint64_t)(len + 1) * count, ns);
+	check(name, stream.out_len == (len + 1) * count &&
+	      out_buf[0] == S_ACK[0] && out_buf[1] == HOST_SPI_IDLE &&
+	      host_spi[BSP_DEV_SPI2].cs == 1);
+}
+
+static void bench_serprog_read_pipe(uint32_t count, uint32_t len)
+{
+	char name[24];
+	uint32_t ns;
+
+	build_serprog_read(count, len);
+	ns = run_pipe(bbio_mode_serprog);
+	snprintf(name, sizeof(name), "sp-read-%d-pipe", len);
+	report(name, count, 11 * count, (uint64_t)(len + 1) * count, ns);
+	check(name, stream.out_len == (len + 1) * count);
+}
+
+/* Page program: WRITE opcode, 24 bits address and 256 bytes */
+static void bench_serprog_program(uint32_t count)
+{
+	uint32_t i, ns;
+
+	in_len = 0;
+	for (i = 0; i < count; i++) {
+		in_spiop(260, 0);
+		in_byte(0x02);
+		in_byte(i >> 8);
+		in_byte(i);
+		in_byte(0);
+		memset(&in_buf[in_len], i, 256);
+		in_len += 256;
+	}
+	ns = run(bbio_mode_serprog);
+	report("sp-program-256", count, 267 * count, count, ns);
+	check("sp-program-256", stream.out_len == count &&
+	      out_buf[0] == S_ACK[0]);
+}
+
+/* SUMP: 4 bytes little endian parameters of the long commands */
+static void in_sump(uint8_t command, uint32_t param)
+{
+	uint8_t cmd[5];
+
+	cmd[0] = command;
+	cmd[1] = param & 0xff;
+	cmd[2] = (param >> 8) & 0xff;
+	cmd[3] = (param >> 16) & 0xff;
+	cmd[4] = param >> 24;
+	in_put(cmd, sizeof(cmd));
+}
+
+/* Identification, dispatch and reply cost */
+static void bench_sump_id(uint32_t count)
+{
+	uint32_t i, ns;
+
+	in_len = 0;
+	for (i = 0; i < count; i++)
+		in_byte(SUMP_ID);
+	ns = run(sump);
+	report("sump-id", count, count, 4 * count, ns);
+	check("sump-id", stream.out_len == 4 * count &&
+	      memcmp(out_buf, "1ALS", 4) == 0);
+}
+
+/* Capture setup as sent by a client before each run */
+static void bench_sump_setup(uint32_t count)
+{
+	uint32_t i, ns;
+
+	in_len = 0;
+	for (i = 0; i < count; i++) {
+		in_sump(SUMP_DIV, 99);
+		in_sump(SUMP_CNT, 0x010000ff);
+		in_sump(SUMP_FLAGS, 0x30);
+		in_sump(SUMP_TRIG_1, 0);
+		in_sump(SUMP_TRIG_VALS_1, 0);
+	}
+	ns = run(sump);
+	report("sump-setup", count, 25 * count, 0, ns);
+	check("sump-setup", stream.out_len == 0 &&
+	      mode.proto.config.sump.channels == 3 &&
+	      mode.proto.config.sump.read_count == 1024 &&
+	      mode.proto.config.sump.delay_count == 1024 &&
+	      host_tim.prescaler == 2 * 2);
+}
+
+/*
+ * Capture of 1024 samples on both channel groups with an immediate
+ * trigger, the port counts the samples so the last one is known
+ */
+static void bench_sump_run(uint32_t count)
+{
+	uint32_t i, ns, samples;
+
+	in_len = 0;
+	in_sump(SUMP_CNT, 0x010000ff);
+	in_sump(SUMP_FLAGS, 0x30);
+	in_sump(SUMP_TRIG_1, 0);
+	for (i = 0; i < count; i++) {
+		in_sump(SUMP_CNT, 0x010000ff);
+		in_byte(SUMP_RUN);
+	}
+	host_gpioc.IDR = 0;
+	samples = host_tim.samples;
+	ns = run(sump);
+	samples = host_tim.samples - samples;
+	report("sump-run-1024", count, 6 * count, stream.out_len, ns);
+	/* Trigger sample then delay_count samples, newest sample first */
+	check("sump-run-1024", samples == 1025 * count &&
+	      out_buf[0] == (1025 & 0xff) && out_buf[1] == (1025 >> 8) &&
+	      !host_tim.init);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t count = 10000;
+
+	if (argc > 1)
+		count = strtoul(argv[1], NULL, 0);
+	if (count == 0)
+		count = 1;
+
+	pool_init();
+	in_buf = malloc(count * (4096 + 16) + 64);
+	out_size = 64 * 1024;
+	out_buf = malloc(out_size);
+	if (in_buf == NULL || out_buf == NULL)
+		return 1;
+
+	bench_serprog_query(count);
+	bench_serprog_sync(count);
+	bench_serprog_read(count, 256);
+	bench_serprog_read(count, 4096);
+	bench_serprog_read_pipe(count, 4096);
+	bench_serprog_program(count);
+	bench_sump_id(count);
+	bench_sump_setup(count);
+	bench_sump_run(count / 10 + 1);
+
+	free(in_buf);
+	free(out_buf);
+	if (failures) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * HydraBus simulator: the BBIO, SUMP and serprog layers against the mock
+ * BSP, served on a pty so that the host tools (scripts/bbio_bench.py,
+ * flashrom -p serprog, SUMP clients) run unchanged, or on stdin/stdout.
+ * The protocols are entered as from the console of main.c, other bytes
+ * are ignored as the command line is not part of the host build.
+ *
+ * Usage: host_sim [-p]
+ *   -p  serve on a pty whose name is printed, until killed. Without it
+ *       stdin/stdout are served until stdin is closed.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "stub_bsp.h"
+#include "hydrabus_serprog.h"
+#include "hydrabus_sump.h"
+
+int cmd_bbio(t_hydra_console *con);
+
+static t_mode_config mode;
+static host_stream_t stream;
+static t_hydra_console con = {
+	.sdu = &stream,
+	.mode = &mode,
+};
+
+/* Same entry sequences as console() in main.c */
+static void console(void)
+{
+	uint8_t input;
+	int i = 0;
+
+	while (!hydrabus_ubtn()) {
+		if (chnRead(con.sdu, &input, 1) != 1)
+			continue;
+		switch (input) {
+		case 0:
+			if (++i == 20) {
+				cmd_bbio(&con);
+				i = 0;
+			}
+			break;
+		/* SUMP identification is 5*\x00 \x02 */
+		case 2:
+			if (i == 5) {
+				cprintf(&con, "1ALS");
+				sump(&con);
+			}
+			break;
+		/* SERPROG identification is 8*\x00, then \x10 */
+		case 0x10:
+			if (i == 8)
+				bbio_mode_serprog(&con);
+			break;
+		default:
+			i = 0;
+		}
+	}
+}
+
+/* Raw pty, the slave is kept open so that clients can come and go */
+static int pty_open(void)
+{
+	struct termios tio;
+	const char *name;
+	int master, slave;
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+		return -1;
+	name = ptsname(master);
+	if (name == NULL)
+		return -1;
+	slave = open(name, O_RDWR | O_NOCTTY);
+	if (slave < 0 || tcgetattr(slave, &tio) != 0)
+		return -1;
+	cfmakeraw(&tio);
+	if (tcsetattr(slave, TCSANOW, &tio) != 0)
+		return -1;
+	printf("%s\n", name);
+	fflush(stdout);
+
+	return master;
+}
+
+int main(int argc, char *argv[])
+{
+	int fd;
+
+	pool_init();
+	if (argc > 1 && strcmp(argv[1], "-p") == 0) {
+		fd = pty_open();
+		if (fd < 0) {
+			perror("pty");
+			return 1;
+		}
+		host_stream_init_fd(&stream, fd, fd);
+	} else {
+		host_stream_init_fd(&stream, STDIN_FILENO, STDOUT_FILENO);
+	}
+	host_ubtn_stream = &stream;
+
+	console();
+
+	return 0;
+}
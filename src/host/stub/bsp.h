@@ -0,0 +1,75 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _BSP_H_
+#define _BSP_H_
+
+/*
+ * Host replacement of drv/stm32cube/bsp.h, the cycle counter counts
+ * nanoseconds of the monotonic clock.
+ */
+#include <stdint.h>
+
+uint32_t host_get_ns(void);
+
+#define bsp_get_cyclecounter() host_get_ns()
+
+#define __CLZ(x)		((uint32_t)__builtin_clz(x))
+#define __get_PRIMASK()		(0)
+#define __set_PRIMASK(x)	((void)(x))
+#define __disable_irq()
+
+#if !defined(bool) || defined(__DOXYGEN__)
+typedef enum {
+	FALSE = 0,
+	TRUE = (!FALSE)
+} bool;
+#endif
+
+/* HAL GPIO subset used by SUMP, GPIOC input data counts the samples */
+typedef struct {
+	volatile uint32_t IDR;
+} GPIO_TypeDef;
+
+typedef struct {
+	uint32_t Pin;
+	uint32_t Mode;
+	uint32_t Pull;
+	uint32_t Speed;
+	uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+#define GPIO_MODE_INPUT		(0)
+#define GPIO_PULLDOWN		(2)
+#define GPIO_SPEED_HIGH		(2)
+
+extern GPIO_TypeDef host_gpioc;
+#define GPIOC			(&host_gpioc)
+
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init);
+void HAL_GPIO_DeInit(GPIO_TypeDef *port, uint32_t pin);
+
+typedef enum {
+	BSP_OK      = 0x00,
+	BSP_ERROR   = 0x01,
+	BSP_BUSY    = 0x02,
+	BSP_TIMEOUT = 0x03
+} bsp_status_t;
+
+#endif /* _BSP_H_ */
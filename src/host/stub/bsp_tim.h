@@ -0,0 +1,42 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _BSP_TIM_H_
+#define _BSP_TIM_H_
+
+/*
+ * Host replacement of drv/stm32cube/bsp_tim.h, each update event is
+ * a new sample of the simulated port (see stub_bsp.c)
+ */
+#include "bsp.h"
+
+#define TIM_CLOCKDIVISION_DIV1	(0)
+#define TIM_COUNTERMODE_UP	(0)
+
+void host_tim_wait_irq(void);
+
+#define bsp_tim_wait_irq()	host_tim_wait_irq()
+#define bsp_tim_clr_irq()
+
+void bsp_tim_init(uint32_t tim_period, uint32_t prescaler, uint32_t clock_division, uint32_t counter_mode);
+void bsp_tim_set_prescaler(uint32_t prescaler);
+void bsp_tim_deinit(void);
+void bsp_tim_start(void);
+void bsp_tim_stop(void);
+
+#endif /* _BSP_TIM_H_ */
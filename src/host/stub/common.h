@@ -0,0 +1,89 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _COMMON_H_
+#define _COMMON_H_
+
+/*
+ * Host replacement of common/common.h: the console reads from and writes
+ * to a host_stream_t instead of a ChibiOS channel.
+ */
+#include <stdint.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include "bsp.h"
+#include "tokenline.h"
+#include "mode_config.h"
+#include "alloc.h"
+
+#define ARRAY_SIZE(x) (sizeof((x))/sizeof((x)[0]))
+
+#ifndef MIN
+#define MIN(a, b) (a < b ? a : b)
+#endif
+
+#ifndef BIT
+#define BIT(x) (1 << x)
+#endif
+
+/*
+ * Memory stream, reads return 0 once the input is consumed.
+ * With fd_in set the stream reads from a pipe or pty instead and writes
+ * to fd_out, eof is set once the other end is closed.
+ */
+typedef struct host_stream {
+	const uint8_t *in;
+	uint32_t in_len;
+	uint32_t in_pos;
+	uint8_t *out;		/* First out_size bytes written are kept */
+	uint32_t out_size;
+	uint32_t out_len;	/* Total of bytes written */
+	int fd_in;		/* -1 for a memory stream */
+	int fd_out;
+	int eof;
+} host_stream_t;
+
+typedef struct hydra_console {
+	host_stream_t *sdu;
+	t_mode_config *mode;
+} t_hydra_console;
+
+/* System ticks of the timeouts, as CH_CFG_ST_FREQUENCY in chconf.h */
+#define HOST_ST_FREQUENCY	(10000)
+#define HOST_TIME_INFINITE	((uint32_t)-1)
+
+uint32_t host_stream_read(host_stream_t *s, uint8_t *buf, uint32_t len,
+			  uint32_t timeout);
+void host_stream_write(host_stream_t *s, const uint8_t *buf, uint32_t len);
+
+#define chnRead(s, buf, n)		host_stream_read(s, buf, n, HOST_TIME_INFINITE)
+#define chnReadTimeout(s, buf, n, t)	host_stream_read(s, buf, n, t)
+#define chnWrite(s, buf, n)		host_stream_write(s, buf, n)
+
+/* A single thread runs on the host, there is nothing to lock */
+#define chSysLock()
+#define chSysUnlock()
+
+void cprint(t_hydra_console *con, const char *data, const uint32_t size);
+void cprintf(t_hydra_console *con, const char *fmt, ...);
+
+/* Pressed once the input stream is consumed or closed so that the mode loops end */
+uint8_t hydrabus_ubtn(void);
+
+#endif /* _COMMON_H_ */
@@ -0,0 +1,27 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _TOKENLINE_H_
+#define _TOKENLINE_H_
+
+/* The console parser is not built on the host, only its types are used */
+typedef struct t_tokenline t_tokenline;
+typedef struct t_tokenline_parsed t_tokenline_parsed;
+
+#endif /* _TOKENLINE_H_ */
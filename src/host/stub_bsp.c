@@ -0,0 +1,367 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Mock BSP for the host builds: console over a memory, pipe or pty stream,
+ * simulated SPI devices, AUX pins and a SUMP port counting the samples.
+ * BBIO modes without a host model do nothing.
+ */
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "bsp_spi.h"
+#include "bsp_tim.h"
+#include "stub_bsp.h"
+#include "hydrabus_bbio.h"
+#include "hydrabus_mode_spi.h"
+
+host_stream_t *host_ubtn_stream;
+host_spi_dev_t host_spi[BSP_DEV_SPI_END];
+host_tim_t host_tim;
+GPIO_TypeDef host_gpioc;
+static uint8_t host_aux;
+
+/* Same values as hydrabus_mode_spi.c, the console SPI mode is not built */
+const uint32_t spi_speeds[2][SPI_SPEED_NB] = {
+	/* SPI1 */
+	{
+		320000,
+		650000,
+		1310000,
+		2620000,
+		5250000,
+		10500000,
+		21000000,
+		42000000,
+	},
+	/* SPI2 */
+	{
+		160000,
+		320000,
+		650000,
+		1310000,
+		2620000,
+		5250000,
+		10500000,
+		21000000,
+	}
+};
+
+uint32_t host_get_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void host_stream_init(host_stream_t *s, const uint8_t *in, uint32_t in_len,
+		      uint8_t *out, uint32_t out_size)
+{
+	s->in = in;
+	s->in_len = in_len;
+	s->in_pos = 0;
+	s->out = out;
+	s->out_size = out_size;
+	s->out_len = 0;
+	s->fd_in = -1;
+	s->fd_out = -1;
+	s->eof = 0;
+}
+
+void host_stream_init_fd(host_stream_t *s, int fd_in, int fd_out)
+{
+	host_stream_init(s, NULL, 0, NULL, 0);
+	s->fd_in = fd_in;
+	s->fd_out = fd_out;
+}
+
+/*
+ * Blocks until len bytes are read or the other end is closed, the timeout
+ * applies to each wait for data as the channel timeouts are approximate
+ */
+static uint32_t host_fd_read(host_stream_t *s, uint8_t *buf, uint32_t len,
+			     uint32_t timeout)
+{
+	struct pollfd pfd;
+	uint32_t n;
+	int ms, ret;
+
+	ms = -1;
+	if (timeout != HOST_TIME_INFINITE)
+		ms = (timeout * 1000ULL + HOST_ST_FREQUENCY - 1) / HOST_ST_FREQUENCY;
+	pfd.fd = s->fd_in;
+	pfd.events = POLLIN;
+	n = 0;
+	while (n < len && !s->eof) {
+		ret = poll(&pfd, 1, ms);
+		if (ret == 0)
+			break;
+		if (ret > 0)
+			ret = read(s->fd_in, &buf[n], len - n);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			s->eof = 1;
+			break;
+		}
+		n += ret;
+	}
+	return n;
+}
+
+uint32_t host_stream_read(host_stream_t *s, uint8_t *buf, uint32_t len,
+			  uint32_t timeout)
+{
+	if (s->fd_in >= 0)
+		return host_fd_read(s, buf, len, timeout);
+
+	len = MIN(len, s->in_len - s->in_pos);
+	memcpy(buf, &s->in[s->in_pos], len);
+	s->in_pos += len;
+	return len;
+}
+
+void host_stream_write(host_stream_t *s, const uint8_t *buf, uint32_t len)
+{
+	uint32_t n;
+	int ret;
+
+	if (s->out_len < s->out_size) {
+		n = MIN(len, s->out_size - s->out_len);
+		memcpy(&s->out[s->out_len], buf, n);
+	}
+	s->out_len += len;
+
+	for (n = 0; s->fd_out >= 0 && n < len; n += ret) {
+		ret = write(s->fd_out, &buf[n], len - n);
+		if (ret < 0 && errno == EINTR) {
+			ret = 0;
+			continue;
+		}
+		if (ret <= 0) {
+			s->eof = 1;
+			break;
+		}
+	}
+}
+
+void cprint(t_hydra_console *con, const char *data, const uint32_t size)
+{
+	host_stream_write(con->sdu, (const uint8_t *)data, size);
+}
+
+void cprintf(t_hydra_console *con, const char *fmt, ...)
+{
+	char buf[256];
+	va_list va_args;
+	int len;
+
+	va_start(va_args, fmt);
+	len = vsnprintf(buf, sizeof(buf), fmt, va_args);
+	va_end(va_args);
+	cprint(con, buf, MIN(len, (int)sizeof(buf) - 1));
+}
+
+uint8_t hydrabus_ubtn(void)
+{
+	if (host_ubtn_stream == NULL)
+		return TRUE;
+	if (host_ubtn_stream->fd_in >= 0)
+		return host_ubtn_stream->eof;
+	return host_ubtn_stream->in_pos >= host_ubtn_stream->in_len;
+}
+
+/* SPI: MISO returns MOSI inverted, reads return HOST_SPI_IDLE */
+bsp_status_t bsp_spi_init(bsp_dev_spi_t dev_num, mode_config_proto_t* mode_conf)
+{
+	host_spi[dev_num].init = 1;
+	host_spi[dev_num].speed = mode_conf->config.spi.dev_speed;
+	return BSP_OK;
+}
+
+bsp_status_t bsp_spi_deinit(bsp_dev_spi_t dev_num)
+{
+	host_spi[dev_num].init = 0;
+	return BSP_OK;
+}
+
+void bsp_spi_select(bsp_dev_spi_t dev_num)
+{
+	host_spi[dev_num].cs = 0;
+}
+
+void bsp_spi_unselect(bsp_dev_spi_t dev_num)
+{
+	host_spi[dev_num].cs = 1;
+}
+
+uint8_t bsp_spi_get_cs(bsp_dev_spi_t dev_num)
+{
+	return host_spi[dev_num].cs;
+}
+
+uint8_t bsp_spi_rxne(bsp_dev_spi_t dev_num)
+{
+	(void)dev_num;
+	return 0;
+}
+
+bsp_status_t bsp_spi_write_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t nb_data)
+{
+	(void)tx_data;
+	host_spi[dev_num].tx_bytes += nb_data;
+	return BSP_OK;
+}
+
+bsp_status_t bsp_spi_read_u8(bsp_dev_spi_t dev_num, uint8_t* rx_data, uint8_t nb_data)
+{
+	memset(rx_data, HOST_SPI_IDLE, nb_data);
+	host_spi[dev_num].rx_bytes += nb_data;
+	return BSP_OK;
+}
+
+bsp_status_t bsp_spi_write_read_u8(bsp_dev_spi_t dev_num, uint8_t* tx_data, uint8_t* rx_data, uint8_t nb_data)
+{
+	uint8_t i;
+
+	for (i = 0; i < nb_data; i++)
+		rx_data[i] = ~tx_data[i];
+	host_spi[dev_num].tx_bytes += nb_data;
+	host_spi[dev_num].rx_bytes += nb_data;
+	return BSP_OK;
+}
+
+/* SUMP timer, each update event samples the next value of the port */
+void bsp_tim_init(uint32_t tim_period, uint32_t prescaler, uint32_t clock_division, uint32_t counter_mode)
+{
+	(void)tim_period;
+	(void)clock_division;
+	(void)counter_mode;
+	host_tim.init = 1;
+	host_tim.prescaler = prescaler;
+}
+
+void bsp_tim_set_prescaler(uint32_t prescaler)
+{
+	host_tim.prescaler = prescaler;
+}
+
+void bsp_tim_deinit(void)
+{
+	host_tim.init = 0;
+}
+
+void bsp_tim_start(void)
+{
+	host_tim.running = 1;
+}
+
+void bsp_tim_stop(void)
+{
+	host_tim.running = 0;
+}
+
+void host_tim_wait_irq(void)
+{
+	host_gpioc.IDR = (host_gpioc.IDR + 1) & 0xffff;
+	host_tim.samples++;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init)
+{
+	(void)port;
+	(void)init;
+}
+
+void HAL_GPIO_DeInit(GPIO_TypeDef *port, uint32_t pin)
+{
+	(void)port;
+	(void)pin;
+}
+
+/* AUX pins, all the pins read back the last value written */
+void bbio_aux_mode_set(t_hydra_console *con)
+{
+	(void)con;
+}
+
+uint8_t bbio_aux_mode_get(t_hydra_console *con)
+{
+	return con->mode->proto.aux_config;
+}
+
+uint8_t bbio_aux_read(void)
+{
+	return host_aux;
+}
+
+void bbio_aux_write(uint8_t command)
+{
+	host_aux = command & 0x0f;
+}
+
+uint8_t bbio_aux(t_hydra_console *con, uint8_t command)
+{
+	uint8_t config;
+
+	switch(command & 0b11110000){
+	case BBIO_AUX_MODE_READ:
+		return bbio_aux_mode_get(con);
+	case BBIO_AUX_MODE_SET:
+		chnRead(con->sdu, &config, 1);
+		con->mode->proto.aux_config = config;
+		return 1;
+	case BBIO_AUX_READ:
+		return bbio_aux_read();
+	case BBIO_AUX_WRITE:
+		bbio_aux_write(command);
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* Modes without host model */
+#define HOST_NO_MODE(name) \
+	void name(t_hydra_console *con) { (void)con; }
+
+HOST_NO_MODE(bbio_mode_i2c)
+HOST_NO_MODE(bbio_mode_uart)
+HOST_NO_MODE(bbio_mode_onewire)
+HOST_NO_MODE(bbio_mode_rawwire)
+HOST_NO_MODE(jtag_enter_openocd)
+HOST_NO_MODE(bbio_mode_can)
+HOST_NO_MODE(bbio_mode_pin)
+HOST_NO_MODE(bbio_mode_flash)
+HOST_NO_MODE(bbio_mode_smartcard)
+HOST_NO_MODE(bbio_mode_mmc)
+HOST_NO_MODE(bbio_mode_sdio)
+HOST_NO_MODE(sd_xfer_server)
+HOST_NO_MODE(bbio_adc)
+HOST_NO_MODE(bbio_adc_continuous)
+HOST_NO_MODE(bbio_freq)
+HOST_NO_MODE(bbio_freq_continuous)
+HOST_NO_MODE(bbio_rng)
+HOST_NO_MODE(bbio_dac_wave)
+HOST_NO_MODE(bbio_pwm)
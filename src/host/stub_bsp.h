@@ -0,0 +1,52 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _STUB_BSP_H_
+#define _STUB_BSP_H_
+
+#include "common.h"
+#include "bsp_spi.h"
+
+/* Byte read from a simulated SPI device when nothing is written */
+#define HOST_SPI_IDLE	(0xFF)
+
+typedef struct {
+	uint8_t init;
+	uint8_t cs;
+	uint32_t speed;
+	uint32_t tx_bytes;
+	uint32_t rx_bytes;
+} host_spi_dev_t;
+
+typedef struct {
+	uint8_t init;
+	uint8_t running;
+	uint32_t prescaler;
+	uint32_t samples;
+} host_tim_t;
+
+extern host_stream_t *host_ubtn_stream;
+extern host_spi_dev_t host_spi[BSP_DEV_SPI_END];
+extern host_tim_t host_tim;
+
+void host_stream_init(host_stream_t *s, const uint8_t *in, uint32_t in_len,
+		      uint8_t *out, uint32_t out_size);
+/* Pipe or pty stream, fd_out can be the same descriptor as fd_in */
+void host_stream_init_fd(host_stream_t *s, int fd_in, int fd_out);
+
+#endif /* _STUB_BSP_H_ */
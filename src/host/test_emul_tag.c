@@ -0,0 +1,274 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host test of the ISO14443A tag emulation core, reader frames are
+ * replayed as they are received from the TRF7970A FIFO (with their CRC_A).
+ */
+#include <stdio.h>
+#include <string.h>
+#include "hydranfc_emul_tag.h"
+
+typedef struct {
+	const char *name;
+	uint8_t rx_len;
+	uint8_t rx[20];
+	int resp_len;		/* Complete bytes, -1 when there is no response */
+	uint8_t resp_bits;
+	uint8_t resp[20];
+	int ret;
+	emul_tag_state_t state;
+} frame_t;
+
+#define OK	EMUL_TAG_OK
+#define NONE	-1, 0, { 0 }
+#define ACK	0, 4, { 0x0A }
+#define NAK	0, 4, { 0x00 }
+
+/* UID 04 11 22 33 44 55 66 */
+#define UL_SELECT(wakeup) \
+	{ #wakeup, 1, { wakeup }, 2, 0, { 0x44, 0x00 }, OK, EMUL_TAG_READY1 }, \
+	{ "ANTICOL CL1", 2, { 0x93, 0x20 }, \
+	  5, 0, { 0x88, 0x04, 0x11, 0x22, 0xBF }, OK, EMUL_TAG_READY1 }, \
+	{ "SELECT CL1", 9, { 0x93, 0x70, 0x88, 0x04, 0x11, 0x22, 0xBF, 0xB3, 0xF9 }, \
+	  3, 0, { 0x04, 0xDA, 0x17 }, OK, EMUL_TAG_READY2 }, \
+	{ "ANTICOL CL2", 2, { 0x95, 0x20 }, \
+	  5, 0, { 0x33, 0x44, 0x55, 0x66, 0x44 }, OK, EMUL_TAG_READY2 }, \
+	{ "SELECT CL2", 9, { 0x95, 0x70, 0x33, 0x44, 0x55, 0x66, 0x44, 0xEC, 0xA3 }, \
+	  3, 0, { 0x00, 0xFE, 0x51 }, OK, EMUL_TAG_ACTIVE }
+
+#define REQA 0x26
+#define WUPA 0x52
+
+static const uint8_t ul_dump[64] = {
+	0x04, 0x11, 0x22, 0xBF, 0x33, 0x44, 0x55, 0x66,
+	0x44, 0x48, 0x00, 0x00, 0xE1, 0x10, 0x06, 0x00,
+	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+	0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F,
+	0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27,
+	0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+	0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37,
+	0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F
+};
+
+static const frame_t ul_frames[] = {
+	UL_SELECT(REQA),
+	{ "READ 14 roll over", 4, { 0x30, 0x0E, 0x7C, 0x41 },
+	  18, 0, { 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+		   0x04, 0x11, 0x22, 0xBF, 0x33, 0x44, 0x55, 0x66, 0x3E, 0xFE },
+	  OK, EMUL_TAG_ACTIVE },
+	{ "WRITE 4", 8, { 0xA2, 0x04, 0xDE, 0xAD, 0xBE, 0xEF, 0x22, 0x8B },
+	  ACK, OK, EMUL_TAG_ACTIVE },
+	{ "READ 4", 4, { 0x30, 0x04, 0x26, 0xEE },
+	  18, 0, { 0xDE, 0xAD, 0xBE, 0xEF, 0x14, 0x15, 0x16, 0x17,
+		   0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0xC5, 0xD1 },
+	  OK, EMUL_TAG_ACTIVE },
+	{ "READ 16 out of range", 4, { 0x30, 0x10, 0x83, 0xB8 },
+	  NAK, OK, EMUL_TAG_IDLE },
+	UL_SELECT(WUPA),
+	{ "WRITE 0 serial number", 8, { 0xA2, 0x00, 0x01, 0x02, 0x03, 0x04, 0x68, 0x7A },
+	  NAK, OK, EMUL_TAG_IDLE },
+	UL_SELECT(WUPA),
+	{ "WRITE 2 lock pages 4-7", 8, { 0xA2, 0x02, 0x00, 0x00, 0xF0, 0x00, 0xA7, 0xD5 },
+	  ACK, OK, EMUL_TAG_ACTIVE },
+	{ "WRITE 5 locked", 8, { 0xA2, 0x05, 0x01, 0x02, 0x03, 0x04, 0x3C, 0x5C },
+	  NAK, OK, EMUL_TAG_IDLE },
+	UL_SELECT(WUPA),
+	{ "COMPAT WRITE 6 locked", 4, { 0xA0, 0x06, 0x69, 0xD4 },
+	  NAK, OK, EMUL_TAG_IDLE },
+	UL_SELECT(WUPA),
+	{ "COMPAT WRITE 8", 4, { 0xA0, 0x08, 0x17, 0x3D },
+	  ACK, OK, EMUL_TAG_COMPAT_WRITE },
+	{ "COMPAT WRITE 8 data", 18,
+	  { 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+	    0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF, 0x75, 0x25 },
+	  ACK, OK, EMUL_TAG_ACTIVE },
+	{ "READ 8", 4, { 0x30, 0x08, 0x4A, 0x24 },
+	  18, 0, { 0xA0, 0xA1, 0xA2, 0xA3, 0x24, 0x25, 0x26, 0x27,
+		   0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0xC1, 0x94 },
+	  OK, EMUL_TAG_ACTIVE },
+	{ "WRITE 2 block lock BL9-4", 8, { 0xA2, 0x02, 0x00, 0x00, 0x02, 0x00, 0x1F, 0x9A },
+	  ACK, OK, EMUL_TAG_ACTIVE },
+	{ "WRITE 2 frozen lock pages 8-9", 8, { 0xA2, 0x02, 0x00, 0x00, 0x00, 0x03, 0x34, 0x9B },
+	  ACK, OK, EMUL_TAG_ACTIVE },
+	{ "WRITE 8", 8, { 0xA2, 0x08, 0x09, 0x09, 0x09, 0x09, 0xA3, 0xCA },
+	  ACK, OK, EMUL_TAG_ACTIVE },
+	{ "READ 2", 4, { 0x30, 0x02, 0x10, 0x8B },
+	  18, 0, { 0x44, 0x48, 0xF2, 0x00, 0xE1, 0x10, 0x06, 0x00,
+		   0xDE, 0xAD, 0xBE, 0xEF, 0x14, 0x15, 0x16, 0x17, 0x2F, 0xA4 },
+	  OK, EMUL_TAG_ACTIVE },
+	{ "GET_VERSION not supported", 3, { 0x60, 0xF8, 0x32 },
+	  NAK, OK, EMUL_TAG_IDLE },
+	UL_SELECT(REQA),
+	{ "HALT", 4, { 0x50, 0x00, 0x57, 0xCD }, NONE, OK, EMUL_TAG_HALT },
+	{ "REQA halted", 1, { REQA }, NONE, OK, EMUL_TAG_HALT },
+	UL_SELECT(WUPA),
+	{ "REQA", 1, { REQA }, 2, 0, { 0x44, 0x00 }, OK, EMUL_TAG_READY1 },
+	{ "READ in READY1", 4, { 0x30, 0x00, 0x02, 0xA8 },
+	  NONE, EMUL_TAG_ERROR, EMUL_TAG_IDLE },
+	{ "SELECT CL1 in IDLE", 9, { 0x93, 0x70, 0x88, 0x04, 0x11, 0x22, 0xBF, 0xB3, 0xF9 },
+	  NONE, OK, EMUL_TAG_IDLE },
+	{ "REQA", 1, { REQA }, 2, 0, { 0x44, 0x00 }, OK, EMUL_TAG_READY1 },
+	{ "SELECT CL1 bad CRC", 9, { 0x93, 0x70, 0x88, 0x04, 0x11, 0x22, 0xBF, 0xB3, 0xF8 },
+	  NONE, EMUL_TAG_ERROR, EMUL_TAG_IDLE },
+};
+
+/* NTAG213: 45 pages */
+static const frame_t ntag_frames[] = {
+	UL_SELECT(REQA),
+	{ "GET_VERSION", 3, { 0x60, 0xF8, 0x32 },
+	  10, 0, { 0x00, 0x04, 0x04, 0x02, 0x01, 0x00, 0x0F, 0x03, 0x80, 0x91 },
+	  OK, EMUL_TAG_ACTIVE },
+};
+
+/* MIFARE Classic UID CA FE BA BE */
+static const frame_t uid_frames[] = {
+	{ "REQA", 1, { REQA }, 2, 0, { 0x04, 0x00 }, OK, EMUL_TAG_READY1 },
+	{ "ANTICOL CL1", 2, { 0x93, 0x20 },
+	  5, 0, { 0xCA, 0xFE, 0xBA, 0xBE, 0x30 }, OK, EMUL_TAG_READY1 },
+	{ "SELECT CL1", 9, { 0x93, 0x70, 0xCA, 0xFE, 0xBA, 0xBE, 0x30, 0xEF, 0x6F },
+	  3, 0, { 0x08, 0xB6, 0xDD }, OK, EMUL_TAG_ACTIVE },
+	{ "AUTH", 4, { 0x60, 0x00, 0xF5, 0x7B },
+	  6, 0, { 0x00, 0x00, 0x00, 0x00, 0x00, 0x56 }, OK, EMUL_TAG_IDLE },
+};
+
+static emul_tag_t tag;
+static int failures;
+
+static void dump(const char *prefix, const uint8_t *data, int len)
+{
+	int i;
+
+	printf("  %s:", prefix);
+	for (i = 0; i < len; i++)
+		printf(" %02X", data[i]);
+	printf("\n");
+}
+
+static void check(const char *name, int ok)
+{
+	if (!ok) {
+		printf("FAIL %s\n", name);
+		failures++;
+	}
+}
+
+static void replay(const char *test, const frame_t *frames, int nb)
+{
+	const emul_tag_resp_t *resp;
+	const frame_t *f;
+	int i, ret, len, ok;
+
+	for (i = 0; i < nb; i++) {
+		f = &frames[i];
+		ret = emul_tag_rx(&tag, f->rx, f->rx_len, &resp);
+
+		ok = (ret == f->ret && tag.state == f->state);
+		if (f->resp_len < 0) {
+			ok = ok && resp == NULL;
+		} else {
+			len = f->resp_len + (f->resp_bits ? 1 : 0);
+			ok = ok && resp != NULL && resp->len == f->resp_len &&
+			     resp->bits == f->resp_bits &&
+			     !memcmp(resp->data, f->resp, len);
+		}
+		if (!ok) {
+			printf("FAIL %s: frame %d %s (ret %d state %d)\n",
+			       test, i, f->name, ret, tag.state);
+			dump("expected", f->resp, f->resp_len < 0 ? 0 :
+			     f->resp_len + (f->resp_bits ? 1 : 0));
+			if (resp != NULL)
+				dump("response", resp->data,
+				     resp->len + (resp->bits ? 1 : 0));
+			failures++;
+		}
+	}
+	printf("%s: %d frames\n", test, nb);
+}
+
+static void test_crc_a(void)
+{
+	static const struct {
+		uint8_t len;
+		uint8_t data[2];
+		uint16_t crc;
+	} vectors[] = {
+		{ 1, { 0x00 }, 0x51FE },	/* SAK 00 */
+		{ 1, { 0x04 }, 0x17DA },	/* SAK 04 */
+		{ 1, { 0x08 }, 0xDDB6 },	/* SAK 08 */
+		{ 2, { 0x30, 0x00 }, 0xA802 },	/* READ 0 */
+		{ 2, { 0x30, 0x04 }, 0xEE26 },	/* READ 4 */
+		{ 2, { 0x50, 0x00 }, 0xCD57 },	/* HALT */
+		{ 1, { 0x60 }, 0x32F8 },	/* GET_VERSION */
+		{ 2, { 0xE0, 0x80 }, 0x7331 },	/* RATS */
+	};
+	unsigned int i;
+
+	for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+		check("CRC_A", emul_tag_crc_a(vectors[i].data, vectors[i].len) ==
+		      vectors[i].crc);
+	printf("CRC_A: %d vectors\n", (int)i);
+}
+
+static void test_load(void)
+{
+	uint8_t dump[EMUL_TAG_DATA_MAX + 4];
+
+	memcpy(dump, ul_dump, sizeof(ul_dump));
+	check("load 60 bytes", emul_tag_load_ul(&tag, dump, 60) == EMUL_TAG_ERR_SIZE);
+	check("load 66 bytes", emul_tag_load_ul(&tag, dump, 66) == EMUL_TAG_ERR_SIZE);
+	check("load 1028 bytes", emul_tag_load_ul(&tag, dump, sizeof(dump)) == EMUL_TAG_ERR_SIZE);
+	dump[3] ^= 1;
+	check("load bad BCC0", emul_tag_load_ul(&tag, dump, 64) == EMUL_TAG_ERR_BCC);
+	dump[3] ^= 1;
+	dump[8] ^= 1;
+	check("load bad BCC1", emul_tag_load_ul(&tag, dump, 64) == EMUL_TAG_ERR_BCC);
+	check("load UID 5 bytes", emul_tag_load_uid(&tag, dump, 5, dump, 0) == EMUL_TAG_ERR_SIZE);
+	printf("load: done\n");
+}
+
+#define NB(frames) ((int)(sizeof(frames) / sizeof(frames[0])))
+
+int main(void)
+{
+	static const uint8_t uid[4] = { 0xCA, 0xFE, 0xBA, 0xBE };
+	static const uint8_t atqa[2] = { 0x04, 0x00 };
+	uint8_t ntag[45 * EMUL_TAG_PAGE_SIZE];
+
+	test_crc_a();
+	test_load();
+
+	check("load Ultralight", emul_tag_load_ul(&tag, ul_dump, sizeof(ul_dump)) == EMUL_TAG_OK);
+	replay("Ultralight", ul_frames, NB(ul_frames));
+	check("Ultralight written", tag.written);
+
+	memset(ntag, 0, sizeof(ntag));
+	memcpy(ntag, ul_dump, 16);
+	check("load NTAG213", emul_tag_load_ul(&tag, ntag, sizeof(ntag)) == EMUL_TAG_OK);
+	replay("NTAG213", ntag_frames, NB(ntag_frames));
+
+	check("load UID", emul_tag_load_uid(&tag, uid, 4, atqa, 0x08) == EMUL_TAG_OK);
+	replay("UID only", uid_frames, NB(uid_frames));
+
+	if (failures) {
+		printf("%d failure(s)\n", failures);
+		return 1;
+	}
+	printf("All tests passed\n");
+	return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2017 Benjamin VERNOUX
+ * Copyright (C) 2017 Nicolas OBERLI
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host test of the trigger matcher, each stream is fed byte by byte as in
+ * trigger_run() then at once, and the first match is compared to the one
+ * of a naive search.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hydrabus_trigger_match.h"
+
+static trigger_pattern_t patterns[TRIGGER_PATTERNS];
+static trigger_matcher_t matcher;
+static int failures;
+
+static void check(const char *name, int ok)
+{
+	if (!ok) {
+		printf("FAIL %s\n", name);
+		failures++;
+	}
+}
+
+static void set_pattern(int i, const char *data, const char *mask)
+{
+	trigger_pattern_t *pat = &patterns[i];
+
+	pat->len = strlen(data);
+	memcpy(pat->data, data, pat->len);
+	memset(pat->mask, 0xff, sizeof(pat->mask));
+	if (mask != NULL)
+		memcpy(pat->mask, mask, pat->len);
+}
+
+/* Index of the byte completing the first match, or -1 */
+static int naive_match(int nb_patterns, const uint8_t *data, int len)
+{
+	const trigger_pattern_t *pat;
+	int end, p, j;
+
+	for (end = 0; end < len; end++) {
+		for (p = 0; p < nb_patterns; p++) {
+			pat = &patterns[p];
+			if (pat->len == 0 || pat->len > end + 1)
+				continue;
+			for (j = 0; j < pat->len; j++) {
+				if ((data[end + 1 - pat->len + j] ^ pat->data[j]) &
+				    pat->mask[j])
+					break;
+			}
+			if (j == pat->len)
+				return end;
+		}
+	}
+	return -1;
+}
+
+static void run(const char *name, int nb_patterns, const uint8_t *data,
+		int len, int expected)
+{
+	uint32_t state[TRIGGER_WORDS];
+	int i, found;
+
+	check(name, trigger_match_compile(&matcher, patterns, nb_patterns) == 0);
+
+	memset(state, 0, sizeof(state));
+	found = -1;
+	for (i = 0; i < len && found < 0; i++) {
+		if (trigger_match(&matcher, state, &data[i], 1) >= 0)
+			found = i;
+	}
+	if (found != expected)
+		printf("%s: byte wise %d, expected %d\n", name, found, expected);
+	check(name, found == expected);
+
+	memset(state, 0, sizeof(state));
+	found = trigger_match(&matcher, state, data, len);
+	if (found != expected)
+		printf("%s: block %d, expected %d\n", name, found, expected);
+	check(name, found == expected);
+}
+
+#define RUN(name, nb, str, expected) \
+	run(name, nb, (const uint8_t *)str, sizeof(str) - 1, expected)
+
+static void test_cases(void)
+{
+	set_pattern(0, "aab", NULL);
+	RUN("overlap", 1, "aaab", 3);
+	RUN("no match", 1, "abab", -1);
+
+	set_pattern(0, "abab", NULL);
+	RUN("self overlap", 1, "ababab", 3);
+	RUN("restart", 1, "abaabab", 6);
+
+	set_pattern(0, "HELLO", NULL);
+	set_pattern(1, "LLO W", NULL);
+	set_pattern(2, "xyz", NULL);
+	RUN("alternatives", 3, "HELLO WORLD", 4);
+	RUN("second pattern", 3, "HELLLO WORLD", 7);
+	RUN("third pattern", 3, "-xyz-", 3);
+
+	/* Any byte in the middle, low nibble only at the end */
+	set_pattern(0, "\xAA?\x05", "\xFF\x00\x0F");
+	RUN("mask", 1, "\x01\xAA\x77\xF5", 3);
+	RUN("mask no match", 1, "\xAA\x77\xF4", -1);
+
+	/* Empty patterns are skipped */
+	patterns[0].len = 0;
+	set_pattern(1, "b", NULL);
+	RUN("empty", 2, "aab", 2);
+}
+
+/* Patterns across the 32 bits state words */
+static void test_positions(void)
+{
+	uint8_t data[TRIGGER_POSITIONS + 16];
+	int i;
+
+	memset(patterns, 0, sizeof(patterns));
+	for (i = 0; i < 28; i++)
+		data[i] = 'A' + i % 26;
+	memcpy(patterns[0].data, data, 28);
+	memset(patterns[0].mask, 0xff, sizeof(patterns[0].mask));
+	patterns[0].len = 28;
+	set_pattern(1, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ!", NULL);
+	check("64 positions",
+	      trigger_match_compile(&matcher, patterns, 2) == -1);
+
+	set_pattern(1, "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ", NULL);
+	memset(data, '-', sizeof(data));
+	memcpy(&data[10], patterns[1].data, patterns[1].len);
+	run("cross word", 2, data, sizeof(data), 10 + 36 - 1);
+}
+
+/* Random streams over a small alphabet against the naive search */
+static void test_random(void)
+{
+	uint8_t data[256];
+	int n, i, p, nb, len;
+
+	srand(1);
+	for (n = 0; n < 2000; n++) {
+		memset(patterns, 0, sizeof(patterns));
+		nb = 1 + rand() % TRIGGER_PATTERNS;
+		for (p = 0; p < nb; p++) {
+			patterns[p].len = 1 + rand() % 6;
+			for (i = 0; i < patterns[p].len; i++) {
+				patterns[p].data[i] = rand() % 4;
+				patterns[p].mask[i] = (rand() % 8) ? 0xff :
+						      (rand() % 2) ? 0x00 : 0x01;
+			}
+		}
+		for (i = 0; i < (int)sizeof(data); i++)
+			data[i] = rand() % 4;
+		len = 32 + rand() % 224;
+		run("random", nb, data, len, naive_match(nb, data, len));
+		if (failures)
+			break;
+	}
+}
+
+int main(void)
+{
+	test_cases();
+	test_positions();
+	test_random();
+
+	if (failures) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+	printf("All tests passed\n");
+	return 0;
+}
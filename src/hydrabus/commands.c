@@ -168,6 +168,29 @@ const t_token_dict tl_dict[] = {
 	{ T_POKE, "poke" },
 	{ T_SWIO, "swio" },
 	{ T_CONTINUITY, "continuity" },
+	{ T_PPS, "pps" },
+	{ T_ONFI, "onfi" },
+	{ T_DUMP, "dump" },
+	{ T_PAGES, "pages" },
+	{ T_RESOURCES, "resources" },
+	{ T_PROFILE, "profile" },
+	{ T_RESET, "reset" },
+	{ T_TRANSFER, "transfer" },
+	{ T_BENCHMARK, "benchmark" },
+	{ T_MACRO, "macro" },
+	{ T_RUN, "run" },
+	{ T_REPEAT, "repeat" },
+	{ T_SAVE, "save" },
+	{ T_LOAD, "load" },
+	{ T_SINE, "sine" },
+	{ T_SQUARE, "square" },
+	{ T_RAMP, "ramp" },
+	{ T_RATE, "rate" },
+	{ T_UPLOAD, "upload" },
+	{ T_CHANNEL, "channel" },
+	{ T_BURST, "burst" },
+	{ T_SEQUENCE, "sequence" },
+	{ T_TENBIT, "tenbit" },
 	/* Developer warning add new command(s) here */
 
 	/* BP-compatible commands */
@@ -250,6 +273,11 @@ t_token tokens_mode_brute[] = {
 		.arg_type = T_ARG_UINT,
 		.help = "Performs an IDCODE scan on x pins (PB0 up to PB11)"
 	},
+	{
+		T_SCAN,
+		.arg_type = T_ARG_UINT,
+		.help = "Fast pinout discovery by IDCODE on x pins (PB0 up to PB11)"
+	},
 	{ }
 };
 
@@ -298,6 +326,50 @@ t_token tokens_mode_adc_trigger[] = {
 	{ }
 };
 
+t_token tokens_mode_macro[] = {
+	{
+		T_ARG_UINT,
+		.help = "Macro number"
+	},
+	{
+		T_ARG_STRING,
+		.help = "Define macro from a command sequence"
+	},
+	{
+		T_RUN,
+		.help = "Run macro"
+	},
+	{
+		T_REPEAT,
+		.arg_type = T_ARG_UINT,
+		.help = "Number of runs (0 until UBTN)"
+	},
+	{
+		T_PERIOD,
+		.arg_type = T_ARG_UINT,
+		.help = "Delay between run starts (usec)"
+	},
+	{
+		T_ERASE,
+		.help = "Erase macro"
+	},
+	{
+		T_SHOW,
+		.help = "Show macros"
+	},
+	{
+		T_SAVE,
+		.arg_type = T_ARG_STRING,
+		.help = "Save macros to microSD file"
+	},
+	{
+		T_LOAD,
+		.arg_type = T_ARG_STRING,
+		.help = "Load macros from microSD file"
+	},
+	{ }
+};
+
 t_token tokens_mode_trigger[] = {
 	{
 		T_SHOW,
@@ -307,7 +379,12 @@ t_token tokens_mode_trigger[] = {
 	{
 		T_FILTER,
 		.arg_type = T_ARG_STRING,
-		.help = "Trigger data"
+		.help = "Trigger data (repeat to match any of several)"
+	},
+	{
+		T_MASK,
+		.arg_type = T_ARG_STRING,
+		.help = "Mask of the last trigger data (\\x00 matches any byte)"
 	},
 	{
 		T_START,
@@ -398,7 +475,7 @@ t_token tokens_mode_nfc_sniff[] = {
 	{\
 		T_EMUL_MF_ULTRALIGHT,\
 		.subtokens = tokens_mode_nfc_emul_mf_ul,\
-		.help = "Emul Tag Mifare Ultralight (optional read from microSD)"\
+		.help = "Emul Tag Mifare Ultralight/NTAG21x (optional dump from microSD)"\
 	},\
 	{\
 		T_CLONE_MF_ULTRALIGHT,\
@@ -498,6 +575,11 @@ t_token tokens_mode_uart[] = {
 		.subtokens = tokens_mode_trigger,
 		.help = "Setup UART trigger"
 	},
+	{
+		T_MACRO,
+		.subtokens = tokens_mode_macro,
+		.help = "Bus transaction macros"
+	},
 	UART_PARAMETERS
 	/* UART-specific commands */
 	{
@@ -558,7 +640,7 @@ t_token tokens_mode_uart[] = {
 	},
 	{
 		T_SCAN,
-		.help = "Measure baudrate (PC6)"
+		.help = "Detect baudrate and frame format (PC6) and configure UART"
 	},
 	{
 		T_EXIT,
@@ -632,6 +714,11 @@ t_token tokens_mode_smartcard[] = {
 		.subtokens = tokens_mode_trigger,
 		.help = "Setup SMARTCARD trigger"
 	},
+	{
+		T_MACRO,
+		.subtokens = tokens_mode_macro,
+		.help = "Bus transaction macros"
+	},
 	SMARTCARD_PARAMETERS
 	/* SMARTCARD-specific commands */
 	{
@@ -666,6 +753,10 @@ t_token tokens_mode_smartcard[] = {
 		T_ATR,
 		.help = "Read card ATR"
 	},
+	{
+		T_PPS,
+		.help = "Negotiate card speed from ATR (PPS)"
+	},
 	/* BP commands */
 	{
 		T_LEFT_SQ,
@@ -749,6 +840,11 @@ t_token tokens_mode_lin[] = {
 		.subtokens = tokens_mode_trigger,
 		.help = "Setup LIN trigger"
 	},
+	{
+		T_MACRO,
+		.subtokens = tokens_mode_macro,
+		.help = "Bus transaction macros"
+	},
 	LIN_PARAMETERS
 	/* LIN-specific commands */
 	{
@@ -940,6 +1036,14 @@ t_token tokens_can[] = {
 		.help = "Max clock stretch tick count. (0 = Disabled, n = Ticks)"\
 	},
 
+t_token tokens_mode_i2c_scan[] = {
+	{
+		T_TENBIT,
+		.help = "Also scan 10-bit addresses"
+	},
+	{ }
+};
+
 t_token tokens_mode_i2c[] = {
 	{
 		T_SHOW,
@@ -951,11 +1055,17 @@ t_token tokens_mode_i2c[] = {
 		.subtokens = tokens_mode_trigger,
 		.help = "Setup I2C trigger"
 	},
+	{
+		T_MACRO,
+		.subtokens = tokens_mode_macro,
+		.help = "Bus transaction macros"
+	},
 	I2C_PARAMETERS
 	/* I2C-specific commands */
 	{
 		T_SCAN,
-		.help = "Scan for connected devices"
+		.subtokens = tokens_mode_i2c_scan,
+		.help = "Scan for connected devices and identify known parts"
 	},
 	{
 		T_SNIFF,
@@ -1078,6 +1188,11 @@ t_token tokens_mode_spi[] = {
 		.subtokens = tokens_mode_trigger,
 		.help = "Setup SPI trigger"
 	},
+	{
+		T_MACRO,
+		.subtokens = tokens_mode_macro,
+		.help = "Bus transaction macros"
+	},
 	SPI_PARAMETERS
 	/* SPI-specific commands */
 	{
@@ -1346,6 +1461,11 @@ t_token tokens_mode_onewire[] = {
 		.subtokens = tokens_mode_trigger,
 		.help = "Setup 1-wire trigger"
 	},
+	{
+		T_MACRO,
+		.subtokens = tokens_mode_macro,
+		.help = "Bus transaction macros"
+	},
 	ONEWIRE_PARAMETERS
 	/* 1-wire-specific commands */
 	{
@@ -1457,6 +1577,11 @@ t_token tokens_mode_twowire[] = {
 		.subtokens = tokens_mode_trigger,
 		.help = "Setup 2-wire trigger"
 	},
+	{
+		T_MACRO,
+		.subtokens = tokens_mode_macro,
+		.help = "Bus transaction macros"
+	},
 	TWOWIRE_PARAMETERS
 	/* 2-wire-specific commands */
 	{
@@ -1591,6 +1716,11 @@ t_token tokens_mode_threewire[] = {
 		.subtokens = tokens_mode_trigger,
 		.help = "Setup 3-wire trigger"
 	},
+	{
+		T_MACRO,
+		.subtokens = tokens_mode_macro,
+		.help = "Bus transaction macros"
+	},
 	THREEWIRE_PARAMETERS
 	/* 3-wire-specific commands */
 	{
@@ -1706,6 +1836,32 @@ t_token tokens_mode_flash[] = {
 		T_ID,
 		.help = "Displays the ID and status registers"
 	},
+	{
+		T_ONFI,
+		.help = "Read ONFI parameter page (chip geometry)"
+	},
+	{
+		T_SCAN,
+		.help = "Scan factory bad block markers"
+	},
+	{
+		T_DUMP,
+		.help = "Dump pages with spare area (start/pages/sd)"
+	},
+	{
+		T_START,
+		.arg_type = T_ARG_UINT,
+		.help = "First page to dump"
+	},
+	{
+		T_PAGES,
+		.arg_type = T_ARG_UINT,
+		.help = "Number of pages to dump"
+	},
+	{
+		T_SD,
+		.help = "Dump to nand_dump.bin on SD card"
+	},
 	/* BP commands */
 	{
 		T_EXIT,
@@ -1784,10 +1940,14 @@ t_token tokens_mode_wiegand[] = {
 	},
 	WIEGAND_PARAMETERS
 	/* wiegand-specific commands */
+	{
+		T_SNIFF,
+		.help = "Decode frames continuously until UBTN"
+	},
 	{
 		T_READ,
 		.flags = T_FLAG_SUFFIX_TOKEN_DELIM_INT,
-		.help = "Read byte (repeat with :<num>)"
+		.help = "Read frame (repeat with :<num>)"
 	},
 	{
 		T_HD,
@@ -1927,6 +2087,37 @@ t_token tokens_dac[] = {
 		T_NOISE,
 		.help = "Noise output (amplitude 3.3V)"
 	},
+	{
+		T_SINE,
+		.help = "Sine waveform output (amplitude 3.3V)"
+	},
+	{
+		T_SQUARE,
+		.help = "Square waveform output (amplitude 3.3V)"
+	},
+	{
+		T_RAMP,
+		.help = "Ramp waveform output (amplitude 3.3V)"
+	},
+	{
+		T_LOAD,
+		.arg_type = T_ARG_STRING,
+		.help = "Waveform from microSD file (16bits LE samples)"
+	},
+	{
+		T_UPLOAD,
+		.help = "Waveform sent on the console (16bits LE samples)"
+	},
+	{
+		T_SAMPLES,
+		.arg_type = T_ARG_UINT,
+		.help = "Waveform samples per period (default 100)"
+	},
+	{
+		T_RATE,
+		.arg_type = T_ARG_UINT,
+		.help = "Waveform sample rate in Hz (default 100000)"
+	},
 	{
 		T_EXIT,
 		.help = "Exit DAC mode (reinit DAC1&2 pins to safe mode/in)"
@@ -1938,21 +2129,45 @@ t_token tokens_pwm[] = {
 	{
 		T_HELP,
 		.arg_type = T_ARG_HELP,
-		.help = "PWM1 (PB11)"
+		.help = "PWM1 (PB11), PWM2 (PB10), PWM3 (PB3), PWM4 (PA15)"
+	},
+	{
+		T_CHANNEL,
+		.arg_type = T_ARG_UINT,
+		.help = "PWM channel <1 to 4> (default 1)"
 	},
 	{
 		T_FREQUENCY,
 		.arg_type = T_ARG_UINT,
-		.help = "PWM frequency <value 1Hz to 42MHz>"
+		.help = "PWM frequency <value 1Hz to 42MHz> (all channels)"
 	},
 	{
 		T_DUTY_CYCLE,
 		.arg_type = T_ARG_UINT,
 		.help = "Duty Cycle in % <value 0 to 100>"
 	},
+	{
+		T_BURST,
+		.arg_type = T_ARG_UINT,
+		.help = "Output a burst of pulses then stay low"
+	},
+	{
+		T_SEQUENCE,
+		.arg_type = T_ARG_STRING,
+		.help = "Duty cycles in %, one per period (\"10,50,90\")"
+	},
+	{
+		T_REPEAT,
+		.arg_type = T_ARG_UINT,
+		.help = "Sequence runs (default 0: loop)"
+	},
+	{
+		T_SHOW,
+		.help = "Show channels frequency, duty cycle and resolution"
+	},
 	{
 		T_EXIT,
-		.help = "Exit PWM mode (reinit PWM1 pin to safe mode/in)"
+		.help = "Exit PWM mode (reinit PWM pins to safe mode/in)"
 	},
 	{ }
 };
@@ -1963,6 +2178,37 @@ t_token tokens_freq[] = {
 		.arg_type = T_ARG_HELP,
 		.help = "FREQ1 (PC6)"
 	},
+	{
+		T_PERIOD,
+		.arg_type = T_ARG_UINT,
+		.help = "Gate time (msec)"
+	},
+	{
+		T_SAMPLES,
+		.arg_type = T_ARG_UINT,
+		.help = "Number of gates"
+	},
+	{
+		T_CONTINUOUS,
+		.help = "Measure continuously"
+	},
+	{ }
+};
+
+t_token tokens_rng[] = {
+	{
+		T_SAMPLES,
+		.arg_type = T_ARG_UINT,
+		.help = "Number of 32-bit words"
+	},
+	{
+		T_CONTINUOUS,
+		.help = "Stream continuously"
+	},
+	{
+		T_RAW,
+		.help = "Output raw binary instead of hex"
+	},
 	{ }
 };
 
@@ -2006,6 +2252,10 @@ t_token tokens_sd[] = {
 		T_TESTPERF,
 		.help = "Test SD card performance"
 	},
+	{
+		T_BENCHMARK,
+		.help = "Benchmark SD card raw and filesystem I/O (CSV saved to card)"
+	},
 	{
 		T_CAT,
 		.arg_type = T_ARG_STRING,
@@ -2031,6 +2281,10 @@ t_token tokens_sd[] = {
 		.arg_type = T_ARG_STRING,
 		.help = "Execute script from file"
 	},
+	{
+		T_TRANSFER,
+		.help = "Binary file transfer mode (exit with 0x00 or UBTN)"
+	},
 	{ }
 };
 
@@ -2039,6 +2293,8 @@ t_token tokens_show[] = {
 	{ T_MEMORY },
 	{ T_THREADS },
 	{ T_SD },
+	{ T_RESOURCES },
+	{ T_PROFILE },
 	{ T_DEBUG },
 	{ }
 };
@@ -2075,6 +2331,14 @@ t_token tokens_debug[] = {
 		T_OFF,
 		.help = "Disable"
 	},
+	{
+		T_PROFILE,
+		.help = "Hot path profiler"
+	},
+	{
+		T_RESET,
+		.help = "Reset profiler statistics"
+	},
 	{ }
 };
 
@@ -2134,19 +2398,19 @@ t_token tl_tokens[] = {
 		T_DAC,
 		.subtokens = tokens_dac,
 		.help = "Write analog values",
-		.help_full = "Usage: dac <dac1/dac2> <raw (0 to 4095)/volt (0 to 3.3V)/triangle/noise> [exit]"
+		.help_full = "Usage: dac <dac1/dac2> <raw (0 to 4095)/volt (0 to 3.3V)/triangle/noise> [exit]\r\nWaveform: dac <dac1/dac2> <sine/square/ramp/load (filename)/upload> [samples (per period)] [rate (Hz)]"
 	},
 	{
 		T_PWM,
 		.subtokens = tokens_pwm,
 		.help = "Write PWM",
-		.help_full = "Usage: pwm <frequency (1Hz to 42MHz)> [duty-cycle (0 to 100%)] [exit]"
+		.help_full = "Usage: pwm [channel (1 to 4)] <frequency (1Hz to 42MHz)> [duty-cycle (0 to 100%)] [exit]\r\nDMA: pwm [channel (1 to 4)] <burst (nb pulses)/sequence (duty cycles)> [repeat (nb runs)]"
 	},
 	{
 		T_FREQUENCY,
 		.subtokens = tokens_freq,
 		.help = "Read frequency",
-		.help_full = "Usage: frequency"
+		.help_full = "Usage: frequency [period (gate msec)] [samples (nb gates)] [continuous]"
 	},
 	{
 		T_CONTINUITY,
@@ -2215,7 +2479,9 @@ t_token tl_tokens[] = {
 	},
 	{
 		T_RNG,
-		.help = "Random number"
+		.subtokens = tokens_rng,
+		.help = "Random number",
+		.help_full = "Usage: random [samples (nb words)] [continuous] [raw]"
 	},
 	{
 		T_FLASH,
@@ -160,6 +160,29 @@ enum {
 	T_POKE,
 	T_SWIO,
 	T_CONTINUITY,
+	T_PPS,
+	T_ONFI,
+	T_DUMP,
+	T_PAGES,
+	T_RESOURCES,
+	T_PROFILE,
+	T_RESET,
+	T_TRANSFER,
+	T_BENCHMARK,
+	T_MACRO,
+	T_RUN,
+	T_REPEAT,
+	T_SAVE,
+	T_LOAD,
+	T_SINE,
+	T_SQUARE,
+	T_RAMP,
+	T_RATE,
+	T_UPLOAD,
+	T_CHANNEL,
+	T_BURST,
+	T_SEQUENCE,
+	T_TENBIT,
 	/* Developer warning add new command(s) here */
 
 	/* BP-compatible commands */
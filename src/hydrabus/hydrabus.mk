@@ -23,16 +23,27 @@ HYDRABUSSRC = hydrabus/hydrabus.c \
             hydrabus/hydrabus_bbio_pin.c \
             hydrabus/hydrabus_bbio_can.c \
             hydrabus/hydrabus_bbio_uart.c \
+            hydrabus/hydrabus_uart_autobaud.c \
             hydrabus/hydrabus_bbio_smartcard.c \
+            hydrabus/hydrabus_smartcard_iso7816.c \
+            hydrabus/hydrabus_flash_nand.c \
             hydrabus/hydrabus_bbio_i2c.c \
+            hydrabus/hydrabus_i2c_scan.c \
             hydrabus/hydrabus_bbio_rawwire.c \
             hydrabus/hydrabus_freq.c \
             hydrabus/hydrabus_bbio_onewire.c \
             hydrabus/hydrabus_bbio_flash.c \
             hydrabus/hydrabus_bbio_adc.c \
             hydrabus/hydrabus_bbio_freq.c \
+            hydrabus/hydrabus_bbio_rng.c \
+            hydrabus/hydrabus_bbio_dac.c \
+            hydrabus/hydrabus_bbio_pwm.c \
             hydrabus/hydrabus_sd.c \
+            hydrabus/hydrabus_sd_xfer.c \
+            hydrabus/hydrabus_sd_bench.c \
             hydrabus/hydrabus_trigger.c \
+            hydrabus/hydrabus_trigger_match.c \
+            hydrabus/hydrabus_macro.c \
             hydrabus/hydrabus_mode_wiegand.c \
             hydrabus/hydrabus_mode_lin.c \
             hydrabus/hydrabus_bbio_aux.c \
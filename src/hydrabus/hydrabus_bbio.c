@@ -36,9 +36,13 @@
 #include "hydrabus_bbio_smartcard.h"
 #include "hydrabus_bbio_adc.h"
 #include "hydrabus_bbio_freq.h"
+#include "hydrabus_bbio_rng.h"
+#include "hydrabus_bbio_dac.h"
+#include "hydrabus_bbio_pwm.h"
 #include "hydrabus_bbio_aux.h"
 #include "hydrabus_bbio_mmc.h"
 #include "hydrabus_bbio_sdio.h"
+#include "hydrabus_sd_xfer.h"
 #ifdef HYDRANFC
 #include "hydranfc_bbio_reader.h"
 #endif
@@ -96,6 +100,9 @@ int cmd_bbio(t_hydra_console *con)
 			case BBIO_SDIO:
 				bbio_mode_sdio(con);
 				break;
+			case BBIO_SD_XFER:
+				sd_xfer_server(con);
+				break;
 #ifdef HYDRANFC
 			case BBIO_NFC_READER:
 				bbio_mode_hydranfc_reader(con);
@@ -114,6 +121,18 @@ int cmd_bbio(t_hydra_console *con)
 			case BBIO_FREQ:
 				bbio_freq(con);
 				continue;
+			case BBIO_FREQ_CONT:
+				bbio_freq_continuous(con);
+				continue;
+			case BBIO_RNG:
+				bbio_rng(con);
+				continue;
+			case BBIO_DAC_WAVE:
+				bbio_dac_wave(con);
+				continue;
+			case BBIO_PWM:
+				bbio_pwm(con);
+				continue;
 			case BBIO_RESET:
 				break;
 			default:
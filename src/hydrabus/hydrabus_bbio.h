@@ -49,6 +49,10 @@
 #define BBIO_VOLT		0b00010100
 #define BBIO_VOLT_CONT		0b00010101
 #define BBIO_FREQ		0b00010110
+#define BBIO_FREQ_CONT		0b00010111
+#define BBIO_RNG		0b00011000
+#define BBIO_SD_XFER		0b00011001
+#define BBIO_DAC_WAVE		0b00011010
 
 /*
  * SPI-specific commands
@@ -79,6 +83,7 @@
 #define BBIO_I2C_ACK_BIT		0b00000110
 #define BBIO_I2C_NACK_BIT		0b00000111
 #define BBIO_I2C_WRITE_READ		0b00001000
+#define BBIO_I2C_SCAN			0b00001001
 #define BBIO_I2C_START_SNIFF		0b00001111
 #define BBIO_I2C_BULK_WRITE		0b00010000
 #define BBIO_I2C_CLK_STRETCH		0b00100000
@@ -113,6 +118,7 @@
  */
 #define BBIO_UART_START_ECHO		0b00000010
 #define BBIO_UART_STOP_ECHO		0b00000011
+#define BBIO_UART_AUTOBAUD		0b00000100
 #define BBIO_UART_BAUD_RATE		0b00000111
 #define BBIO_UART_BRIDGE		0b00001111
 #define BBIO_UART_BULK_TRANSFER		0b00010000
@@ -135,6 +141,8 @@
 #define BBIO_RAWWIRE_CLK_HIGH		0b00001011
 #define BBIO_RAWWIRE_DATA_LOW		0b00001100
 #define BBIO_RAWWIRE_DATA_HIGH		0b00001101
+#define BBIO_RAWWIRE_SET_FREQ		0b00001110
+#define BBIO_RAWWIRE_STREAM		0b00001111
 #define BBIO_RAWWIRE_BULK_TRANSFER	0b00010000
 #define BBIO_RAWWIRE_BULK_CLK		0b00100000
 #define BBIO_RAWWIRE_BULK_BIT		0b00110000
@@ -147,6 +155,10 @@
  */
 #define BBIO_ONEWIRE_RESET		0b00000010
 #define BBIO_ONEWIRE_READ		0b00000100
+#define BBIO_ONEWIRE_SEARCH		0b00000110
+#define BBIO_ONEWIRE_MATCH_READ		0b00000111
+#define BBIO_ONEWIRE_SWIO_READ_MEM	0b00001000
+#define BBIO_ONEWIRE_SWIO_WRITE_MEM	0b00001001
 #define BBIO_ONEWIRE_BULK_TRANSFER	0b00010000
 #define BBIO_ONEWIRE_SWIO_READ		0b00100000
 #define BBIO_ONEWIRE_SWIO_WRITE		0b00110000
@@ -164,6 +176,10 @@
 #define BBIO_FLASH_WAIT_READY		0b00001000
 #define BBIO_FLASH_SD_DUMP_OFF		0b00001010
 #define BBIO_FLASH_SD_DUMP_ON		0b00001011
+#define BBIO_FLASH_ONFI			0b00001100
+#define BBIO_FLASH_READ_PAGES		0b00001101
+#define BBIO_FLASH_PROGRAM_PAGE		0b00001110
+#define BBIO_FLASH_BAD_BLOCKS		0b00001111
 #define BBIO_FLASH_WRITE_ADDR		0b00010000
 
 /*
@@ -175,6 +191,8 @@
 #define BBIO_SMARTCARD_PRESCALER	0b00000110
 #define BBIO_SMARTCARD_GUARDTIME	0b00000111
 #define BBIO_SMARTCARD_ATR		0b00001000
+#define BBIO_SMARTCARD_PPS		0b00001001
+#define BBIO_SMARTCARD_APDU		0b00001010
 #define BBIO_SMARTCARD_SET_SPEED	0b01100000
 #define BBIO_SMARTCARD_CONFIG		0b10000000
 
@@ -196,6 +214,7 @@
 #define BBIO_NFC_CMD_SEND_BYTES		0b00000101
 #define BBIO_NFC_SET_MODE_ISO_14443A	0b00000110
 #define BBIO_NFC_SET_MODE_ISO_15693	0b00000111
+#define BBIO_NFC_EMUL_MF_ULTRALIGHT	0b00001000
 
 /*
  * MMC-specific commands
@@ -205,6 +224,8 @@
 #define BBIO_MMC_READ_PAGE		0b00000100
 #define BBIO_MMC_WRITE_PAGE		0b00000101
 #define BBIO_MMC_EXT_CSD		0b00000110
+#define BBIO_MMC_READ_MULTI		0b00000111
+#define BBIO_MMC_WRITE_MULTI		0b00001000
 #define BBIO_MMC_CONFIG			0b10000000
 
 /*
@@ -213,6 +234,15 @@
 #define BBIO_SDIO_CMD			0b00000100
 #define BBIO_SDIO_WRITE			0b00001000
 #define BBIO_SDIO_READ			0b00001100
+#define BBIO_SDIO_IO_RW_EXTENDED	0b00010000
+#define BBIO_SDIO_QUEUE			0b00010100
 #define BBIO_SDIO_CONFIG		0b10000000
 
+/*
+ * SD file transfer commands
+ */
+#define BBIO_SD_XFER_STAT		0b00000010
+#define BBIO_SD_XFER_GET		0b00000011
+#define BBIO_SD_XFER_PUT		0b00000100
+
 int cmd_bbio(t_hydra_console *con);
@@ -0,0 +1,137 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common.h"
+
+#include "hydrabus_bbio.h"
+#include "bsp_dac.h"
+
+#include <string.h>
+
+#define BBIO_DAC_MAX_SAMPLES	(0x2000)
+#define BBIO_DAC_TIMEOUT	TIME_MS2I(1000)
+
+static uint32_t bbio_dac_get_u32(uint8_t *data)
+{
+	return (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+/* Reads one half buffer when the host sends 0x01, FALSE on 0x00 or timeout */
+static bool bbio_dac_refill(t_hydra_console *con, uint16_t *half, uint32_t nb_samples)
+{
+	uint8_t cmd;
+
+	cprint(con, "\x01", 1);
+	if(chnReadTimeout(con->sdu, &cmd, 1, BBIO_DAC_TIMEOUT) != 1 || cmd != 0x01) {
+		return FALSE;
+	}
+	return chnReadTimeout(con->sdu, (uint8_t *)half, nb_samples * 2,
+			      BBIO_DAC_TIMEOUT) == nb_samples * 2;
+}
+
+/*
+ * Arbitrary waveform on DAC1 (channel 0) or DAC2 (channel 1).
+ * The host sends the channel (1 byte), the sample rate in Hz and the
+ * number of samples (4 bytes each, big endian) and the mode (1 byte).
+ *
+ * Mode 0 (loop): nb_samples 16bits little endian samples follow. The
+ * device answers 0x01 and the actual rate (4 bytes, big endian) then
+ * plays the buffer until BBIO_RESET is received.
+ *
+ * Mode 1 (stream): nb_samples (even) is the size of a double buffer.
+ * The device answers 0x01 and the actual rate then sends 0x01 each time
+ * half a buffer can be refilled, the host answers 0x01 followed by
+ * nb_samples/2 samples, or 0x00 to stop.
+ *
+ * The waveform ends with 0x00 followed by the bsp_dac_wave_stats_t
+ * counters (3 x uint32_t). Setup errors are answered the same way.
+ */
+void bbio_dac_wave(t_hydra_console *con)
+{
+	bsp_dac_wave_stats_t stats;
+	bsp_dev_dac_t dev_num;
+	uint32_t rate, nb_samples, half_samples;
+	uint16_t *buffer = NULL;
+	uint8_t data[10];
+	uint8_t cmd=1, mode;
+	int half;
+
+	memset(&stats, 0, sizeof(bsp_dac_wave_stats_t));
+
+	if(chnReadTimeout(con->sdu, data, 10, BBIO_DAC_TIMEOUT) != 10) {
+		goto end;
+	}
+	dev_num = (data[0] == 1) ? BSP_DEV_DAC2 : BSP_DEV_DAC1;
+	rate = bbio_dac_get_u32(&data[1]);
+	nb_samples = bbio_dac_get_u32(&data[5]);
+	mode = data[9];
+	half_samples = nb_samples / 2;
+
+	if(nb_samples < 2 || nb_samples > BBIO_DAC_MAX_SAMPLES) {
+		goto end;
+	}
+	if(mode != 0 && (nb_samples & 1)) {
+		goto end;
+	}
+	buffer = pool_alloc_bytes(nb_samples * 2);
+	if(buffer == NULL) {
+		goto end;
+	}
+
+	if(mode == 0) {
+		if(chnReadTimeout(con->sdu, (uint8_t *)buffer, nb_samples * 2,
+				  BBIO_DAC_TIMEOUT) != nb_samples * 2) {
+			goto end;
+		}
+	} else {
+		if(!bbio_dac_refill(con, buffer, half_samples) ||
+		   !bbio_dac_refill(con, buffer + half_samples, half_samples)) {
+			goto end;
+		}
+	}
+
+	if(bsp_dac_wave_start(dev_num, buffer, nb_samples, &rate) != BSP_OK) {
+		goto end;
+	}
+	data[0] = 0x01;
+	data[1] = rate >> 24;
+	data[2] = rate >> 16;
+	data[3] = rate >> 8;
+	data[4] = rate;
+	cprint(con, (char *)data, 5);
+
+	if(mode == 0) {
+		while(cmd != BBIO_RESET && !hydrabus_ubtn()) {
+			chnReadTimeout(con->sdu, &cmd, 1, TIME_MS2I(100));
+		}
+	} else {
+		while(!hydrabus_ubtn()) {
+			half = bsp_dac_wave_wait(dev_num, BBIO_DAC_TIMEOUT);
+			if(half < 0 ||
+			   !bbio_dac_refill(con, buffer + half * half_samples, half_samples)) {
+				break;
+			}
+		}
+	}
+	bsp_dac_wave_stop(dev_num, &stats);
+
+end:
+	cprint(con, "\x00", 1);
+	cprint(con, (char *)&stats, sizeof(bsp_dac_wave_stats_t));
+	pool_free(buffer);
+}
@@ -27,6 +27,7 @@
 #include "hydrabus_bbio.h"
 #include "hydrabus_bbio_flash.h"
 #include "hydrabus_mode_flash.h"
+#include "hydrabus_flash_nand.h"
 
 
 static void bbio_mode_id(t_hydra_console *con)
@@ -34,6 +35,79 @@ static void bbio_mode_id(t_hydra_console *con)
 	cprint(con, BBIO_FLASH_HEADER, 4);
 }
 
+static uint32_t get_be32(uint8_t *buf)
+{
+	return (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+}
+
+/*
+ * Read pages with their spare area. Each page answers 0x01 + NAND status +
+ * data, or 0x01 + NAND status once written to the SD dump file. 0x00 ends
+ * the transfer early (chip busy timeout, SD error or short write).
+ */
+static void bbio_flash_read_pages(t_hydra_console *con, flash_nand_t *nand,
+				  uint8_t *page_buf, FIL *outfile, bool to_sd)
+{
+	uint8_t buf[8];
+	uint32_t page, nb_pages, page_len;
+	uint8_t status;
+	UINT written;
+
+	chnRead(con->sdu, buf, 8);
+	page = get_be32(&buf[0]);
+	nb_pages = get_be32(&buf[4]);
+	page_len = nand->page_size + nand->spare_size;
+
+	for(; nb_pages > 0; nb_pages--, page++) {
+		if(!flash_nand_read_page(con, nand, page, page_buf, &status)) {
+			break;
+		}
+		if(to_sd) {
+			if(f_write(outfile, page_buf, page_len, &written) != FR_OK ||
+			   written != page_len) {
+				break;
+			}
+			buf[0] = 1;
+			buf[1] = status;
+			cprint(con, (char *)buf, 2);
+		} else {
+			buf[0] = 1;
+			buf[1] = status;
+			cprint(con, (char *)buf, 2);
+			cprint(con, (char *)page_buf, page_len);
+		}
+	}
+	if(nb_pages > 0) {
+		cprint(con, "\x00", 1);
+	}
+}
+
+/* Bitmap of bad blocks, bit n of byte n/8 set for a bad block n */
+static void bbio_flash_bad_blocks(t_hydra_console *con, flash_nand_t *nand,
+				  uint8_t *bitmap)
+{
+	uint32_t block, len;
+	bool bad;
+
+	len = (nand->blocks + 7) / 8;
+	if(len > 0x1000) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	memset(bitmap, 0, len);
+	for(block = 0; block < nand->blocks; block++) {
+		if(!flash_nand_is_bad_block(con, nand, block, &bad)) {
+			cprint(con, "\x00", 1);
+			return;
+		}
+		if(bad) {
+			bitmap[block / 8] |= 1 << (block % 8);
+		}
+	}
+	cprint(con, "\x01", 1);
+	cprint(con, (char *)bitmap, len);
+}
+
 void bbio_mode_flash(t_hydra_console *con)
 {
 	FIL outfile;
@@ -42,6 +116,10 @@ void bbio_mode_flash(t_hydra_console *con)
 	uint8_t *tx_data = pool_alloc_bytes(0x1000); // 4096 bytes
 	uint8_t *rx_data = pool_alloc_bytes(0x1000); // 4096 bytes
 	bool to_sd = FALSE;
+	flash_nand_t nand;
+	uint8_t *page_buf = NULL;
+	uint8_t status;
+	UINT written;
 
 	if(tx_data == 0 || rx_data == 0) {
 		pool_free(tx_data);
@@ -49,6 +127,8 @@ void bbio_mode_flash(t_hydra_console *con)
 		return;
 	}
 
+	nand.valid = FALSE;
+
 	flash_init_proto_default(con);
 	flash_pin_init(con);
 
@@ -60,6 +140,10 @@ void bbio_mode_flash(t_hydra_console *con)
 			case BBIO_RESET:
 				pool_free(tx_data);
 				pool_free(rx_data);
+				pool_free(page_buf);
+				if(to_sd) {
+					file_close(&outfile);
+				}
 				flash_cleanup(con);
 				return;
 			case BBIO_MODE_ID:
@@ -116,7 +200,8 @@ void bbio_mode_flash(t_hydra_console *con)
 				}
 
 				if(to_sd) {
-					if(file_append(&outfile, rx_data, to_rx)) {
+					if(f_write(&outfile, rx_data, to_rx, &written) == FR_OK &&
+					   written == to_rx) {
 						cprint(con, "\x01", 1);
 					} else {
 						cprint(con, "\x00", 1);
@@ -127,21 +212,70 @@ void bbio_mode_flash(t_hydra_console *con)
 				}
 				break;
 			case BBIO_FLASH_SD_DUMP_ON:
-				to_sd = TRUE;
-				if(file_open(&outfile, "sd_dump.bin", 'w')) {
+				if(to_sd) {
+					file_close(&outfile);
+				}
+				/* A previous dump is replaced, data is then written in sequence */
+				to_sd = (is_fs_ready() || mount() == 0) &&
+					f_open(&outfile, "sd_dump.bin",
+					       FA_WRITE | FA_CREATE_ALWAYS) == FR_OK;
+				if(to_sd) {
 					cprint(con, "\x01", 1);
 				} else {
 					cprint(con, "\x00", 1);
 				}
 				break;
 			case BBIO_FLASH_SD_DUMP_OFF:
+				if(to_sd && file_close(&outfile)) {
+					cprint(con, "\x01", 1);
+				} else {
+					cprint(con, "\x00", 1);
+				}
 				to_sd = FALSE;
-				if(file_close(&outfile)) {
+				break;
+			case BBIO_FLASH_ONFI:
+				pool_free(page_buf);
+				page_buf = NULL;
+				if(flash_nand_read_param_page(con, &nand, rx_data)) {
+					page_buf = pool_alloc_bytes(nand.page_size + nand.spare_size);
+				}
+				if(page_buf != NULL) {
 					cprint(con, "\x01", 1);
+					cprint(con, (char *)rx_data, FLASH_NAND_PARAM_PAGE_SIZE);
 				} else {
+					nand.valid = FALSE;
 					cprint(con, "\x00", 1);
 				}
 				break;
+			case BBIO_FLASH_READ_PAGES:
+				if(!nand.valid) {
+					/* Consume arguments */
+					chnRead(con->sdu, rx_data, 8);
+					cprint(con, "\x00", 1);
+					break;
+				}
+				bbio_flash_read_pages(con, &nand, page_buf, &outfile, to_sd);
+				break;
+			case BBIO_FLASH_PROGRAM_PAGE:
+				chnRead(con->sdu, rx_data, 4);
+				if(!nand.valid) {
+					cprint(con, "\x00", 1);
+					break;
+				}
+				chnRead(con->sdu, page_buf, nand.page_size + nand.spare_size);
+				rx_data[4] = flash_nand_program_page(con, &nand,
+								     get_be32(rx_data),
+								     page_buf, &status);
+				rx_data[5] = status;
+				cprint(con, (char *)&rx_data[4], 2);
+				break;
+			case BBIO_FLASH_BAD_BLOCKS:
+				if(!nand.valid) {
+					cprint(con, "\x00", 1);
+					break;
+				}
+				bbio_flash_bad_blocks(con, &nand, rx_data);
+				break;
 			default:
 				if ((bbio_subcommand & BBIO_FLASH_WRITE_ADDR) == BBIO_FLASH_WRITE_ADDR) {
 					// data contains the number of bytes to
@@ -165,6 +299,9 @@ void bbio_mode_flash(t_hydra_console *con)
 	}
 	pool_free(tx_data);
 	pool_free(rx_data);
-	file_close(&outfile);
+	pool_free(page_buf);
+	if(to_sd) {
+		file_close(&outfile);
+	}
 	flash_cleanup(con);
 }
@@ -26,9 +26,56 @@ void bbio_freq(t_hydra_console *con)
 {
 	uint32_t frequency, duty;
 
-	if(bsp_freq_get_values(BSP_DEV_FREQ1, &frequency, &duty) == TRUE) {
+	if(bsp_freq_get_values(BSP_DEV_FREQ1, &frequency, &duty) == BSP_OK) {
 		cprint(con, (char *)&frequency, 4);
 		cprint(con, (char *)&duty, 4);
 	}
 	bsp_freq_deinit(BSP_DEV_FREQ1);
 }
+
+/*
+ * Gate time in msec is sent as 2 bytes (big endian). A bsp_freq_stats_t
+ * record (8 x uint32_t) is then sent after each gate until BBIO_RESET is
+ * received. A gate time of 0 or a setup error is answered with 0x00.
+ */
+void bbio_freq_continuous(t_hydra_console *con)
+{
+	bsp_freq_stats_t stats;
+	uint16_t *buffer;
+	uint8_t cmd=1;
+	uint8_t data[2];
+	uint16_t gate;
+	systime_t start;
+
+	chnRead(con->sdu, data, 2);
+	gate = (data[0] << 8) | data[1];
+
+	buffer = pool_alloc_bytes(0x1000);
+	if(gate == 0 || buffer == NULL) {
+		cprint(con, "\x00", 1);
+		pool_free(buffer);
+		return;
+	}
+
+	if(bsp_freq_capture_start(BSP_DEV_FREQ1, buffer, 0x1000/4) != BSP_OK) {
+		cprint(con, "\x00", 1);
+		bsp_freq_deinit(BSP_DEV_FREQ1);
+		pool_free(buffer);
+		return;
+	}
+	cprint(con, "\x01", 1);
+
+	bsp_freq_capture_get_stats(BSP_DEV_FREQ1, &stats);
+	while(cmd != BBIO_RESET) {
+		start = chVTGetSystemTimeX();
+		while(chVTTimeElapsedSinceX(start) < TIME_MS2I(gate)) {
+			bsp_freq_capture_poll(BSP_DEV_FREQ1);
+			chThdSleepMilliseconds(1);
+		}
+		bsp_freq_capture_get_stats(BSP_DEV_FREQ1, &stats);
+		cprint(con, (char *)&stats, sizeof(bsp_freq_stats_t));
+		chnReadTimeout(con->sdu, &cmd, 1, TIME_IMMEDIATE);
+	}
+	bsp_freq_deinit(BSP_DEV_FREQ1);
+	pool_free(buffer);
+}
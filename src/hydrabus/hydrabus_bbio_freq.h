@@ -18,3 +18,4 @@
  */
 
 void bbio_freq(t_hydra_console *con);
+void bbio_freq_continuous(t_hydra_console *con);
@@ -27,7 +27,9 @@
 #include "hydrabus_bbio_i2c.h"
 #include "bsp_i2c_master.h"
 #include "bsp_i2c_slave.h"
+#include "hydrabus_i2c_scan.h"
 #include "hydrabus_bbio_aux.h"
+#include "profile.h"
 
 #define I2C_DEV_NUM (1)
 
@@ -84,9 +86,58 @@ static void bbio_mode_id(t_hydra_console *con)
 	cprint(con, BBIO_I2C_HEADER, 4);
 }
 
+/*
+ * Parameter: flags (bit 0: 10-bit addresses)
+ * Reply: 0x01, 16 bytes bitmap of the 7-bit addresses which ACKed,
+ * number of 10-bit devices then their u16 BE address,
+ * number of identified devices then for each: address, name length, name.
+ * 0x00 if the bus is held low or on clock stretching timeout.
+ */
+void bbio_i2c_scan(t_hydra_console *con)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	i2c_scan_t *res;
+	const char *name;
+	uint8_t buf[2];
+	int i;
+
+	chnRead(con->sdu, buf, 1);
+
+	res = pool_alloc_bytes(sizeof(i2c_scan_t));
+	if (res == NULL) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+
+	if (i2c_scan(proto, (buf[0] & 1) ? TRUE : FALSE, res) != BSP_OK) {
+		cprint(con, "\x00", 1);
+		pool_free(res);
+		return;
+	}
+
+	cprint(con, "\x01", 1);
+	cprint(con, (char *)res->ack, sizeof(res->ack));
+	cprint(con, (char *)&res->nb_tenbit, 1);
+	for (i = 0; i < res->nb_tenbit; i++) {
+		buf[0] = res->tenbit[i] >> 8;
+		buf[1] = res->tenbit[i] & 0xff;
+		cprint(con, (char *)buf, 2);
+	}
+	cprint(con, (char *)&res->nb_id, 1);
+	for (i = 0; i < res->nb_id; i++) {
+		name = i2c_scan_sig_name(res->id[i].sig);
+		buf[0] = res->id[i].addr;
+		buf[1] = strlen(name);
+		cprint(con, (char *)buf, 2);
+		cprint(con, name, buf[1]);
+	}
+	pool_free(res);
+}
+
 void bbio_mode_i2c(t_hydra_console *con)
 {
 	uint8_t bbio_subcommand;
+	uint32_t start;
 	uint16_t to_rx, to_tx, i;
 	uint8_t *tx_data = pool_alloc_bytes(0x1000); // 4096 bytes
 	uint8_t *rx_data = pool_alloc_bytes(0x1000); // 4096 bytes
@@ -109,6 +160,7 @@ void bbio_mode_i2c(t_hydra_console *con)
 
 	while (!hydrabus_ubtn()) {
 		if(chnRead(con->sdu, &bbio_subcommand, 1) == 1) {
+			start = prof_start();
 			switch(bbio_subcommand) {
 			case BBIO_RESET:
 				pool_free(tx_data);
@@ -142,6 +194,9 @@ void bbio_mode_i2c(t_hydra_console *con)
 			case BBIO_I2C_START_SNIFF:
 				bbio_i2c_sniff(con);
 				break;
+			case BBIO_I2C_SCAN:
+				bbio_i2c_scan(con);
+				break;
 			case BBIO_I2C_WRITE_READ:
 				chnRead(con->sdu, rx_data, 4);
 				to_tx = (rx_data[0] << 8) + rx_data[1];
@@ -270,6 +325,7 @@ void bbio_mode_i2c(t_hydra_console *con)
 					}
 				}
 			}
+			prof_record(PROF_BBIO_I2C, start);
 		}
 	}
 	pool_free(tx_data);
@@ -21,4 +21,5 @@
 
 void bbio_i2c_init_proto_default(t_hydra_console *con);
 void bbio_i2c_sniff(t_hydra_console *con);
+void bbio_i2c_scan(t_hydra_console *con);
 void bbio_mode_i2c(t_hydra_console *con);
@@ -27,6 +27,7 @@
 #include "hydrabus_bbio_mmc.h"
 #include "bsp_mmc.h"
 #include "hydrabus_bbio_aux.h"
+#include "crc32.h"
 
 extern const SDCConfig sdccfg;
 
@@ -43,6 +44,124 @@ static void bbio_mode_id(t_hydra_console *con)
 	cprint(con, BBIO_MMC_HEADER, 4);
 }
 
+static uint32_t bbio_mmc_get_u32(t_hydra_console *con)
+{
+	uint8_t buf[4];
+
+	chnRead(con->sdu, buf, 4);
+	return (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+}
+
+static void bbio_mmc_put_status(t_hydra_console *con, bsp_status_t status,
+				uint32_t value)
+{
+	uint8_t buf[5];
+
+	buf[0] = (status == BSP_OK) ? 1 : 0;
+	buf[1] = value >> 24;
+	buf[2] = value >> 16;
+	buf[3] = value >> 8;
+	buf[4] = value;
+	cprint(con, (char *)buf, 5);
+}
+
+/*
+ * Stream a block range from the card. Each chunk of up to
+ * BBIO_MMC_MULTI_BLOCKS blocks is sent as 0x01 + data while the next chunk
+ * is read by DMA into the other buffer. The range ends with 0x01 + CRC32 of
+ * all data, or 0x00 + first failing block number instead of a chunk.
+ */
+static void bbio_mmc_read_multi(t_hydra_console *con, uint8_t *buf[2])
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint32_t block_number, nb_blocks, nb, cur_nb;
+	uint32_t crc = 0;
+	uint8_t *cur;
+	uint8_t i = 0;
+	bsp_status_t status;
+
+	block_number = bbio_mmc_get_u32(con);
+	nb_blocks = bbio_mmc_get_u32(con);
+
+	nb = (nb_blocks < BBIO_MMC_MULTI_BLOCKS) ? nb_blocks : BBIO_MMC_MULTI_BLOCKS;
+	status = bsp_mmc_read_blocks_start(proto->dev_num, buf[i], block_number, nb);
+
+	while(status == BSP_OK) {
+		status = bsp_mmc_blocks_wait(proto->dev_num);
+		if(status != BSP_OK) {
+			break;
+		}
+		cur = buf[i];
+		cur_nb = nb;
+		block_number += nb;
+		nb_blocks -= nb;
+
+		if(nb_blocks > 0) {
+			i ^= 1;
+			nb = (nb_blocks < BBIO_MMC_MULTI_BLOCKS) ? nb_blocks : BBIO_MMC_MULTI_BLOCKS;
+			status = bsp_mmc_read_blocks_start(proto->dev_num, buf[i],
+							   block_number, nb);
+		}
+
+		cprint(con, "\x01", 1);
+		cprint(con, (char *)cur, cur_nb * BSP_SDIO_BLOCK_LEN);
+		crc = crc32_update(crc, cur, cur_nb * BSP_SDIO_BLOCK_LEN);
+
+		if(nb_blocks == 0) {
+			break;
+		}
+	}
+	bbio_mmc_put_status(con, status, (status == BSP_OK) ? crc : block_number);
+}
+
+/*
+ * Write a block range to the card. The host streams all the data without
+ * waiting, the next chunk is received while the previous one is written by
+ * DMA. Data is always consumed, even after an error, to keep the protocol in
+ * sync. Answer is 0x01 + CRC32 of received data, or 0x00 + first failing
+ * block number.
+ */
+static void bbio_mmc_write_multi(t_hydra_console *con, uint8_t *buf[2])
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint32_t block_number, nb_blocks, nb;
+	uint32_t pending_block = 0;
+	uint32_t crc = 0;
+	uint8_t pending = 0;
+	uint8_t i = 0;
+	bsp_status_t status = BSP_OK;
+
+	block_number = bbio_mmc_get_u32(con);
+	nb_blocks = bbio_mmc_get_u32(con);
+
+	while(nb_blocks > 0) {
+		nb = (nb_blocks < BBIO_MMC_MULTI_BLOCKS) ? nb_blocks : BBIO_MMC_MULTI_BLOCKS;
+		chnRead(con->sdu, buf[i], nb * BSP_SDIO_BLOCK_LEN);
+		crc = crc32_update(crc, buf[i], nb * BSP_SDIO_BLOCK_LEN);
+
+		if(pending) {
+			pending = 0;
+			if(bsp_mmc_blocks_wait(proto->dev_num) != BSP_OK) {
+				status = BSP_ERROR;
+			}
+		}
+		if(status == BSP_OK) {
+			pending_block = block_number;
+			status = bsp_mmc_write_blocks_start(proto->dev_num, buf[i],
+							    block_number, nb);
+			pending = (status == BSP_OK);
+		}
+
+		block_number += nb;
+		nb_blocks -= nb;
+		i ^= 1;
+	}
+	if(pending && bsp_mmc_blocks_wait(proto->dev_num) != BSP_OK) {
+		status = BSP_ERROR;
+	}
+	bbio_mmc_put_status(con, status, (status == BSP_OK) ? crc : pending_block);
+}
+
 void bbio_mode_mmc(t_hydra_console *con)
 {
 	uint8_t bbio_subcommand;
@@ -50,6 +169,7 @@ void bbio_mode_mmc(t_hydra_console *con)
 	uint32_t * mmc_cid;
 	uint8_t *tx_data = pool_alloc_bytes(0x1000); // 4096 bytes
 	uint8_t *rx_data = pool_alloc_bytes(0x1000); // 4096 bytes
+	uint8_t *buf[2];
 	bsp_status_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
@@ -59,6 +179,9 @@ void bbio_mode_mmc(t_hydra_console *con)
 		return;
 	}
 
+	buf[0] = rx_data;
+	buf[1] = tx_data;
+
 	sdcDisconnect(&SDCD1);
 	sdcStop(&SDCD1);
 
@@ -124,6 +247,12 @@ void bbio_mode_mmc(t_hydra_console *con)
 					cprint(con, "\x00", 1);
 				}
 				break;
+			case BBIO_MMC_READ_MULTI:
+				bbio_mmc_read_multi(con, buf);
+				break;
+			case BBIO_MMC_WRITE_MULTI:
+				bbio_mmc_write_multi(con, buf);
+				break;
 			default:
 				if ((bbio_subcommand & BBIO_MMC_CONFIG) == BBIO_MMC_CONFIG) {
 					proto->config.sdio.bus_width = (bbio_subcommand & 0b1)?4:1;
@@ -19,5 +19,8 @@
 
 #define BBIO_MMC_HEADER		"MMC1"
 
+/* Blocks per chunk of a multi-block transfer (one 4096 bytes pool buffer) */
+#define BBIO_MMC_MULTI_BLOCKS	(8)
+
 void bbio_mmc_init_proto_default(t_hydra_console *con);
 void bbio_mode_mmc(t_hydra_console *con);
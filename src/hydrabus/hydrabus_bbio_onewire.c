@@ -29,12 +29,135 @@
 #include "hydrabus_mode_onewire.h"
 #include "hydrabus_bbio_aux.h"
 
+#define BBIO_ONEWIRE_BUFFER_SIZE	0x1000 // 4096 bytes
+#define BBIO_ONEWIRE_MAX_DEVICES	(BBIO_ONEWIRE_BUFFER_SIZE/8)
+#define BBIO_ONEWIRE_MAX_WORDS		(BBIO_ONEWIRE_BUFFER_SIZE/4)
+
+/* Search flags */
+#define BBIO_ONEWIRE_SEARCH_ALARM	0b01
+#define BBIO_ONEWIRE_SEARCH_FAMILY	0b10
 
 static void bbio_mode_id(t_hydra_console *con)
 {
 	cprint(con, BBIO_ONEWIRE_HEADER, 4);
 }
 
+/*
+ * Runs a complete ROM search on the bus and returns all found IDs at once.
+ * Answer is 0x01, number of devices (2 bytes, MSB first) then 8 bytes
+ * per device.
+ */
+static void bbio_onewire_search(t_hydra_console *con, uint8_t *buffer)
+{
+	struct onewire_scan_state state;
+	uint8_t params[2];
+	uint16_t count = 0;
+	bool device_found_p;
+	enum onewire_scan_mode mode;
+
+	// params[0] contains search flags, params[1] the family code
+	chnRead(con->sdu, params, 2);
+
+	state.search_cmd = (params[0] & BBIO_ONEWIRE_SEARCH_ALARM) ?
+			   ONEWIRE_CMD_ALARMSEARCH : ONEWIRE_CMD_SEARCHROM;
+	if(params[0] & BBIO_ONEWIRE_SEARCH_FAMILY) {
+		state.ROM_ADDR[0] = params[1];
+		mode = onewire_scan_family;
+	} else {
+		mode = onewire_scan_start;
+	}
+
+	device_found_p = onewire_search(con, &state, mode);
+	while(device_found_p && count < BBIO_ONEWIRE_MAX_DEVICES) {
+		if((params[0] & BBIO_ONEWIRE_SEARCH_FAMILY) &&
+		   state.ROM_ADDR[0] != params[1]) {
+			break;
+		}
+		memcpy(buffer+(count*8), state.ROM_ADDR, 8);
+		count++;
+		device_found_p = onewire_search(con, &state, onewire_scan_continue);
+	}
+
+	params[0] = count >> 8;
+	params[1] = count & 0xff;
+	cprint(con, "\x01", 1);
+	cprint(con, (char *)params, 2);
+	cprint(con, (char *)buffer, count*8);
+}
+
+/*
+ * Selects a device with MATCH ROM, writes a command then reads the answer.
+ * Request is ROM (8 bytes), number of bytes to write (1 byte), data to
+ * write, number of bytes to read (2 bytes, MSB first).
+ */
+static void bbio_onewire_match_read(t_hydra_console *con, uint8_t *buffer)
+{
+	uint8_t rom[8], len[2];
+	uint8_t to_tx;
+	uint32_t to_rx, i;
+
+	chnRead(con->sdu, rom, 8);
+	chnRead(con->sdu, &to_tx, 1);
+	chnRead(con->sdu, buffer, to_tx);
+	chnRead(con->sdu, len, 2);
+	to_rx = (len[0] << 8) + len[1];
+
+	if(to_rx > BBIO_ONEWIRE_BUFFER_SIZE) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+
+	if(!onewire_match_rom(con, rom)) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+
+	for(i=0; i<to_tx; i++) {
+		onewire_write_u8(con, buffer[i]);
+	}
+	for(i=0; i<to_rx; i++) {
+		buffer[i] = onewire_read_u8(con);
+	}
+	cprint(con, "\x01", 1);
+	cprint(con, (char *)buffer, to_rx);
+}
+
+/*
+ * SWIO memory block access. Request is address (4 bytes) and number of
+ * 32-bit words (2 bytes), both little endian as for SWIO register access.
+ */
+static void bbio_onewire_swio_mem(t_hydra_console *con, uint8_t *buffer,
+				  uint8_t write)
+{
+	uint32_t address;
+	uint16_t nb_words;
+	bool status;
+
+	chnRead(con->sdu, (uint8_t *)&address, 4);
+	chnRead(con->sdu, (uint8_t *)&nb_words, 2);
+
+	if(nb_words > BBIO_ONEWIRE_MAX_WORDS) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+
+	if(write) {
+		chnRead(con->sdu, buffer, nb_words*4);
+		status = onewire_swio_write_mem(con, address,
+						(uint32_t *)buffer, nb_words);
+		cprint(con, status ? "\x01" : "\x00", 1);
+	} else {
+		status = onewire_swio_read_mem(con, address,
+					       (uint32_t *)buffer, nb_words);
+		if(status) {
+			cprint(con, "\x01", 1);
+			cprint(con, (char *)buffer, nb_words*4);
+		} else {
+			cprint(con, "\x00", 1);
+		}
+	}
+}
+
 void bbio_mode_onewire(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -43,6 +166,11 @@ void bbio_mode_onewire(t_hydra_console *con)
 	uint8_t rx_data[16], tx_data[16];
 	uint8_t data;
 	bsp_status_t status;
+	uint8_t *buffer = pool_alloc_bytes(BBIO_ONEWIRE_BUFFER_SIZE);
+
+	if(buffer == 0) {
+		return;
+	}
 
 	onewire_init_proto_default(con);
 	onewire_pin_init(con);
@@ -53,6 +181,7 @@ void bbio_mode_onewire(t_hydra_console *con)
 		if(chnRead(con->sdu, &bbio_subcommand, 1) == 1) {
 			switch(bbio_subcommand) {
 			case BBIO_RESET:
+				pool_free(buffer);
 				onewire_cleanup(con);
 				return;
 			case BBIO_MODE_ID:
@@ -65,6 +194,12 @@ void bbio_mode_onewire(t_hydra_console *con)
 				rx_data[0] = onewire_read_u8(con);
 				cprint(con, (char *)&rx_data[0], 1);
 				break;
+			case BBIO_ONEWIRE_SEARCH:
+				bbio_onewire_search(con, buffer);
+				break;
+			case BBIO_ONEWIRE_MATCH_READ:
+				bbio_onewire_match_read(con, buffer);
+				break;
 			case BBIO_ONEWIRE_SWIO_READ:
 				chnRead(con->sdu, &data, 1);
 				swio_data = onewire_swio_read_reg(con, data);
@@ -76,6 +211,12 @@ void bbio_mode_onewire(t_hydra_console *con)
 				onewire_swio_write_reg(con, data, swio_data);
 				cprint(con, "\x01", 1);
 				break;
+			case BBIO_ONEWIRE_SWIO_READ_MEM:
+				bbio_onewire_swio_mem(con, buffer, 0);
+				break;
+			case BBIO_ONEWIRE_SWIO_WRITE_MEM:
+				bbio_onewire_swio_mem(con, buffer, 1);
+				break;
 			default:
 				if ((bbio_subcommand & BBIO_AUX_MASK) == BBIO_AUX_MASK) {
 					cprintf(con, "%c", bbio_aux(con, bbio_subcommand));
@@ -112,5 +253,6 @@ void bbio_mode_onewire(t_hydra_console *con)
 			}
 		}
 	}
+	pool_free(buffer);
 	onewire_cleanup(con);
 }
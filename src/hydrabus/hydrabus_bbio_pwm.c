@@ -0,0 +1,151 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common.h"
+
+#include "hydrabus_bbio.h"
+#include "bsp_pwm.h"
+
+#include <string.h>
+
+#define BBIO_PWM_MAX_WORDS	(0x1000)
+#define BBIO_PWM_TIMEOUT	TIME_MS2I(1000)
+
+/*
+ * Multi-channel PWM. The host sends the frequency in Hz (4 bytes, big
+ * endian), a channel mask (1 byte, bit 0: PWM1 to bit 3: PWM4), the
+ * number of steps (2 bytes, big endian) and the mode (1 byte, 0: loop,
+ * 1: once). A mask of 0 stops all channels and is answered with 0x01.
+ *
+ * steps rows of duty cycles follow, one per channel of the mask (PWM1
+ * first) as 2 bytes big endian (0 to 0xFFFF = 100%). The device answers
+ * 0x01, the actual frequency and the resolution in steps per period
+ * (4 bytes each, big endian), or 0x00 on error.
+ *
+ * A single step sets static duty cycles which stay active on return.
+ * Longer sequences are loaded by DMA, one step per PWM period, and end
+ * with 0x01 once played (mode 1) or when BBIO_RESET is received.
+ */
+void bbio_pwm(t_hydra_console *con)
+{
+	uint32_t freq, steps, nb, i, j, res, duty_pc;
+	uint32_t *buffer = NULL;
+	uint8_t data[9], cmd=1, mask, once;
+
+	if(chnReadTimeout(con->sdu, data, 8, BBIO_PWM_TIMEOUT) != 8) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	freq = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+	mask = data[4] & ((1 << BSP_DEV_PWM_END) - 1);
+	steps = (data[5] << 8) | data[6];
+	once = data[7];
+
+	if(mask == 0) {
+		for(i = 0; i < BSP_DEV_PWM_END; i++) {
+			bsp_pwm_deinit(i);
+		}
+		cprint(con, "\x01", 1);
+		return;
+	}
+
+	nb = 0;
+	for(i = 0; i < BSP_DEV_PWM_END; i++) {
+		if(mask & (1 << i)) {
+			nb++;
+		}
+	}
+	/* The DMA rows may span all 4 channels */
+	if(steps == 0 || steps * BSP_DEV_PWM_END > BBIO_PWM_MAX_WORDS) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+	buffer = pool_alloc_bytes(BBIO_PWM_MAX_WORDS * sizeof(uint32_t));
+	if(buffer == NULL) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+
+	for(i = 0; i < steps * nb; i++) {
+		if(chnReadTimeout(con->sdu, data, 2, BBIO_PWM_TIMEOUT) != 2) {
+			cprint(con, "\x00", 1);
+			pool_free(buffer);
+			return;
+		}
+		buffer[i] = (data[0] << 8) | data[1];
+		if(buffer[i] == 0xffff) {
+			buffer[i] = BSP_PWM_DUTY_MAX;
+		}
+	}
+
+	for(i = 0; i < BSP_DEV_PWM_END; i++) {
+		if((mask & (1 << i)) && !bsp_pwm_is_active(i) &&
+		   bsp_pwm_init(i) != BSP_OK) {
+			cprint(con, "\x00", 1);
+			pool_free(buffer);
+			return;
+		}
+	}
+	if(bsp_pwm_set_frequency(freq) != BSP_OK) {
+		cprint(con, "\x00", 1);
+		pool_free(buffer);
+		return;
+	}
+
+	if(steps == 1) {
+		for(i = 0, j = 0; i < BSP_DEV_PWM_END; i++) {
+			if(mask & (1 << i)) {
+				bsp_pwm_set_duty(i, buffer[j++]);
+			}
+		}
+		pool_free(buffer);
+		buffer = NULL;
+	} else if(bsp_pwm_seq_start(mask, buffer, steps, BBIO_PWM_MAX_WORDS,
+				     once == 0) != BSP_OK) {
+		cprint(con, "\x00", 1);
+		pool_free(buffer);
+		return;
+	}
+
+	bsp_pwm_get(BSP_DEV_PWM1, &freq, &duty_pc);
+	res = bsp_pwm_get_resolution();
+	data[0] = 0x01;
+	data[1] = freq >> 24;
+	data[2] = freq >> 16;
+	data[3] = freq >> 8;
+	data[4] = freq;
+	data[5] = res >> 24;
+	data[6] = res >> 16;
+	data[7] = res >> 8;
+	data[8] = res;
+	cprint(con, (char *)data, 9);
+
+	if(buffer == NULL) {
+		return;
+	}
+
+	while(cmd != BBIO_RESET && !hydrabus_ubtn()) {
+		if(once && bsp_pwm_seq_done()) {
+			break;
+		}
+		chnReadTimeout(con->sdu, &cmd, 1, TIME_MS2I(1));
+	}
+	bsp_pwm_seq_stop();
+	pool_free(buffer);
+	cprint(con, "\x01", 1);
+}
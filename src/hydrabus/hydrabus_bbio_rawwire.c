@@ -28,6 +28,9 @@
 #include "hydrabus_mode_twowire.h"
 #include "hydrabus_mode_threewire.h"
 #include "hydrabus_bbio_aux.h"
+#include "profile.h"
+#include "bsp_gpio.h"
+#include "bsp_tim.h"
 
 
 const mode_rawwire_exec_t bbio_twowire = {
@@ -70,13 +73,187 @@ static void bbio_mode_id(t_hydra_console *con)
 	cprint(con, BBIO_RAWWIRE_HEADER, 4);
 }
 
+#define BBIO_RAWWIRE_BUF_LEN	0x1000
+
+/* Pin masks resolved once per stream to avoid per-bit indirections */
+typedef struct {
+	uint16_t clk;
+	uint16_t dout;
+	uint16_t din;
+	uint8_t din_pin;
+	uint8_t cpol;
+	uint8_t msb;
+	uint8_t twowire;
+} bbio_rawwire_pins_t;
+
+static void bbio_rawwire_get_pins(t_hydra_console *con, mode_rawwire_exec_t *mode,
+				  bbio_rawwire_pins_t *pins)
+{
+	rawwire_config_t *cfg = &con->mode->proto.config.rawwire;
+
+	pins->twowire = (mode->tim_init == bbio_twowire.tim_init);
+	pins->clk = 1 << cfg->clk_pin;
+	pins->din = 1 << cfg->sdi_pin;
+	pins->din_pin = cfg->sdi_pin;
+	pins->dout = pins->twowire ? pins->din : (1 << cfg->sdo_pin);
+	pins->cpol = cfg->clock_polarity;
+	pins->msb = (cfg->dev_bit_lsb_msb == DEV_FIRSTBIT_MSB);
+}
+
+/* Each edge waits for the next timer update event like twowire_clk_high() */
+static inline void bbio_rawwire_clk(bbio_rawwire_pins_t *pins, uint8_t level)
+{
+	bsp_tim_wait_irq();
+	if(level) {
+		GPIOB->BSRR.H.set = pins->clk;
+	} else {
+		GPIOB->BSRR.H.clear = pins->clk;
+	}
+	bsp_tim_clr_irq();
+}
+
+static inline uint8_t bbio_rawwire_bit(bbio_rawwire_pins_t *pins, uint8_t bit)
+{
+	uint8_t in;
+
+	if(bit) {
+		GPIOB->BSRR.H.set = pins->dout;
+	} else {
+		GPIOB->BSRR.H.clear = pins->dout;
+	}
+	bbio_rawwire_clk(pins, !pins->cpol);
+	in = (GPIOB->IDR & pins->din) ? 1 : 0;
+	bbio_rawwire_clk(pins, pins->cpol);
+	return in;
+}
+
+/* Bytes are replaced in place by the bits sampled on the data input */
+static void bbio_rawwire_bytes(bbio_rawwire_pins_t *pins, uint8_t *data, uint32_t len)
+{
+	uint32_t i;
+	uint8_t b, tx, rx, shift;
+
+	if(pins->twowire) {
+		bsp_gpio_mode_out(BSP_GPIO_PORTB, pins->din_pin);
+	}
+	for(i = 0; i < len; i++) {
+		tx = data[i];
+		rx = 0;
+		for(b = 0; b < 8; b++) {
+			shift = pins->msb ? 7 - b : b;
+			rx |= bbio_rawwire_bit(pins, (tx >> shift) & 1) << shift;
+		}
+		data[i] = rx;
+	}
+}
+
+/*
+ * One step per byte: data level, optional clock pulse and optional sample.
+ * Steps without clock last one clock period. On twowire, read steps
+ * release the shared data line.
+ */
+static void bbio_rawwire_vector(bbio_rawwire_pins_t *pins, uint8_t *steps,
+				uint32_t nb_steps, uint8_t *result)
+{
+	uint32_t i;
+	uint8_t step, in = 0, input = 0;
+
+	memset(result, 0, (nb_steps + 7) / 8);
+	if(pins->twowire) {
+		bsp_gpio_mode_out(BSP_GPIO_PORTB, pins->din_pin);
+	}
+	for(i = 0; i < nb_steps; i++) {
+		step = steps[i];
+		if(pins->twowire && (step & BBIO_RAWWIRE_STEP_READ) != input) {
+			input = step & BBIO_RAWWIRE_STEP_READ;
+			if(input) {
+				bsp_gpio_mode_in(BSP_GPIO_PORTB, pins->din_pin);
+			} else {
+				bsp_gpio_mode_out(BSP_GPIO_PORTB, pins->din_pin);
+			}
+		}
+		if(step & BBIO_RAWWIRE_STEP_DATA) {
+			GPIOB->BSRR.H.set = pins->dout;
+		} else {
+			GPIOB->BSRR.H.clear = pins->dout;
+		}
+		if(step & BBIO_RAWWIRE_STEP_CLOCK) {
+			bbio_rawwire_clk(pins, !pins->cpol);
+			in = (GPIOB->IDR & pins->din) ? 1 : 0;
+			bbio_rawwire_clk(pins, pins->cpol);
+		} else {
+			bsp_tim_wait_irq();
+			bsp_tim_clr_irq();
+			in = (GPIOB->IDR & pins->din) ? 1 : 0;
+			bsp_tim_wait_irq();
+			bsp_tim_clr_irq();
+		}
+		if(step & BBIO_RAWWIRE_STEP_READ) {
+			result[i / 8] |= in << (i % 8);
+		}
+	}
+	if(pins->twowire && input) {
+		bsp_gpio_mode_out(BSP_GPIO_PORTB, pins->din_pin);
+	}
+}
+
+/*
+ * Host sends format (1 byte), length (2 bytes BE, bytes or steps, up to
+ * 4096) then the payload. Answer is 0x01 + sampled bytes, or 0x01 + packed
+ * samples (bit n of byte n/8 for step n) for a bit-vector.
+ */
+static void bbio_rawwire_stream(t_hydra_console *con, mode_rawwire_exec_t *mode,
+				uint8_t *tx_buf, uint8_t *rx_buf)
+{
+	bbio_rawwire_pins_t pins;
+	uint32_t len, chunk;
+	uint8_t hdr[3];
+
+	chnRead(con->sdu, hdr, 3);
+	len = (hdr[1] << 8) | hdr[2];
+
+	if(len == 0 || len > BBIO_RAWWIRE_BUF_LEN ||
+	   (hdr[0] != BBIO_RAWWIRE_STREAM_BYTES && hdr[0] != BBIO_RAWWIRE_STREAM_VECTOR)) {
+		/* Drain the payload to stay in sync */
+		while(len > 0) {
+			chunk = (len > BBIO_RAWWIRE_BUF_LEN) ? BBIO_RAWWIRE_BUF_LEN : len;
+			chnRead(con->sdu, tx_buf, chunk);
+			len -= chunk;
+		}
+		cprint(con, "\x00", 1);
+		return;
+	}
+	chnRead(con->sdu, tx_buf, len);
+
+	bbio_rawwire_get_pins(con, mode, &pins);
+	if(hdr[0] == BBIO_RAWWIRE_STREAM_BYTES) {
+		bbio_rawwire_bytes(&pins, tx_buf, len);
+		cprint(con, "\x01", 1);
+		cprint(con, (char *)tx_buf, len);
+	} else {
+		bbio_rawwire_vector(&pins, tx_buf, len, rx_buf);
+		cprint(con, "\x01", 1);
+		cprint(con, (char *)rx_buf, (len + 7) / 8);
+	}
+}
+
 void bbio_mode_rawwire(t_hydra_console *con)
 {
 	uint8_t bbio_subcommand, i;
+	uint32_t start;
 	uint8_t rx_data[16], tx_data[16];
 	uint8_t data;
+	uint32_t freq;
 	mode_rawwire_exec_t curmode = bbio_twowire;
 	mode_config_proto_t* proto = &con->mode->proto;
+	uint8_t *stream_tx = pool_alloc_bytes(BBIO_RAWWIRE_BUF_LEN);
+	uint8_t *stream_rx = pool_alloc_bytes(BBIO_RAWWIRE_BUF_LEN);
+
+	if(stream_tx == 0 || stream_rx == 0) {
+		pool_free(stream_tx);
+		pool_free(stream_rx);
+		return;
+	}
 
 	curmode.init(con);
 	curmode.pin_init(con);
@@ -88,8 +265,11 @@ void bbio_mode_rawwire(t_hydra_console *con)
 
 	while (!hydrabus_ubtn()) {
 		if(chnRead(con->sdu, &bbio_subcommand, 1) == 1) {
+			start = prof_start();
 			switch(bbio_subcommand) {
 			case BBIO_RESET:
+				pool_free(stream_tx);
+				pool_free(stream_rx);
 				curmode.cleanup(con);
 				return;
 			case BBIO_MODE_ID:
@@ -127,6 +307,28 @@ void bbio_mode_rawwire(t_hydra_console *con)
 				curmode.data_high(con);
 				cprint(con, "\x01", 1);
 				break;
+			case BBIO_RAWWIRE_SET_FREQ:
+				chnRead(con->sdu, rx_data, 4);
+				freq = (rx_data[0] << 24) | (rx_data[1] << 16) |
+				       (rx_data[2] << 8) | rx_data[3];
+				/* Same limit as the console modes, 2-wire and 3-wire alike */
+				if(freq == 0 || freq > TWOWIRE_MAX_FREQ) {
+					cprint(con, "\x00", 1);
+					break;
+				}
+				/* Two timer update events per clock period */
+				freq = bsp_tim_set_freq(2 * freq) / 2;
+				proto->config.rawwire.dev_speed = freq;
+				rx_data[0] = 1;
+				rx_data[1] = freq >> 24;
+				rx_data[2] = freq >> 16;
+				rx_data[3] = freq >> 8;
+				rx_data[4] = freq;
+				cprint(con, (char *)rx_data, 5);
+				break;
+			case BBIO_RAWWIRE_STREAM:
+				bbio_rawwire_stream(con, &curmode, stream_tx, stream_rx);
+				break;
 			default:
 				if ((bbio_subcommand & BBIO_AUX_MASK) == BBIO_AUX_MASK) {
 					cprintf(con, "%c", bbio_aux(con, bbio_subcommand));
@@ -234,7 +436,10 @@ void bbio_mode_rawwire(t_hydra_console *con)
 					cprint(con, "\x01", 1);
 				}
 			}
+			prof_record(PROF_BBIO_RAWWIRE, start);
 		}
 	}
+	pool_free(stream_tx);
+	pool_free(stream_rx);
 	curmode.cleanup(con);
 }
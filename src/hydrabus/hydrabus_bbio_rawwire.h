@@ -18,6 +18,15 @@
 
 #define BBIO_RAWWIRE_HEADER	"RAW1"
 
+/* BBIO_RAWWIRE_STREAM formats */
+#define BBIO_RAWWIRE_STREAM_BYTES	0x00
+#define BBIO_RAWWIRE_STREAM_VECTOR	0x01
+
+/* Bit-vector step, one byte per step */
+#define BBIO_RAWWIRE_STEP_DATA		0b00000001 /* Data output level */
+#define BBIO_RAWWIRE_STEP_CLOCK		0b00000010 /* Clock pulse */
+#define BBIO_RAWWIRE_STEP_READ		0b00000100 /* Sample data input */
+
 void bbio_mode_rawwire(t_hydra_console *con);
 
 typedef struct mode_rawwire_exec_t {
@@ -0,0 +1,68 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2019 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common.h"
+
+#include "hydrabus_bbio.h"
+#include "bsp_rng.h"
+
+#include <string.h>
+
+#define BBIO_RNG_BUFFER_SIZE	0x1000
+
+/*
+ * Stream RNG output in blocks of BBIO_RNG_BUFFER_SIZE bytes, each
+ * preceded by 0x01, until BBIO_RESET is received. The stream ends with
+ * 0x00 followed by the bsp_rng_stats_t error counters (3 x uint32_t).
+ */
+void bbio_rng(t_hydra_console *con)
+{
+	bsp_rng_stats_t stats;
+	uint32_t *buffer0, *buffer1, *data;
+	uint8_t cmd=1;
+
+	buffer0 = pool_alloc_bytes(BBIO_RNG_BUFFER_SIZE);
+	buffer1 = pool_alloc_bytes(BBIO_RNG_BUFFER_SIZE);
+	if(buffer0 == NULL || buffer1 == NULL) {
+		pool_free(buffer0);
+		pool_free(buffer1);
+		memset(&stats, 0, sizeof(bsp_rng_stats_t));
+		cprint(con, "\x00", 1);
+		cprint(con, (char *)&stats, sizeof(bsp_rng_stats_t));
+		return;
+	}
+
+	bsp_rng_stream_start(buffer0, buffer1, BBIO_RNG_BUFFER_SIZE/4);
+	while(cmd != BBIO_RESET) {
+		data = bsp_rng_stream_get(TIME_MS2I(100));
+		if(data == NULL) {
+			break;
+		}
+		cprint(con, "\x01", 1);
+		cprint(con, (char *)data, BBIO_RNG_BUFFER_SIZE);
+		bsp_rng_stream_release();
+		chnReadTimeout(con->sdu, &cmd, 1, TIME_IMMEDIATE);
+	}
+	bsp_rng_stream_stop(&stats);
+
+	cprint(con, "\x00", 1);
+	cprint(con, (char *)&stats, sizeof(bsp_rng_stats_t));
+
+	pool_free(buffer0);
+	pool_free(buffer1);
+}
@@ -47,6 +47,256 @@ static void bbio_mode_id(t_hydra_console *con)
 	cprint(con, BBIO_SDIO_HEADER, 4);
 }
 
+#define SDIO_CMD_IO_RW_DIRECT	52
+#define SDIO_CMD_IO_RW_EXTENDED	53
+#define SDIO_CMD53_MAX_BLOCKS	511
+/* R5 COM_CRC_ERROR, ILLEGAL_COMMAND, ERROR, FUNCTION_NUMBER, OUT_OF_RANGE */
+#define SDIO_R5_ERRORS		0xCB00
+#define BBIO_SDIO_BUF_LEN	0x1000
+
+static uint32_t get_be32(uint8_t *buf)
+{
+	return (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+}
+
+static uint32_t bbio_sdio_r5(mode_config_proto_t* proto)
+{
+	uint32_t response[4];
+
+	bsp_sdio_read_response(proto->dev_num, response);
+	return response[0];
+}
+
+static bsp_status_t bbio_sdio_cmd52(mode_config_proto_t* proto, uint8_t flags,
+				    uint8_t function, uint32_t address,
+				    uint8_t *data, uint32_t *r5)
+{
+	bsp_status_t status;
+	uint32_t arg;
+
+	arg = ((flags & BBIO_SDIO_FLAG_WRITE) ? (1U << 31) : 0) |
+	      ((function & 0x7) << 28) |
+	      ((flags & BBIO_SDIO_FLAG_RAW) ? (1 << 27) : 0) |
+	      ((address & 0x1FFFF) << 9) | *data;
+
+	status = bsp_sdio_send_command(proto->dev_num, SDIO_CMD_IO_RW_DIRECT, arg, 1);
+	if(status != BSP_OK) {
+		return status;
+	}
+	*r5 = bbio_sdio_r5(proto);
+	*data = *r5 & 0xFF;
+	return (*r5 & SDIO_R5_ERRORS) ? BSP_ERROR : BSP_OK;
+}
+
+/*
+ * Run as many CMD53 as needed for length bytes: up to 511 blocks in block
+ * mode, up to 512 bytes in byte mode. The address follows the data when
+ * the incrementing address flag is set.
+ */
+static bsp_status_t bbio_sdio_cmd53(mode_config_proto_t* proto, uint8_t flags,
+				    uint8_t function, uint32_t *address,
+				    uint8_t *data, uint32_t length,
+				    uint16_t block_size, uint32_t *r5)
+{
+	bsp_status_t status = BSP_OK;
+	uint32_t arg, len, count;
+	uint8_t block = flags & BBIO_SDIO_FLAG_BLOCK;
+	uint8_t write = flags & BBIO_SDIO_FLAG_WRITE;
+
+	if(block && (block_size == 0 || (length % block_size) != 0)) {
+		return BSP_ERROR;
+	}
+
+	while(length > 0 && status == BSP_OK) {
+		if(block) {
+			count = length / block_size;
+			if(count > SDIO_CMD53_MAX_BLOCKS) {
+				count = SDIO_CMD53_MAX_BLOCKS;
+			}
+			len = count * block_size;
+		} else {
+			len = (length > BSP_SDIO_BLOCK_LEN) ? BSP_SDIO_BLOCK_LEN : length;
+			count = len & 0x1FF; /* 0 means 512 bytes */
+		}
+		arg = (write ? (1U << 31) : 0) |
+		      ((function & 0x7) << 28) |
+		      (block ? (1 << 27) : 0) |
+		      ((flags & BBIO_SDIO_FLAG_INCR) ? (1 << 26) : 0) |
+		      ((*address & 0x1FFFF) << 9) | count;
+
+		status = bsp_sdio_transfer(proto->dev_num, SDIO_CMD_IO_RW_EXTENDED,
+					   arg, 1, data, len,
+					   block ? block_size : 0, write);
+		*r5 = bbio_sdio_r5(proto);
+		if(status == BSP_OK && (*r5 & SDIO_R5_ERRORS)) {
+			status = BSP_ERROR;
+		}
+		if(flags & BBIO_SDIO_FLAG_INCR) {
+			*address += len;
+		}
+		data += len;
+		length -= len;
+	}
+	return status;
+}
+
+/*
+ * CMD53 of any length streamed through the pool buffer.
+ * Host sends flags, function, address (4 bytes BE), length (4 bytes BE) and
+ * block size (2 bytes BE) followed by the data on writes.
+ * Reads answer 0x01 + data for each buffer, then every transfer ends with
+ * 0x01 or 0x00 (error) + R5 flags byte.
+ */
+static void bbio_sdio_rw_extended(t_hydra_console *con, uint8_t *buf)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	bsp_status_t status = BSP_OK;
+	uint32_t address, length, len, max, r5 = 0;
+	uint16_t block_size;
+	uint8_t flags, function;
+	uint8_t hdr[12];
+
+	chnRead(con->sdu, hdr, 12);
+	flags = hdr[0];
+	function = hdr[1];
+	address = get_be32(&hdr[2]);
+	length = get_be32(&hdr[6]);
+	block_size = (hdr[10] << 8) | hdr[11];
+
+	/* Reads may overrun the end of the data by up to 3 bytes */
+	max = BBIO_SDIO_BUF_LEN - 4;
+	if(flags & BBIO_SDIO_FLAG_BLOCK) {
+		if(block_size == 0 || block_size > max) {
+			status = BSP_ERROR;
+		} else {
+			max -= max % block_size;
+		}
+	}
+
+	while(length > 0) {
+		len = (length > max) ? max : length;
+		if(flags & BBIO_SDIO_FLAG_WRITE) {
+			/* Always consume the data to stay in sync with the host */
+			chnRead(con->sdu, buf, len);
+			if(status == BSP_OK) {
+				status = bbio_sdio_cmd53(proto, flags, function, &address,
+							 buf, len, block_size, &r5);
+			}
+		} else {
+			if(status == BSP_OK) {
+				status = bbio_sdio_cmd53(proto, flags, function, &address,
+							 buf, len, block_size, &r5);
+			}
+			if(status != BSP_OK) {
+				break;
+			}
+			cprint(con, "\x01", 1);
+			cprint(con, (char *)buf, len);
+		}
+		length -= len;
+	}
+	hdr[0] = (status == BSP_OK) ? 1 : 0;
+	hdr[1] = (r5 >> 8) & 0xFF;
+	cprint(con, (char *)hdr, 2);
+}
+
+/*
+ * Run a list of CMD52/CMD53 in one USB transaction.
+ * Host sends the list size (2 bytes BE, up to 4096) then the list:
+ *  0x52, flags, function, address (4 bytes BE), data
+ *  0x53, flags, function, address (4 bytes BE), length (4 bytes BE),
+ *        block size (2 bytes BE), data on writes
+ * Execution stops on the first error. Answer is status (0x01 all done),
+ * number of executed entries (2 bytes BE), last R5 flags, output size
+ * (2 bytes BE) then the output: CMD52 data byte or CMD53 read data.
+ */
+static void bbio_sdio_queue(t_hydra_console *con, uint8_t *list, uint8_t *out)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	bsp_status_t status = BSP_OK;
+	uint32_t size, pos = 0, out_len = 0, address, length, r5 = 0;
+	uint16_t nb_done = 0, block_size;
+	uint8_t hdr[6];
+	uint8_t *entry;
+
+	chnRead(con->sdu, hdr, 2);
+	size = (hdr[0] << 8) | hdr[1];
+	if(size > BBIO_SDIO_BUF_LEN) {
+		/* Drain, nothing is executed */
+		while(size > 0) {
+			length = (size > BBIO_SDIO_BUF_LEN) ? BBIO_SDIO_BUF_LEN : size;
+			chnRead(con->sdu, list, length);
+			size -= length;
+		}
+		status = BSP_ERROR;
+	} else {
+		chnRead(con->sdu, list, size);
+	}
+
+	while(status == BSP_OK && pos < size) {
+		entry = &list[pos];
+		switch(entry[0]) {
+		case BBIO_SDIO_QUEUE_CMD52:
+			if(pos + 8 > size || out_len + 1 > BBIO_SDIO_BUF_LEN) {
+				status = BSP_ERROR;
+				break;
+			}
+			out[out_len] = entry[7];
+			status = bbio_sdio_cmd52(proto, entry[1], entry[2],
+						 get_be32(&entry[3]),
+						 &out[out_len], &r5);
+			out_len++;
+			pos += 8;
+			break;
+		case BBIO_SDIO_QUEUE_CMD53:
+			if(pos + 13 > size) {
+				status = BSP_ERROR;
+				break;
+			}
+			address = get_be32(&entry[3]);
+			length = get_be32(&entry[7]);
+			block_size = (entry[11] << 8) | entry[12];
+			pos += 13;
+			if(entry[1] & BBIO_SDIO_FLAG_WRITE) {
+				if(length > size - pos) {
+					status = BSP_ERROR;
+					break;
+				}
+				status = bbio_sdio_cmd53(proto, entry[1], entry[2],
+							 &address, &list[pos],
+							 length, block_size, &r5);
+				pos += length;
+			} else {
+				/* Reads may overrun the end of the data by up to 3 bytes */
+				if(out_len + 3 > BBIO_SDIO_BUF_LEN ||
+				   length > BBIO_SDIO_BUF_LEN - 3 - out_len) {
+					status = BSP_ERROR;
+					break;
+				}
+				status = bbio_sdio_cmd53(proto, entry[1], entry[2],
+							 &address, &out[out_len],
+							 length, block_size, &r5);
+				out_len += length;
+			}
+			break;
+		default:
+			status = BSP_ERROR;
+		}
+		if(status == BSP_OK) {
+			nb_done++;
+		}
+	}
+
+	hdr[0] = (status == BSP_OK) ? 1 : 0;
+	hdr[1] = nb_done >> 8;
+	hdr[2] = nb_done & 0xFF;
+	hdr[3] = (r5 >> 8) & 0xFF;
+	hdr[4] = out_len >> 8;
+	hdr[5] = out_len & 0xFF;
+	cprint(con, (char *)hdr, 6);
+	cprint(con, (char *)out, out_len);
+}
+
 void bbio_mode_sdio(t_hydra_console *con)
 {
 	uint8_t bbio_subcommand;
@@ -122,6 +372,12 @@ void bbio_mode_sdio(t_hydra_console *con)
 						cprint(con, (char *)rx_data, BSP_SDIO_BLOCK_LEN);
 					}
 					break;
+				case BBIO_SDIO_IO_RW_EXTENDED:
+					bbio_sdio_rw_extended(con, rx_data);
+					break;
+				case BBIO_SDIO_QUEUE:
+					bbio_sdio_queue(con, tx_data, rx_data);
+					break;
 				case BBIO_SDIO_WRITE:
 					chnRead(con->sdu, &cmd_id, 1);
 					chnRead(con->sdu, (uint8_t *)&cmd_arg, 4);
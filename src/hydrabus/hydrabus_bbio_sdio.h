@@ -20,5 +20,15 @@
 
 #define BBIO_SDIO_HEADER		"SDI1"
 
+/* CMD52/CMD53 flags */
+#define BBIO_SDIO_FLAG_WRITE		0b00000001
+#define BBIO_SDIO_FLAG_BLOCK		0b00000010 /* CMD53 block mode */
+#define BBIO_SDIO_FLAG_INCR		0b00000100 /* CMD53 incrementing address */
+#define BBIO_SDIO_FLAG_RAW		0b00001000 /* CMD52 read after write */
+
+/* Queue entries */
+#define BBIO_SDIO_QUEUE_CMD52		0x52
+#define BBIO_SDIO_QUEUE_CMD53		0x53
+
 void bbio_sdio_init_proto_default(t_hydra_console *con);
 void bbio_mode_sdio(t_hydra_console *con);
@@ -26,9 +26,12 @@
 #include "hydrabus_bbio.h"
 #include "hydrabus_bbio_smartcard.h"
 #include "bsp_smartcard.h"
+#include "hydrabus_smartcard_iso7816.h"
 
 #define SMARTCARD_DEFAULT_SPEED (9408)
 
+static smartcard_iso7816_t iso7816;
+
 void bbio_smartcard_init_proto_default(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -62,6 +65,8 @@ void bbio_mode_smartcard(t_hydra_console *con)
 	uint8_t to_read;
 	uint32_t dev_speed=0;
 	uint32_t final_baudrate;
+	int result;
+	uint8_t rsp_len[2];
 	bsp_status_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
@@ -73,6 +78,7 @@ void bbio_mode_smartcard(t_hydra_console *con)
 
 	bbio_smartcard_init_proto_default(con);
 	bsp_smartcard_init(proto->dev_num, proto);
+	smartcard_iso7816_reset(&iso7816);
 
 	bbio_mode_id(con);
 
@@ -193,8 +199,38 @@ void bbio_mode_smartcard(t_hydra_console *con)
 				bsp_smartcard_set_rst(proto->dev_num, 1);
 				to_read = 33;
 				bsp_smartcard_read_u8(proto->dev_num, rx_data, &to_read, TIME_MS2I(500));
-				cprint(con, (char *)&i, 1);
-				cprint(con, (char *)rx_data, i);
+				cprint(con, (char *)&to_read, 1);
+				cprint(con, (char *)rx_data, to_read);
+				smartcard_iso7816_parse_atr(&iso7816, rx_data, to_read);
+				break;
+			case BBIO_SMARTCARD_PPS:
+				status = smartcard_iso7816_pps(proto, &iso7816);
+				if(status == BSP_OK) {
+					cprint(con, "\x01", 1);
+				} else {
+					cprint(con, "\x00", 1);
+				}
+				break;
+			case BBIO_SMARTCARD_APDU:
+				chnRead(con->sdu, rx_data, 2);
+				to_tx = (rx_data[0] << 8) + rx_data[1];
+				if (to_tx > 4096) {
+					cprint(con, "\x00", 1);
+					break;
+				}
+				chnRead(con->sdu, tx_data, to_tx);
+				result = smartcard_iso7816_apdu(proto, &iso7816,
+								tx_data, to_tx,
+								rx_data, 4096);
+				if(result < 0) {
+					cprint(con, "\x00", 1);
+					break;
+				}
+				rsp_len[0] = result >> 8;
+				rsp_len[1] = result & 0xff;
+				cprint(con, "\x01", 1);
+				cprint(con, (char *)rsp_len, 2);
+				cprint(con, (char *)rx_data, result);
 				break;
 			default:
 				if ((bbio_subcommand & BBIO_AUX_MASK) == BBIO_AUX_MASK) {
@@ -27,6 +27,7 @@
 #include "hydrabus_bbio_spi.h"
 #include "bsp_spi.h"
 #include "hydrabus_bbio_aux.h"
+#include "profile.h"
 
 void bbio_spi_init_proto_default(t_hydra_console *con)
 {
@@ -95,6 +96,7 @@ static void bbio_mode_id(t_hydra_console *con)
 void bbio_mode_spi(t_hydra_console *con)
 {
 	uint8_t bbio_subcommand;
+	uint32_t start;
 	uint32_t to_rx, to_tx, i;
 	uint8_t *tx_data = pool_alloc_bytes(0x1000); // 4096 bytes
 	uint8_t *rx_data = pool_alloc_bytes(0x1000); // 4096 bytes
@@ -115,6 +117,7 @@ void bbio_mode_spi(t_hydra_console *con)
 
 	while (!hydrabus_ubtn()) {
 		if(chnRead(con->sdu, &bbio_subcommand, 1) == 1) {
+			start = prof_start();
 			switch(bbio_subcommand) {
 			case BBIO_RESET:
 				pool_free(tx_data);
@@ -308,6 +311,7 @@ void bbio_mode_spi(t_hydra_console *con)
 					cprint(con, "\x01", 1);
 				}
 			}
+			prof_record(PROF_BBIO_SPI, start);
 		}
 	}
 	pool_free(tx_data);
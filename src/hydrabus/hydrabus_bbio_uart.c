@@ -26,7 +26,9 @@
 #include "hydrabus_bbio.h"
 #include "hydrabus_bbio_uart.h"
 #include "bsp_uart.h"
+#include "hydrabus_uart_autobaud.h"
 #include "hydrabus_bbio_aux.h"
+#include "profile.h"
 
 void bbio_uart_init_proto_default(t_hydra_console *con)
 {
@@ -72,6 +74,37 @@ static THD_FUNCTION(uart_reader_thread, arg)
 	}
 }
 
+/*
+ * Parameter: window timeout in ms (u16 BE)
+ * Reply: 0x01, baudrate (u32 BE), data bits (0 if unknown), parity,
+ * stop bits, confidence in %. The UART is configured with the result.
+ * 0x00 if no bit time was found.
+ */
+static void bbio_uart_autobaud(t_hydra_console *con)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uart_autobaud_t res;
+	uint8_t buf[8];
+
+	chnRead(con->sdu, buf, 2);
+	if(uart_autobaud((buf[0] << 8) + buf[1], &res) != BSP_OK ||
+	   uart_autobaud_apply(proto, &res) != BSP_OK) {
+		cprint(con, "\x00", 1);
+		return;
+	}
+
+	buf[0] = 1;
+	buf[1] = res.baudrate >> 24;
+	buf[2] = res.baudrate >> 16;
+	buf[3] = res.baudrate >> 8;
+	buf[4] = res.baudrate & 0xff;
+	buf[5] = res.data_bits;
+	buf[6] = res.parity;
+	buf[7] = res.stop_bits;
+	cprint(con, (char *)buf, 8);
+	cprint(con, (char *)&res.confidence, 1);
+}
+
 static void bbio_mode_id(t_hydra_console *con)
 {
 	cprint(con, BBIO_UART_HEADER, 4);
@@ -81,6 +114,7 @@ void bbio_mode_uart(t_hydra_console *con)
 {
 	uint32_t baud_rate;
 	uint8_t bbio_subcommand, i;
+	uint32_t start;
 	uint8_t rx_data[4];
 	uint8_t tx_data;
 	uint8_t data;
@@ -95,6 +129,7 @@ void bbio_mode_uart(t_hydra_console *con)
 
 	while (!hydrabus_ubtn()) {
 		if(chnRead(con->sdu, &bbio_subcommand, 1) == 1) {
+			start = prof_start();
 			switch(bbio_subcommand) {
 			case BBIO_RESET:
 				bsp_uart_deinit(proto->dev_num);
@@ -123,6 +158,9 @@ void bbio_mode_uart(t_hydra_console *con)
 				}
 				cprint(con, "\x01", 1);
 				break;
+			case BBIO_UART_AUTOBAUD:
+				bbio_uart_autobaud(con);
+				break;
 			case BBIO_UART_BAUD_RATE:
 				chnRead(con->sdu, rx_data, 4);
 				baud_rate =(rx_data[0]<<24) + (rx_data[1]<<16);
@@ -249,6 +287,7 @@ void bbio_mode_uart(t_hydra_console *con)
 					cprint(con, "\x01", 1);
 				}
 			}
+			prof_record(PROF_BBIO_UART, start);
 		}
 	}
 	if(rthread != NULL)
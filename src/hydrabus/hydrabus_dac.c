@@ -21,14 +21,24 @@
 #include "hydrabus.h"
 #include "bsp.h"
 #include "bsp_dac.h"
+#include "microsd.h"
 
 #include <string.h>
 
+/* Arbitrary waveform buffer size (pool), synthesis and upload defaults */
+#define DAC_WAVE_MAX_SAMPLES	(4096)
+#define DAC_WAVE_SAMPLES	(100)
+#define DAC_WAVE_RATE		(100000)
+#define DAC_WAVE_UPLOAD_TIMEOUT	TIME_MS2I(10000)
+
 static const char *dac_channel_names[] = {
 	"DAC1",
 	"DAC2"
 };
 
+/* Waveform played by each DAC, kept until exit or another output is set */
+static uint16_t *dac_wave_buf[BSP_DEV_DAC_END];
+
 #define PRINT_DAC_VAL_DIGITS	(1000)
 void print_dac_12bits_val(t_hydra_console *con, uint32_t val_raw_adc)
 {
@@ -70,6 +80,143 @@ static int dac_write(t_hydra_console *con, bsp_dev_dac_t dev_num, int16_t raw_va
 	return TRUE;
 }
 
+static void dac_wave_free(bsp_dev_dac_t dev_num)
+{
+	if (dac_wave_buf[dev_num] == NULL)
+		return;
+
+	bsp_dac_wave_stop(dev_num, NULL);
+	pool_free(dac_wave_buf[dev_num]);
+	dac_wave_buf[dev_num] = NULL;
+}
+
+/* sin(2*pi*x) for x in [0, 1[, 7th order Taylor series on a quarter period */
+static float dac_sin(float x)
+{
+	float r, r2, sign;
+
+	sign = 1.0f;
+	if (x >= 0.5f) {
+		x -= 0.5f;
+		sign = -1.0f;
+	}
+	if (x > 0.25f)
+		x = 0.5f - x;
+	r = x * 6.2831853f;
+	r2 = r * r;
+
+	return sign * r * (1.0f - r2 / 6.0f * (1.0f - r2 / 20.0f * (1.0f - r2 / 42.0f)));
+}
+
+/* One period of a full scale sine, square or ramp */
+static void dac_wave_synth(uint16_t *buf, uint32_t nb_samples, int shape)
+{
+	uint32_t i;
+	float v;
+
+	for (i = 0; i < nb_samples; i++) {
+		switch (shape) {
+		case T_SINE:
+			v = 2047.5f + 2047.5f * dac_sin((float)i / nb_samples);
+			buf[i] = (v > 4095.0f) ? 4095 : (uint16_t)(v + 0.5f);
+			break;
+		case T_SQUARE:
+			buf[i] = (i < nb_samples / 2) ? 4095 : 0;
+			break;
+		case T_RAMP:
+			buf[i] = (i * 4095) / (nb_samples - 1);
+			break;
+		}
+	}
+}
+
+/* Raw little endian 12bits samples from a microSD file, returns the count */
+static uint32_t dac_wave_load(t_hydra_console *con, char *filename, uint16_t *buf)
+{
+	uint32_t nb_samples;
+	FIL fp;
+
+	if (!file_open(&fp, filename, 'r')) {
+		cprintf(con, "Failed to open file %s\r\n", filename);
+		return 0;
+	}
+	nb_samples = file_read(&fp, (uint8_t *)buf, DAC_WAVE_MAX_SAMPLES * 2) / 2;
+	if (!f_eof(&fp))
+		cprintf(con, "File truncated to %d samples\r\n", DAC_WAVE_MAX_SAMPLES);
+	file_close(&fp);
+
+	return nb_samples;
+}
+
+/* Raw little endian 12bits samples sent on the console right after the command */
+static uint32_t dac_wave_upload(t_hydra_console *con, uint16_t *buf, uint32_t nb_samples)
+{
+	uint32_t nb_bytes;
+
+	cprintf(con, "Send %d bytes\r\n", nb_samples * 2);
+	nb_bytes = chnReadTimeout(con->sdu, (uint8_t *)buf, nb_samples * 2,
+				  DAC_WAVE_UPLOAD_TIMEOUT);
+	if (nb_bytes != nb_samples * 2) {
+		cprintf(con, "Timeout: received %d bytes\r\n", nb_bytes);
+		return 0;
+	}
+
+	return nb_samples;
+}
+
+static void dac_wave(t_hydra_console *con, bsp_dev_dac_t dev_num, int shape,
+		     char *filename, uint32_t nb_samples, uint32_t rate)
+{
+	bsp_status_t status;
+	uint32_t freq_mhz;
+	uint16_t *buf;
+
+	if (nb_samples < 2 || nb_samples > DAC_WAVE_MAX_SAMPLES) {
+		cprintf(con, "Samples must be between 2 and %d\r\n", DAC_WAVE_MAX_SAMPLES);
+		return;
+	}
+	if (rate == 0 || rate > BSP_DAC_WAVE_MAX_RATE) {
+		cprintf(con, "Rate must be between 1 and %d Hz\r\n", BSP_DAC_WAVE_MAX_RATE);
+		return;
+	}
+
+	dac_wave_free(dev_num);
+	buf = pool_alloc_bytes(DAC_WAVE_MAX_SAMPLES * 2);
+	if (buf == NULL) {
+		cprintf(con, "Not enough memory\r\n");
+		return;
+	}
+
+	switch (shape) {
+	case T_LOAD:
+		nb_samples = dac_wave_load(con, filename, buf);
+		break;
+	case T_UPLOAD:
+		nb_samples = dac_wave_upload(con, buf, nb_samples);
+		break;
+	default:
+		dac_wave_synth(buf, nb_samples, shape);
+		break;
+	}
+	if (nb_samples < 2) {
+		pool_free(buf);
+		return;
+	}
+
+	status = bsp_dac_wave_start(dev_num, buf, nb_samples, &rate);
+	if (status != BSP_OK) {
+		cprintf(con, "bsp_dac_wave_start error: %d\r\n", status);
+		pool_free(buf);
+		return;
+	}
+	dac_wave_buf[dev_num] = buf;
+
+	freq_mhz = (rate * 1000) / nb_samples;
+	cprintf(con, "%s %d samples at %d Hz, period %d.%03d Hz\r\n",
+		dac_channel_names[dev_num], nb_samples, rate,
+		freq_mhz / 1000, freq_mhz % 1000);
+}
+
 int cmd_dac(t_hydra_console *con, t_tokenline_parsed *p)
 {
 	int num_sources, t;
@@ -77,6 +224,9 @@ int cmd_dac(t_hydra_console *con, t_tokenline_parsed *p)
 	float volt;
 	bsp_dev_dac_t dev_num;
 	bsp_status_t status;
+	uint32_t nb_samples, rate;
+	char *filename;
+	int shape;
 
 	if (p->tokens[1] == 0)
 		return FALSE;
@@ -86,6 +236,10 @@ int cmd_dac(t_hydra_console *con, t_tokenline_parsed *p)
 	num_sources = 0;
 	value = -1;
 	volt = 0.0f;
+	nb_samples = DAC_WAVE_SAMPLES;
+	rate = DAC_WAVE_RATE;
+	filename = NULL;
+	shape = 0;
 	while (p->tokens[t]) {
 		switch (p->tokens[t++]) {
 		case T_DAC1:
@@ -108,6 +262,7 @@ int cmd_dac(t_hydra_console *con, t_tokenline_parsed *p)
 				return TRUE;
 			}
 			cprintf(con, "%s Raw\r\n", dac_channel_names[dev_num]);
+			dac_wave_free(dev_num);
 			dac_write(con, dev_num, value, volt);
 			break;
 		case T_VOLT:
@@ -122,6 +277,7 @@ int cmd_dac(t_hydra_console *con, t_tokenline_parsed *p)
 				return TRUE;
 			}
 			cprintf(con, "%s Volt\r\n", dac_channel_names[dev_num]);
+			dac_wave_free(dev_num);
 			dac_write(con, dev_num, value, volt);
 			break;
 		case T_TRIANGLE:
@@ -130,6 +286,7 @@ int cmd_dac(t_hydra_console *con, t_tokenline_parsed *p)
 				return TRUE;
 			}
 			cprintf(con, "%s (Triangle Out)\r\n", dac_channel_names[dev_num]);
+			dac_wave_free(dev_num);
 			if ((status = bsp_dac_init(dev_num)) != BSP_OK) {
 				cprintf(con, "bsp_dac_init error: %d\r\n", status);
 				return FALSE;
@@ -142,24 +299,55 @@ int cmd_dac(t_hydra_console *con, t_tokenline_parsed *p)
 				return TRUE;
 			}
 			cprintf(con, "%s (Noise Out)\r\n", dac_channel_names[dev_num]);
+			dac_wave_free(dev_num);
 			if ((status = bsp_dac_init(dev_num)) != BSP_OK) {
 				cprintf(con, "bsp_dac_init error: %d\r\n", status);
 				return FALSE;
 			}
 			bsp_dac_noise(dev_num);
 			break;
+		case T_SINE:
+		case T_SQUARE:
+		case T_RAMP:
+		case T_UPLOAD:
+			shape = p->tokens[t - 1];
+			break;
+		case T_LOAD:
+			shape = T_LOAD;
+			t += 1;
+			filename = p->buf + p->tokens[t++];
+			break;
+		case T_SAMPLES:
+			t += 1;
+			memcpy(&nb_samples, p->buf + p->tokens[t++], sizeof(uint32_t));
+			break;
+		case T_RATE:
+			t += 1;
+			memcpy(&rate, p->buf + p->tokens[t++], sizeof(uint32_t));
+			break;
 		case T_EXIT:
 			if (num_sources == 0) {
+				dac_wave_free(BSP_DEV_DAC1);
+				dac_wave_free(BSP_DEV_DAC2);
 				bsp_dac_deinit(BSP_DEV_DAC1);
 				bsp_dac_deinit(BSP_DEV_DAC2);
 				bsp_dac_disable();
 			} else {
+				dac_wave_free(dev_num);
 				bsp_dac_deinit(dev_num);
 			}
 			return TRUE;
 		}
 	}
 
+	if (shape != 0) {
+		if (!num_sources) {
+			cprintf(con, "Specify at least one source.\r\n");
+			return TRUE;
+		}
+		dac_wave(con, dev_num, shape, filename, nb_samples, rate);
+	}
+
 	return TRUE;
 }
 
@@ -0,0 +1,309 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common.h"
+#include "bsp_gpio.h"
+#include "hydrabus_mode_flash.h"
+#include "hydrabus_flash_nand.h"
+#include <string.h>
+
+#define NAND_CMD_READ		0x00
+#define NAND_CMD_READ_START	0x30
+#define NAND_CMD_PROGRAM	0x80
+#define NAND_CMD_PROGRAM_START	0x10
+#define NAND_CMD_STATUS		0x70
+#define NAND_CMD_READ_PARAM	0xEC
+
+/* Program is around 1ms, read 100us, keep a large margin */
+#define NAND_BUSY_TIMEOUT_MS	(50)
+
+#define ONFI_CRC_INIT		0x4F4E
+#define ONFI_CRC_POLY		0x8005
+#define ONFI_PARAM_COPIES	(3)
+
+/* WE# High to RE# low, ALE to data start - Around 70ns */
+static void delay_tWHR(void)
+{
+	__asm__("nop");
+	__asm__("nop");
+	__asm__("nop");
+	__asm__("nop");
+	__asm__("nop");
+	__asm__("nop");
+	__asm__("nop");
+	__asm__("nop");
+	__asm__("nop");
+	__asm__("nop");
+	__asm__("nop");
+	__asm__("nop");
+}
+
+/* WE# High to R/B# low - Up to 100ns */
+static void delay_tWB(void)
+{
+	delay_tWHR();
+	delay_tWHR();
+}
+
+static bool nand_wait_ready(void)
+{
+	systime_t start;
+
+	delay_tWB();
+	start = chVTGetSystemTimeX();
+	while(!(GPIOB->IDR & (1 << FLASH_READ_BUSY))) {
+		if(chVTTimeElapsedSinceX(start) > TIME_MS2I(NAND_BUSY_TIMEOUT_MS)) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/*
+ * Data phase with the bus direction set once, RE#/WE# toggled directly on
+ * the port to keep the cycle time close to the chip limits.
+ */
+static void nand_read_data(uint8_t *data, uint32_t len)
+{
+	uint32_t i;
+
+	flash_data_mode_input();
+	for(i = 0; i < len; i++) {
+		GPIOB->BSRR.H.clear = (1 << FLASH_READ_ENABLE);
+		/* tREA */
+		__asm__("nop");
+		__asm__("nop");
+		__asm__("nop");
+		__asm__("nop");
+		data[i] = GPIOC->IDR & 0xff;
+		GPIOB->BSRR.H.set = (1 << FLASH_READ_ENABLE);
+	}
+}
+
+static void nand_write_data(uint8_t *data, uint32_t len)
+{
+	uint32_t i;
+
+	flash_data_mode_output();
+	for(i = 0; i < len; i++) {
+		GPIOB->BSRR.H.clear = (1 << FLASH_WRITE_ENABLE);
+		GPIOC->BSRR.W = data[i] | ((uint8_t)~data[i] << 16);
+		/* tDS */
+		__asm__("nop");
+		__asm__("nop");
+		GPIOB->BSRR.H.set = (1 << FLASH_WRITE_ENABLE);
+	}
+	GPIOC->BSRR.H.clear = 0xff;
+}
+
+static void nand_address(t_hydra_console *con, flash_nand_t *nand,
+			 uint32_t column, uint32_t page)
+{
+	uint8_t i;
+
+	for(i = 0; i < nand->col_cycles; i++) {
+		flash_write_address(con, column >> (8 * i));
+	}
+	for(i = 0; i < nand->row_cycles; i++) {
+		flash_write_address(con, page >> (8 * i));
+	}
+}
+
+static uint8_t nand_status(t_hydra_console *con)
+{
+	flash_write_command(con, NAND_CMD_STATUS);
+	delay_tWHR();
+	return flash_read_value(con);
+}
+
+static uint16_t onfi_crc16(uint8_t *data, uint32_t len)
+{
+	uint16_t crc = ONFI_CRC_INIT;
+	uint32_t i;
+	uint8_t j;
+
+	for(i = 0; i < len; i++) {
+		crc ^= data[i] << 8;
+		for(j = 0; j < 8; j++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ ONFI_CRC_POLY : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+static uint32_t get_le32(uint8_t *buf)
+{
+	return buf[0] | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24);
+}
+
+static void onfi_string(char *dst, uint8_t *src, uint8_t len)
+{
+	memcpy(dst, src, len);
+	dst[len] = 0;
+	while(len > 0 && dst[len - 1] == ' ') {
+		dst[--len] = 0;
+	}
+}
+
+/**
+  * @brief  Read the ONFI parameter page and fill the chip geometry.
+  * @param  con: Console.
+  * @param  nand: Geometry to fill.
+  * @param  param: FLASH_NAND_PARAM_PAGE_SIZE bytes buffer, receives the
+  * first valid copy of the parameter page.
+  * @retval TRUE if a copy with a valid CRC was found.
+  */
+bool flash_nand_read_param_page(t_hydra_console *con, flash_nand_t *nand, uint8_t *param)
+{
+	uint8_t i;
+	bool found = FALSE;
+
+	nand->valid = FALSE;
+
+	flash_chip_en_low();
+	flash_write_command(con, NAND_CMD_READ_PARAM);
+	flash_write_address(con, 0x00);
+	if(nand_wait_ready()) {
+		delay_tWHR();
+		/* Redundant copies follow each other, keep the first good one */
+		for(i = 0; i < ONFI_PARAM_COPIES && !found; i++) {
+			nand_read_data(param, FLASH_NAND_PARAM_PAGE_SIZE);
+			if(memcmp(param, "ONFI", 4) == 0 &&
+			   onfi_crc16(param, 254) == (param[254] | (param[255] << 8))) {
+				found = TRUE;
+			}
+		}
+	}
+	flash_chip_en_high();
+
+	if(!found) {
+		return FALSE;
+	}
+
+	onfi_string(nand->manufacturer, &param[32], 12);
+	onfi_string(nand->model, &param[44], 20);
+	nand->page_size = get_le32(&param[80]);
+	nand->spare_size = param[84] | (param[85] << 8);
+	nand->pages_per_block = get_le32(&param[92]);
+	nand->blocks = get_le32(&param[96]) * param[100];
+	nand->row_cycles = param[101] & 0x0f;
+	nand->col_cycles = param[101] >> 4;
+	nand->valid = TRUE;
+
+	return TRUE;
+}
+
+/**
+  * @brief  Read a page and its spare area.
+  * @param  con: Console.
+  * @param  nand: Chip geometry.
+  * @param  page: Page (row address).
+  * @param  data: page_size + spare_size bytes buffer.
+  * @param  status: Status register after the array read (on-die ECC flags).
+  * @retval FALSE if the chip stayed busy.
+  */
+bool flash_nand_read_page(t_hydra_console *con, flash_nand_t *nand,
+			  uint32_t page, uint8_t *data, uint8_t *status)
+{
+	bool ready;
+
+	flash_chip_en_low();
+	flash_write_command(con, NAND_CMD_READ);
+	nand_address(con, nand, 0, page);
+	flash_write_command(con, NAND_CMD_READ_START);
+	ready = nand_wait_ready();
+	if(ready) {
+		*status = nand_status(con);
+		/* Back to data output after the status read */
+		flash_write_command(con, NAND_CMD_READ);
+		delay_tWHR();
+		nand_read_data(data, nand->page_size + nand->spare_size);
+	}
+	flash_chip_en_high();
+
+	return ready;
+}
+
+/**
+  * @brief  Program a page and its spare area.
+  * @param  con: Console.
+  * @param  nand: Chip geometry.
+  * @param  page: Page (row address).
+  * @param  data: page_size + spare_size bytes to program.
+  * @param  status: Status register at the end of programming.
+  * @retval TRUE if the chip reported success.
+  */
+bool flash_nand_program_page(t_hydra_console *con, flash_nand_t *nand,
+			     uint32_t page, uint8_t *data, uint8_t *status)
+{
+	bool ready;
+
+	*status = NAND_STATUS_FAIL;
+
+	flash_chip_en_low();
+	flash_write_command(con, NAND_CMD_PROGRAM);
+	nand_address(con, nand, 0, page);
+	/* tADL */
+	delay_tWHR();
+	nand_write_data(data, nand->page_size + nand->spare_size);
+	flash_write_command(con, NAND_CMD_PROGRAM_START);
+	ready = nand_wait_ready();
+	if(ready) {
+		*status = nand_status(con);
+	}
+	flash_chip_en_high();
+
+	return ready && !(*status & NAND_STATUS_FAIL);
+}
+
+/**
+  * @brief  Check the factory bad block marker (first spare byte of the
+  * first and last page of the block).
+  * @param  con: Console.
+  * @param  nand: Chip geometry.
+  * @param  block: Block number.
+  * @param  bad: Set to TRUE if a marker is not 0xFF.
+  * @retval FALSE if the chip stayed busy.
+  */
+bool flash_nand_is_bad_block(t_hydra_console *con, flash_nand_t *nand,
+			     uint32_t block, bool *bad)
+{
+	uint32_t pages[2];
+	uint8_t marker, i;
+	bool ready = TRUE;
+
+	pages[0] = block * nand->pages_per_block;
+	pages[1] = pages[0] + nand->pages_per_block - 1;
+	*bad = FALSE;
+
+	for(i = 0; i < 2 && ready && !*bad; i++) {
+		flash_chip_en_low();
+		flash_write_command(con, NAND_CMD_READ);
+		nand_address(con, nand, nand->page_size, pages[i]);
+		flash_write_command(con, NAND_CMD_READ_START);
+		ready = nand_wait_ready();
+		if(ready) {
+			delay_tWHR();
+			nand_read_data(&marker, 1);
+			*bad = (marker != 0xFF);
+		}
+		flash_chip_en_high();
+	}
+
+	return ready;
+}
@@ -0,0 +1,50 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_FLASH_NAND_H_
+#define _HYDRABUS_FLASH_NAND_H_
+
+#include "common.h"
+
+#define FLASH_NAND_PARAM_PAGE_SIZE	(256)
+
+/* Status register, also set by on-die ECC chips on uncorrectable reads */
+#define NAND_STATUS_FAIL	(1 << 0)
+
+/* Chip geometry from the ONFI parameter page */
+typedef struct {
+	bool valid;
+	char manufacturer[13];
+	char model[21];
+	uint32_t page_size;	/* Data bytes per page */
+	uint32_t spare_size;	/* Spare bytes per page */
+	uint32_t pages_per_block;
+	uint32_t blocks;	/* Blocks of all LUNs */
+	uint8_t col_cycles;
+	uint8_t row_cycles;
+} flash_nand_t;
+
+bool flash_nand_read_param_page(t_hydra_console *con, flash_nand_t *nand, uint8_t *param);
+bool flash_nand_read_page(t_hydra_console *con, flash_nand_t *nand,
+			  uint32_t page, uint8_t *data, uint8_t *status);
+bool flash_nand_program_page(t_hydra_console *con, flash_nand_t *nand,
+			     uint32_t page, uint8_t *data, uint8_t *status);
+bool flash_nand_is_bad_block(t_hydra_console *con, flash_nand_t *nand,
+			     uint32_t block, bool *bad);
+
+#endif /* _HYDRABUS_FLASH_NAND_H_ */
@@ -25,11 +25,108 @@
 
 #include <string.h>
 
+#define FREQ_CAPTURE_BUFFER_SIZE	0x1000
+#define FREQ_CAPTURE_MAX_GATE		10000
+
+static void print_freq_stats(t_hydra_console *con, bsp_freq_stats_t *stats)
+{
+	if(stats->edges == 0) {
+		cprintf(con, "No edge\r\n");
+		return;
+	}
+	cprintf(con, "Frequency : %d.%03dHz\tDuty : %d.%d%%\t",
+		stats->freq, stats->freq_frac,
+		stats->duty / 10, stats->duty % 10);
+	cprintf(con, "Period min/max/stddev : %dns/%dns/%dps\t",
+		stats->period_min, stats->period_max,
+		stats->period_stddev);
+	cprintf(con, "Edges : %d", stats->edges);
+	if(stats->errors > 0) {
+		cprintf(con, "\tOverflows : %d", stats->errors);
+	}
+	cprintf(con, "\r\n");
+}
+
+static int freq_continuous(t_hydra_console *con, bsp_dev_freq_t dev_num,
+			   uint32_t gate, int count, int continuous)
+{
+	bsp_freq_stats_t stats;
+	uint16_t *buffer;
+	systime_t start;
+
+	buffer = pool_alloc_bytes(FREQ_CAPTURE_BUFFER_SIZE);
+	if(buffer == NULL) {
+		cprintf(con, "Unable to allocate buffer\r\n");
+		return FALSE;
+	}
+
+	cprintf(con, "Interrupt by pressing user button.\r\n");
+	if(bsp_freq_capture_start(dev_num, buffer,
+				  FREQ_CAPTURE_BUFFER_SIZE / 4) != BSP_OK) {
+		cprintf(con, "No signal\r\n");
+		bsp_freq_deinit(dev_num);
+		pool_free(buffer);
+		return TRUE;
+	}
+
+	/* Drop what was captured during setup */
+	bsp_freq_capture_get_stats(dev_num, &stats);
+	while(!hydrabus_ubtn()) {
+		start = chVTGetSystemTimeX();
+		while(chVTTimeElapsedSinceX(start) < TIME_MS2I(gate)) {
+			bsp_freq_capture_poll(dev_num);
+			chThdSleepMilliseconds(1);
+		}
+		bsp_freq_capture_get_stats(dev_num, &stats);
+		print_freq_stats(con, &stats);
+		if(!continuous && --count <= 0)
+			break;
+	}
+
+	bsp_freq_deinit(dev_num);
+	pool_free(buffer);
+	return TRUE;
+}
+
 int cmd_freq(t_hydra_console *con, t_tokenline_parsed *p)
 {
-	uint32_t frequency, duty;
+	uint32_t frequency, duty, gate;
 	mode_config_proto_t* proto = &con->mode->proto;
-	(void) p;
+	int t, count, continuous, capture;
+
+	t = 1;
+	gate = 1000;
+	count = 1;
+	continuous = FALSE;
+	capture = FALSE;
+	while (p->tokens[t]) {
+		switch (p->tokens[t++]) {
+		case T_PERIOD:
+			t += 1;
+			memcpy(&gate, p->buf + p->tokens[t++], sizeof(uint32_t));
+			capture = TRUE;
+			break;
+		case T_SAMPLES:
+			t += 1;
+			memcpy(&count, p->buf + p->tokens[t++], sizeof(int));
+			capture = TRUE;
+			break;
+		case T_CONTINUOUS:
+			continuous = TRUE;
+			capture = TRUE;
+			break;
+		}
+	}
+
+	if(capture) {
+		if(gate == 0 || gate > FREQ_CAPTURE_MAX_GATE) {
+			cprintf(con, "Gate time must be between 1 and %d msec\r\n",
+				FREQ_CAPTURE_MAX_GATE);
+			return TRUE;
+		}
+		return freq_continuous(con, proto->dev_num, gate, count,
+				       continuous);
+	}
 
 	bsp_freq_get_values(proto->dev_num, &frequency, &duty);
 	cprintf(con, "Frequency : %dHz\r\n", frequency);
@@ -40,4 +137,3 @@ int cmd_freq(t_hydra_console *con, t_tokenline_parsed *p)
 
 	return TRUE;
 }
-
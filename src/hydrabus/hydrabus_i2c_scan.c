@@ -0,0 +1,255 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common.h"
+#include "bsp_i2c_master.h"
+#include "hydrabus_i2c_scan.h"
+#include <string.h>
+
+/* Lowest speed used to probe, faster configured speeds are kept */
+#define I2C_SCAN_SPEED		BSP_I2C_SPEED_400KHZ
+
+/* 10-bit address first byte: 11110 A9 A8 R/W */
+#define I2C_TENBIT_PREFIX	(0xf0)
+
+static const uint32_t i2c_scan_speeds[] = {
+	50000, 100000, 400000, 1000000
+};
+
+/*
+ * Known ID registers. A device matches when the register read at one of
+ * the addresses of the entry, masked, equals the expected value.
+ * Values of 2 bytes are read MSB first.
+ */
+typedef struct {
+	uint8_t addr_min;
+	uint8_t addr_max;
+	uint8_t reg;
+	uint8_t len;
+	uint16_t mask;
+	uint16_t value;
+	const char *name;
+} i2c_scan_sig_t;
+
+static const i2c_scan_sig_t i2c_scan_sigs[] = {
+	{ 0x0d, 0x0d, 0x0d, 1, 0x00ff, 0x00ff, "QMC5883L" },
+	{ 0x18, 0x19, 0x0f, 1, 0x00ff, 0x0033, "LIS3DH/LIS2DH12" },
+	{ 0x1c, 0x1d, 0x0d, 1, 0x00ff, 0x002a, "MMA8452Q" },
+	{ 0x1c, 0x1e, 0x0f, 1, 0x00ff, 0x003d, "LIS3MDL" },
+	{ 0x1d, 0x1d, 0x00, 1, 0x00ff, 0x00e5, "ADXL345" },
+	{ 0x1e, 0x1e, 0x0a, 1, 0x00ff, 0x0048, "HMC5883L" },
+	{ 0x29, 0x29, 0xc0, 1, 0x00ff, 0x00ee, "VL53L0X" },
+	{ 0x36, 0x36, 0x08, 2, 0xfff0, 0x0010, "MAX17048" },
+	{ 0x39, 0x39, 0x92, 1, 0x00ff, 0x00ab, "APDS-9960" },
+	{ 0x40, 0x40, 0xff, 2, 0xffff, 0x1050, "HDC1080" },
+	{ 0x40, 0x4f, 0xff, 2, 0xfff0, 0x2260, "INA226" },
+	{ 0x48, 0x4b, 0x0f, 2, 0x0fff, 0x0117, "TMP117" },
+	{ 0x53, 0x53, 0x00, 1, 0x00ff, 0x00e5, "ADXL345" },
+	{ 0x57, 0x57, 0xff, 1, 0x00ff, 0x0015, "MAX30102" },
+	{ 0x5a, 0x5b, 0x20, 1, 0x00ff, 0x0081, "CCS811" },
+	{ 0x5c, 0x5d, 0x0f, 1, 0x00ff, 0x00b1, "LPS22HB" },
+	{ 0x5c, 0x5d, 0x0f, 1, 0x00ff, 0x00bd, "LPS25H" },
+	{ 0x68, 0x69, 0x75, 1, 0x00ff, 0x0068, "MPU-6050" },
+	{ 0x68, 0x69, 0x75, 1, 0x00ff, 0x0070, "MPU-6500" },
+	{ 0x68, 0x69, 0x75, 1, 0x00ff, 0x0071, "MPU-9250" },
+	{ 0x68, 0x69, 0x00, 1, 0x00ff, 0x00ea, "ICM-20948" },
+	{ 0x6a, 0x6b, 0x0f, 1, 0x00ff, 0x0069, "LSM6DS3" },
+	{ 0x6a, 0x6b, 0x0f, 1, 0x00ff, 0x006a, "LSM6DSL" },
+	{ 0x6a, 0x6b, 0x0f, 1, 0x00ff, 0x006c, "LSM6DSO" },
+	{ 0x6a, 0x6b, 0x0f, 1, 0x00ff, 0x00d4, "L3GD20" },
+	{ 0x6a, 0x6b, 0x0f, 1, 0x00ff, 0x00d7, "L3GD20H" },
+	{ 0x76, 0x77, 0xd0, 1, 0x00ff, 0x0055, "BMP180" },
+	{ 0x76, 0x77, 0xd0, 1, 0x00ff, 0x0058, "BMP280" },
+	{ 0x76, 0x77, 0xd0, 1, 0x00ff, 0x0060, "BME280" },
+	{ 0x76, 0x77, 0xd0, 1, 0x00ff, 0x0061, "BME680" },
+};
+#define I2C_SCAN_SIG_NB (sizeof(i2c_scan_sigs) / sizeof(i2c_scan_sigs[0]))
+
+const char *i2c_scan_sig_name(uint8_t sig)
+{
+	if (sig >= I2C_SCAN_SIG_NB)
+		return "";
+	return i2c_scan_sigs[sig].name;
+}
+
+/* START (or repeated START) then address byte, returns the ACK */
+static bsp_status_t i2c_scan_probe(bsp_dev_i2c_t dev, uint8_t addr_byte, uint8_t *ack)
+{
+	bsp_i2c_start(dev);
+	return bsp_i2c_master_write_u8(dev, addr_byte, ack);
+}
+
+static bsp_status_t i2c_scan_read_reg(bsp_dev_i2c_t dev, uint8_t addr,
+				      uint8_t reg, uint8_t len, uint16_t *value)
+{
+	bsp_status_t status;
+	uint8_t ack, data;
+	int i;
+
+	*value = 0;
+	status = i2c_scan_probe(dev, addr << 1, &ack);
+	if (status == BSP_OK && ack)
+		status = bsp_i2c_master_write_u8(dev, reg, &ack);
+	if (status == BSP_OK && ack)
+		status = i2c_scan_probe(dev, (addr << 1) | 1, &ack);
+	if (status == BSP_OK && ack) {
+		for (i = 0; i < len; i++) {
+			status = bsp_i2c_master_read_u8(dev, &data);
+			if (status != BSP_OK)
+				break;
+			/* NACK the last byte */
+			status = bsp_i2c_read_ack(dev, (i < len - 1) ? TRUE : FALSE);
+			if (status != BSP_OK)
+				break;
+			*value = (*value << 8) | data;
+		}
+	}
+	bsp_i2c_stop(dev);
+
+	if (status == BSP_OK && !ack)
+		status = BSP_ERROR;
+	return status;
+}
+
+static void i2c_scan_identify(bsp_dev_i2c_t dev, uint8_t addr, i2c_scan_t *scan)
+{
+	const i2c_scan_sig_t *sig;
+	uint16_t value;
+	int last_reg, last_len;
+	bool valid;
+	unsigned int i;
+
+	/* Several entries share the same register, read it only once */
+	last_reg = -1;
+	last_len = 0;
+	valid = FALSE;
+	value = 0;
+	for (i = 0; i < I2C_SCAN_SIG_NB; i++) {
+		sig = &i2c_scan_sigs[i];
+		if (addr < sig->addr_min || addr > sig->addr_max)
+			continue;
+		if (sig->reg != last_reg || sig->len != last_len) {
+			last_reg = sig->reg;
+			last_len = sig->len;
+			valid = (i2c_scan_read_reg(dev, addr, sig->reg, sig->len,
+						   &value) == BSP_OK);
+		}
+		if (valid && (value & sig->mask) == sig->value) {
+			scan->id[scan->nb_id].addr = addr;
+			scan->id[scan->nb_id].sig = i;
+			scan->nb_id++;
+			return;
+		}
+	}
+}
+
+/*
+ * Only the first byte of 10-bit addresses is probed for the 4 groups,
+ * the 256 second bytes of a group are probed when any device of the group
+ * acknowledged it.
+ */
+static bsp_status_t i2c_scan_tenbit(bsp_dev_i2c_t dev, i2c_scan_t *scan)
+{
+	bsp_status_t status;
+	uint8_t ack, prefix;
+	int hi, lo;
+
+	for (hi = 0; hi < 4; hi++) {
+		prefix = I2C_TENBIT_PREFIX | (hi << 1);
+		status = i2c_scan_probe(dev, prefix, &ack);
+		if (status != BSP_OK)
+			return status;
+		if (!ack)
+			continue;
+
+		for (lo = 0; lo < 256; lo++) {
+			status = i2c_scan_probe(dev, prefix, &ack);
+			if (status == BSP_OK && ack)
+				status = bsp_i2c_master_write_u8(dev, lo, &ack);
+			if (status != BSP_OK)
+				return status;
+			if (ack && scan->nb_tenbit < I2C_SCAN_TENBIT_MAX)
+				scan->tenbit[scan->nb_tenbit++] = (hi << 8) | lo;
+		}
+	}
+	return BSP_OK;
+}
+
+/** \brief Probe all the 7-bit addresses and identify known devices.
+ *
+ * Addresses are probed back to back with repeated STARTs at 400kHz, or at
+ * the configured speed when faster, and the configured speed is restored.
+ *
+ * \param proto mode_config_proto_t*: I2C configuration.
+ * \param tenbit bool: also probe the 10-bit addresses.
+ * \param scan i2c_scan_t*: result of the scan.
+ * \return bsp_status_t: BSP_ERROR if the bus is held low, BSP_TIMEOUT on
+ * clock stretching timeout.
+ *
+ */
+bsp_status_t i2c_scan(mode_config_proto_t *proto, bool tenbit, i2c_scan_t *scan)
+{
+	bsp_dev_i2c_t dev = proto->dev_num;
+	bsp_status_t status;
+	systime_t start;
+	uint8_t speed, ack;
+	int addr;
+
+	memset(scan, 0, sizeof(i2c_scan_t));
+
+	if (!bsp_i2c_bus_idle(dev))
+		return BSP_ERROR;
+
+	speed = proto->config.i2c.dev_speed;
+	if (speed < I2C_SCAN_SPEED)
+		speed = I2C_SCAN_SPEED;
+	bsp_i2c_master_set_speed(dev, speed);
+	scan->speed = i2c_scan_speeds[speed];
+
+	start = chVTGetSystemTimeX();
+
+	/* Skip address 0x00 (general call) and >= 0x78 (10-bit address prefix) */
+	status = BSP_OK;
+	for (addr = 0x01; addr < 0x78; addr++) {
+		status = i2c_scan_probe(dev, addr << 1, &ack);
+		if (status != BSP_OK)
+			break;
+		if (ack) {
+			scan->ack[addr >> 3] |= 1 << (addr & 7);
+			scan->nb_ack++;
+		}
+	}
+
+	if (status == BSP_OK && tenbit)
+		status = i2c_scan_tenbit(dev, scan);
+	bsp_i2c_stop(dev);
+
+	if (status == BSP_OK) {
+		for (addr = 0x01; addr < 0x78; addr++) {
+			if (scan->nb_id == I2C_SCAN_ID_MAX)
+				break;
+			if (i2c_scan_acked(scan, addr))
+				i2c_scan_identify(dev, addr, scan);
+		}
+	}
+
+	scan->time_us = TIME_I2US(chVTTimeElapsedSinceX(start));
+	bsp_i2c_master_set_speed(dev, proto->config.i2c.dev_speed);
+
+	return status;
+}
@@ -0,0 +1,51 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_I2C_SCAN_H_
+#define _HYDRABUS_I2C_SCAN_H_
+
+#include "common.h"
+#include "bsp.h"
+
+#define I2C_SCAN_TENBIT_MAX	(16)
+#define I2C_SCAN_ID_MAX		(16)
+
+/* Device identified from the signature table */
+typedef struct {
+	uint8_t addr;
+	uint8_t sig;	/* Index in the signature table */
+} i2c_scan_id_t;
+
+typedef struct {
+	uint8_t ack[16];	/* Bitmap of the 7-bit addresses which ACKed */
+	uint8_t nb_ack;
+	uint8_t nb_tenbit;
+	uint16_t tenbit[I2C_SCAN_TENBIT_MAX];
+	uint8_t nb_id;
+	i2c_scan_id_t id[I2C_SCAN_ID_MAX];
+	uint32_t speed;		/* Bus speed used by the scan in Hz */
+	uint32_t time_us;
+} i2c_scan_t;
+
+#define i2c_scan_acked(scan, addr) \
+	(((scan)->ack[(addr) >> 3] & (1 << ((addr) & 7))) != 0)
+
+bsp_status_t i2c_scan(mode_config_proto_t *proto, bool tenbit, i2c_scan_t *scan);
+const char *i2c_scan_sig_name(uint8_t sig);
+
+#endif /* _HYDRABUS_I2C_SCAN_H_ */
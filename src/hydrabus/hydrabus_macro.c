@@ -0,0 +1,656 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Bus transaction macros.
+ *
+ * A macro is a console sequence such as "[0x03 0 0 0 r:16]" compiled once
+ * into an operation list, then run from the list without going through
+ * the command parser. Consecutive bytes are merged into a single write.
+ * Runs are paced on absolute DWT cycle counter deadlines so the period
+ * does not drift with the time spent in the transaction or printing.
+ *
+ * Modes providing the *_buf callbacks run the transfers silently and the
+ * bytes read are printed once the run is over, other modes print as usual.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ch.h"
+#include "hal.h"
+
+#include "ff.h"
+
+#include "common.h"
+#include "tokenline.h"
+#include "hydrabus.h"
+#include "bsp.h"
+#include "microsd.h"
+#include "hydrabus_mode.h"
+#include "hydrabus_aux.h"
+#include "hydrabus_macro.h"
+
+#define MACRO_NB	(8)
+#define MACRO_OPS	(32)
+#define MACRO_DATA	(64)
+#define MACRO_SRC	(96)
+
+/* Longest period, keeps deadlines within half the cycle counter range */
+#define MACRO_PERIOD_MAX_US	(10000000)
+/* Longest total delay of consecutive '&' and '%' */
+#define MACRO_DELAY_MAX_US	(10000000)
+/* Sleep until this close to a deadline, then spin */
+#define MACRO_SPIN_US		(500)
+
+#define MAYBE_CALL(x) { if (x) x(con); }
+
+enum {
+	MACRO_OP_START,
+	MACRO_OP_STOP,
+	MACRO_OP_WRITE,		/* len bytes at data + arg, wwr set for write/read */
+	MACRO_OP_READ,		/* len bytes */
+	MACRO_OP_DELAY,		/* arg usec */
+	MACRO_OP_AUX,		/* arg value */
+	MACRO_OP_CLKH,		/* raw operations are repeated arg times */
+	MACRO_OP_CLKL,
+	MACRO_OP_DATH,
+	MACRO_OP_DATL,
+	MACRO_OP_DATS,
+	MACRO_OP_CLK,
+	MACRO_OP_BITR,
+};
+
+typedef struct {
+	uint8_t type;
+	uint8_t wwr;
+	uint16_t len;
+	uint32_t arg;
+} macro_op_t;
+
+typedef struct {
+	uint8_t nb_ops;
+	uint8_t nb_data;
+	uint16_t nb_rx;
+	macro_op_t ops[MACRO_OPS];
+	uint8_t data[MACRO_DATA];
+	char src[MACRO_SRC];
+} macro_t;
+
+static macro_t macros[MACRO_NB];
+
+static const char str_macro_undefined[] = "Macro %d is not defined.\r\n";
+
+static macro_op_t *macro_add_op(macro_t *m, uint8_t type)
+{
+	macro_op_t *op;
+
+	if (m->nb_ops == MACRO_OPS)
+		return NULL;
+	op = &m->ops[m->nb_ops++];
+	op->type = type;
+	op->wwr = 0;
+	op->len = 0;
+	op->arg = 0;
+
+	return op;
+}
+
+static macro_op_t *macro_last_op(macro_t *m, uint8_t type)
+{
+	if (m->nb_ops == 0 || m->ops[m->nb_ops - 1].type != type)
+		return NULL;
+	return &m->ops[m->nb_ops - 1];
+}
+
+static uint32_t macro_strtoul(const char *s, const char **end)
+{
+	uint32_t value;
+
+	if (s[0] == '0' && (s[1] == 'b' || s[1] == 'B'))
+		value = strtoul(s + 2, (char **)end, 2);
+	else
+		value = strtoul(s, (char **)end, 0);
+
+	return value;
+}
+
+static int macro_word(const char *s, const char *word)
+{
+	int len = strlen(word);
+
+	return !strncmp(s, word, len) && !isalnum((int)s[len]) && s[len] != '-';
+}
+
+/* Returns NULL on success, or an error message */
+static const char *macro_compile(macro_t *m, const char *src)
+{
+	macro_op_t *op;
+	const char *s;
+	uint32_t value, count, i;
+	uint8_t type, wwr;
+
+	m->nb_ops = 0;
+	m->nb_data = 0;
+	m->nb_rx = 0;
+	m->src[0] = 0;
+	if (strlen(src) >= sizeof(m->src))
+		return "Macro too long";
+
+	wwr = 0;
+	value = 0;
+	s = src;
+	while (*s) {
+		if (*s == ' ' || *s == '\t') {
+			s++;
+			continue;
+		}
+
+		if (isdigit((int)*s)) {
+			value = macro_strtoul(s, &s);
+			if (value > 0xff)
+				return "Please specify one byte at a time";
+			type = MACRO_OP_WRITE;
+		} else if (macro_word(s, "r") || macro_word(s, "read")) {
+			s += (s[1] == 'e') ? 4 : 1;
+			type = MACRO_OP_READ;
+		} else if (macro_word(s, "aux-on") || macro_word(s, "aux-off")) {
+			value = (s[5] == 'n');
+			s += value ? 6 : 7;
+			type = MACRO_OP_AUX;
+		} else {
+			switch (*s++) {
+			case '[':
+			case '{':
+				type = MACRO_OP_START;
+				wwr = (s[-1] == '{');
+				break;
+			case ']':
+			case '}':
+				type = MACRO_OP_STOP;
+				wwr = 0;
+				break;
+			case '&':
+				type = MACRO_OP_DELAY;
+				value = 1;
+				break;
+			case '%':
+				type = MACRO_OP_DELAY;
+				value = 1000;
+				break;
+			case '/':
+				type = MACRO_OP_CLKH;
+				break;
+			case '\\':
+				type = MACRO_OP_CLKL;
+				break;
+			case '-':
+				type = MACRO_OP_DATH;
+				break;
+			case '_':
+				type = MACRO_OP_DATL;
+				break;
+			case '!':
+				type = MACRO_OP_DATS;
+				break;
+			case '^':
+				type = MACRO_OP_CLK;
+				break;
+			case '.':
+				type = MACRO_OP_BITR;
+				break;
+			default:
+				return "Unknown command";
+			}
+		}
+
+		count = 1;
+		if (*s == ':') {
+			s++;
+			if (!isdigit((int)*s))
+				return "Invalid repeat count";
+			count = macro_strtoul(s, &s);
+			if (count == 0)
+				return "Invalid repeat count";
+		}
+
+		switch (type) {
+		case MACRO_OP_WRITE:
+			if (count > (uint32_t)(MACRO_DATA - m->nb_data))
+				return "Too many bytes to write";
+			if (wwr && count > (uint32_t)(HYDRABUS_MODE_STREAM_CHUNK - m->nb_rx))
+				return "Too many bytes to read";
+			op = macro_last_op(m, MACRO_OP_WRITE);
+			if (op == NULL || op->wwr != wwr) {
+				op = macro_add_op(m, MACRO_OP_WRITE);
+				if (op == NULL)
+					break;
+				op->wwr = wwr;
+				op->arg = m->nb_data;
+			}
+			for (i = 0; i < count; i++)
+				m->data[m->nb_data++] = value;
+			op->len += count;
+			if (wwr)
+				m->nb_rx += count;
+			break;
+		case MACRO_OP_READ:
+			if (count > (uint32_t)(HYDRABUS_MODE_STREAM_CHUNK - m->nb_rx))
+				return "Too many bytes to read";
+			op = macro_last_op(m, MACRO_OP_READ);
+			if (op == NULL)
+				op = macro_add_op(m, MACRO_OP_READ);
+			if (op == NULL)
+				break;
+			op->len += count;
+			m->nb_rx += count;
+			break;
+		case MACRO_OP_DELAY:
+			op = macro_last_op(m, MACRO_OP_DELAY);
+			if (op == NULL)
+				op = macro_add_op(m, MACRO_OP_DELAY);
+			if (op == NULL)
+				break;
+			if (count > (MACRO_DELAY_MAX_US - op->arg) / value)
+				return "Delay too long";
+			op->arg += value * count;
+			break;
+		case MACRO_OP_START:
+		case MACRO_OP_STOP:
+			op = macro_add_op(m, type);
+			if (op == NULL)
+				break;
+			op->wwr = wwr;
+			break;
+		case MACRO_OP_AUX:
+			op = macro_add_op(m, type);
+			if (op == NULL)
+				break;
+			op->arg = value;
+			break;
+		default:
+			op = macro_add_op(m, type);
+			if (op == NULL)
+				break;
+			op->arg = count;
+			break;
+		}
+		if (op == NULL)
+			return "Too many operations";
+	}
+	strcpy(m->src, src);
+
+	return NULL;
+}
+
+/* Keeps the previous definition if the new one does not compile */
+static const char *macro_define(int num, const char *src)
+{
+	const char *error;
+	macro_t m;
+
+	error = macro_compile(&m, src);
+	if (error == NULL)
+		macros[num] = m;
+
+	return error;
+}
+
+static uint32_t macro_write(t_hydra_console *con, const macro_op_t *op,
+			    uint8_t *tx, uint8_t *rx, uint32_t *pos)
+{
+	const mode_exec_t *exec = con->mode->exec;
+	uint32_t status;
+
+	status = BSP_ERROR;
+	if (op->wwr) {
+		if (exec->write_read_buf != NULL) {
+			status = exec->write_read_buf(con, tx, rx + *pos, op->len);
+			*pos += op->len;
+		} else if (exec->write_read != NULL) {
+			status = exec->write_read(con, tx,
+						  con->mode->proto.buffer_rx,
+						  op->len);
+		}
+	} else {
+		if (exec->write_buf != NULL)
+			status = exec->write_buf(con, tx, op->len);
+		else if (exec->write != NULL)
+			status = exec->write(con, tx, op->len);
+	}
+
+	return status;
+}
+
+static uint32_t macro_read(t_hydra_console *con, const macro_op_t *op,
+			   uint8_t *rx, uint32_t *pos)
+{
+	const mode_exec_t *exec = con->mode->exec;
+	uint32_t status, done, nb;
+
+	if (exec->read_buf != NULL) {
+		nb = op->len;
+		status = exec->read_buf(con, rx + *pos, &nb);
+		*pos += nb;
+		return status;
+	}
+
+	status = BSP_ERROR;
+	for (done = 0; done < op->len && exec->read != NULL; done += nb) {
+		nb = MIN(op->len - done, UINT8_MAX);
+		status = exec->read(con, con->mode->proto.buffer_rx, nb);
+		if (status != HYDRABUS_MODE_STATUS_OK)
+			break;
+	}
+
+	return status;
+}
+
+/* Runs the operation list once, *pos is set to the number of bytes in rx */
+static uint32_t macro_exec(t_hydra_console *con, const macro_t *m,
+			   uint8_t *rx, uint32_t *pos)
+{
+	const mode_exec_t *exec = con->mode->exec;
+	const macro_op_t *op;
+	uint32_t status, i, j;
+
+	*pos = 0;
+	status = HYDRABUS_MODE_STATUS_OK;
+	for (i = 0; i < m->nb_ops && status == HYDRABUS_MODE_STATUS_OK; i++) {
+		op = &m->ops[i];
+		switch (op->type) {
+		case MACRO_OP_START:
+			con->mode->proto.wwr = op->wwr;
+			MAYBE_CALL(exec->start);
+			break;
+		case MACRO_OP_STOP:
+			con->mode->proto.wwr = 0;
+			MAYBE_CALL(exec->stop);
+			break;
+		case MACRO_OP_WRITE:
+			status = macro_write(con, op, (uint8_t *)m->data + op->arg,
+					     rx, pos);
+			break;
+		case MACRO_OP_READ:
+			status = macro_read(con, op, rx, pos);
+			break;
+		case MACRO_OP_DELAY:
+			DelayUs(op->arg);
+			break;
+		case MACRO_OP_AUX:
+			cmd_aux_write(0, op->arg);
+			break;
+		default:
+			for (j = 0; j < op->arg; j++) {
+				switch (op->type) {
+				case MACRO_OP_CLKH:
+					MAYBE_CALL(exec->clkh);
+					break;
+				case MACRO_OP_CLKL:
+					MAYBE_CALL(exec->clkl);
+					break;
+				case MACRO_OP_DATH:
+					MAYBE_CALL(exec->dath);
+					break;
+				case MACRO_OP_DATL:
+					MAYBE_CALL(exec->datl);
+					break;
+				case MACRO_OP_DATS:
+					MAYBE_CALL(exec->dats);
+					break;
+				case MACRO_OP_CLK:
+					MAYBE_CALL(exec->clk);
+					break;
+				case MACRO_OP_BITR:
+					MAYBE_CALL(exec->bitr);
+					break;
+				}
+			}
+			break;
+		}
+	}
+
+	return status;
+}
+
+static void macro_wait(uint32_t deadline)
+{
+	const int32_t cycles_us = STM32_HCLK / 1000000;
+	int32_t remaining;
+
+	while ((remaining = (int32_t)(deadline - bsp_get_cyclecounter())) > 0) {
+		if (remaining > (MACRO_SPIN_US * 2) * cycles_us)
+			chThdSleepMicroseconds((remaining / cycles_us) - MACRO_SPIN_US);
+	}
+}
+
+static void macro_run(t_hydra_console *con, int num, uint32_t repeat,
+		      uint32_t period_us)
+{
+	macro_t *m = &macros[num];
+	uint32_t status, period, next, runs, late, pos, i;
+	uint8_t *rx;
+
+	rx = NULL;
+	if (m->nb_rx > 0) {
+		rx = pool_alloc_bytes(m->nb_rx);
+		if (rx == NULL) {
+			cprintf(con, "Not enough memory.\r\n");
+			return;
+		}
+	}
+
+	if (repeat != 1)
+		cprintf(con, "Interrupt by pressing user button.\r\n");
+
+	period = period_us * (STM32_HCLK / 1000000);
+	runs = 0;
+	late = 0;
+	next = bsp_get_cyclecounter();
+	while ((repeat == 0 || runs < repeat) && !hydrabus_ubtn()) {
+		status = macro_exec(con, m, rx, &pos);
+		runs++;
+
+		if (pos > 0) {
+			cprintf(con, hydrabus_mode_str_mul_read);
+			for (i = 0; i < pos; i++)
+				cprintf(con, hydrabus_mode_str_mul_value_u8, rx[i]);
+			cprintf(con, hydrabus_mode_str_mul_br);
+		}
+		if (status != HYDRABUS_MODE_STATUS_OK) {
+			cprintf(con, "Macro %d error:%d\r\n", num, status);
+			break;
+		}
+
+		if (period == 0 || runs == repeat)
+			continue;
+		next += period;
+		if ((int32_t)(bsp_get_cyclecounter() - next) >= 0) {
+			/* Overrun, restart the period from now */
+			late++;
+			next = bsp_get_cyclecounter();
+			continue;
+		}
+		macro_wait(next);
+	}
+
+	if (repeat != 1)
+		cprintf(con, "%d runs, %d late\r\n", runs, late);
+	pool_free(rx);
+}
+
+static void macro_show(t_hydra_console *con)
+{
+	int i;
+
+	for (i = 0; i < MACRO_NB; i++) {
+		if (macros[i].src[0] == 0)
+			continue;
+		cprintf(con, "%d: %s (%d operations)\r\n", i, macros[i].src,
+			macros[i].nb_ops);
+	}
+}
+
+static void macro_save(t_hydra_console *con, char *filename)
+{
+	char line[MACRO_SRC + 8];
+	FRESULT err;
+	FIL fp;
+	UINT bw;
+	int i, len;
+
+	if (!is_fs_ready() && mount() != 0) {
+		cprintf(con, "SD card not ready.\r\n");
+		return;
+	}
+
+	err = f_open(&fp, filename, FA_WRITE | FA_CREATE_ALWAYS);
+	if (err != FR_OK) {
+		cprintf(con, "Failed to open file %s: %d\r\n", filename, err);
+		return;
+	}
+	for (i = 0; i < MACRO_NB && err == FR_OK; i++) {
+		if (macros[i].src[0] == 0)
+			continue;
+		len = snprintf(line, sizeof(line), "%d %s\n", i, macros[i].src);
+		err = f_write(&fp, line, len, &bw);
+	}
+	if (f_close(&fp) != FR_OK || err != FR_OK)
+		cprintf(con, "Failed to write file %s: %d\r\n", filename, err);
+}
+
+static void macro_load(t_hydra_console *con, char *filename)
+{
+	char line[MACRO_SRC + 8];
+	const char *error, *s;
+	uint32_t num;
+	FIL fp;
+	int len;
+
+	if (!file_open(&fp, filename, 'r')) {
+		cprintf(con, "Failed to open file %s\r\n", filename);
+		return;
+	}
+	while (file_readline(&fp, (uint8_t *)line, sizeof(line))) {
+		if (line[0] == '#')
+			continue;
+		len = strlen(line);
+		while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = 0;
+		if (len == 0)
+			continue;
+
+		num = strtoul(line, (char **)&s, 10);
+		if (s == line || num >= MACRO_NB) {
+			cprintf(con, "Invalid macro number: %s\r\n", line);
+			continue;
+		}
+		while (*s == ' ' || *s == '\t')
+			s++;
+		error = macro_define(num, s);
+		if (error != NULL)
+			cprintf(con, "Macro %d: %s\r\n", num, error);
+	}
+	file_close(&fp);
+	macro_show(con);
+}
+
+int cmd_macro(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
+{
+	const char *error;
+	uint32_t repeat, period;
+	int t, num;
+	bool run;
+
+	num = -1;
+	repeat = 1;
+	period = 0;
+	run = FALSE;
+	for (t = token_pos; p->tokens[t]; t++) {
+		switch (p->tokens[t]) {
+		case T_ARG_UINT:
+			memcpy(&num, p->buf + p->tokens[++t], sizeof(int));
+			if (num < 0 || num >= MACRO_NB) {
+				cprintf(con, "Macro number must be between 0 and %d.\r\n",
+					MACRO_NB - 1);
+				return t - token_pos;
+			}
+			break;
+		case T_ARG_STRING:
+			t++;
+			if (num < 0) {
+				cprintf(con, "Please specify a macro number.\r\n");
+				return t - token_pos;
+			}
+			error = macro_define(num, p->buf + p->tokens[t]);
+			if (error != NULL) {
+				cprintf(con, "%s.\r\n", error);
+				return t - token_pos;
+			}
+			break;
+		case T_RUN:
+			run = TRUE;
+			break;
+		case T_REPEAT:
+			t += 2;
+			memcpy(&repeat, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_PERIOD:
+			t += 2;
+			memcpy(&period, p->buf + p->tokens[t], sizeof(uint32_t));
+			if (period > MACRO_PERIOD_MAX_US) {
+				cprintf(con, "Period must be at most %d usec.\r\n",
+					MACRO_PERIOD_MAX_US);
+				return t - token_pos;
+			}
+			break;
+		case T_ERASE:
+			if (num >= 0)
+				macros[num].src[0] = 0;
+			break;
+		case T_SHOW:
+			macro_show(con);
+			break;
+		case T_SAVE:
+			t += 2;
+			macro_save(con, p->buf + p->tokens[t]);
+			break;
+		case T_LOAD:
+			t += 2;
+			macro_load(con, p->buf + p->tokens[t]);
+			break;
+		default:
+			return t - token_pos;
+		}
+	}
+
+	if (run) {
+		if (num < 0) {
+			cprintf(con, "Please specify a macro number.\r\n");
+			return t - token_pos;
+		}
+		if (macros[num].src[0] == 0) {
+			cprintf(con, str_macro_undefined, num);
+			return t - token_pos;
+		}
+		macro_run(con, num, repeat, period);
+	}
+
+	return t - token_pos;
+}
@@ -25,10 +25,12 @@
 #include "hydrabus.h"
 #include "hydrabus_mode.h"
 #include "hydrabus_trigger.h"
+#include "hydrabus_macro.h"
 #include "hydrabus_aux.h"
 #include "mode_config.h"
 
 #include "bsp_rng.h"
+#include "bsp_resource.h"
 
 #define MAYBE_CALL(x) { if (x) x(con); }
 static int hydrabus_mode_write(t_hydra_console *con, t_tokenline_parsed *p,
@@ -109,6 +111,10 @@ static const char mode_str_read_error[] = "READ error:%d\r\n";
 static const char mode_str_write_read_error[] = "WRITE/READ error:%d\r\n";
 
 static const char mode_str_aux_read[] = "AUX: %d\r\n";
+static const char mode_str_write_repeat[] = "WRITE: 0x%02X (x%lu) ";
+
+/* Values per line when streaming */
+#define MODE_STREAM_LINE (16)
 
 static void hydrabus_mode_read_error(t_hydra_console *con, uint32_t mode_status)
 {
@@ -126,6 +132,40 @@ static void hydrabus_mode_write_read_error(t_hydra_console *con, uint32_t mode_s
 }
 
 
+/*
+ * Same format as hydrabus_mode_str_mul_value_u8, built without vsnprintf()
+ * as this runs for every byte of a stream. col counts the values printed.
+ */
+static void mode_stream_print(t_hydra_console *con, const uint8_t *data,
+			      uint32_t nb_data, uint32_t *col)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	char line[(MODE_STREAM_LINE * 5) + 2];
+	uint32_t i, len;
+
+	len = 0;
+	for (i = 0; i < nb_data; i++) {
+		line[len++] = '0';
+		line[len++] = 'x';
+		line[len++] = hex[data[i] >> 4];
+		line[len++] = hex[data[i] & 0x0f];
+		line[len++] = ' ';
+		if ((++(*col) % MODE_STREAM_LINE) == 0) {
+			line[len++] = '\r';
+			line[len++] = '\n';
+			cprint(con, line, len);
+			len = 0;
+		}
+	}
+	cprint(con, line, len);
+}
+
+static void mode_stream_end(t_hydra_console *con, uint32_t col)
+{
+	if (col % MODE_STREAM_LINE)
+		cprintf(con, hydrabus_mode_str_mul_br);
+}
+
 void print_freq(t_hydra_console *con, uint32_t freq)
 {
 #define PRINT_FREQ_1GHZ	(1000000000L)
@@ -169,6 +209,12 @@ int cmd_mode_init(t_hydra_console *con, t_tokenline_parsed *p)
 		con->mode->exec = modes[i].exec;
 		if (con->mode->exec->init(con, p) == 0)
 			return FALSE;
+		/* Peripheral or pins used by the other console */
+		if (print_resource_conflict(con)) {
+			MAYBE_CALL(con->mode->exec->cleanup);
+			bsp_resource_release_all();
+			return FALSE;
+		}
 		if (!tl_mode_push(con->tl, modes[i].tokens))
 			return FALSE;
 		con->console_mode = modes[i].token;
@@ -277,6 +323,9 @@ int cmd_mode_exec(t_hydra_console *con, t_tokenline_parsed *p)
 		case T_TRIGGER:
 			t += cmd_trigger(con, p, t + 1);
 			break;
+		case T_MACRO:
+			t += cmd_macro(con, p, t + 1);
+			break;
 		case T_AUX_ON:
 			cmd_aux_write(0, 1);
 			break;
@@ -366,6 +415,78 @@ static int chomp_strings(t_hydra_console *con, t_tokenline_parsed *p,
 	return t - token_pos;
 }
 
+/*
+ * Single value repeated more than the proto buffer can hold, sent from a
+ * pool buffer with write_buf or write_read_buf. Read values are printed
+ * while the transfer goes on.
+ */
+static uint32_t hydrabus_mode_write_stream(t_hydra_console *con, uint8_t value,
+					   uint32_t count)
+{
+	mode_config_proto_t* p_proto = &con->mode->proto;
+	uint32_t mode_status, done, nb, col;
+	uint8_t *tx_data, *rx_data;
+
+	tx_data = pool_alloc_bytes(HYDRABUS_MODE_STREAM_CHUNK);
+	rx_data = pool_alloc_bytes(HYDRABUS_MODE_STREAM_CHUNK);
+	if (tx_data == 0 || rx_data == 0) {
+		pool_free(tx_data);
+		pool_free(rx_data);
+		return BSP_ERROR;
+	}
+	memset(tx_data, value, HYDRABUS_MODE_STREAM_CHUNK);
+
+	cprintf(con, mode_str_write_repeat, value, count);
+	if (p_proto->wwr == 1)
+		cprintf(con, hydrabus_mode_str_mul_read);
+
+	mode_status = HYDRABUS_MODE_STATUS_OK;
+	col = 0;
+	for (done = 0; done < count && !hydrabus_ubtn(); done += nb) {
+		nb = MIN(count - done, HYDRABUS_MODE_STREAM_CHUNK);
+		if (p_proto->wwr == 1) {
+			mode_status = con->mode->exec->write_read_buf(con,
+					tx_data, rx_data, nb);
+			if (mode_status != HYDRABUS_MODE_STATUS_OK)
+				break;
+			mode_stream_print(con, rx_data, nb, &col);
+		} else {
+			mode_status = con->mode->exec->write_buf(con, tx_data, nb);
+			if (mode_status != HYDRABUS_MODE_STATUS_OK)
+				break;
+		}
+	}
+	if (p_proto->wwr == 1)
+		mode_stream_end(con, col);
+	else
+		cprintf(con, hydrabus_mode_str_mul_br);
+
+	pool_free(tx_data);
+	pool_free(rx_data);
+	return mode_status;
+}
+
+/* Returns TRUE if the write is a single value:count too big for buffer_tx */
+static bool hydrabus_mode_is_write_stream(t_hydra_console *con,
+					  t_tokenline_parsed *p, int t)
+{
+	const mode_exec_t *exec = con->mode->exec;
+	uint32_t count;
+
+	if (p->tokens[t] != T_ARG_UINT ||
+	    p->tokens[t + 2] != T_ARG_TOKEN_SUFFIX_INT ||
+	    p->tokens[t + 4] == T_ARG_UINT || p->tokens[t + 4] == T_TILDE)
+		return FALSE;
+
+	memcpy(&count, p->buf + p->tokens[t + 3], sizeof(uint32_t));
+	if (count <= MODE_CONFIG_PROTO_BUFFER_SIZE)
+		return FALSE;
+
+	if (con->mode->proto.wwr == 1)
+		return exec->write_read_buf != NULL;
+	return exec->write_buf != NULL;
+}
+
 /*
  * This function can be called for either T_WRITE or a free-standing
  * T_ARG_UINT, so it's called with t pointing to the first token after
@@ -377,13 +498,30 @@ static int hydrabus_mode_write(t_hydra_console *con, t_tokenline_parsed *p,
 			       int t)
 {
 	mode_config_proto_t* p_proto = &con->mode->proto;
-	uint32_t mode_status;
+	uint32_t mode_status, arg_uint;
 	unsigned int num_bytes = 0;
 	int tokens_used, i;
 	int count = 1;
 
 	tokens_used = 0;
 
+	if (hydrabus_mode_is_write_stream(con, p, t)) {
+		memcpy(&arg_uint, p->buf + p->tokens[t + 1], sizeof(uint32_t));
+		memcpy(&count, p->buf + p->tokens[t + 3], sizeof(int));
+		if (arg_uint > 0xff) {
+			cprintf(con, "Please specify one byte at a time.\r\n");
+			return 0;
+		}
+		mode_status = hydrabus_mode_write_stream(con, arg_uint, count);
+		if (mode_status != HYDRABUS_MODE_STATUS_OK) {
+			if (p_proto->wwr == 1)
+				hydrabus_mode_write_read_error(con, mode_status);
+			else
+				hydrabus_mode_write_error(con, mode_status);
+		}
+		return 4;
+	}
+
 	switch(p->tokens[t]) {
 	case T_ARG_TOKEN_SUFFIX_INT:
 		t++;
@@ -428,6 +566,55 @@ static int hydrabus_mode_write(t_hydra_console *con, t_tokenline_parsed *p,
 	return tokens_used;
 }
 
+/*
+ * Reads above the proto buffer size. With read_buf the data is read in
+ * pool buffer chunks and printed while the transfer goes on, other modes
+ * get successive reads of UINT8_MAX bytes.
+ */
+static uint32_t hydrabus_mode_read_stream(t_hydra_console *con, uint32_t count)
+{
+	mode_config_proto_t* p_proto = &con->mode->proto;
+	const mode_exec_t *exec = con->mode->exec;
+	uint32_t mode_status, done, nb, col;
+	uint8_t *rx_data;
+
+	if (exec->read_buf == NULL) {
+		mode_status = !HYDRABUS_MODE_STATUS_OK;
+		for (done = 0; done < count && !hydrabus_ubtn(); done += nb) {
+			nb = MIN(count - done, UINT8_MAX);
+			if (exec->read == NULL)
+				break;
+			mode_status = exec->read(con, p_proto->buffer_rx, nb);
+			if (mode_status != HYDRABUS_MODE_STATUS_OK)
+				break;
+		}
+		return mode_status;
+	}
+
+	rx_data = pool_alloc_bytes(HYDRABUS_MODE_STREAM_CHUNK);
+	if (rx_data == 0)
+		return BSP_ERROR;
+
+	cprintf(con, hydrabus_mode_str_mul_read);
+	mode_status = HYDRABUS_MODE_STATUS_OK;
+	col = 0;
+	for (done = 0; done < count && !hydrabus_ubtn(); done += nb) {
+		nb = MIN(count - done, HYDRABUS_MODE_STREAM_CHUNK);
+		mode_status = exec->read_buf(con, rx_data, &nb);
+		mode_stream_print(con, rx_data, nb, &col);
+		if (mode_status != HYDRABUS_MODE_STATUS_OK) {
+			done += nb;
+			break;
+		}
+	}
+	mode_stream_end(con, col);
+	if (mode_status == BSP_TIMEOUT)
+		cprintf(con, hydrabus_mode_str_read_timeout, done, count);
+
+	pool_free(rx_data);
+	return mode_status;
+}
+
 /* Returns the number of tokens eaten. */
 static int hydrabus_mode_read(t_hydra_console *con, t_tokenline_parsed *p,
 			      int token_pos)
@@ -446,14 +633,13 @@ static int hydrabus_mode_read(t_hydra_console *con, t_tokenline_parsed *p,
 		count = 1;
 	}
 
-	if(count > UINT8_MAX) {
-		cprintf(con, "ERROR: read is limited to %d\r\n", UINT8_MAX);
-		return t - token_pos;
-	}
-
-	mode_status = !HYDRABUS_MODE_STATUS_OK;
-	if(con->mode->exec->read != NULL) {
-		mode_status = con->mode->exec->read(con, p_proto->buffer_rx, count);
+	if (count > UINT8_MAX) {
+		mode_status = hydrabus_mode_read_stream(con, count);
+	} else {
+		mode_status = !HYDRABUS_MODE_STATUS_OK;
+		if(con->mode->exec->read != NULL) {
+			mode_status = con->mode->exec->read(con, p_proto->buffer_rx, count);
+		}
 	}
 	if (mode_status == BSP_ERROR)
 		hydrabus_mode_read_error(con, mode_status);
@@ -461,14 +647,44 @@ static int hydrabus_mode_read(t_hydra_console *con, t_tokenline_parsed *p,
 	return t - token_pos;
 }
 
+/* Keep a multiple of 16 to be aligned in the hexdump */
+#define HEXDUMP_CHUNK_SIZE 64
+
+/* Hexdump of count bytes read with read_buf in pool buffer chunks */
+static void hydrabus_mode_hexdump_stream(t_hydra_console *con, uint32_t count)
+{
+	uint32_t mode_status, bytes_read, nb, i;
+	uint8_t *rx_data;
+
+	rx_data = pool_alloc_bytes(HYDRABUS_MODE_STREAM_CHUNK);
+	if (rx_data == 0) {
+		hydrabus_mode_read_error(con, BSP_ERROR);
+		return;
+	}
+
+	for (bytes_read = 0; bytes_read < count && !hydrabus_ubtn(); bytes_read += nb) {
+		nb = MIN(count - bytes_read, HYDRABUS_MODE_STREAM_CHUNK);
+		mode_status = con->mode->exec->read_buf(con, rx_data, &nb);
+		for (i = 0; i < nb; i += HEXDUMP_CHUNK_SIZE)
+			print_hex(con, rx_data + i, MIN(nb - i, HEXDUMP_CHUNK_SIZE));
+
+		if (mode_status == BSP_TIMEOUT) {
+			cprintf(con, hydrabus_mode_str_read_timeout,
+				bytes_read + nb, count);
+			break;
+		} else if (mode_status != HYDRABUS_MODE_STATUS_OK) {
+			hydrabus_mode_read_error(con, mode_status);
+			break;
+		}
+	}
+	pool_free(rx_data);
+}
+
 /* Returns the number of tokens eaten. */
 static int hydrabus_mode_hexdump(t_hydra_console *con, t_tokenline_parsed *p,
 			      int token_pos)
 {
 
-	/* Keep a multiple of 16 to be aligned in the hexdump */
-	#define HEXDUMP_CHUNK_SIZE 64
-
 	mode_config_proto_t* p_proto;
 	uint32_t mode_status;
 	uint32_t count;
@@ -486,6 +702,11 @@ static int hydrabus_mode_hexdump(t_hydra_console *con, t_tokenline_parsed *p,
 		count = 1;
 	}
 
+	if (count > HEXDUMP_CHUNK_SIZE && con->mode->exec->read_buf != NULL) {
+		hydrabus_mode_hexdump_stream(con, count);
+		return t - token_pos;
+	}
+
 	while((bytes_read < count) && !hydrabus_ubtn()){
 		mode_status = !HYDRABUS_MODE_STATUS_OK;
 		if((count-bytes_read) >= HEXDUMP_CHUNK_SIZE) {
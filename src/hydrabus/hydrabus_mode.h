@@ -24,6 +24,9 @@
 
 #define HYDRABUS_MODE_STATUS_OK (0)
 
+/* Pool buffer size used to stream read/write/hexdump above the proto buffers */
+#define HYDRABUS_MODE_STREAM_CHUNK (4096)
+
 /* Common string for hydrabus mode */
 /* "/CS ENABLED\r\n" */
 extern const char hydrabus_mode_str_cs_enabled[];
@@ -72,6 +75,14 @@ typedef struct mode_exec_t {
 	uint32_t (*dump)(t_hydra_console *con, uint8_t *rx_data, uint8_t *nb_data);
 	/* Write & Read data (return status 0=OK) */
 	uint32_t (*write_read)(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint8_t nb_data);
+	/*
+	 * Transfers on a caller provided buffer of any size, without output,
+	 * used to stream large transfers (return status 0=OK).
+	 * read_buf sets nb_data to the number of bytes received on timeout.
+	 */
+	uint32_t (*read_buf)(t_hydra_console *con, uint8_t *rx_data, uint32_t *nb_data);
+	uint32_t (*write_buf)(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data);
+	uint32_t (*write_read_buf)(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint32_t nb_data);
 	/* Set CLK High (x-WIRE or other raw mode) command '/' */
 	void (*clkh)(t_hydra_console *con);
 	/* Set CLK Low (x-WIRE or other raw mode) command '\' */
@@ -22,11 +22,18 @@
 #include "bsp.h"
 #include "bsp_gpio.h"
 #include "hydrabus_mode_flash.h"
+#include "hydrabus_flash_nand.h"
+#include "microsd.h"
 #include <string.h>
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 static int show(t_hydra_console *con, t_tokenline_parsed *p);
 static void flash_display_id(t_hydra_console *con);
+static void flash_display_onfi(t_hydra_console *con);
+static void flash_scan(t_hydra_console *con);
+static void flash_dump(t_hydra_console *con, uint32_t start, uint32_t nb_pages, bool to_sd);
+
+static flash_nand_t nand;
 
 static const char* str_prompt_flash[] = {
 	"nandflash" PROMPT,
@@ -73,7 +80,7 @@ static void show_params(t_hydra_console *con)
 	cprintf(con, "Address bytes : %d\r\n", proto->config.flash.dev_numbits);
 }
 
-static void flash_data_mode_input(void)
+void flash_data_mode_input(void)
 {
 	/*
 	uint8_t i;
@@ -87,7 +94,7 @@ static void flash_data_mode_input(void)
 	GPIOC->PUPDR &= 0xFFFF0000;
 }
 
-static void flash_data_mode_output(void)
+void flash_data_mode_output(void)
 {
 	/*
 	uint8_t i;
@@ -249,6 +256,8 @@ static int init(t_hydra_console *con, t_tokenline_parsed *p)
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
+	uint32_t start = 0, nb_pages = 0;
+	bool dump = FALSE, to_sd = FALSE;
 	int t;
 
 	for (t = token_pos; p->tokens[t]; t++) {
@@ -279,11 +288,37 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 		case T_ID:
 			flash_display_id(con);
 			break;
+		case T_ONFI:
+			flash_display_onfi(con);
+			break;
+		case T_SCAN:
+			flash_scan(con);
+			break;
+		case T_DUMP:
+			dump = TRUE;
+			break;
+		case T_START:
+			t += 2;
+			memcpy(&start, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_PAGES:
+			t += 2;
+			memcpy(&nb_pages, p->buf + p->tokens[t], sizeof(uint32_t));
+			break;
+		case T_SD:
+			to_sd = TRUE;
+			break;
 		default:
+			if(dump) {
+				flash_dump(con, start, nb_pages, to_sd);
+			}
 			return t - token_pos;
 		}
 	}
 
+	if(dump) {
+		flash_dump(con, start, nb_pages, to_sd);
+	}
 	return t - token_pos;
 }
 
@@ -360,6 +395,152 @@ static void flash_display_id(t_hydra_console *con)
 	cprintf(con, "%02X\r\n", data);
 }
 
+static bool flash_get_geometry(t_hydra_console *con, uint8_t *param)
+{
+	if(nand.valid) {
+		return TRUE;
+	}
+	if(!flash_nand_read_param_page(con, &nand, param)) {
+		cprintf(con, "No valid ONFI parameter page\r\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void flash_display_onfi(t_hydra_console *con)
+{
+	uint8_t *param = pool_alloc_bytes(FLASH_NAND_PARAM_PAGE_SIZE);
+
+	if(param == NULL) {
+		cprintf(con, "Unable to allocate buffer\r\n");
+		return;
+	}
+	/* Always read it again, the chip may have been swapped */
+	nand.valid = FALSE;
+	if(flash_get_geometry(con, param)) {
+		cprintf(con, "Manufacturer : %s\r\n", nand.manufacturer);
+		cprintf(con, "Model : %s\r\n", nand.model);
+		cprintf(con, "Page size : %d + %d bytes\r\n",
+			nand.page_size, nand.spare_size);
+		cprintf(con, "Pages per block : %d\r\n", nand.pages_per_block);
+		cprintf(con, "Blocks : %d\r\n", nand.blocks);
+		cprintf(con, "Address cycles : %d column, %d row\r\n",
+			nand.col_cycles, nand.row_cycles);
+	}
+	pool_free(param);
+}
+
+static void flash_scan(t_hydra_console *con)
+{
+	uint8_t *param = pool_alloc_bytes(FLASH_NAND_PARAM_PAGE_SIZE);
+	uint32_t block, nb_bad = 0;
+	bool bad;
+
+	if(param == NULL) {
+		cprintf(con, "Unable to allocate buffer\r\n");
+		return;
+	}
+	if(flash_get_geometry(con, param)) {
+		for(block = 0; block < nand.blocks; block++) {
+			if(hydrabus_ubtn()) {
+				cprintf(con, "Aborted\r\n");
+				break;
+			}
+			if(!flash_nand_is_bad_block(con, &nand, block, &bad)) {
+				cprintf(con, "Block %d: timeout\r\n", block);
+				break;
+			}
+			if(bad) {
+				cprintf(con, "Bad block %d\r\n", block);
+				nb_bad++;
+			}
+		}
+		cprintf(con, "%d bad block(s) out of %d\r\n", nb_bad, nand.blocks);
+	}
+	pool_free(param);
+}
+
+/* Dump pages with their spare area, to the console or to nand_dump.bin */
+static void flash_dump(t_hydra_console *con, uint32_t start, uint32_t nb_pages, bool to_sd)
+{
+	FIL outfile;
+	uint8_t *data;
+	uint32_t page, page_len, total, i;
+	uint32_t nb_errors = 0;
+	uint8_t status;
+	UINT written;
+
+	data = pool_alloc_bytes(FLASH_NAND_PARAM_PAGE_SIZE);
+	if(data == NULL) {
+		cprintf(con, "Unable to allocate buffer\r\n");
+		return;
+	}
+	if(!flash_get_geometry(con, data)) {
+		pool_free(data);
+		return;
+	}
+	pool_free(data);
+
+	page_len = nand.page_size + nand.spare_size;
+	total = nand.blocks * nand.pages_per_block;
+	/* Whole chip by default on SD, a single page on the console */
+	if(nb_pages == 0 && !to_sd) {
+		nb_pages = 1;
+	}
+	if(nb_pages == 0 || start + nb_pages > total) {
+		nb_pages = (start < total) ? total - start : 0;
+	}
+
+	data = pool_alloc_bytes(page_len);
+	if(data == NULL) {
+		cprintf(con, "Unable to allocate %d bytes\r\n", page_len);
+		return;
+	}
+	/* A previous dump is replaced, pages are then written in sequence */
+	if(to_sd && ((!is_fs_ready() && mount() != 0) ||
+		     f_open(&outfile, "nand_dump.bin",
+			    FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)) {
+		cprintf(con, "Unable to open nand_dump.bin\r\n");
+		pool_free(data);
+		return;
+	}
+
+	for(page = start; page < start + nb_pages; page++) {
+		if(hydrabus_ubtn()) {
+			cprintf(con, "Aborted\r\n");
+			break;
+		}
+		if(!flash_nand_read_page(con, &nand, page, data, &status)) {
+			cprintf(con, "Page %d: timeout\r\n", page);
+			break;
+		}
+		/* On-die ECC chips flag uncorrectable pages in the status */
+		if(status & NAND_STATUS_FAIL) {
+			cprintf(con, "Page %d: status 0x%02X\r\n", page, status);
+			nb_errors++;
+		}
+		if(to_sd) {
+			if(f_write(&outfile, data, page_len, &written) != FR_OK ||
+			   written != page_len) {
+				cprintf(con, "SD write error\r\n");
+				break;
+			}
+		} else {
+			cprintf(con, "Page %d:\r\n", page);
+			for(i = 0; i < page_len; i += 128) {
+				print_hex(con, &data[i], (page_len - i > 128) ? 128 : page_len - i);
+			}
+		}
+	}
+	cprintf(con, "%d page(s) read, %d with error status\r\n",
+		page - start, nb_errors);
+
+	if(to_sd) {
+		file_close(&outfile);
+	}
+	pool_free(data);
+}
+
 static int show(t_hydra_console *con, t_tokenline_parsed *p)
 {
 	int tokens_used;
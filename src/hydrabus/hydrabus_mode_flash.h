@@ -29,6 +29,11 @@
 void flash_init_proto_default(t_hydra_console *con);
 bool flash_pin_init(t_hydra_console *con);
 void flash_send_bit(uint8_t bit);
+void flash_chip_en_high(void);
+void flash_chip_en_low(void);
+void flash_data_mode_input(void);
+void flash_data_mode_output(void);
+uint8_t flash_read_value(t_hydra_console *con);
 void flash_write_value(t_hydra_console *con, uint8_t tx_data);
 void flash_write_command(t_hydra_console *con, uint8_t tx_data);
 void flash_write_address(t_hydra_console *con, uint8_t tx_data);
@@ -20,11 +20,12 @@
 #include "hydrabus_mode_i2c.h"
 #include "bsp_i2c_master.h"
 #include "bsp_i2c_slave.h"
+#include "hydrabus_i2c_scan.h"
 #include <string.h>
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos);
 static int show(t_hydra_console *con, t_tokenline_parsed *p);
-static void scan(t_hydra_console *con, t_tokenline_parsed *p);
+static void scan(t_hydra_console *con, bool tenbit);
 static void sniff(t_hydra_console *con);
 
 #define I2C_DEV_NUM (1)
@@ -170,7 +171,12 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 			}
 			break;
 		case T_SCAN:
-			scan(con, p);
+			if (p->tokens[t + 1] == T_TENBIT) {
+				t++;
+				scan(con, TRUE);
+			} else {
+				scan(con, FALSE);
+			}
 			break;
 		case T_SNIFF:
 			sniff(con);
@@ -294,10 +300,10 @@ static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 	return status;
 }
 
-static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t *nb_data)
+static uint32_t read_buf(t_hydra_console *con, uint8_t *rx_data, uint32_t *nb_data)
 {
-	uint32_t status;
-	uint8_t i, tmp;
+	uint32_t status, i;
+	uint8_t tmp;
 	mode_config_proto_t* proto = &con->mode->proto;
 	status = BSP_ERROR;
 	for(i = 0; i < *nb_data; i++) {
@@ -316,9 +322,18 @@ static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t *nb_data)
 
 		proto->config.i2c.ack_pending = 1;
 	}
+	if (status != BSP_OK)
+		*nb_data = i;
 	return status;
 }
 
+static uint32_t dump(t_hydra_console *con, uint8_t *rx_data, uint8_t *nb_data)
+{
+	uint32_t nb = *nb_data;
+
+	return read_buf(con, rx_data, &nb);
+}
+
 static void cleanup(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -341,34 +356,56 @@ static int show(t_hydra_console *con, t_tokenline_parsed *p)
 	return tokens_used;
 }
 
-static void scan(t_hydra_console *con, t_tokenline_parsed *p)
+static void scan(t_hydra_console *con, bool tenbit)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
-	int i;
-	uint8_t ack, found;
+	i2c_scan_t *res;
+	bsp_status_t status;
+	const char *name;
+	int i, j;
 
-	(void)p;
+	res = pool_alloc_bytes(sizeof(i2c_scan_t));
+	if (res == NULL) {
+		cprintf(con, "Error, unable to get buffer space.\r\n");
+		return;
+	}
 
 	if(proto->config.i2c.ack_pending) {
 		bsp_i2c_read_ack(I2C_DEV_NUM, TRUE);
 		proto->config.i2c.ack_pending = 0;
 	}
 
-	/* Skip address 0x00 (general call) and >= 0x78 (10-bit address prefix) */
-	found = FALSE;
+	status = i2c_scan(proto, tenbit, res);
+	if (status == BSP_ERROR) {
+		cprintf(con, "Bus busy, SDA or SCL held low.\r\n");
+		goto out;
+	} else if (status != BSP_OK) {
+		cprintf(con, "Clock stretching timeout, scan aborted.\r\n");
+	}
+
 	for (i = 0x1; i < 0x78; i++) {
-		bsp_i2c_start(I2C_DEV_NUM);
-		bsp_i2c_master_write_u8(I2C_DEV_NUM, i << 1, &ack);
-		bsp_i2c_stop(I2C_DEV_NUM);
-		if (ack) {
-			cprintf(con, "Device found at address 0x%02x (0x%02x W / 0x%02x R)\r\n",
-				i, (i << 1), (i << 1)+1);
-			found = TRUE;
+		if (!i2c_scan_acked(res, i))
+			continue;
+		name = "";
+		for (j = 0; j < res->nb_id; j++) {
+			if (res->id[j].addr == i)
+				name = i2c_scan_sig_name(res->id[j].sig);
 		}
+		cprintf(con, "Device found at address 0x%02x (0x%02x W / 0x%02x R) %s\r\n",
+			i, (i << 1), (i << 1)+1, name);
+	}
+	for (i = 0; i < res->nb_tenbit; i++) {
+		cprintf(con, "10-bit device found at address 0x%03x\r\n",
+			res->tenbit[i]);
 	}
 
-	if (!found)
+	if (res->nb_ack == 0 && res->nb_tenbit == 0)
 		cprintf(con, "No devices found.\r\n");
+	cprintf(con, "%d device(s), %d identified, %lu us at %lu kHz\r\n",
+		res->nb_ack + res->nb_tenbit, res->nb_id,
+		res->time_us, res->speed / 1000);
+out:
+	pool_free(res);
 }
 
 static void print_sniff_buffer(t_hydra_console *con, uint16_t *buffer, uint16_t length)
@@ -439,6 +476,7 @@ const mode_exec_t mode_i2c_exec = {
 	.write = &write,
 	.read = &read,
 	.dump = &dump,
+	.read_buf = &read_buf,
 	.cleanup = &cleanup,
 	.get_prompt = &get_prompt,
 };
@@ -39,6 +39,9 @@ static const char* str_prompt_jtag[] = {
 
 #define MAX_CHAIN_LEN 32
 
+/* When set, TDI is driven on all these PORTB pins at once (pin discovery) */
+static uint16_t jtag_tdi_mask = 0;
+
 static void init_proto_default(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -228,14 +231,20 @@ static inline void jtag_tdi_high(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
 
-	bsp_gpio_set(BSP_GPIO_PORTB, proto->config.jtag.tdi_pin);
+	if (jtag_tdi_mask)
+		GPIOB->BSRR.H.set = jtag_tdi_mask;
+	else
+		bsp_gpio_set(BSP_GPIO_PORTB, proto->config.jtag.tdi_pin);
 }
 
 static inline void jtag_tdi_low(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
 
-	bsp_gpio_clr(BSP_GPIO_PORTB, proto->config.jtag.tdi_pin);
+	if (jtag_tdi_mask)
+		GPIOB->BSRR.H.clear = jtag_tdi_mask;
+	else
+		bsp_gpio_clr(BSP_GPIO_PORTB, proto->config.jtag.tdi_pin);
 }
 
 static inline void jtag_trst_high(t_hydra_console *con)
@@ -618,6 +627,216 @@ static void jtag_brute_pins_idcode(t_hydra_console *con, uint8_t num_pins)
 	jtag_pin_init(con);
 }
 
+/*
+ * Pin discovery.
+ *
+ * Instead of trying every TMS/TCK/TDI/TDO permutation, each TCK/TMS pair
+ * runs one TAP reset and shifts the 32 bits of DR out while sampling the
+ * whole port: any pin showing a valid IDCODE is a TDO. TDI and TRST are
+ * then located among the remaining pins by driving halves of them at once
+ * with port-wide writes, falling back to one pin at a time.
+ */
+typedef bool (*jtag_probe_t)(t_hydra_console *con, uint16_t pins, uint16_t set);
+
+static bool jtag_idcode_valid(uint32_t idcode)
+{
+	/* IDCODE bit0 must be 1, 0x7F is not a valid JEDEC manufacturer */
+	return (idcode & 0x1) && idcode != 0xffffffff &&
+	       ((idcode >> 1) & 0x7f) != 0x7f;
+}
+
+/* TCK and TMS are outputs, the other pins inputs with the mode pull */
+static void jtag_discover_pins_in(t_hydra_console *con, uint8_t num_pins)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint8_t i;
+
+	for (i = 0; i < num_pins; i++) {
+		if (i == proto->config.jtag.tck_pin || i == proto->config.jtag.tms_pin) {
+			bsp_gpio_init(BSP_GPIO_PORTB, i, proto->config.jtag.dev_gpio_mode,
+				      proto->config.jtag.dev_gpio_pull);
+			bsp_gpio_clr(BSP_GPIO_PORTB, i);
+		} else {
+			bsp_gpio_init(BSP_GPIO_PORTB, i, MODE_CONFIG_DEV_GPIO_IN,
+				      proto->config.jtag.dev_gpio_pull);
+		}
+	}
+}
+
+/* Samples the whole port on each of the 32 DR bits following a TAP reset */
+static void jtag_discover_sample(t_hydra_console *con, uint16_t samples[32])
+{
+	uint8_t i;
+
+	jtag_reset_state(con);
+
+	/* Go into Shift-DR state */
+	jtag_send_bit(con, 0);
+	jtag_send_bit(con, 0 | TMS);
+	jtag_send_bit(con, 0);
+	jtag_send_bit(con, 0);
+
+	for (i = 0; i < 32; i++) {
+		jtag_clk_high(con);
+		samples[i] = bsp_gpio_port_read(BSP_GPIO_PORTB);
+		jtag_clk_low(con);
+	}
+}
+
+static uint32_t jtag_discover_idcode(uint16_t samples[32], uint8_t pin)
+{
+	uint32_t idcode;
+	uint8_t i;
+
+	idcode = 0;
+	for (i = 0; i < 32; i++)
+		idcode |= ((samples[i] >> pin) & 1) << i;
+
+	return idcode;
+}
+
+/* pins are outputs held high, set gets the TDI pattern */
+static bool jtag_probe_tdi(t_hydra_console *con, uint16_t pins, uint16_t set)
+{
+	uint8_t num_devices;
+
+	GPIOB->BSRR.H.set = pins;
+	jtag_tdi_mask = set;
+	num_devices = jtag_scan_bypass(con);
+	jtag_tdi_mask = 0;
+	GPIOB->BSRR.H.set = pins;
+
+	return num_devices > 0;
+}
+
+/* pins are outputs held high, set is held low */
+static bool jtag_probe_trst(t_hydra_console *con, uint16_t pins, uint16_t set)
+{
+	uint8_t num_devices;
+
+	GPIOB->BSRR.H.set = pins & ~set;
+	GPIOB->BSRR.H.clear = set;
+	num_devices = jtag_scan_idcode(con);
+	GPIOB->BSRR.H.set = pins;
+
+	return num_devices == 0;
+}
+
+/* Returns the pin number found by probe among pins, or 12 */
+static uint8_t jtag_discover_narrow(t_hydra_console *con, uint16_t pins,
+				    jtag_probe_t probe)
+{
+	uint16_t cand, half;
+	uint8_t i, n;
+
+	if (pins == 0 || !probe(con, pins, pins))
+		return 12;
+
+	/* Halve the candidates driven at once */
+	cand = pins;
+	while (cand & (cand - 1)) {
+		half = 0;
+		n = __builtin_popcount(cand) / 2;
+		for (i = 0; n > 0; i++) {
+			if (cand & (1 << i)) {
+				half |= 1 << i;
+				n--;
+			}
+		}
+		cand = probe(con, pins, half) ? half : (cand & ~half);
+	}
+	if (probe(con, pins, cand))
+		return __builtin_ctz(cand);
+
+	/* Pins driven together interfered, one at a time */
+	for (i = 0; i < 16; i++) {
+		if ((pins & (1 << i)) && probe(con, pins, 1 << i))
+			return i;
+	}
+	return 12;
+}
+
+static void jtag_discover(t_hydra_console *con, uint8_t num_pins)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	uint16_t samples[32];
+	uint16_t others;
+	uint32_t idcode;
+	uint8_t tck, tms, tdo, i;
+	uint8_t valid_tck, valid_tms, valid_tdi, valid_tdo, valid_trst;
+	uint8_t pinout_found = 0;
+
+	valid_tck = valid_tms = valid_tdi = valid_tdo = valid_trst = 12;
+	proto->config.jtag.tdi_pin = 12;
+	proto->config.jtag.trst_pin = 12;
+
+	for (tck = 0; tck < num_pins; tck++) {
+		for (tms = 0; tms < num_pins; tms++) {
+			if (tms == tck) continue;
+			if (hydrabus_ubtn()) return;
+
+			proto->config.jtag.tck_pin = tck;
+			proto->config.jtag.tms_pin = tms;
+			proto->config.jtag.tdi_pin = 12;
+			jtag_discover_pins_in(con, num_pins);
+			jtag_discover_sample(con, samples);
+
+			for (tdo = 0; tdo < num_pins; tdo++) {
+				if (tdo == tck || tdo == tms) continue;
+				idcode = jtag_discover_idcode(samples, tdo);
+				if (!jtag_idcode_valid(idcode)) continue;
+
+				/* Remaining pins become outputs held high */
+				proto->config.jtag.tdo_pin = tdo;
+				others = 0;
+				for (i = 0; i < num_pins; i++) {
+					if (i == tck || i == tms || i == tdo) continue;
+					others |= 1 << i;
+					bsp_gpio_init(BSP_GPIO_PORTB, i,
+						      proto->config.jtag.dev_gpio_mode,
+						      proto->config.jtag.dev_gpio_pull);
+				}
+				GPIOB->BSRR.H.set = others;
+
+				proto->config.jtag.tdi_pin = jtag_discover_narrow(con,
+						others, jtag_probe_tdi);
+				if (proto->config.jtag.tdi_pin != 12)
+					others &= ~(1 << proto->config.jtag.tdi_pin);
+				proto->config.jtag.trst_pin = jtag_discover_narrow(con,
+						others, jtag_probe_trst);
+
+				cprintf(con, "IDCODE : %08X\r\n", idcode);
+				jtag_print_pins(con);
+				pinout_found = 1;
+				valid_tck = tck;
+				valid_tms = tms;
+				valid_tdi = proto->config.jtag.tdi_pin;
+				valid_tdo = tdo;
+				valid_trst = proto->config.jtag.trst_pin;
+
+				proto->config.jtag.trst_pin = 12;
+				jtag_discover_pins_in(con, num_pins);
+			}
+		}
+	}
+
+	for (i = 0; i < num_pins; i++) {
+		bsp_gpio_init(BSP_GPIO_PORTB, i, MODE_CONFIG_DEV_GPIO_IN,
+			      MODE_CONFIG_DEV_GPIO_NOPULL);
+	}
+	if(pinout_found) {
+		proto->config.jtag.tms_pin = valid_tms;
+		proto->config.jtag.tck_pin = valid_tck;
+		proto->config.jtag.tdi_pin = valid_tdi;
+		proto->config.jtag.tdo_pin = valid_tdo;
+		proto->config.jtag.trst_pin = valid_trst;
+	} else {
+		init_proto_default(con);
+	}
+
+	jtag_pin_init(con);
+}
+
 static uint8_t ocd_shift_u8(t_hydra_console *con, uint8_t tdi, uint8_t tms, uint8_t num_bits)
 {
 	uint8_t tdo = 0;
@@ -788,6 +1007,7 @@ static int init(t_hydra_console *con, t_tokenline_parsed *p)
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
+	systime_t start;
 	int arg_int, t;
 	float arg_float;
 
@@ -824,6 +1044,7 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 				cprintf(con, "Cannot use more than 12 pins (PB0-11).\r\n");
 				return t;
 			}
+			start = chVTGetSystemTime();
 			switch(p->tokens[t+1]) {
 			case T_BYPASS:
 				jtag_brute_pins_bypass(con, arg_int);
@@ -831,7 +1052,12 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 			case T_IDCODE:
 				jtag_brute_pins_idcode(con, arg_int);
 				break;
+			case T_SCAN:
+				jtag_discover(con, arg_int);
+				break;
 			}
+			cprintf(con, "Done in %d ms.\r\n",
+				TIME_I2MS(chVTTimeElapsedSinceX(start)));
 			t+=3;
 			break;
 		case T_TCK:
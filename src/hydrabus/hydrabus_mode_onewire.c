@@ -241,7 +241,7 @@ static uint8_t onewire_crc8(uint8_t value, struct onewire_scan_state *state)
  * was move from a bunch of global variables to a struct. But the overall
  * design remains unchanged.
  */
-static bool onewire_search(t_hydra_console *con, struct onewire_scan_state *state, enum onewire_scan_mode mode)
+bool onewire_search(t_hydra_console *con, struct onewire_scan_state *state, enum onewire_scan_mode mode)
 {
 	int id_bit_number;
 	int last_zero, rom_byte_number;
@@ -254,6 +254,12 @@ static bool onewire_search(t_hydra_console *con, struct onewire_scan_state *stat
 		state->last_discrepancy = 0;
 		state->last_device_p = false;
 		state->last_family_discrepancy = 0;
+	} else if(mode == onewire_scan_family) {
+		/* Target setup: ROM_ADDR[0] holds the requested family code.  */
+		memset(&state->ROM_ADDR[1], 0, 7);
+		state->last_discrepancy = 64;
+		state->last_device_p = false;
+		state->last_family_discrepancy = 0;
 	}
 
 	/* Initialize for this search.  */
@@ -275,8 +281,8 @@ static bool onewire_search(t_hydra_console *con, struct onewire_scan_state *stat
 			return false;
 		}
 
-		/* Issue the search command.  */
-		onewire_write_u8(con, ONEWIRE_CMD_SEARCHROM);
+		/* Issue the search command (normal or alarm search).  */
+		onewire_write_u8(con, state->search_cmd);
 
 		/* Loop to do the search.  */
 		do {
@@ -358,6 +364,21 @@ static bool onewire_search(t_hydra_console *con, struct onewire_scan_state *stat
 	return device_found_p;
 }
 
+bool onewire_match_rom(t_hydra_console *con, uint8_t *rom)
+{
+	uint8_t i;
+
+	if(!onewire_start_and_check(con)) {
+		return false;
+	}
+
+	onewire_write_u8(con, ONEWIRE_CMD_MATCHROM);
+	for(i = 0; i < 8; i++) {
+		onewire_write_u8(con, rom[i]);
+	}
+	return true;
+}
+
 static void onewire_scan(t_hydra_console *con)
 {
 	int i;
@@ -367,6 +388,7 @@ static void onewire_scan(t_hydra_console *con)
 
 	cprintf(con, "Scanning bus for devices.\r\n");
 
+	state.search_cmd = ONEWIRE_CMD_SEARCHROM;
 	device_found_p = onewire_search(con, &state, onewire_scan_start);
 	while(device_found_p) {
 		cprintf(con, "%i: ", ++count);
@@ -533,6 +555,122 @@ void onewire_swio_write_reg(t_hydra_console *con, uint8_t address, uint32_t valu
 	DelayUs(10);
 }
 
+/*
+ * Abstract commands (RISC-V debug spec, access register):
+ * aarsize=32bit, transfer, optional write/postexec, regno 0x1000+GPR
+ */
+#define SWIO_CMD_WRITE_X9		0x00231009
+#define SWIO_CMD_READ_X8		0x00221008
+#define SWIO_CMD_READ_X8_EXEC		0x00261008
+#define SWIO_CMD_WRITE_X8_EXEC		0x00271008
+#define SWIO_CMD_EXEC			0x00040000
+
+/* c.lw x8,0(x9) ; c.addi x9,4 ; c.ebreak */
+#define SWIO_PROGBUF_LOAD		0x04914080
+/* c.sw x8,0(x9) ; c.addi x9,4 ; c.ebreak */
+#define SWIO_PROGBUF_STORE		0x0491c080
+#define SWIO_PROGBUF_EBREAK		0x90029002
+
+static bool onewire_swio_cmd_status(t_hydra_console *con)
+{
+	uint32_t status;
+	uint8_t retry = 100;
+
+	do {
+		status = onewire_swio_read_reg(con, SWIO_DM_ABSTRACTCS);
+	} while((status & SWIO_DM_ABSTRACTCS_BUSY) && --retry);
+
+	if(status & SWIO_DM_ABSTRACTCS_BUSY) {
+		return false;
+	}
+
+	if(status & SWIO_DM_ABSTRACTCS_CMDERR) {
+		/* Clear the error for the next command */
+		onewire_swio_write_reg(con, SWIO_DM_ABSTRACTCS,
+				       SWIO_DM_ABSTRACTCS_CMDERR);
+		return false;
+	}
+	return true;
+}
+
+static void onewire_swio_setup_progbuf(t_hydra_console *con, uint32_t insn,
+				       uint32_t address)
+{
+	onewire_swio_write_reg(con, SWIO_DM_ABSTRACTAUTO, 0);
+	onewire_swio_write_reg(con, SWIO_DM_PROGBUF0, insn);
+	onewire_swio_write_reg(con, SWIO_DM_PROGBUF1, SWIO_PROGBUF_EBREAK);
+
+	/* x9 holds the current address */
+	onewire_swio_write_reg(con, SWIO_DM_DATA0, address);
+	onewire_swio_write_reg(con, SWIO_DM_COMMAND, SWIO_CMD_WRITE_X9);
+}
+
+/*
+ * Reads nb_words 32-bit words starting at address. Hart must be halted.
+ * The program buffer loads the next word in x8, and autoexecdata re-runs
+ * the "read x8 then execute" command each time DATA0 is read, so every
+ * word only costs one SWIO register read. The last word is fetched without
+ * executing the program buffer to never read past the end of the range.
+ */
+bool onewire_swio_read_mem(t_hydra_console *con, uint32_t address, uint32_t *data, uint32_t nb_words)
+{
+	uint32_t i;
+
+	if(nb_words == 0) {
+		return true;
+	}
+
+	onewire_swio_setup_progbuf(con, SWIO_PROGBUF_LOAD, address);
+
+	/* Load first word into x8 */
+	onewire_swio_write_reg(con, SWIO_DM_COMMAND, SWIO_CMD_EXEC);
+
+	if(nb_words > 1) {
+		/* DATA0 <= x8, then load next word into x8 */
+		onewire_swio_write_reg(con, SWIO_DM_COMMAND, SWIO_CMD_READ_X8_EXEC);
+		if(nb_words > 2) {
+			onewire_swio_write_reg(con, SWIO_DM_ABSTRACTAUTO, 1);
+		}
+		for(i=0; i<nb_words-2; i++) {
+			data[i] = onewire_swio_read_reg(con, SWIO_DM_DATA0);
+		}
+		onewire_swio_write_reg(con, SWIO_DM_ABSTRACTAUTO, 0);
+		data[nb_words-2] = onewire_swio_read_reg(con, SWIO_DM_DATA0);
+	}
+
+	/* Last word is already in x8 */
+	onewire_swio_write_reg(con, SWIO_DM_COMMAND, SWIO_CMD_READ_X8);
+	data[nb_words-1] = onewire_swio_read_reg(con, SWIO_DM_DATA0);
+
+	return onewire_swio_cmd_status(con);
+}
+
+/*
+ * Writes nb_words 32-bit words starting at address. Hart must be halted.
+ * Each DATA0 write triggers "write x8 then execute" through autoexecdata.
+ */
+bool onewire_swio_write_mem(t_hydra_console *con, uint32_t address, uint32_t *data, uint32_t nb_words)
+{
+	uint32_t i;
+
+	if(nb_words == 0) {
+		return true;
+	}
+
+	onewire_swio_setup_progbuf(con, SWIO_PROGBUF_STORE, address);
+
+	onewire_swio_write_reg(con, SWIO_DM_DATA0, data[0]);
+	onewire_swio_write_reg(con, SWIO_DM_COMMAND, SWIO_CMD_WRITE_X8_EXEC);
+
+	onewire_swio_write_reg(con, SWIO_DM_ABSTRACTAUTO, 1);
+	for(i=1; i<nb_words; i++) {
+		onewire_swio_write_reg(con, SWIO_DM_DATA0, data[i]);
+	}
+	onewire_swio_write_reg(con, SWIO_DM_ABSTRACTAUTO, 0);
+
+	return onewire_swio_cmd_status(con);
+}
+
 void onewire_swio_debug(t_hydra_console *con)
 {
 	uint32_t value;
@@ -26,6 +26,21 @@
 #define ONEWIRE_CMD_MATCHROM			0x55
 #define ONEWIRE_CMD_SEARCHROM			0xF0
 #define ONEWIRE_CMD_SKIPROM			0xCC
+#define ONEWIRE_CMD_ALARMSEARCH			0xEC
+
+/* SWIO debug module registers */
+#define SWIO_DM_DATA0				0x04
+#define SWIO_DM_DATA1				0x05
+#define SWIO_DM_CONTROL				0x10
+#define SWIO_DM_STATUS				0x11
+#define SWIO_DM_ABSTRACTCS			0x16
+#define SWIO_DM_COMMAND				0x17
+#define SWIO_DM_ABSTRACTAUTO			0x18
+#define SWIO_DM_PROGBUF0			0x20
+#define SWIO_DM_PROGBUF1			0x21
+
+#define SWIO_DM_ABSTRACTCS_BUSY			(1<<12)
+#define SWIO_DM_ABSTRACTCS_CMDERR		(0b111<<8)
 
 
 void onewire_init_proto_default(t_hydra_console *con);
@@ -45,6 +60,8 @@ uint8_t onewire_swio_read_bit(t_hydra_console *con);
 uint32_t onewire_swio_read_reg(t_hydra_console *con, uint8_t address);
 void onewire_swio_write_reg(t_hydra_console *con, uint8_t address, uint32_t value);
 void onewire_swio_debug(t_hydra_console *con);
+bool onewire_swio_read_mem(t_hydra_console *con, uint32_t address, uint32_t *data, uint32_t nb_words);
+bool onewire_swio_write_mem(t_hydra_console *con, uint32_t address, uint32_t *data, uint32_t nb_words);
 
 struct onewire_scan_state {
 	uint8_t ROM_ADDR[8];
@@ -52,8 +69,13 @@ struct onewire_scan_state {
 	int last_family_discrepancy;
 	bool last_device_p;
 	uint8_t crc8;
+	uint8_t search_cmd;
 };
 enum onewire_scan_mode {
 	onewire_scan_start,
 	onewire_scan_continue,
+	onewire_scan_family,
 };
+
+bool onewire_search(t_hydra_console *con, struct onewire_scan_state *state, enum onewire_scan_mode mode);
+bool onewire_match_rom(t_hydra_console *con, uint8_t *rom);
@@ -20,6 +20,7 @@
 #include "hydrabus_mode_smartcard.h"
 #include "bsp.h"
 #include "bsp_smartcard.h"
+#include "hydrabus_smartcard_iso7816.h"
 #include <string.h>
 
 #define SMARTCARD_DEFAULT_SPEED (9408)
@@ -37,17 +38,11 @@ static const char* str_prompt_smartcard[] = {
 
 static const char* str_bsp_init_err= { "bsp_smartcard_init() error %d\r\n" };
 
-/* Since the hardware cannot apply inverse convention, we manage it here */
+static smartcard_iso7816_t iso7816;
+
 static void apply_convention(t_hydra_console *con, uint8_t * data, uint8_t nb_data)
 {
-	mode_config_proto_t* proto = &con->mode->proto;
-	uint8_t i;
-	if(proto->config.smartcard.dev_convention == DEV_CONVENTION_INVERSE) {
-		for(i=0; i<nb_data; i++) {
-			data[i] = data[i] ^ 0xff;
-			data[i] = reverse_u8(data[i]);
-		}
-	}
+	smartcard_iso7816_convention(&con->mode->proto, data, nb_data);
 }
 
 static void init_proto_default(t_hydra_console *con)
@@ -172,6 +167,7 @@ static void smartcard_get_atr(t_hydra_console *con)
 		atr_size = 8;
 		atr_size = bsp_smartcard_read_u8(proto->dev_num, &atr[1], &atr_size, TIME_MS2I(100));
 		print_hex(con, atr, atr_size);
+		smartcard_iso7816_reset(&iso7816);
 		return;
 	}
 
@@ -239,10 +235,32 @@ static void smartcard_get_atr(t_hydra_console *con)
 		to_read = 1;
 		bsp_smartcard_read_u8(proto->dev_num, atr+r, &to_read, TIME_MS2I(proto->timeout));
 		apply_convention(con, atr+r, 1);
-		print_hex(con, atr, r+1);
-	} else {
-		print_hex(con, atr, r);
+		r++;
+	}
+	print_hex(con, atr, r);
+
+	smartcard_iso7816_parse_atr(&iso7816, atr, r);
+	cprintf(con, "Protocol: T=%d\r\n", iso7816.protocol);
+}
+
+static void smartcard_pps(t_hydra_console *con)
+{
+	mode_config_proto_t* proto = &con->mode->proto;
+	bsp_status_t status;
+
+	if(iso7816.atr_size == 0) {
+		cprintf(con, "Read card ATR first\r\n");
+		return;
 	}
+
+	status = smartcard_iso7816_pps(proto, &iso7816);
+	if(status != BSP_OK) {
+		cprintf(con, "PPS failed (%d), reset the card\r\n", status);
+		return;
+	}
+	cprintf(con, "Fi=%d, Di=%d, T=%d, speed: %d bps\r\n",
+		iso7816.fi, iso7816.di, iso7816.protocol,
+		proto->config.smartcard.dev_speed);
 }
 
 static void smartcard_rst_high(t_hydra_console *con)
@@ -453,6 +471,9 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 		case T_ATR:
 			smartcard_get_atr(con);
 			break;
+		case T_PPS:
+			smartcard_pps(con);
+			break;
 		default:
 			return t - token_pos;
 		}
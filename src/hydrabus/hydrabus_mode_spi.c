@@ -342,6 +342,51 @@ static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_d
 	return status;
 }
 
+/* The BSP transfers at most UINT8_MAX bytes at once */
+static uint32_t read_buf(t_hydra_console *con, uint8_t *rx_data, uint32_t *nb_data)
+{
+	uint32_t i, nb, status;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	status = BSP_OK;
+	for (i = 0; i < *nb_data; i += nb) {
+		nb = MIN(*nb_data - i, UINT8_MAX);
+		status = bsp_spi_read_u8(proto->dev_num, rx_data + i, nb);
+		if (status != BSP_OK) {
+			*nb_data = i;
+			break;
+		}
+	}
+	return status;
+}
+
+static uint32_t write_buf(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
+{
+	uint32_t i, nb, status;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	status = BSP_OK;
+	for (i = 0; i < nb_data && status == BSP_OK; i += nb) {
+		nb = MIN(nb_data - i, UINT8_MAX);
+		status = bsp_spi_write_u8(proto->dev_num, tx_data + i, nb);
+	}
+	return status;
+}
+
+static uint32_t write_read_buf(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint32_t nb_data)
+{
+	uint32_t i, nb, status;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	status = BSP_OK;
+	for (i = 0; i < nb_data && status == BSP_OK; i += nb) {
+		nb = MIN(nb_data - i, UINT8_MAX);
+		status = bsp_spi_write_read_u8(proto->dev_num, tx_data + i,
+					       rx_data + i, nb);
+	}
+	return status;
+}
+
 static void cleanup(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -387,6 +432,9 @@ const mode_exec_t mode_spi_exec = {
 	.read = &read,
 	.dump = &dump,
 	.write_read = &write_read,
+	.read_buf = &read_buf,
+	.write_buf = &write_buf,
+	.write_read_buf = &write_read_buf,
 	.cleanup = &cleanup,
 	.get_prompt = &get_prompt,
 };
@@ -80,14 +80,15 @@ void threewire_tim_init(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
 
-	bsp_tim_init(42, (THREEWIRE_MAX_FREQ/proto->config.rawwire.dev_speed), TIM_CLOCKDIVISION_DIV1, TIM_COUNTERMODE_UP);
+	/* One update event per clock edge */
+	bsp_tim_init_freq(2 * proto->config.rawwire.dev_speed);
 }
 
 void threewire_tim_set_prescaler(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
 
-	bsp_tim_set_prescaler((THREEWIRE_MAX_FREQ/proto->config.rawwire.dev_speed));
+	bsp_tim_set_freq(2 * proto->config.rawwire.dev_speed);
 }
 
 inline void threewire_sdo_high(t_hydra_console *con)
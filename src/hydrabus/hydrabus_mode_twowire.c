@@ -78,14 +78,15 @@ void twowire_tim_init(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
 
-	bsp_tim_init(42,(TWOWIRE_MAX_FREQ/proto->config.rawwire.dev_speed), TIM_CLOCKDIVISION_DIV1, TIM_COUNTERMODE_UP);
+	/* One update event per clock edge */
+	bsp_tim_init_freq(2 * proto->config.rawwire.dev_speed);
 }
 
 void twowire_tim_set_prescaler(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
 
-	bsp_tim_set_prescaler((TWOWIRE_MAX_FREQ/proto->config.rawwire.dev_speed));
+	bsp_tim_set_freq(2 * proto->config.rawwire.dev_speed);
 }
 
 static void twowire_sda_mode_input(t_hydra_console *con)
@@ -19,7 +19,7 @@
 #include "common.h"
 #include "hydrabus_mode_uart.h"
 #include "bsp_uart.h"
-#include "bsp_freq.h"
+#include "hydrabus_uart_autobaud.h"
 #include <string.h>
 
 #define UART_DEFAULT_SPEED (9600)
@@ -146,20 +146,39 @@ static void bridge(t_hydra_console *con)
 
 static void baudrate(t_hydra_console *con)
 {
-	uint32_t baudrate=0, tmp;
-	uint8_t i;
+	uart_autobaud_t res;
+	bsp_status_t status;
 	mode_config_proto_t* proto = &con->mode->proto;
 
-	for(i=0; i<10; i++) {
-		bsp_freq_get_baudrate(proto->dev_num, &tmp);
-		if(tmp > baudrate) {
-			baudrate = tmp;
-		}
+	cprintf(con, "Measuring on PC6, interrupt by pressing user button.\r\n");
+	status = uart_autobaud(proto->timeout, &res);
+	if(status == BSP_TIMEOUT) {
+		cprintf(con, "Not enough edges (%d), no UART traffic?\r\n", res.edges);
+		return;
+	} else if(status != BSP_OK) {
+		cprintf(con, "No bit time found.\r\n");
+		return;
 	}
-	cprintf(con, "Estimated baudrate : %d\r\n", baudrate);
-	cprintf(con, "\r\n");
 
-	bsp_freq_deinit(proto->dev_num);
+	cprintf(con, "Estimated baudrate : %d (measured %d, %d%% match)\r\n",
+		res.baudrate, res.measured, res.confidence);
+	if(res.data_bits == 0) {
+		cprintf(con, "Frame format: unknown\r\n");
+	} else {
+		cprintf(con, "Frame format: %d%c%d (%d frames)\r\n",
+			res.data_bits, "NEO"[res.parity], res.stop_bits,
+			res.frames);
+		if(res.data_bits != 8)
+			cprintf(con, "Only 8 data bits are supported, speed applied.\r\n");
+	}
+
+	status = uart_autobaud_apply(proto, &res);
+	if(status != BSP_OK) {
+		cprintf(con, str_bsp_init_err, status);
+		return;
+	}
+	cprintf(con, "\r\n");
+	show_params(con);
 }
 
 static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
@@ -366,6 +385,53 @@ static uint32_t write_read(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_d
 	return status;
 }
 
+/* The BSP transfers at most UINT8_MAX bytes at once */
+static uint32_t read_buf(t_hydra_console *con, uint8_t *rx_data, uint32_t *nb_data)
+{
+	uint32_t i, status;
+	uint8_t nb;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	status = BSP_OK;
+	for (i = 0; i < *nb_data; i += nb) {
+		nb = MIN(*nb_data - i, UINT8_MAX);
+		status = bsp_uart_read_u8(proto->dev_num, rx_data + i, &nb,
+					  TIME_MS2I(proto->timeout));
+		if (status != BSP_OK) {
+			*nb_data = i + nb;
+			break;
+		}
+	}
+	return status;
+}
+
+static uint32_t write_buf(t_hydra_console *con, uint8_t *tx_data, uint32_t nb_data)
+{
+	uint32_t i, nb, status;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	status = BSP_OK;
+	for (i = 0; i < nb_data && status == BSP_OK; i += nb) {
+		nb = MIN(nb_data - i, UINT8_MAX);
+		status = bsp_uart_write_u8(proto->dev_num, tx_data + i, nb);
+	}
+	return status;
+}
+
+static uint32_t write_read_buf(t_hydra_console *con, uint8_t *tx_data, uint8_t *rx_data, uint32_t nb_data)
+{
+	uint32_t i, nb, status;
+	mode_config_proto_t* proto = &con->mode->proto;
+
+	status = BSP_OK;
+	for (i = 0; i < nb_data && status == BSP_OK; i += nb) {
+		nb = MIN(nb_data - i, UINT8_MAX);
+		status = bsp_uart_write_read_u8(proto->dev_num, tx_data + i,
+						rx_data + i, nb);
+	}
+	return status;
+}
+
 static void cleanup(t_hydra_console *con)
 {
 	mode_config_proto_t* proto = &con->mode->proto;
@@ -403,6 +469,9 @@ const mode_exec_t mode_uart_exec = {
 	.read = &read,
 	.dump = &dump,
 	.write_read = &write_read,
+	.read_buf = &read_buf,
+	.write_buf = &write_buf,
+	.write_read_buf = &write_read_buf,
 	.cleanup = &cleanup,
 	.get_prompt = &get_prompt,
 };
@@ -148,37 +148,315 @@ static uint8_t wiegand_sense_pins(void)
 	return v;
 }
 
-uint8_t wiegand_read(t_hydra_console *con, uint8_t *rx_data)
+/*
+ * Receiver: both edges of D0 and D1 are timestamped with the cycle counter
+ * from the EXTI callback into a ring, the console thread assembles bits and
+ * frames from it. A frame ends after a silence of WIEGAND_FRAME_GAP_MS or
+ * four times the longest gap seen between its bits, whichever is longer.
+ */
+typedef struct {
+	uint32_t cycles;
+	uint8_t lines;
+} wiegand_edge_t;
+
+typedef struct {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+} wiegand_stat_t;
+
+typedef struct {
+	uint8_t bits[WIEGAND_MAX_BITS / 8];
+	uint16_t nb_bits;
+	uint8_t lines;
+	uint32_t pulse_start;
+	uint32_t pulse_end;
+	uint32_t gap_max;
+} wiegand_frame_t;
+
+static wiegand_edge_t wiegand_ring[WIEGAND_RING_SIZE];
+static volatile uint32_t wiegand_head;
+static volatile uint32_t wiegand_tail;
+static volatile uint32_t wiegand_overflows;
+static binary_semaphore_t wiegand_sem;
+
+static wiegand_frame_t wiegand_frame;
+static wiegand_stat_t wiegand_width;
+static wiegand_stat_t wiegand_gap;
+static uint32_t wiegand_frames;
+static uint32_t wiegand_parity_errors;
+static uint32_t wiegand_unknown;
+
+static void wiegand_edge_cb(void *arg)
 {
-	uint32_t start_time;
-	uint16_t i = 0;
-	uint8_t tmp = 0;
+	uint32_t cycles, head;
+
+	(void)arg;
+	cycles = bsp_get_cyclecounter();
+
+	chSysLockFromISR();
+	head = wiegand_head;
+	if (head - wiegand_tail < WIEGAND_RING_SIZE) {
+		wiegand_ring[head % WIEGAND_RING_SIZE].cycles = cycles;
+		wiegand_ring[head % WIEGAND_RING_SIZE].lines = wiegand_sense_pins();
+		wiegand_head = head + 1;
+	} else {
+		wiegand_overflows++;
+	}
+	chBSemSignalI(&wiegand_sem);
+	chSysUnlockFromISR();
+}
 
+static void wiegand_rx_start(t_hydra_console *con)
+{
 	wiegand_mode_input(con);
 
-	//Wait for first bit
-	start_time = HAL_GetTick();
-	while(tmp == 0 && !hydrabus_ubtn()) {
-		if((HAL_GetTick()-start_time) > WIEGAND_TIMEOUT_MAX) {
-			return 0;
+	memset(&wiegand_frame, 0, sizeof(wiegand_frame));
+	wiegand_head = 0;
+	wiegand_tail = 0;
+	chBSemObjectInit(&wiegand_sem, TRUE);
+
+	palEnablePadEvent(GPIOB, WIEGAND_D0_PIN, PAL_EVENT_MODE_BOTH_EDGES);
+	palSetPadCallback(GPIOB, WIEGAND_D0_PIN, wiegand_edge_cb, NULL);
+	palEnablePadEvent(GPIOB, WIEGAND_D1_PIN, PAL_EVENT_MODE_BOTH_EDGES);
+	palSetPadCallback(GPIOB, WIEGAND_D1_PIN, wiegand_edge_cb, NULL);
+}
+
+static void wiegand_rx_stop(void)
+{
+	palDisablePadEvent(GPIOB, WIEGAND_D0_PIN);
+	palDisablePadEvent(GPIOB, WIEGAND_D1_PIN);
+}
+
+static void wiegand_stats_reset(void)
+{
+	memset(&wiegand_width, 0, sizeof(wiegand_width));
+	memset(&wiegand_gap, 0, sizeof(wiegand_gap));
+	wiegand_frames = 0;
+	wiegand_parity_errors = 0;
+	wiegand_unknown = 0;
+	wiegand_overflows = 0;
+}
+
+static void wiegand_stat_add(wiegand_stat_t *stat, uint32_t cycles)
+{
+	if (stat->count == 0 || cycles < stat->min)
+		stat->min = cycles;
+	if (cycles > stat->max)
+		stat->max = cycles;
+	stat->total += cycles;
+	stat->count++;
+}
+
+static void wiegand_rx_edge(wiegand_frame_t *f, const wiegand_edge_t *e)
+{
+	uint32_t gap;
+
+	if (f->lines == 0 && e->lines != 0) {
+		/* Pulse start, D1 low is a 1 */
+		if (f->nb_bits > 0) {
+			gap = e->cycles - f->pulse_end;
+			wiegand_stat_add(&wiegand_gap, gap);
+			if (gap > f->gap_max)
+				f->gap_max = gap;
 		}
-		tmp = wiegand_sense_pins();
+		if (f->nb_bits < WIEGAND_MAX_BITS) {
+			if (e->lines == 0b10)
+				f->bits[f->nb_bits / 8] |= 0x80 >> (f->nb_bits % 8);
+			f->nb_bits++;
+		}
+		f->pulse_start = e->cycles;
+	} else if (f->lines != 0 && e->lines == 0) {
+		/* Pulse end */
+		wiegand_stat_add(&wiegand_width, e->cycles - f->pulse_start);
+		f->pulse_end = e->cycles;
 	}
+	f->lines = e->lines;
+}
 
-	while(i < 255 && !hydrabus_ubtn()) {
-		tmp = wiegand_sense_pins();
-		if(tmp == 0) {
-			if((HAL_GetTick()-start_time) > WIEGAND_TIMEOUT_FRAME) {
-				return i;
-			}
-		} else {
-			rx_data[i++] = tmp;
-			while(wiegand_sense_pins() != 0) {
-			}
-			start_time = HAL_GetTick();
+/*
+ * Processes the pending edges, waiting up to timeout for new ones.
+ * Returns TRUE when wiegand_frame holds a complete frame.
+ */
+static bool wiegand_rx_poll(sysinterval_t timeout)
+{
+	wiegand_frame_t *f = &wiegand_frame;
+	uint32_t silence;
+
+	chBSemWaitTimeout(&wiegand_sem, timeout);
+	while (wiegand_tail != wiegand_head) {
+		wiegand_rx_edge(f, &wiegand_ring[wiegand_tail % WIEGAND_RING_SIZE]);
+		wiegand_tail++;
+	}
+
+	if (f->nb_bits == 0 || f->lines != 0)
+		return FALSE;
+	silence = WIEGAND_FRAME_GAP_MS * (STM32_HCLK / 1000);
+	if (4 * f->gap_max > silence)
+		silence = 4 * f->gap_max;
+	return (bsp_get_cyclecounter() - f->pulse_end) > silence;
+}
+
+static void wiegand_rx_next(void)
+{
+	memset(wiegand_frame.bits, 0, sizeof(wiegand_frame.bits));
+	wiegand_frame.nb_bits = 0;
+	wiegand_frame.gap_max = 0;
+}
+
+static uint32_t wiegand_field(uint64_t v, uint8_t n, uint8_t pos, uint8_t len)
+{
+	return (v >> (n - pos - len)) & ((1ULL << len) - 1);
+}
+
+/* Parity of the bits first to last, every bit or those with i % 3 != skip */
+static uint8_t wiegand_parity(uint64_t v, uint8_t n, uint8_t first,
+			      uint8_t last, int skip)
+{
+	uint8_t i, parity;
+
+	parity = 0;
+	for (i = first; i <= last; i++) {
+		if (skip < 0 || (i % 3) != skip)
+			parity ^= wiegand_field(v, n, i, 1);
+	}
+	return parity;
+}
+
+/* Leading even parity up to even_last, trailing odd parity from odd_first */
+static bool wiegand_check_std(uint64_t v, uint8_t n, uint8_t even_last,
+			      uint8_t odd_first)
+{
+	return wiegand_parity(v, n, 0, even_last, -1) == 0 &&
+	       wiegand_parity(v, n, odd_first, n - 1, -1) == 1;
+}
+
+/* HID Corporate 1000: interleaved even/odd parities and an overall odd one */
+static bool wiegand_check_c1k(uint64_t v, uint8_t n, uint8_t even_last,
+			      uint8_t odd_last)
+{
+	return (wiegand_parity(v, n, 2, even_last, 1) ^
+		wiegand_field(v, n, 1, 1)) == 0 &&
+	       (wiegand_parity(v, n, 1, odd_last, 0) ^
+		wiegand_field(v, n, n - 1, 1)) == 1 &&
+	       wiegand_parity(v, n, 0, n - 1, -1) == 1;
+}
+
+static const struct {
+	uint8_t nb_bits;
+	const char *name;
+	bool c1k;
+	uint8_t parity_a;
+	uint8_t parity_b;
+	uint8_t fc_pos;
+	uint8_t fc_len;
+	uint8_t cn_pos;
+	uint8_t cn_len;
+} wiegand_formats[] = {
+	{ 26, "H10301", FALSE, 12, 13, 1, 8, 9, 16 },
+	{ 34, "H10306", FALSE, 16, 17, 1, 16, 17, 16 },
+	{ 35, "C1k35s", TRUE, 33, 32, 2, 12, 14, 20 },
+	{ 37, "H10304", FALSE, 18, 18, 1, 16, 17, 19 },
+	{ 48, "C1k48s", TRUE, 45, 44, 2, 22, 24, 23 },
+};
+
+static void wiegand_print_frame(t_hydra_console *con, wiegand_frame_t *f)
+{
+	uint64_t v;
+	uint16_t i, fmt;
+	bool ok;
+
+	wiegand_frames++;
+	cprintf(con, "%d bits: ", f->nb_bits);
+	for (i = 0; i < (f->nb_bits + 7) / 8; i++)
+		cprintf(con, "%02X", f->bits[i]);
+
+	for (fmt = 0; fmt < ARRAY_SIZE(wiegand_formats); fmt++) {
+		if (wiegand_formats[fmt].nb_bits == f->nb_bits)
+			break;
+	}
+	if (fmt == ARRAY_SIZE(wiegand_formats)) {
+		wiegand_unknown++;
+		cprintf(con, "\r\n");
+		return;
+	}
+
+	v = 0;
+	for (i = 0; i < f->nb_bits; i++)
+		v = (v << 1) | ((f->bits[i / 8] >> (7 - (i % 8))) & 1);
+
+	if (wiegand_formats[fmt].c1k)
+		ok = wiegand_check_c1k(v, f->nb_bits, wiegand_formats[fmt].parity_a,
+				       wiegand_formats[fmt].parity_b);
+	else
+		ok = wiegand_check_std(v, f->nb_bits, wiegand_formats[fmt].parity_a,
+				       wiegand_formats[fmt].parity_b);
+	if (!ok)
+		wiegand_parity_errors++;
+
+	cprintf(con, " %s FC:%d CN:%d%s\r\n", wiegand_formats[fmt].name,
+		wiegand_field(v, f->nb_bits, wiegand_formats[fmt].fc_pos,
+			      wiegand_formats[fmt].fc_len),
+		wiegand_field(v, f->nb_bits, wiegand_formats[fmt].cn_pos,
+			      wiegand_formats[fmt].cn_len),
+		ok ? "" : " parity error");
+}
+
+static void wiegand_print_stat(t_hydra_console *con, const char *name,
+			       wiegand_stat_t *stat)
+{
+	const uint32_t cycles_us = STM32_HCLK / 1000000;
+
+	if (stat->count == 0)
+		return;
+	cprintf(con, "%s: min %dus avg %dus max %dus\r\n", name,
+		stat->min / cycles_us,
+		(uint32_t)(stat->total / stat->count) / cycles_us,
+		stat->max / cycles_us);
+}
+
+static void wiegand_print_stats(t_hydra_console *con)
+{
+	cprintf(con, "Frames: %d, parity errors: %d, unknown format: %d, lost edges: %d\r\n",
+		wiegand_frames, wiegand_parity_errors, wiegand_unknown,
+		wiegand_overflows);
+	wiegand_print_stat(con, "Pulse width", &wiegand_width);
+	wiegand_print_stat(con, "Pulse gap", &wiegand_gap);
+}
+
+/* Receives one frame, returns FALSE on timeout or UBTN */
+static bool wiegand_read_frame(t_hydra_console *con, uint32_t timeout_ms)
+{
+	systime_t start;
+
+	wiegand_rx_start(con);
+	start = chVTGetSystemTime();
+	while (!wiegand_rx_poll(TIME_MS2I(WIEGAND_POLL_MS))) {
+		if (hydrabus_ubtn() || (wiegand_frame.nb_bits == 0 &&
+		    chVTTimeElapsedSinceX(start) > TIME_MS2I(timeout_ms))) {
+			wiegand_rx_stop();
+			return FALSE;
+		}
+	}
+	wiegand_rx_stop();
+	return TRUE;
+}
+
+/* Prints every frame until UBTN */
+static void wiegand_sniff(t_hydra_console *con)
+{
+	cprintf(con, "Interrupt by pressing user button.\r\n");
+	wiegand_stats_reset();
+	wiegand_rx_start(con);
+	while (!hydrabus_ubtn()) {
+		if (wiegand_rx_poll(TIME_MS2I(WIEGAND_POLL_MS))) {
+			wiegand_print_frame(con, &wiegand_frame);
+			wiegand_rx_next();
 		}
 	}
-	return 0;
+	wiegand_rx_stop();
+	wiegand_print_stats(con);
 }
 
 void wiegand_write_u8(t_hydra_console *con, uint8_t tx_data)
@@ -219,6 +497,9 @@ static int exec(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 		case T_SHOW:
 			t += show(con, p);
 			break;
+		case T_SNIFF:
+			wiegand_sniff(con);
+			break;
 		case T_PULL:
 			switch (p->tokens[++t]) {
 			case T_UP:
@@ -264,18 +545,13 @@ static uint32_t write(t_hydra_console *con, uint8_t *tx_data, uint8_t nb_data)
 
 static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 {
-	uint8_t i;
-	uint8_t nb_bits;
+	(void)rx_data;
 
+	wiegand_stats_reset();
 	while(nb_data > 0) {
-		nb_bits = wiegand_read(con, rx_data);
-
-		cprintf(con, hydrabus_mode_str_mul_read);
-		for(i = 0; i < nb_bits; i++) {
-			cprintf(con, "%d ",
-				rx_data[i] == 0b10 ? 1 : 0);
-		}
-		cprintf(con, hydrabus_mode_str_mul_br);
+		if (!wiegand_read_frame(con, WIEGAND_TIMEOUT_MAX))
+			break;
+		wiegand_print_frame(con, &wiegand_frame);
 		nb_data--;
 	}
 	return BSP_OK;
@@ -284,6 +560,8 @@ static uint32_t read(t_hydra_console *con, uint8_t *rx_data, uint8_t nb_data)
 void wiegand_cleanup(t_hydra_console *con)
 {
 	(void)con;
+
+	wiegand_rx_stop();
 }
 
 static int show(t_hydra_console *con, t_tokenline_parsed *p)
@@ -297,6 +575,7 @@ static int show(t_hydra_console *con, t_tokenline_parsed *p)
 		cprintf(con, "D1: PB%d\r\n", WIEGAND_D1_PIN);
 	} else {
 		show_params(con);
+		wiegand_print_stats(con);
 	}
 	return tokens_used;
 }
@@ -22,12 +22,15 @@
 #define WIEGAND_D0_PIN	 8
 #define WIEGAND_D1_PIN	 9
 
-#define WIEGAND_TIMEOUT_MAX 100000  // Max 200ms between bits
-#define WIEGAND_TIMEOUT_FRAME 2000  // Max 200ms between bits
+#define WIEGAND_TIMEOUT_MAX 100000  // Max wait for a frame (ms)
+#define WIEGAND_FRAME_GAP_MS 25  // Min silence ending a frame (ms)
+#define WIEGAND_POLL_MS 5
+
+#define WIEGAND_MAX_BITS 512
+#define WIEGAND_RING_SIZE 256  // Edges, power of 2
 
 void wiegand_init_proto_default(t_hydra_console *con);
 bool wiegand_pin_init(t_hydra_console *con);
-uint8_t wiegand_read(t_hydra_console *con, uint8_t *rx_data);
 void wiegand_write_u8(t_hydra_console *con, uint8_t tx_data);
 inline void wiegand_d0_high(void);
 inline void wiegand_d0_low(void);
@@ -22,51 +22,196 @@
 #include "bsp.h"
 #include "bsp_pwm.h"
 
+#include <stdlib.h>
 #include <string.h>
 
+/* Largest DMA sequence (words, pool) */
+#define PWM_SEQ_MAX	(4096)
+
 int frequency = 10000;
 int duty_cycle = 50;
 
 static const char *pwm_channel_names[] = {
-	"PWM1"
+	"PWM1 (PB11)",
+	"PWM2 (PB10)",
+	"PWM3 (PB3)",
+	"PWM4 (PA15)"
 };
 
-static int pwm_write(t_hydra_console *con, uint32_t freq, uint32_t dc)
+/* Sequence played by DMA, kept until the next pwm command when looping */
+static uint32_t *pwm_seq_buf;
+
+static void pwm_seq_free(void)
+{
+	if (pwm_seq_buf == NULL)
+		return;
+
+	bsp_pwm_seq_stop();
+	pool_free(pwm_seq_buf);
+	pwm_seq_buf = NULL;
+}
+
+static void pwm_show(t_hydra_console *con)
 {
-	bsp_status_t status;
-	bsp_dev_pwm_t pwm_src;
 	uint32_t final_freq;
 	uint32_t final_duty_cycle_percent;
+	int i;
+
+	for (i = 0; i < BSP_DEV_PWM_END; i++) {
+		if (!bsp_pwm_is_active(i))
+			continue;
+		bsp_pwm_get(i, &final_freq, &final_duty_cycle_percent);
+		cprintf(con, "%s ", pwm_channel_names[i]);
+		cprintf(con, "Frequency: %d, Duty Cycle: %d%%(+/-1%%), Resolution: %d steps\r\n",
+			final_freq, final_duty_cycle_percent, bsp_pwm_get_resolution());
+	}
+}
+
+static int pwm_start(t_hydra_console *con, bsp_dev_pwm_t pwm_src)
+{
+	bsp_status_t status;
+
+	if (bsp_pwm_is_active(pwm_src))
+		return TRUE;
 
-	pwm_src = BSP_DEV_PWM1;
 	if ((status = bsp_pwm_init(pwm_src)) != BSP_OK) {
 		cprintf(con, "bsp_pwm_init error: %d\r\n", status);
 		return FALSE;
 	}
+	return TRUE;
+}
+
+static int pwm_write(t_hydra_console *con, bsp_dev_pwm_t pwm_src, uint32_t freq, uint32_t dc)
+{
+	bsp_status_t status;
+
+	if (!pwm_start(con, pwm_src))
+		return FALSE;
 
 	if ((status = bsp_pwm_update(pwm_src, freq, dc)) != BSP_OK) {
 		cprintf(con, "bsp_pwm_update error: %d\r\n", status);
 		return FALSE;
 	}
-	bsp_pwm_get(pwm_src, &final_freq, &final_duty_cycle_percent);
-
-	cprintf(con, "%s ", pwm_channel_names[0]);
-	cprintf(con, "Frequency: %d, Duty Cycle: %d%%(+/-1%%)\r\n",
-		final_freq, final_duty_cycle_percent);
+	pwm_show(con);
 
 	return TRUE;
 }
 
+/*
+ * Burst of nb_pulses periods at duty cycle dc, or a sequence of duty
+ * cycles in % (one per period), played repeat times (0 loops).
+ */
+static void pwm_sequence(t_hydra_console *con, bsp_dev_pwm_t pwm_src, uint32_t freq,
+			 uint32_t dc, uint32_t nb_pulses, char *seq, uint32_t repeat)
+{
+	bsp_status_t status;
+	uint32_t steps, i;
+	uint32_t *buf;
+	char *end;
+
+	if (!pwm_start(con, pwm_src))
+		return;
+	if ((status = bsp_pwm_set_frequency(freq)) != BSP_OK) {
+		cprintf(con, "bsp_pwm_set_frequency error: %d\r\n", status);
+		return;
+	}
+
+	buf = pool_alloc_bytes(PWM_SEQ_MAX * sizeof(uint32_t));
+	if (buf == NULL) {
+		cprintf(con, "Not enough memory\r\n");
+		return;
+	}
+
+	steps = 0;
+	if (seq == NULL) {
+		/* Pulses then output held low */
+		if (nb_pulses == 0 || nb_pulses >= PWM_SEQ_MAX) {
+			cprintf(con, "Burst must be between 1 and %d pulses\r\n", PWM_SEQ_MAX - 1);
+			pool_free(buf);
+			return;
+		}
+		for (steps = 0; steps < nb_pulses; steps++)
+			buf[steps] = (dc * BSP_PWM_DUTY_MAX) / 100;
+		buf[steps++] = 0;
+		repeat = 1;
+	} else {
+		while (*seq) {
+			i = strtoul(seq, &end, 10);
+			if (end == seq || i > 100 || steps == PWM_SEQ_MAX) {
+				cprintf(con, "Invalid sequence: %s\r\n", seq);
+				pool_free(buf);
+				return;
+			}
+			buf[steps++] = (i * BSP_PWM_DUTY_MAX) / 100;
+			seq = end;
+			while (*seq == ',' || *seq == ' ')
+				seq++;
+		}
+		if (steps == 0) {
+			cprintf(con, "Invalid sequence\r\n");
+			pool_free(buf);
+			return;
+		}
+		if (repeat > PWM_SEQ_MAX / steps) {
+			cprintf(con, "Sequence too long\r\n");
+			pool_free(buf);
+			return;
+		}
+		for (i = 1; i < repeat; i++)
+			memcpy(&buf[i * steps], buf, steps * sizeof(uint32_t));
+		if (repeat > 1)
+			steps *= repeat;
+		if (steps == 1)
+			buf[steps++] = buf[0];
+	}
+
+	status = bsp_pwm_seq_start(1 << pwm_src, buf, steps, PWM_SEQ_MAX, repeat == 0);
+	if (status != BSP_OK) {
+		cprintf(con, "bsp_pwm_seq_start error: %d\r\n", status);
+		pool_free(buf);
+		return;
+	}
+	pwm_seq_buf = buf;
+	pwm_show(con);
+
+	if (repeat == 0) {
+		cprintf(con, "Sequence of %d steps running\r\n", steps);
+		return;
+	}
+	while (!bsp_pwm_seq_done() && !hydrabus_ubtn())
+		chThdSleepMilliseconds(1);
+	cprintf(con, "%d steps done\r\n", steps);
+	pwm_seq_free();
+}
+
 int cmd_pwm(t_hydra_console *con, t_tokenline_parsed *p)
 {
-	int t;
+	bsp_dev_pwm_t pwm_src;
+	uint32_t nb_pulses, repeat;
+	int t, channel, show;
+	char *seq;
 
 	if (p->tokens[1] == 0)
 		return FALSE;
 
+	pwm_src = BSP_DEV_PWM1;
+	channel = 0;
+	nb_pulses = 0;
+	repeat = 0;
+	show = FALSE;
+	seq = NULL;
 	t = 1;
 	while (p->tokens[t]) {
 		switch (p->tokens[t++]) {
+		case T_CHANNEL:
+			t += 1;
+			memcpy(&channel, p->buf + p->tokens[t++], sizeof(int));
+			if (channel < 1 || channel > BSP_DEV_PWM_END) {
+				cprintf(con, "Channel must be between 1 and %d\r\n", BSP_DEV_PWM_END);
+				return TRUE;
+			}
+			pwm_src = channel - 1;
+			break;
 		case T_FREQUENCY:
 			t += 1;
 			memcpy(&frequency, p->buf + p->tokens[t++], sizeof(int));
@@ -75,8 +220,29 @@ int cmd_pwm(t_hydra_console *con, t_tokenline_parsed *p)
 			t += 1;
 			memcpy(&duty_cycle, p->buf + p->tokens[t++], sizeof(int));
 			break;
+		case T_BURST:
+			t += 1;
+			memcpy(&nb_pulses, p->buf + p->tokens[t++], sizeof(uint32_t));
+			break;
+		case T_SEQUENCE:
+			t += 1;
+			seq = p->buf + p->tokens[t++];
+			break;
+		case T_REPEAT:
+			t += 1;
+			memcpy(&repeat, p->buf + p->tokens[t++], sizeof(uint32_t));
+			break;
+		case T_SHOW:
+			show = TRUE;
+			break;
 		case T_EXIT:
-			bsp_pwm_deinit(BSP_DEV_PWM1);
+			pwm_seq_free();
+			if (channel == 0) {
+				for (channel = 0; channel < BSP_DEV_PWM_END; channel++)
+					bsp_pwm_deinit(channel);
+			} else {
+				bsp_pwm_deinit(pwm_src);
+			}
 			return TRUE;
 		case T_HELP:
 			cprintf(con, "Specify at least frequency or/and duty-cycle.\r\n");
@@ -84,8 +250,16 @@ int cmd_pwm(t_hydra_console *con, t_tokenline_parsed *p)
 		}
 	}
 
-	pwm_write(con, frequency, duty_cycle);
+	if (show && t == 2) {
+		pwm_show(con);
+		return TRUE;
+	}
+
+	pwm_seq_free();
+	if (nb_pulses > 0 || seq != NULL)
+		pwm_sequence(con, pwm_src, frequency, duty_cycle, nb_pulses, seq, repeat);
+	else
+		pwm_write(con, pwm_src, frequency, duty_cycle);
 
 	return TRUE;
 }
-
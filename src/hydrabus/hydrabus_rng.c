@@ -25,15 +25,102 @@
 #include <string.h>
 
 
-int cmd_rng(t_hydra_console *con, t_tokenline_parsed *p)
+#define RNG_BUFFER_SIZE	0x1000
+
+static void print_rng_words(t_hydra_console *con, uint32_t *data,
+			    uint32_t nb_words, int raw)
 {
-	(void)p;
+	uint32_t i;
 
-	bsp_rng_init();
+	if(raw) {
+		cprint(con, (char *)data, nb_words * 4);
+		return;
+	}
+	for(i = 0; i < nb_words; i++) {
+		cprintf(con, "%08X%s", data[i], ((i & 7) == 7) ? "\r\n" : " ");
+	}
+	if(nb_words & 7)
+		cprintf(con, "\r\n");
+}
+
+static int rng_stream(t_hydra_console *con, uint32_t count, int continuous,
+		      int raw)
+{
+	bsp_rng_stats_t stats;
+	uint32_t *buffer0, *buffer1, *data;
+	uint32_t nb_words;
 
-	cprintf(con, "%08X\r\n", bsp_rng_read());
+	buffer0 = pool_alloc_bytes(RNG_BUFFER_SIZE);
+	buffer1 = pool_alloc_bytes(RNG_BUFFER_SIZE);
+	if(buffer0 == NULL || buffer1 == NULL) {
+		cprintf(con, "Unable to allocate buffer\r\n");
+		pool_free(buffer0);
+		pool_free(buffer1);
+		return FALSE;
+	}
 
-	bsp_rng_deinit();
+	if(!raw && (continuous || count > 64))
+		cprintf(con, "Interrupt by pressing user button.\r\n");
 
+	bsp_rng_stream_start(buffer0, buffer1, RNG_BUFFER_SIZE / 4);
+	while(!hydrabus_ubtn() && (continuous || count > 0)) {
+		data = bsp_rng_stream_get(TIME_MS2I(100));
+		if(data == NULL) {
+			break;
+		}
+		nb_words = RNG_BUFFER_SIZE / 4;
+		if(!continuous && count < nb_words)
+			nb_words = count;
+		print_rng_words(con, data, nb_words, raw);
+		bsp_rng_stream_release();
+		if(!continuous)
+			count -= nb_words;
+	}
+	bsp_rng_stream_stop(&stats);
+
+	if(!raw || stats.seed_errors || stats.clock_errors) {
+		cprintf(con, "Seed errors : %d\r\nClock errors : %d\r\n",
+			stats.seed_errors, stats.clock_errors);
+	}
+
+	pool_free(buffer0);
+	pool_free(buffer1);
 	return TRUE;
 }
+
+int cmd_rng(t_hydra_console *con, t_tokenline_parsed *p)
+{
+	uint32_t count;
+	int t, continuous, raw;
+
+	t = 1;
+	count = 1;
+	continuous = FALSE;
+	raw = FALSE;
+	while (p->tokens[t]) {
+		switch (p->tokens[t++]) {
+		case T_SAMPLES:
+			t += 1;
+			memcpy(&count, p->buf + p->tokens[t++], sizeof(uint32_t));
+			break;
+		case T_CONTINUOUS:
+			continuous = TRUE;
+			break;
+		case T_RAW:
+			raw = TRUE;
+			break;
+		}
+	}
+
+	if(!continuous && count <= 1 && !raw) {
+		bsp_rng_init();
+
+		cprintf(con, "%08X\r\n", bsp_rng_read());
+
+		bsp_rng_deinit();
+
+		return TRUE;
+	}
+
+	return rng_stream(con, count, continuous, raw);
+}
@@ -29,6 +29,8 @@
 #include "common.h"
 
 #include "script.h"
+#include "hydrabus_sd_xfer.h"
+#include "hydrabus_sd_bench.h"
 
 /* FS object.*/
 extern FATFS SDC_FS;
@@ -783,6 +785,9 @@ int cmd_sd(t_hydra_console *con, t_tokenline_parsed *p)
 	case T_TESTPERF:
 		ret = cmd_sd_test_perf(con, p);
 		break;
+	case T_BENCHMARK:
+		ret = cmd_sd_bench(con, p);
+		break;
 	case T_RM:
 		ret = cmd_sd_rm(con, p);
 		break;
@@ -792,6 +797,9 @@ int cmd_sd(t_hydra_console *con, t_tokenline_parsed *p)
 	case T_SCRIPT:
 		ret = cmd_sd_script(con, p);
 		break;
+	case T_TRANSFER:
+		ret = cmd_sd_xfer(con, p);
+		break;
 	default:
 		return FALSE;
 	}
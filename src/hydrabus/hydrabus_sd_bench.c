@@ -0,0 +1,506 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * SD card benchmark suite.
+ *
+ * Raw tests never touch blocks outside of a scratch file: its clusters are
+ * allocated through FatFS then accessed with blkRead()/blkWrite(), so the
+ * filesystem stays consistent whatever is written. The same file is used
+ * for the f_read()/f_write() tests, then a second file is grown cluster by
+ * cluster to measure the allocation cost.
+ *
+ * Each test runs for SD_BENCH_MS, per operation latencies are timed with
+ * the DWT cycle counter and sampled for percentiles.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include "ch.h"
+#include "hal.h"
+
+#include "ff.h"
+
+#include "bsp.h"
+#include "microsd.h"
+#include "common.h"
+#include "hydrabus_sd_bench.h"
+
+#define SD_BENCH_SCRATCH	(16 * 1024 * 1024)
+#define SD_BENCH_BUF_SIZE	(16384)
+#define SD_BENCH_MS		(1000)
+#define SD_BENCH_SAMPLES	(256)
+#define SD_BENCH_ALLOC_CLUSTERS	(64)
+#define SD_BENCH_MAX_RESULTS	(32)
+
+#define SD_BENCH_FILE		"0:sdbench.tmp"
+#define SD_BENCH_ALLOC_FILE	"0:sdbench.al"
+#define SD_BENCH_CSV		"0:sdbench.csv"
+
+#define CYCLES_PER_US		(STM32_HCLK / 1000000)
+
+typedef struct {
+	const char *name;
+	uint32_t size;
+	bool aligned;
+	uint32_t ops;
+	uint64_t bytes;
+	uint64_t cycles;
+	/* In us */
+	uint32_t p50;
+	uint32_t p99;
+	uint32_t max;
+} sd_bench_result_t;
+
+typedef struct {
+	t_hydra_console *con;
+	FIL fp;
+	uint8_t *buf;
+	uint32_t cluster;
+	uint32_t rand;
+	systime_t start;
+	uint32_t samples[SD_BENCH_SAMPLES];
+	sd_bench_result_t res[SD_BENCH_MAX_RESULTS];
+	uint8_t nb_res;
+	char line[96];
+} sd_bench_t;
+
+static const uint32_t seq_sizes[] = { 512, 4096, SD_BENCH_BUF_SIZE };
+static const uint32_t rnd_sizes[] = { 512, 4096 };
+
+static uint32_t bench_rand(sd_bench_t *b)
+{
+	/* xorshift32, fixed seed so runs are comparable */
+	b->rand ^= b->rand << 13;
+	b->rand ^= b->rand >> 17;
+	b->rand ^= b->rand << 5;
+	return b->rand;
+}
+
+static sd_bench_result_t *bench_begin(sd_bench_t *b, const char *name,
+				      uint32_t size, bool aligned)
+{
+	sd_bench_result_t *r;
+
+	r = &b->res[b->nb_res];
+	memset(r, 0, sizeof(sd_bench_result_t));
+	r->name = name;
+	r->size = size;
+	r->aligned = aligned;
+	b->start = chVTGetSystemTime();
+	return r;
+}
+
+static bool bench_running(sd_bench_t *b)
+{
+	return chVTIsSystemTimeWithin(b->start, b->start + TIME_MS2I(SD_BENCH_MS)) &&
+	       !hydrabus_ubtn();
+}
+
+/* Reservoir sampling keeps a uniform sample of all the latencies */
+static void bench_add(sd_bench_t *b, sd_bench_result_t *r, uint32_t cycles,
+		      uint32_t bytes)
+{
+	uint32_t j;
+
+	if (r->ops < SD_BENCH_SAMPLES) {
+		b->samples[r->ops] = cycles;
+	} else {
+		j = bench_rand(b) % (r->ops + 1);
+		if (j < SD_BENCH_SAMPLES)
+			b->samples[j] = cycles;
+	}
+	r->ops++;
+	r->bytes += bytes;
+	r->cycles += cycles;
+}
+
+static uint32_t bench_kibs(sd_bench_result_t *r)
+{
+	uint64_t us;
+
+	us = r->cycles / CYCLES_PER_US;
+	if (us == 0)
+		return 0;
+	return (uint32_t)((r->bytes * 1000000) / 1024 / us);
+}
+
+static void bench_end(sd_bench_t *b, sd_bench_result_t *r)
+{
+	uint32_t i, j, n, tmp;
+
+	n = (r->ops < SD_BENCH_SAMPLES) ? r->ops : SD_BENCH_SAMPLES;
+	for (i = 1; i < n; i++) {
+		tmp = b->samples[i];
+		for (j = i; j > 0 && b->samples[j - 1] > tmp; j--)
+			b->samples[j] = b->samples[j - 1];
+		b->samples[j] = tmp;
+	}
+	if (n > 0) {
+		r->p50 = b->samples[(n * 50) / 100] / CYCLES_PER_US;
+		r->p99 = b->samples[(n * 99) / 100] / CYCLES_PER_US;
+		r->max = b->samples[n - 1] / CYCLES_PER_US;
+	}
+
+	cprintf(b->con, "%-10s %6lu %-3s %8lu %7lu %9lu %9lu %9lu\r\n",
+		r->name, r->size, r->aligned ? "yes" : "no", bench_kibs(r),
+		r->ops, r->p50, r->p99, r->max);
+	b->nb_res++;
+}
+
+/* First LBA of the scratch file data at pos, FatFS gives the cluster */
+static bool bench_lba(sd_bench_t *b, uint32_t pos, uint32_t *lba)
+{
+	FATFS *fs = b->fp.obj.fs;
+
+	if (f_lseek(&b->fp, pos + 1) != FR_OK)
+		return FALSE;
+	*lba = fs->database + (b->fp.clust - 2) * fs->csize +
+	       (pos / MMCSD_BLOCK_SIZE) % fs->csize;
+	return TRUE;
+}
+
+static bool bench_raw(sd_bench_t *b, const char *name, uint32_t size,
+		      bool write, bool random)
+{
+	sd_bench_result_t *r;
+	uint32_t pos, lba, start, delta;
+	bool err;
+
+	r = bench_begin(b, name, size, TRUE);
+	pos = 0;
+	while (bench_running(b)) {
+		if (random)
+			pos = (bench_rand(b) % (SD_BENCH_SCRATCH / size)) * size;
+		if (!bench_lba(b, pos, &lba))
+			return FALSE;
+
+		start = bsp_get_cyclecounter();
+		if (write)
+			err = blkWrite(&SDCD1, lba, b->buf, size / MMCSD_BLOCK_SIZE);
+		else
+			err = blkRead(&SDCD1, lba, b->buf, size / MMCSD_BLOCK_SIZE);
+		delta = bsp_get_cyclecounter() - start;
+		if (err) {
+			cprintf(b->con, "SD %s failed at block %lu.\r\n",
+				write ? "write" : "read", lba);
+			return FALSE;
+		}
+		bench_add(b, r, delta, size);
+
+		pos += size;
+		if (pos >= SD_BENCH_SCRATCH)
+			pos = 0;
+	}
+	bench_end(b, r);
+	return TRUE;
+}
+
+static bool bench_fs(sd_bench_t *b, const char *name, uint32_t size,
+		     uint8_t offset, bool write)
+{
+	sd_bench_result_t *r;
+	uint32_t start, delta;
+	FRESULT err;
+	UINT n;
+
+	r = bench_begin(b, name, size, offset == 0);
+	err = f_lseek(&b->fp, 0);
+	while (err == FR_OK && bench_running(b)) {
+		if (f_tell(&b->fp) + size > SD_BENCH_SCRATCH) {
+			err = f_lseek(&b->fp, 0);
+			if (err != FR_OK)
+				break;
+		}
+		start = bsp_get_cyclecounter();
+		if (write)
+			err = f_write(&b->fp, b->buf + offset, size, &n);
+		else
+			err = f_read(&b->fp, b->buf + offset, size, &n);
+		delta = bsp_get_cyclecounter() - start;
+		if (err == FR_OK && n != size)
+			err = FR_DENIED;
+		if (err == FR_OK)
+			bench_add(b, r, delta, size);
+	}
+	if (err == FR_OK && write)
+		err = f_sync(&b->fp);
+	if (err != FR_OK) {
+		cprintf(b->con, "%s failed: error %d.\r\n", name, err);
+		return FALSE;
+	}
+	bench_end(b, r);
+	return TRUE;
+}
+
+/* Small append followed by f_sync(), as done by logging */
+static bool bench_sync(sd_bench_t *b)
+{
+	sd_bench_result_t *r;
+	uint32_t start, delta;
+	FRESULT err;
+	UINT n;
+
+	r = bench_begin(b, "fs-sync", MMCSD_BLOCK_SIZE, TRUE);
+	err = f_lseek(&b->fp, 0);
+	while (err == FR_OK && bench_running(b) &&
+	       f_tell(&b->fp) + MMCSD_BLOCK_SIZE <= SD_BENCH_SCRATCH) {
+		start = bsp_get_cyclecounter();
+		err = f_write(&b->fp, b->buf, MMCSD_BLOCK_SIZE, &n);
+		if (err == FR_OK)
+			err = f_sync(&b->fp);
+		delta = bsp_get_cyclecounter() - start;
+		if (err == FR_OK)
+			bench_add(b, r, delta, MMCSD_BLOCK_SIZE);
+	}
+	if (err != FR_OK) {
+		cprintf(b->con, "fs-sync failed: error %d.\r\n", err);
+		return FALSE;
+	}
+	bench_end(b, r);
+	return TRUE;
+}
+
+static FRESULT bench_write_cluster(sd_bench_t *b)
+{
+	uint32_t left, len;
+	FRESULT err;
+	UINT n;
+
+	err = FR_OK;
+	for (left = b->cluster; left > 0 && err == FR_OK; left -= len) {
+		len = (left > SD_BENCH_BUF_SIZE) ? SD_BENCH_BUF_SIZE : left;
+		err = f_write(&b->fp, b->buf, len, &n);
+		if (err == FR_OK && n != len)
+			err = FR_DENIED;
+	}
+	return err;
+}
+
+/*
+ * Cost of growing a file: each cluster is first written at the end of the
+ * file (allocation), then overwritten in place.
+ */
+static bool bench_alloc(sd_bench_t *b)
+{
+	sd_bench_result_t *r;
+	uint32_t start, delta, nb, i;
+	FRESULT err;
+
+	err = f_open(&b->fp, SD_BENCH_ALLOC_FILE, FA_WRITE | FA_CREATE_ALWAYS);
+	if (err != FR_OK) {
+		cprintf(b->con, "Failed to open %s: error %d.\r\n",
+			SD_BENCH_ALLOC_FILE, err);
+		return FALSE;
+	}
+
+	r = bench_begin(b, "fs-alloc", b->cluster, TRUE);
+	for (nb = 0; nb < SD_BENCH_ALLOC_CLUSTERS && bench_running(b); nb++) {
+		start = bsp_get_cyclecounter();
+		err = bench_write_cluster(b);
+		delta = bsp_get_cyclecounter() - start;
+		if (err != FR_OK)
+			break;
+		bench_add(b, r, delta, b->cluster);
+	}
+	if (err == FR_OK)
+		err = f_sync(&b->fp);
+	if (err == FR_OK) {
+		bench_end(b, r);
+
+		r = bench_begin(b, "fs-overwr", b->cluster, TRUE);
+		err = f_lseek(&b->fp, 0);
+		for (i = 0; i < nb && err == FR_OK; i++) {
+			start = bsp_get_cyclecounter();
+			err = bench_write_cluster(b);
+			delta = bsp_get_cyclecounter() - start;
+			bench_add(b, r, delta, b->cluster);
+		}
+		if (err == FR_OK)
+			bench_end(b, r);
+	}
+	f_close(&b->fp);
+	f_unlink(SD_BENCH_ALLOC_FILE);
+
+	if (err != FR_OK) {
+		cprintf(b->con, "fs-alloc failed: error %d.\r\n", err);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static bool bench_scratch(sd_bench_t *b)
+{
+	uint8_t i;
+	bool ok;
+
+	ok = TRUE;
+	for (i = 0; ok && i < ARRAY_SIZE(seq_sizes); i++) {
+		if (seq_sizes[i] <= b->cluster)
+			ok = bench_raw(b, "raw-seq-rd", seq_sizes[i], FALSE, FALSE);
+	}
+	for (i = 0; ok && i < ARRAY_SIZE(seq_sizes); i++) {
+		if (seq_sizes[i] <= b->cluster)
+			ok = bench_raw(b, "raw-seq-wr", seq_sizes[i], TRUE, FALSE);
+	}
+	for (i = 0; ok && i < ARRAY_SIZE(rnd_sizes); i++) {
+		if (rnd_sizes[i] <= b->cluster)
+			ok = bench_raw(b, "raw-rnd-rd", rnd_sizes[i], FALSE, TRUE);
+	}
+	for (i = 0; ok && i < ARRAY_SIZE(rnd_sizes); i++) {
+		if (rnd_sizes[i] <= b->cluster)
+			ok = bench_raw(b, "raw-rnd-wr", rnd_sizes[i], TRUE, TRUE);
+	}
+	for (i = 0; ok && i < ARRAY_SIZE(seq_sizes); i++) {
+		ok = bench_fs(b, "fs-write", seq_sizes[i], 0, TRUE);
+#if STM32_SDC_SDIO_UNALIGNED_SUPPORT
+		if (ok)
+			ok = bench_fs(b, "fs-write", seq_sizes[i], 1, TRUE);
+#endif
+	}
+	for (i = 0; ok && i < ARRAY_SIZE(seq_sizes); i++) {
+		ok = bench_fs(b, "fs-read", seq_sizes[i], 0, FALSE);
+#if STM32_SDC_SDIO_UNALIGNED_SUPPORT
+		if (ok)
+			ok = bench_fs(b, "fs-read", seq_sizes[i], 1, FALSE);
+#endif
+	}
+	if (ok)
+		ok = bench_sync(b);
+
+	return ok;
+}
+
+static void bench_save_csv(sd_bench_t *b)
+{
+	sd_bench_result_t *r;
+	FRESULT err;
+	uint8_t i;
+	UINT n;
+	int len;
+
+	err = f_open(&b->fp, SD_BENCH_CSV, FA_WRITE | FA_CREATE_ALWAYS);
+	if (err != FR_OK) {
+		cprintf(b->con, "Failed to open %s: error %d.\r\n", SD_BENCH_CSV, err);
+		return;
+	}
+	len = snprintf(b->line, sizeof(b->line),
+		       "test,size,aligned,kib_s,ops,p50_us,p99_us,max_us\r\n");
+	err = f_write(&b->fp, b->line, len, &n);
+	for (i = 0; i < b->nb_res && err == FR_OK; i++) {
+		r = &b->res[i];
+		len = snprintf(b->line, sizeof(b->line),
+			       "%s,%lu,%d,%lu,%lu,%lu,%lu,%lu\r\n",
+			       r->name, r->size, r->aligned ? 1 : 0,
+			       bench_kibs(r), r->ops, r->p50, r->p99, r->max);
+		err = f_write(&b->fp, b->line, len, &n);
+	}
+	if (err == FR_OK)
+		err = f_close(&b->fp);
+	else
+		f_close(&b->fp);
+
+	if (err != FR_OK)
+		cprintf(b->con, "Failed to write %s: error %d.\r\n", SD_BENCH_CSV, err);
+	else
+		cprintf(b->con, "Results saved to %s.\r\n", SD_BENCH_CSV);
+}
+
+int cmd_sd_bench(t_hydra_console *con, t_tokenline_parsed *p)
+{
+	sd_bench_t *b;
+	FATFS *fs;
+	DWORD free_clusters;
+	FRESULT err;
+	bool ok;
+
+	(void)p;
+
+	if (!is_fs_ready()) {
+		err = mount();
+		if (err != 0) {
+			cprintf(con, "Mount failed: error %d.\r\n", err);
+			return FALSE;
+		}
+	}
+
+	err = f_getfree("0:", &free_clusters, &fs);
+	if (err != FR_OK) {
+		cprintf(con, "Failed to get free space: error %d.\r\n", err);
+		return FALSE;
+	}
+	if ((uint64_t)free_clusters * fs->csize * MMCSD_BLOCK_SIZE <
+	    SD_BENCH_SCRATCH + (uint64_t)SD_BENCH_ALLOC_CLUSTERS * fs->csize * MMCSD_BLOCK_SIZE) {
+		cprintf(con, "Not enough free space on SD card.\r\n");
+		return FALSE;
+	}
+
+	b = pool_alloc_bytes(sizeof(sd_bench_t));
+	if (b == 0) {
+		cprintf(con, "Not enough memory.\r\n");
+		return FALSE;
+	}
+	/* One more word for the unaligned tests */
+	b->buf = pool_alloc_bytes(SD_BENCH_BUF_SIZE + 4);
+	if (b->buf == 0) {
+		pool_free(b);
+		cprintf(con, "Not enough memory.\r\n");
+		return FALSE;
+	}
+	b->con = con;
+	b->cluster = fs->csize * MMCSD_BLOCK_SIZE;
+	b->rand = 0x12345678;
+	b->nb_res = 0;
+	memset(b->buf, 0x55, SD_BENCH_BUF_SIZE + 4);
+
+	err = f_open(&b->fp, SD_BENCH_FILE, FA_READ | FA_WRITE | FA_CREATE_ALWAYS);
+	if (err == FR_OK) {
+		/* Seeking past the end allocates the clusters */
+		err = f_lseek(&b->fp, SD_BENCH_SCRATCH);
+		if (err == FR_OK && f_size(&b->fp) != SD_BENCH_SCRATCH)
+			err = FR_DENIED;
+		if (err == FR_OK)
+			err = f_sync(&b->fp);
+		if (err != FR_OK)
+			f_close(&b->fp);
+	}
+	if (err != FR_OK) {
+		cprintf(con, "Failed to create %s: error %d.\r\n", SD_BENCH_FILE, err);
+		f_unlink(SD_BENCH_FILE);
+		pool_free(b->buf);
+		pool_free(b);
+		return FALSE;
+	}
+
+	cprintf(con, "Cluster size %lu bytes, %d ms per test, UBTN to abort.\r\n",
+		b->cluster, SD_BENCH_MS);
+	cprintf(con, "Test         Size Aln     KiB/s     Ops   P50(us)   P99(us)   Max(us)\r\n");
+
+	ok = bench_scratch(b);
+	f_close(&b->fp);
+	f_unlink(SD_BENCH_FILE);
+	if (ok)
+		ok = bench_alloc(b);
+
+	if (b->nb_res > 0)
+		bench_save_csv(b);
+
+	pool_free(b->buf);
+	pool_free(b);
+	return ok;
+}
@@ -0,0 +1,429 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Binary file transfer between the host and the SD card.
+ *
+ * Commands (after the SDX1 banner):
+ *  STAT [len][name]                    -> 0x01 + size, or 0x00 + FRESULT
+ *  GET  [len][name][offset]            -> 0x01 + size, or 0x00 + FRESULT
+ *      then one data frame per chunk and an end frame holding the FRESULT.
+ *  PUT  [len][name][offset][length]    -> 0x01 + offset, or 0x00 + FRESULT
+ *      then the host sends data frames, each one answered by 0x01 once
+ *      queued. The last one is answered by 0x01 + file size. On any error
+ *      the answer is 0x00 + offset to resume from.
+ * All values are 32 bits big endian. Frames use the common/frame.h format,
+ * a data frame payload is the chunk followed by its CRC32.
+ *
+ * Card accesses are done by a helper thread using two buffers, so the next
+ * chunk is read from (or written to) the card while the other one is on USB.
+ * FatFS is not reentrant: the console thread must not use it while the
+ * helper runs, which is why output bypasses the console log file.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include "ch.h"
+#include "hal.h"
+
+#include "ff.h"
+
+#include "microsd.h"
+#include "common.h"
+#include "hydrabus_bbio.h"
+#include "hydrabus_sd_xfer.h"
+#include "frame.h"
+#include "crc32.h"
+#ifdef HYDRABUS_USB_BULK
+#include "usb_bulk.h"
+#endif
+
+#define SD_XFER_NB_BUF		(2)
+#define SD_XFER_BUF_SIZE	(FRAME_HDR_SIZE + SD_XFER_CHUNK + 4)
+#define SD_XFER_DATA(x, i)	((x)->buf[i] + FRAME_HDR_SIZE)
+
+typedef struct {
+	t_hydra_console *con;
+	FIL fp;
+	uint8_t *buf[SD_XFER_NB_BUF];
+	uint32_t len[SD_XFER_NB_BUF];
+	/* Bytes written by the helper thread on PUT */
+	uint32_t done;
+	FRESULT err;
+	bool abort;
+	semaphore_t free;
+	semaphore_t full;
+	char path[FILENAME_SIZE + 3];
+} sd_xfer_t;
+
+static uint32_t sd_xfer_read(void *priv, uint8_t *buf, uint32_t len,
+			     uint32_t timeout_ms)
+{
+	t_hydra_console *con = priv;
+
+	return chnReadTimeout(con->sdu, buf, len, TIME_MS2I(timeout_ms));
+}
+
+static uint32_t sd_xfer_write(void *priv, const uint8_t *buf, uint32_t len)
+{
+	t_hydra_console *con = priv;
+
+	return chnWrite(con->sdu, buf, len);
+}
+
+static void sd_xfer_flush(void *priv)
+{
+	t_hydra_console *con = priv;
+	uint8_t dummy;
+
+	while (chnReadTimeout(con->sdu, &dummy, 1, TIME_MS2I(10)) == 1);
+}
+
+static uint32_t get_u32(uint8_t *buf)
+{
+	return (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+}
+
+static void put_u32(uint8_t *buf, uint32_t value)
+{
+	buf[0] = value >> 24;
+	buf[1] = value >> 16;
+	buf[2] = value >> 8;
+	buf[3] = value;
+}
+
+static uint32_t sd_xfer_get_u32(t_hydra_console *con)
+{
+	uint8_t buf[4];
+
+	chnRead(con->sdu, buf, 4);
+	return get_u32(buf);
+}
+
+static void sd_xfer_put_status(t_hydra_console *con, bool ok, uint32_t value)
+{
+	uint8_t buf[5];
+
+	buf[0] = ok ? 1 : 0;
+	put_u32(&buf[1], value);
+	chnWrite(con->sdu, buf, 5);
+}
+
+/* Reads [len][name] and builds the full path */
+static void sd_xfer_get_path(sd_xfer_t *x)
+{
+	uint8_t len;
+
+	chnRead(x->con->sdu, &len, 1);
+	x->path[0] = '0';
+	x->path[1] = ':';
+	chnRead(x->con->sdu, (uint8_t *)&x->path[2], len);
+	x->path[2 + len] = 0;
+}
+
+static FRESULT sd_xfer_mount(void)
+{
+	if (!is_fs_ready() && mount() != 0)
+		return FR_NOT_READY;
+	return FR_OK;
+}
+
+static THD_FUNCTION(sd_xfer_reader, arg)
+{
+	sd_xfer_t *x = arg;
+	UINT n;
+	uint8_t i = 0;
+
+	chRegSetThreadName("sd_xfer");
+	do {
+		chSemWait(&x->free);
+		if (x->abort)
+			break;
+		x->err = f_read(&x->fp, SD_XFER_DATA(x, i), SD_XFER_CHUNK, &n);
+		if (x->err != FR_OK)
+			n = 0;
+		x->len[i] = n;
+		chSemSignal(&x->full);
+		i ^= 1;
+	} while (n > 0);
+}
+
+/* Keeps consuming buffers after an error so the producer never blocks */
+static THD_FUNCTION(sd_xfer_writer, arg)
+{
+	sd_xfer_t *x = arg;
+	UINT n;
+	uint8_t i = 0;
+
+	chRegSetThreadName("sd_xfer");
+	while (1) {
+		chSemWait(&x->full);
+		if (x->len[i] == 0)
+			break;
+		if (x->err == FR_OK) {
+			x->err = f_write(&x->fp, SD_XFER_DATA(x, i), x->len[i], &n);
+			x->done += n;
+			if (x->err == FR_OK && n != x->len[i])
+				x->err = FR_DENIED; /* Card full */
+		}
+		chSemSignal(&x->free);
+		i ^= 1;
+	}
+}
+
+static thread_t *sd_xfer_start(sd_xfer_t *x, tfunc_t func)
+{
+	chSemObjectInit(&x->free, SD_XFER_NB_BUF);
+	chSemObjectInit(&x->full, 0);
+	x->err = FR_OK;
+	x->abort = FALSE;
+	x->done = 0;
+
+	return chThdCreateFromHeap(NULL, CONSOLE_WA_SIZE, "sd_xfer",
+				   NORMALPRIO, func, x);
+}
+
+static void sd_xfer_stat(sd_xfer_t *x)
+{
+	FILINFO fno;
+	FRESULT err;
+
+	sd_xfer_get_path(x);
+	err = sd_xfer_mount();
+	if (err == FR_OK)
+		err = f_stat(x->path, &fno);
+	if (err != FR_OK) {
+		sd_xfer_put_status(x->con, FALSE, err);
+		return;
+	}
+	sd_xfer_put_status(x->con, TRUE, fno.fsize);
+}
+
+static void sd_xfer_get(sd_xfer_t *x, const frame_transport_t *tr)
+{
+	thread_t *thread;
+	uint32_t offset, len, crc;
+	uint8_t end[FRAME_HDR_SIZE + 1];
+	FRESULT err;
+	uint8_t i;
+
+	sd_xfer_get_path(x);
+	offset = sd_xfer_get_u32(x->con);
+
+	err = sd_xfer_mount();
+	if (err == FR_OK)
+		err = f_open(&x->fp, x->path, FA_READ | FA_OPEN_EXISTING);
+	if (err != FR_OK) {
+		sd_xfer_put_status(x->con, FALSE, err);
+		return;
+	}
+	if (offset > f_size(&x->fp))
+		err = FR_INVALID_PARAMETER;
+	else
+		err = f_lseek(&x->fp, offset);
+	if (err == FR_OK) {
+		thread = sd_xfer_start(x, sd_xfer_reader);
+		if (thread == NULL)
+			err = FR_NOT_ENOUGH_CORE;
+	}
+	if (err != FR_OK) {
+		f_close(&x->fp);
+		sd_xfer_put_status(x->con, FALSE, err);
+		return;
+	}
+	sd_xfer_put_status(x->con, TRUE, f_size(&x->fp));
+
+	i = 0;
+	while (1) {
+		chSemWait(&x->full);
+		len = x->len[i];
+		if (len == 0)
+			break;
+		crc = crc32_update(0, SD_XFER_DATA(x, i), len);
+		put_u32(SD_XFER_DATA(x, i) + len, crc);
+		if (frame_send(tr, SD_XFER_CHANNEL_DATA, x->buf[i], len + 4) != FRAME_OK)
+			x->err = FR_INT_ERR;
+		if (x->err != FR_OK || hydrabus_ubtn()) {
+			x->abort = TRUE;
+			chSemSignal(&x->free);
+			break;
+		}
+		chSemSignal(&x->free);
+		i ^= 1;
+	}
+	chThdWait(thread);
+	f_close(&x->fp);
+
+	end[FRAME_HDR_SIZE] = x->err;
+	frame_send(tr, SD_XFER_CHANNEL_END, end, 1);
+}
+
+static void sd_xfer_put(sd_xfer_t *x, const frame_transport_t *tr)
+{
+	thread_t *thread;
+	uint32_t offset, remaining, len;
+	frame_status_t status;
+	FRESULT err;
+	uint8_t channel;
+	bool ok;
+	uint8_t i;
+
+	sd_xfer_get_path(x);
+	offset = sd_xfer_get_u32(x->con);
+	remaining = sd_xfer_get_u32(x->con);
+
+	err = sd_xfer_mount();
+	if (err == FR_OK)
+		err = f_open(&x->fp, x->path, FA_WRITE | FA_OPEN_ALWAYS);
+	if (err != FR_OK) {
+		sd_xfer_put_status(x->con, FALSE, err);
+		return;
+	}
+	/* Resuming drops whatever follows the offset */
+	if (offset > f_size(&x->fp))
+		err = FR_INVALID_PARAMETER;
+	else
+		err = f_lseek(&x->fp, offset);
+	if (err == FR_OK)
+		err = f_truncate(&x->fp);
+	if (err == FR_OK) {
+		thread = sd_xfer_start(x, sd_xfer_writer);
+		if (thread == NULL)
+			err = FR_NOT_ENOUGH_CORE;
+	}
+	if (err != FR_OK) {
+		f_close(&x->fp);
+		sd_xfer_put_status(x->con, FALSE, err);
+		return;
+	}
+	sd_xfer_put_status(x->con, TRUE, offset);
+
+	ok = TRUE;
+	i = 0;
+	while (1) {
+		chSemWait(&x->free);
+		if (remaining == 0 || x->err != FR_OK)
+			break;
+
+		status = frame_recv(tr, &channel, SD_XFER_DATA(x, i),
+				    SD_XFER_CHUNK + 4, &len, SD_XFER_TIMEOUT_MS);
+		if (status != FRAME_OK || channel != SD_XFER_CHANNEL_DATA ||
+		    len <= 4 || len - 4 > remaining) {
+			ok = FALSE;
+			break;
+		}
+		len -= 4;
+		if (crc32_update(0, SD_XFER_DATA(x, i), len) !=
+		    get_u32(SD_XFER_DATA(x, i) + len)) {
+			ok = FALSE;
+			break;
+		}
+
+		x->len[i] = len;
+		chSemSignal(&x->full);
+		remaining -= len;
+		if (remaining > 0)
+			chnWrite(x->con->sdu, (uint8_t *)"\x01", 1);
+		i ^= 1;
+	}
+	/* Zero length buffer stops the writer once everything is written */
+	x->len[i] = 0;
+	chSemSignal(&x->full);
+	chThdWait(thread);
+	/* Drop the frame sent by the host after our last acknowledge */
+	if (!ok || x->err != FR_OK)
+		sd_xfer_flush(x->con);
+
+	if (x->err == FR_OK)
+		x->err = f_close(&x->fp);
+	else
+		f_close(&x->fp);
+
+	sd_xfer_put_status(x->con, ok && x->err == FR_OK, offset + x->done);
+}
+
+void sd_xfer_server(t_hydra_console *con)
+{
+	const frame_transport_t tr = {
+		.priv = con,
+		.packet_size = 0,
+		.read = sd_xfer_read,
+		.write = sd_xfer_write,
+		.flush = sd_xfer_flush,
+	};
+	const frame_transport_t *trp = &tr;
+	sd_xfer_t *x;
+	uint8_t *buf;
+	uint8_t cmd;
+
+#ifdef HYDRABUS_USB_BULK
+	/* Each frame is then a single transfer, ended by a ZLP if needed */
+	if (con->bss == (BaseSequentialStream *)&usb_bulk_channel)
+		trp = &usb_bulk_transport;
+#endif
+
+	x = pool_alloc_bytes(sizeof(sd_xfer_t));
+	buf = pool_alloc_bytes(SD_XFER_BUF_SIZE * SD_XFER_NB_BUF);
+	if (x == 0 || buf == 0) {
+		pool_free(x);
+		pool_free(buf);
+		return;
+	}
+	x->con = con;
+	x->buf[0] = buf;
+	x->buf[1] = buf + SD_XFER_BUF_SIZE;
+
+	cprint(con, SD_XFER_HEADER, 4);
+
+	while (!hydrabus_ubtn()) {
+		if (chnRead(con->sdu, &cmd, 1) != 1)
+			continue;
+
+		switch (cmd) {
+		case BBIO_RESET:
+			pool_free(buf);
+			pool_free(x);
+			return;
+		case BBIO_MODE_ID:
+			cprint(con, SD_XFER_HEADER, 4);
+			break;
+		case BBIO_SD_XFER_STAT:
+			sd_xfer_stat(x);
+			break;
+		case BBIO_SD_XFER_GET:
+			sd_xfer_get(x, trp);
+			break;
+		case BBIO_SD_XFER_PUT:
+			sd_xfer_put(x, trp);
+			break;
+		default:
+			cprint(con, "\x00", 1);
+			break;
+		}
+	}
+	pool_free(buf);
+	pool_free(x);
+}
+
+int cmd_sd_xfer(t_hydra_console *con, t_tokenline_parsed *p)
+{
+	(void)p;
+
+	sd_xfer_server(con);
+	return TRUE;
+}
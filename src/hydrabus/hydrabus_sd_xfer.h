@@ -0,0 +1,35 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common.h"
+
+#define SD_XFER_HEADER		"SDX1"
+
+/* Payload of a data frame, followed by its CRC32 (big endian) */
+#define SD_XFER_CHUNK		(8192)
+#define SD_XFER_TIMEOUT_MS	(2000)
+
+#define SD_XFER_CHANNEL_DATA	(0)
+#define SD_XFER_CHANNEL_END	(1)
+
+/*
+ * Binary file transfer server, used by the "sd transfer" command and by
+ * the BBIO_SD_XFER mode. Returns on BBIO_RESET or UBTN.
+ */
+void sd_xfer_server(t_hydra_console *con);
+int cmd_sd_xfer(t_hydra_console *con, t_tokenline_parsed *p);
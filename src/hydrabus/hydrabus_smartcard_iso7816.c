@@ -0,0 +1,676 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2019 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common.h"
+#include "bsp_smartcard.h"
+#include "hydrabus_smartcard_iso7816.h"
+#include <string.h>
+
+#define ISO7816_DEFAULT_FI	(372)
+#define ISO7816_DEFAULT_DI	(1)
+#define ISO7816_DEFAULT_WI	(10)
+
+#define T1_DEFAULT_IFS		(32)
+#define T1_MAX_IFSD		(254)
+#define T1_DEFAULT_BWI		(4)
+#define T1_DEFAULT_CWI		(13)
+#define T1_MAX_RETRIES		(3)
+#define T1_BLOCK_MAX_SIZE	(3 + 254 + 2)
+
+#define T1_PCB_MORE		(0x20)
+#define T1_PCB_R		(0x80)
+#define T1_PCB_S		(0xC0)
+#define T1_S_IFS_REQ		(0xC1)
+#define T1_S_IFS_RESP		(0xE1)
+#define T1_S_WTX_REQ		(0xC3)
+#define T1_S_WTX_RESP		(0xE3)
+#define T1_R_ERR_EDC		(0x01)
+#define T1_R_ERR_OTHER		(0x02)
+
+static const uint16_t iso7816_fi[] = {
+	372, 372, 558, 744, 1116, 1488, 1860, 0,
+	0, 512, 768, 1024, 1536, 2048, 0, 0
+};
+static const uint8_t iso7816_di[] = {
+	0, 1, 2, 4, 8, 16, 32, 64,
+	12, 20, 0, 0, 0, 0, 0, 0
+};
+
+static uint8_t t1_tx_block[T1_BLOCK_MAX_SIZE];
+static uint16_t t1_tx_size;
+static uint8_t t1_rx_block[T1_BLOCK_MAX_SIZE];
+
+/* Since the hardware cannot apply inverse convention, we manage it here */
+void smartcard_iso7816_convention(mode_config_proto_t *proto, uint8_t *data, uint16_t nb_data)
+{
+	uint16_t i;
+
+	if(proto->config.smartcard.dev_convention == DEV_CONVENTION_INVERSE) {
+		for(i=0; i<nb_data; i++) {
+			data[i] = data[i] ^ 0xff;
+			data[i] = reverse_u8(data[i]);
+		}
+	}
+}
+
+void smartcard_iso7816_reset(smartcard_iso7816_t *ctx)
+{
+	memset(ctx, 0, sizeof(smartcard_iso7816_t));
+	ctx->ta1 = 0x11;
+	ctx->wi = ISO7816_DEFAULT_WI;
+	ctx->ifsc = T1_DEFAULT_IFS;
+	ctx->bwi = T1_DEFAULT_BWI;
+	ctx->cwi = T1_DEFAULT_CWI;
+	ctx->fi = ISO7816_DEFAULT_FI;
+	ctx->di = ISO7816_DEFAULT_DI;
+}
+
+/*
+ * Parse interface bytes of an ATR already converted to direct convention.
+ * Returns FALSE if the ATR is truncated.
+ */
+bool smartcard_iso7816_parse_atr(smartcard_iso7816_t *ctx, uint8_t *atr, uint8_t atr_size)
+{
+	uint8_t y, i, n, t, v;
+	int first_t = -1;
+
+	smartcard_iso7816_reset(ctx);
+	if(atr_size < 2 || atr_size > ISO7816_ATR_MAX_SIZE) {
+		return FALSE;
+	}
+	memcpy(ctx->atr, atr, atr_size);
+	ctx->atr_size = atr_size;
+
+	y = atr[1] >> 4;
+	i = 2;
+	n = 1;
+	t = 0;
+	while(1) {
+		if(i + ((y & 1) + ((y >> 1) & 1) + ((y >> 2) & 1) + ((y >> 3) & 1)) > atr_size) {
+			return FALSE;
+		}
+		if(y & 0x1) {
+			v = atr[i++];
+			if(n == 1) {
+				ctx->ta1 = v;
+			} else if(n == 2) {
+				ctx->ta2 = v;
+				ctx->specific = 1;
+			} else if(t == 1) {
+				ctx->ifsc = v;
+			}
+		}
+		if(y & 0x2) {
+			v = atr[i++];
+			if(n >= 3 && t == 1) {
+				ctx->bwi = v >> 4;
+				ctx->cwi = v & 0x0f;
+			}
+		}
+		if(y & 0x4) {
+			v = atr[i++];
+			if(n == 1) {
+				ctx->guard_n = v;
+			} else if(n == 2) {
+				ctx->wi = v ? v : ISO7816_DEFAULT_WI;
+			} else if(t == 1) {
+				ctx->crc = v & 0x1;
+			}
+		}
+		if(!(y & 0x8)) {
+			break;
+		}
+		v = atr[i++];
+		t = v & 0x0f;
+		if(first_t < 0) {
+			first_t = t;
+		}
+		y = v >> 4;
+		n++;
+	}
+
+	if(ctx->specific) {
+		ctx->protocol = ctx->ta2 & 0x0f;
+	} else if(first_t > 0) {
+		ctx->protocol = first_t;
+	}
+	if(ctx->protocol > 1) {
+		/* Only T=0 and T=1 are supported */
+		ctx->protocol = 0;
+	}
+
+	return TRUE;
+}
+
+static float iso7816_etu_us(mode_config_proto_t *proto, smartcard_iso7816_t *ctx)
+{
+	return (float)ctx->fi * 1000000.0f /
+	       ((float)ctx->di * bsp_smartcard_get_clk_frequency(proto->dev_num));
+}
+
+/* T=0 work waiting time, 960 * D * WI etu */
+static uint32_t iso7816_wwt(mode_config_proto_t *proto, smartcard_iso7816_t *ctx)
+{
+	float us;
+
+	us = iso7816_etu_us(proto, ctx) * 960 * ctx->di * ctx->wi;
+	return TIME_US2I((uint32_t)us) + 2;
+}
+
+/* T=1 block waiting time, 11 etu + 2^BWI * 960 * 372 / f */
+static uint32_t iso7816_bwt(mode_config_proto_t *proto, smartcard_iso7816_t *ctx)
+{
+	float us;
+
+	us = iso7816_etu_us(proto, ctx) * 11 +
+	     (float)(1 << ctx->bwi) * 960 * 372 * 1000000.0f /
+	     bsp_smartcard_get_clk_frequency(proto->dev_num);
+	return TIME_US2I((uint32_t)us) + 2;
+}
+
+/* T=1 character waiting time, 11 + 2^CWI etu */
+static uint32_t iso7816_cwt(mode_config_proto_t *proto, smartcard_iso7816_t *ctx)
+{
+	float us;
+
+	us = iso7816_etu_us(proto, ctx) * (11 + (1 << ctx->cwi));
+	return TIME_US2I((uint32_t)us) + 2;
+}
+
+static bsp_status_t iso7816_send(mode_config_proto_t *proto, uint8_t *data, uint16_t nb_data)
+{
+	bsp_status_t status;
+
+	/* Inverse convention is its own inverse, restore caller data after */
+	smartcard_iso7816_convention(proto, data, nb_data);
+	status = bsp_smartcard_irq_write(proto->dev_num, data, nb_data);
+	smartcard_iso7816_convention(proto, data, nb_data);
+
+	return status;
+}
+
+static bsp_status_t iso7816_recv(mode_config_proto_t *proto, uint8_t *data, uint16_t nb_data, uint32_t timeout)
+{
+	bsp_status_t status;
+
+	status = bsp_smartcard_irq_read(proto->dev_num, data, nb_data, timeout);
+	smartcard_iso7816_convention(proto, data, nb_data);
+
+	return status;
+}
+
+static bsp_status_t iso7816_set_fd(mode_config_proto_t *proto, smartcard_iso7816_t *ctx, uint16_t fi, uint8_t di)
+{
+	bsp_status_t status;
+
+	proto->config.smartcard.dev_speed =
+		(uint32_t)(bsp_smartcard_get_clk_frequency(proto->dev_num) * di / fi);
+	/* Extra guard time from TC1, 255 means minimum guard time */
+	if(ctx->guard_n < 255 &&
+	    proto->config.smartcard.dev_guardtime < 12 + ctx->guard_n) {
+		proto->config.smartcard.dev_guardtime = 12 + ctx->guard_n;
+	}
+	status = bsp_smartcard_init(proto->dev_num, proto);
+	if(status == BSP_OK) {
+		ctx->fi = fi;
+		ctx->di = di;
+	}
+	return status;
+}
+
+/*
+ * Negotiate the Fi/Di indicated in TA1 and the first offered protocol.
+ * Nothing is sent if the card uses default values or specific mode.
+ */
+bsp_status_t smartcard_iso7816_pps(mode_config_proto_t *proto, smartcard_iso7816_t *ctx)
+{
+	uint8_t pps[4], resp[4];
+	uint16_t fi;
+	uint8_t di, i, pck;
+	bsp_status_t status;
+
+	fi = iso7816_fi[ctx->ta1 >> 4];
+	di = iso7816_di[ctx->ta1 & 0x0f];
+	if(fi == 0 || di == 0) {
+		return BSP_ERROR;
+	}
+
+	if(ctx->specific) {
+		/* Implicit parameters when bit 5 of TA2 is set */
+		if(ctx->ta2 & 0x10) {
+			return BSP_OK;
+		}
+		return iso7816_set_fd(proto, ctx, fi, di);
+	}
+
+	if(fi == ctx->fi && di == ctx->di) {
+		return BSP_OK;
+	}
+
+	pps[0] = 0xff;
+	pps[1] = 0x10 | ctx->protocol;
+	pps[2] = ctx->ta1;
+	pps[3] = pps[0] ^ pps[1] ^ pps[2];
+
+	bsp_smartcard_irq_start(proto->dev_num);
+	status = iso7816_send(proto, pps, 4);
+	if(status == BSP_OK) {
+		status = iso7816_recv(proto, resp, 2, iso7816_wwt(proto, ctx));
+	}
+	i = 2;
+	if(status == BSP_OK && (resp[1] & 0x10)) {
+		status = iso7816_recv(proto, &resp[i++], 1, iso7816_wwt(proto, ctx));
+	}
+	if(status == BSP_OK) {
+		status = iso7816_recv(proto, &resp[i], 1, iso7816_wwt(proto, ctx));
+	}
+	bsp_smartcard_irq_stop(proto->dev_num);
+	if(status != BSP_OK) {
+		return status;
+	}
+
+	pck = resp[0] ^ resp[1] ^ resp[i];
+	if(i == 3) {
+		pck ^= resp[2];
+	}
+	if(resp[0] != 0xff || (resp[1] & 0x0f) != ctx->protocol || pck != 0) {
+		return BSP_ERROR;
+	}
+	/* PPS1 absent from the answer means default Fi/Di are kept */
+	if(i != 3 || resp[2] != ctx->ta1) {
+		return BSP_OK;
+	}
+
+	return iso7816_set_fd(proto, ctx, fi, di);
+}
+
+/*
+ * Send one T=0 command header and exchange data following the
+ * procedure bytes. Returns the number of bytes stored in resp (data and
+ * SW1 SW2) or -1 on error.
+ */
+static int iso7816_t0_tpdu(mode_config_proto_t *proto, smartcard_iso7816_t *ctx,
+			   uint8_t *header, uint8_t *data, uint16_t lc, uint16_t le,
+			   uint8_t *resp, uint16_t resp_max)
+{
+	uint32_t wwt = iso7816_wwt(proto, ctx);
+	uint16_t total, done, count, n;
+	uint8_t pb, ins;
+
+	ins = header[1];
+	total = (lc > 0) ? lc : le;
+	done = 0;
+	count = 0;
+
+	if(iso7816_send(proto, header, 5) != BSP_OK) {
+		return -1;
+	}
+
+	while(1) {
+		if(iso7816_recv(proto, &pb, 1, wwt) != BSP_OK) {
+			return -1;
+		}
+		if(pb == 0x60) {
+			/* NULL byte, card asks for more time */
+			continue;
+		}
+		if((pb & 0xf0) == 0x60 || (pb & 0xf0) == 0x90) {
+			if(count + 2 > resp_max) {
+				return -1;
+			}
+			resp[count] = pb;
+			if(iso7816_recv(proto, &resp[count + 1], 1, wwt) != BSP_OK) {
+				return -1;
+			}
+			return count + 2;
+		}
+
+		if(pb == ins) {
+			n = total - done;
+		} else if(pb == (ins ^ 0xff)) {
+			n = 1;
+		} else {
+			return -1;
+		}
+		if(n == 0 || done + n > total) {
+			return -1;
+		}
+
+		if(lc > 0) {
+			if(iso7816_send(proto, data + done, n) != BSP_OK) {
+				return -1;
+			}
+		} else {
+			if(count + n + 2 > resp_max) {
+				return -1;
+			}
+			if(iso7816_recv(proto, resp + count, n, wwt) != BSP_OK) {
+				return -1;
+			}
+			count += n;
+		}
+		done += n;
+	}
+}
+
+static int iso7816_t0_apdu(mode_config_proto_t *proto, smartcard_iso7816_t *ctx,
+			   uint8_t *apdu, uint16_t apdu_size,
+			   uint8_t *resp, uint16_t resp_max)
+{
+	uint8_t header[5];
+	uint16_t lc, le, count;
+	uint8_t sw1, sw2, retries;
+	int n;
+
+	if(apdu_size < 4) {
+		return -1;
+	}
+
+	memcpy(header, apdu, 4);
+	header[4] = 0;
+	lc = 0;
+	le = 0;
+	if(apdu_size == 5) {
+		/* Case 2 */
+		header[4] = apdu[4];
+		le = apdu[4] ? apdu[4] : 256;
+	} else if(apdu_size > 5) {
+		/* Case 3 or 4, short APDUs only */
+		lc = apdu[4];
+		if(lc == 0 || (apdu_size != 5 + lc && apdu_size != 6 + lc)) {
+			return -1;
+		}
+		header[4] = lc;
+	}
+
+	count = 0;
+	n = iso7816_t0_tpdu(proto, ctx, header, apdu + 5, lc, le, resp, resp_max);
+	for(retries = 0; n >= 2 && retries < 64; retries++) {
+		sw1 = resp[count + n - 2];
+		sw2 = resp[count + n - 1];
+		if(sw1 == 0x6c && lc == 0) {
+			/* Wrong Le, resend with the length given by the card */
+			header[4] = sw2;
+			le = sw2 ? sw2 : 256;
+			n = iso7816_t0_tpdu(proto, ctx, header, NULL, 0, le,
+					    resp + count, resp_max - count);
+		} else if(sw1 == 0x61) {
+			/* More data available, GET RESPONSE */
+			count += n - 2;
+			header[0] = apdu[0];
+			header[1] = 0xc0;
+			header[2] = 0;
+			header[3] = 0;
+			header[4] = sw2;
+			lc = 0;
+			le = sw2 ? sw2 : 256;
+			n = iso7816_t0_tpdu(proto, ctx, header, NULL, 0, le,
+					    resp + count, resp_max - count);
+		} else {
+			break;
+		}
+	}
+	if(n < 0) {
+		return -1;
+	}
+
+	return count + n;
+}
+
+/* T=1 error detection code, LRC or CRC (ISO/IEC 13239) */
+static uint16_t iso7816_t1_edc(smartcard_iso7816_t *ctx, uint8_t *data, uint16_t size)
+{
+	uint16_t i, crc;
+	uint8_t lrc, b;
+
+	if(ctx->crc) {
+		crc = 0xffff;
+		for(i = 0; i < size; i++) {
+			crc ^= data[i];
+			for(b = 0; b < 8; b++) {
+				crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+			}
+		}
+		return ~crc;
+	}
+
+	lrc = 0;
+	for(i = 0; i < size; i++) {
+		lrc ^= data[i];
+	}
+	return lrc;
+}
+
+static bsp_status_t iso7816_t1_send_block(mode_config_proto_t *proto, smartcard_iso7816_t *ctx,
+					  uint8_t pcb, uint8_t *inf, uint8_t len)
+{
+	uint16_t edc;
+
+	t1_tx_block[0] = 0; /* NAD */
+	t1_tx_block[1] = pcb;
+	t1_tx_block[2] = len;
+	if(len > 0) {
+		memcpy(&t1_tx_block[3], inf, len);
+	}
+	t1_tx_size = 3 + len;
+	edc = iso7816_t1_edc(ctx, t1_tx_block, t1_tx_size);
+	if(ctx->crc) {
+		t1_tx_block[t1_tx_size++] = edc & 0xff;
+		t1_tx_block[t1_tx_size++] = edc >> 8;
+	} else {
+		t1_tx_block[t1_tx_size++] = edc;
+	}
+
+	return iso7816_send(proto, t1_tx_block, t1_tx_size);
+}
+
+static bsp_status_t iso7816_t1_send_iblock(mode_config_proto_t *proto, smartcard_iso7816_t *ctx,
+					   uint8_t *inf, uint8_t len, uint8_t more)
+{
+	uint8_t pcb;
+
+	pcb = (ctx->ns << 6) | (more ? T1_PCB_MORE : 0);
+	ctx->ns ^= 1;
+	return iso7816_t1_send_block(proto, ctx, pcb, inf, len);
+}
+
+static bsp_status_t iso7816_t1_send_rblock(mode_config_proto_t *proto, smartcard_iso7816_t *ctx,
+					   uint8_t error)
+{
+	return iso7816_t1_send_block(proto, ctx, T1_PCB_R | (ctx->nr << 4) | error, NULL, 0);
+}
+
+/*
+ * Receive one T=1 block in t1_rx_block.
+ * Returns the block size, -1 on timeout or -2 on EDC error.
+ */
+static int iso7816_t1_recv_block(mode_config_proto_t *proto, smartcard_iso7816_t *ctx, uint32_t bwt)
+{
+	uint32_t cwt = iso7816_cwt(proto, ctx);
+	uint16_t size, edc;
+	uint8_t edc_size;
+
+	edc_size = ctx->crc ? 2 : 1;
+	if(iso7816_recv(proto, t1_rx_block, 1, bwt) != BSP_OK) {
+		return -1;
+	}
+	if(iso7816_recv(proto, &t1_rx_block[1], 2, cwt) != BSP_OK) {
+		return -1;
+	}
+	if(t1_rx_block[2] == 0xff) {
+		return -2;
+	}
+	size = 3 + t1_rx_block[2];
+	if(iso7816_recv(proto, &t1_rx_block[3], t1_rx_block[2] + edc_size, cwt) != BSP_OK) {
+		return -1;
+	}
+
+	edc = iso7816_t1_edc(ctx, t1_rx_block, size);
+	if(ctx->crc) {
+		if(t1_rx_block[size] != (edc & 0xff) || t1_rx_block[size + 1] != (edc >> 8)) {
+			return -2;
+		}
+	} else if(t1_rx_block[size] != edc) {
+		return -2;
+	}
+
+	return size;
+}
+
+/* Ask the card to accept blocks up to T1_MAX_IFSD bytes */
+static void iso7816_t1_set_ifsd(mode_config_proto_t *proto, smartcard_iso7816_t *ctx)
+{
+	uint8_t ifsd = T1_MAX_IFSD;
+
+	ctx->ifsd = T1_DEFAULT_IFS;
+	if(iso7816_t1_send_block(proto, ctx, T1_S_IFS_REQ, &ifsd, 1) != BSP_OK) {
+		return;
+	}
+	if(iso7816_t1_recv_block(proto, ctx, iso7816_bwt(proto, ctx)) == 4 &&
+	    t1_rx_block[1] == T1_S_IFS_RESP) {
+		ctx->ifsd = t1_rx_block[3];
+	}
+}
+
+static int iso7816_t1_apdu(mode_config_proto_t *proto, smartcard_iso7816_t *ctx,
+			   uint8_t *apdu, uint16_t apdu_size,
+			   uint8_t *resp, uint16_t resp_max)
+{
+	uint32_t bwt, wait;
+	uint16_t sent, count, chunk;
+	uint8_t pcb, len, more, retries;
+	int n;
+
+	if(apdu_size == 0) {
+		return -1;
+	}
+	if(ctx->ifsd == 0) {
+		iso7816_t1_set_ifsd(proto, ctx);
+	}
+
+	bwt = iso7816_bwt(proto, ctx);
+	sent = 0;
+	count = 0;
+	retries = 0;
+
+	/* Command APDU is chained in blocks of IFSC bytes */
+	chunk = (apdu_size > ctx->ifsc) ? ctx->ifsc : apdu_size;
+	more = (chunk < apdu_size);
+	if(iso7816_t1_send_iblock(proto, ctx, apdu, chunk, more) != BSP_OK) {
+		return -1;
+	}
+
+	wait = bwt;
+	while(1) {
+		n = iso7816_t1_recv_block(proto, ctx, wait);
+		wait = bwt;
+		if(n < 0) {
+			if(++retries > T1_MAX_RETRIES) {
+				return -1;
+			}
+			iso7816_t1_send_rblock(proto, ctx,
+					       (n == -2) ? T1_R_ERR_EDC : T1_R_ERR_OTHER);
+			continue;
+		}
+
+		pcb = t1_rx_block[1];
+		len = t1_rx_block[2];
+		if(!(pcb & 0x80)) {
+			/* I-block, card answer */
+			if(more) {
+				return -1;
+			}
+			if(((pcb >> 6) & 1) != ctx->nr) {
+				if(++retries > T1_MAX_RETRIES) {
+					return -1;
+				}
+				iso7816_t1_send_rblock(proto, ctx, T1_R_ERR_OTHER);
+				continue;
+			}
+			retries = 0;
+			ctx->nr ^= 1;
+			if(count + len > resp_max) {
+				return -1;
+			}
+			memcpy(resp + count, &t1_rx_block[3], len);
+			count += len;
+			if(pcb & T1_PCB_MORE) {
+				/* Acknowledge chained answer */
+				iso7816_t1_send_rblock(proto, ctx, 0);
+				continue;
+			}
+			return count;
+		} else if((pcb & T1_PCB_S) == T1_PCB_R) {
+			if(more && ((pcb >> 4) & 1) == ctx->ns) {
+				/* Chained block acknowledged, send the next one */
+				retries = 0;
+				sent += chunk;
+				chunk = (apdu_size - sent > ctx->ifsc) ? ctx->ifsc : apdu_size - sent;
+				more = (sent + chunk < apdu_size);
+				if(iso7816_t1_send_iblock(proto, ctx, apdu + sent, chunk, more) != BSP_OK) {
+					return -1;
+				}
+			} else {
+				/* Card asks for the last block again */
+				if(++retries > T1_MAX_RETRIES) {
+					return -1;
+				}
+				iso7816_send(proto, t1_tx_block, t1_tx_size);
+			}
+		} else {
+			switch(pcb) {
+			case T1_S_WTX_REQ:
+				if(len == 1 && t1_rx_block[3] > 0) {
+					wait = bwt * t1_rx_block[3];
+				}
+				iso7816_t1_send_block(proto, ctx, T1_S_WTX_RESP, &t1_rx_block[3], len);
+				break;
+			case T1_S_IFS_REQ:
+				if(len == 1) {
+					ctx->ifsc = t1_rx_block[3];
+				}
+				iso7816_t1_send_block(proto, ctx, T1_S_IFS_RESP, &t1_rx_block[3], len);
+				break;
+			default:
+				/* ABORT or unexpected S-block */
+				return -1;
+			}
+		}
+	}
+}
+
+/*
+ * Run a full APDU transaction with the protocol selected from the ATR.
+ * Returns the response size (data and SW1 SW2) or -1 on error.
+ */
+int smartcard_iso7816_apdu(mode_config_proto_t *proto, smartcard_iso7816_t *ctx,
+			   uint8_t *apdu, uint16_t apdu_size,
+			   uint8_t *resp, uint16_t resp_max)
+{
+	int n;
+
+	bsp_smartcard_irq_start(proto->dev_num);
+	if(ctx->protocol == 1) {
+		n = iso7816_t1_apdu(proto, ctx, apdu, apdu_size, resp, resp_max);
+	} else {
+		n = iso7816_t0_apdu(proto, ctx, apdu, apdu_size, resp, resp_max);
+	}
+	bsp_smartcard_irq_stop(proto->dev_num);
+
+	return n;
+}
@@ -0,0 +1,56 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2019 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_SMARTCARD_ISO7816_H_
+#define _HYDRABUS_SMARTCARD_ISO7816_H_
+
+#include "common.h"
+#include "bsp.h"
+
+#define ISO7816_ATR_MAX_SIZE	(33)
+
+/* Card parameters from the ATR and protocol state */
+typedef struct {
+	uint8_t atr[ISO7816_ATR_MAX_SIZE];
+	uint8_t atr_size;
+	uint8_t protocol;	/* T=0 or T=1 */
+	uint8_t ta1;		/* Fi/Di indicated by the card */
+	uint8_t ta2;		/* Specific mode byte if specific is set */
+	uint8_t specific;	/* TA2 present, PPS not allowed */
+	uint8_t guard_n;	/* TC1 extra guard time */
+	uint8_t wi;		/* T=0 waiting time integer (TC2) */
+	uint8_t ifsc;		/* T=1 max information field size of the card */
+	uint8_t ifsd;		/* T=1 max information field size of the reader */
+	uint8_t bwi;		/* T=1 block waiting time integer */
+	uint8_t cwi;		/* T=1 character waiting time integer */
+	uint8_t crc;		/* T=1 EDC is CRC instead of LRC */
+	uint8_t ns;		/* T=1 send sequence number */
+	uint8_t nr;		/* T=1 expected receive sequence number */
+	uint16_t fi;		/* Current clock rate conversion integer */
+	uint8_t di;		/* Current baud rate adjustment integer */
+} smartcard_iso7816_t;
+
+void smartcard_iso7816_convention(mode_config_proto_t *proto, uint8_t *data, uint16_t nb_data);
+void smartcard_iso7816_reset(smartcard_iso7816_t *ctx);
+bool smartcard_iso7816_parse_atr(smartcard_iso7816_t *ctx, uint8_t *atr, uint8_t atr_size);
+bsp_status_t smartcard_iso7816_pps(mode_config_proto_t *proto, smartcard_iso7816_t *ctx);
+int smartcard_iso7816_apdu(mode_config_proto_t *proto, smartcard_iso7816_t *ctx,
+			   uint8_t *apdu, uint16_t apdu_size,
+			   uint8_t *resp, uint16_t resp_max);
+
+#endif /* _HYDRABUS_SMARTCARD_ISO7816_H_ */
@@ -25,17 +25,50 @@
 #include "bsp_trigger_conf.h"
 #include "hydrabus_mode.h"
 #include "hydrabus_trigger.h"
+#include "hydrabus_trigger_match.h"
 
 #include <string.h>
 
-static uint8_t trigger_data[256];
-static uint8_t trigger_length = 0;
+/* Mode timeout (ms) while waiting for the next byte */
+#define TRIGGER_TIMEOUT		(1)
+
+static trigger_pattern_t trigger_patterns[TRIGGER_PATTERNS];
+static uint8_t trigger_nb_patterns = 0;
+static trigger_matcher_t trigger_matcher;
+
+/* Cycles from the read of a byte to the trigger output, last and worst */
+static uint32_t trigger_latency = 0;
+static uint32_t trigger_latency_max = 0;
+
+static uint32_t cycles_to_ns(uint32_t cycles)
+{
+	return (uint64_t)cycles * 1000 / (STM32_HCLK / 1000000);
+}
 
 static void show_params(t_hydra_console *con)
 {
-	cprintf(con, "Current trigger data :\r\n");
-	print_hex(con, trigger_data, trigger_length);
+	trigger_pattern_t *pat;
+	uint8_t i, j;
 
+	cprintf(con, "Current trigger data :\r\n");
+	for (i = 0; i < trigger_nb_patterns; i++) {
+		pat = &trigger_patterns[i];
+		cprintf(con, "Pattern %d :\r\n", i);
+		print_hex(con, pat->data, pat->len);
+		for (j = 0; j < pat->len && pat->mask[j] == 0xff; j++);
+		if (j < pat->len) {
+			cprintf(con, "Mask :\r\n");
+			print_hex(con, pat->mask, pat->len);
+		}
+	}
+	if (trigger_latency > 0) {
+		cprintf(con, "Last latency : %d ns (from byte received)\r\n",
+			cycles_to_ns(trigger_latency));
+	}
+	if (trigger_latency_max > 0) {
+		cprintf(con, "Latency bound : %d ns (worst byte)\r\n",
+			cycles_to_ns(trigger_latency_max));
+	}
 }
 
 static int show(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
@@ -56,42 +89,140 @@ static int show(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 	return tokens_used;
 }
 
+/*
+ * The mode is read byte by byte with a short timeout so that a byte is
+ * matched as soon as it is received instead of waiting for a block or the
+ * mode timeout, the latency is counted from the end of its read.
+ */
 static int trigger_run(t_hydra_console *con)
 {
-	uint32_t i=0;
-	uint8_t rx_data, to_read;
+	mode_config_proto_t *proto = &con->mode->proto;
+	uint32_t state[TRIGGER_WORDS];
+	uint32_t status, start, cycles, timeout;
+	uint8_t rx_data;
+	uint8_t to_read;
+	int ret;
+
+	if (con->mode->exec->dump == NULL || trigger_nb_patterns == 0)
+		return 0;
+
+	memset(state, 0, sizeof(state));
 	bsp_trigger_init();
+	trigger_latency = 0;
+	trigger_latency_max = 0;
+	timeout = proto->timeout;
+	proto->timeout = TRIGGER_TIMEOUT;
+	ret = 0;
 	while(!hydrabus_ubtn()) {
-		if(con->mode->exec->read) {
-			to_read = 1;
-			con->mode->exec->dump(con,&rx_data,&to_read);
-		}
-		if(rx_data == trigger_data[i]) {
-			i++;
-		} else {
-			i=0;
-		}
-		if(i==trigger_length) {
+		to_read = 1;
+		status = con->mode->exec->dump(con, &rx_data, &to_read);
+		start = bsp_get_cyclecounter();
+		if (status != BSP_OK && status != BSP_TIMEOUT)
+			break;
+		if (to_read == 0)
+			continue;
+
+		if (trigger_match(&trigger_matcher, state, &rx_data, 1) >= 0) {
 			bsp_trigger_on();
-			return 1;
+			trigger_latency = bsp_get_cyclecounter() - start;
+			if (trigger_latency > trigger_latency_max)
+				trigger_latency_max = trigger_latency;
+			ret = 1;
+			break;
 		}
+		cycles = bsp_get_cyclecounter() - start;
+		if (cycles > trigger_latency_max)
+			trigger_latency_max = cycles;
 	}
-	return 0;
+	proto->timeout = timeout;
+	return ret;
+}
+
+/* The first filter of a command replaces the patterns, others are added */
+static bool trigger_add_filter(t_hydra_console *con, char *str, bool *first)
+{
+	trigger_pattern_t *pat;
+	uint8_t buf[256];
+	uint8_t len;
+
+	if (*first)
+		trigger_nb_patterns = 0;
+	*first = FALSE;
+
+	len = parse_escaped_string(str, buf);
+	if (trigger_nb_patterns == TRIGGER_PATTERNS || len > TRIGGER_POSITIONS) {
+		cprintf(con, "Up to %d patterns of %d bytes in total.\r\n",
+			TRIGGER_PATTERNS, TRIGGER_POSITIONS);
+		return FALSE;
+	}
+
+	pat = &trigger_patterns[trigger_nb_patterns];
+	pat->len = len;
+	memcpy(pat->data, buf, len);
+	memset(pat->mask, 0xff, sizeof(pat->mask));
+	trigger_nb_patterns++;
+
+	return TRUE;
+}
+
+/* Mask of the last pattern, missing bytes are left to 0xFF */
+static bool trigger_set_mask(t_hydra_console *con, char *str)
+{
+	trigger_pattern_t *pat;
+	uint8_t buf[256];
+	uint8_t len;
+
+	if (trigger_nb_patterns == 0) {
+		cprintf(con, "Please specify a filter first.\r\n");
+		return FALSE;
+	}
+	pat = &trigger_patterns[trigger_nb_patterns - 1];
+	len = parse_escaped_string(str, buf);
+	memcpy(pat->mask, buf, MIN(len, pat->len));
+
+	return TRUE;
+}
+
+static bool trigger_update(t_hydra_console *con)
+{
+	if (trigger_match_compile(&trigger_matcher, trigger_patterns,
+				  trigger_nb_patterns) < 0) {
+		trigger_nb_patterns = 0;
+		cprintf(con, "Up to %d bytes in total.\r\n", TRIGGER_POSITIONS);
+		return FALSE;
+	}
+	show_params(con);
+
+	return TRUE;
 }
 
 int cmd_trigger(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 {
+	bool first, changed;
 	int t;
 
+	first = TRUE;
+	changed = FALSE;
 	for (t = token_pos; p->tokens[t]; t++) {
 		switch (p->tokens[t]) {
 		case T_FILTER:
 			t += 2;
-			trigger_length = parse_escaped_string(p->buf + p->tokens[t], trigger_data);
-
-			show_params(con);
+			if (!trigger_add_filter(con, p->buf + p->tokens[t], &first))
+				return t - token_pos;
+			changed = TRUE;
+			break;
+		case T_MASK:
+			t += 2;
+			if (!trigger_set_mask(con, p->buf + p->tokens[t]))
+				return t - token_pos;
+			changed = TRUE;
 			break;
 		case T_START:
+			if (changed) {
+				changed = FALSE;
+				if (!trigger_update(con))
+					return t - token_pos;
+			}
 			cprintf(con, "Interrupt by pressing user button.\r\n");
 			cprint(con, "\r\n", 2);
 			trigger_run(con);
@@ -103,6 +234,7 @@ int cmd_trigger(t_hydra_console *con, t_tokenline_parsed *p, int token_pos)
 			return t - token_pos;
 		}
 	}
+	if (changed)
+		trigger_update(con);
 	return t - token_pos;
 }
-
@@ -0,0 +1,84 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2017 Benjamin VERNOUX
+ * Copyright (C) 2017 Nicolas OBERLI
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hydrabus_trigger_match.h"
+
+#include <string.h>
+
+/*
+ * The patterns are compiled into a bit-parallel (Shift-And) automaton: one
+ * state bit per pattern byte, all the patterns side by side. Each received
+ * byte costs a table lookup and a shift per state word whatever the number
+ * of patterns, overlapping matches are found and a mask byte of 0x00 makes
+ * the position match any byte.
+ */
+
+/* Returns 0, or -1 when the patterns do not fit in TRIGGER_POSITIONS */
+int trigger_match_compile(trigger_matcher_t *m, const trigger_pattern_t *pat,
+			  uint8_t nb_patterns)
+{
+	uint32_t pos, c;
+	uint8_t i, j;
+
+	memset(m, 0, sizeof(*m));
+
+	pos = 0;
+	for (i = 0; i < nb_patterns; i++, pat++) {
+		if (pat->len == 0)
+			continue;
+		if (pos + pat->len > TRIGGER_POSITIONS)
+			return -1;
+
+		m->init_bits[pos / 32] |= 1 << (pos % 32);
+		for (j = 0; j < pat->len; j++, pos++) {
+			for (c = 0; c < 256; c++) {
+				if ((c & pat->mask[j]) == (pat->data[j] & pat->mask[j]))
+					m->table[c][pos / 32] |= 1 << (pos % 32);
+			}
+		}
+		m->final_bits[(pos - 1) / 32] |= 1 << ((pos - 1) % 32);
+	}
+	return 0;
+}
+
+/*
+ * Feeds len bytes to the automaton, state holds the active positions and
+ * starts zeroed. Returns the index of the byte completing a match, or -1.
+ */
+int trigger_match(const trigger_matcher_t *m, uint32_t *state,
+		  const uint8_t *data, uint32_t len)
+{
+	uint32_t i, w, carry, next;
+
+	for (i = 0; i < len; i++) {
+		carry = 0;
+		next = 0;
+		for (w = 0; w < TRIGGER_WORDS; w++) {
+			next = state[w] >> 31;
+			state[w] = ((state[w] << 1) | carry | m->init_bits[w]) &
+				   m->table[data[i]][w];
+			carry = next;
+		}
+		for (w = 0; w < TRIGGER_WORDS; w++) {
+			if (state[w] & m->final_bits[w])
+				return i;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,50 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2017 Benjamin VERNOUX
+ * Copyright (C) 2017 Nicolas OBERLI
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_TRIGGER_MATCH_H_
+#define _HYDRABUS_TRIGGER_MATCH_H_
+
+/*
+ * Trigger pattern matcher, it does not depend on the board so it can be
+ * tested on the host.
+ */
+#include <stdint.h>
+
+#define TRIGGER_PATTERNS	(8)
+#define TRIGGER_WORDS		(2)
+#define TRIGGER_POSITIONS	(TRIGGER_WORDS * 32)
+
+typedef struct {
+	uint8_t len;
+	uint8_t data[TRIGGER_POSITIONS];
+	uint8_t mask[TRIGGER_POSITIONS];
+} trigger_pattern_t;
+
+typedef struct {
+	uint32_t table[256][TRIGGER_WORDS];
+	uint32_t init_bits[TRIGGER_WORDS];
+	uint32_t final_bits[TRIGGER_WORDS];
+} trigger_matcher_t;
+
+int trigger_match_compile(trigger_matcher_t *m, const trigger_pattern_t *pat,
+			  uint8_t nb_patterns);
+int trigger_match(const trigger_matcher_t *m, uint32_t *state,
+		  const uint8_t *data, uint32_t len);
+
+#endif /* _HYDRABUS_TRIGGER_MATCH_H_ */
@@ -0,0 +1,366 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common.h"
+#include "bsp_freq.h"
+#include "bsp_uart.h"
+#include "hydrabus_uart_autobaud.h"
+#include <string.h>
+
+/*
+ * The signal is captured on the FREQ1 input (PC6) as the duration of each
+ * level. A first window at 1us per tick gives a rough bit time used to
+ * select the prescaler of the second window, which has about
+ * AUTOBAUD_TICKS_PER_BIT ticks per bit. Durations are handled in 1/16 tick.
+ */
+#define AUTOBAUD_COARSE_SCALE	(168)	/* 1us ticks */
+#define AUTOBAUD_COARSE_EDGES	(64)
+#define AUTOBAUD_EDGES		(1024)
+#define AUTOBAUD_MIN_EDGES	(32)
+#define AUTOBAUD_TICKS_PER_BIT	(64)
+/* Longest run of identical bits in a frame: start bit + 8 data + parity */
+#define AUTOBAUD_MAX_RUN	(10)
+/* Bits added to the stream for a level longer than a frame */
+#define AUTOBAUD_IDLE_BITS	(16)
+#define AUTOBAUD_MIN_FRAMES	(8)
+#define AUTOBAUD_BITS_SIZE	(AUTOBAUD_EDGES * AUTOBAUD_IDLE_BITS / 8)
+
+static const uint32_t autobaud_std[] = {
+	300, 600, 1200, 2400, 4800, 9600, 14400, 19200, 28800, 38400,
+	57600, 76800, 115200, 230400, 250000, 460800, 500000, 921600,
+	1000000, 1500000, 2000000, 3000000, 4000000
+};
+
+/* Frame formats tried, shortest frames first and parity before none */
+static const struct {
+	uint8_t data_bits;
+	uint8_t parity;
+} autobaud_formats[] = {
+	{ 7, 0 }, { 7, 1 }, { 7, 2 },
+	{ 8, 0 }, { 8, 1 }, { 8, 2 },
+};
+#define AUTOBAUD_FORMATS_NB (sizeof(autobaud_formats) / sizeof(autobaud_formats[0]))
+
+static uint16_t autobaud_capture(uint16_t scale, uint16_t *buf, uint16_t nb,
+				 uint32_t timeout_ms, uint8_t *level)
+{
+	systime_t start;
+	uint16_t count;
+
+	if (bsp_freq_edges_start(BSP_DEV_FREQ1, scale, buf, nb, level) != BSP_OK)
+		return 0;
+
+	start = chVTGetSystemTimeX();
+	do {
+		count = bsp_freq_edges_count(BSP_DEV_FREQ1, nb);
+		if (count == nb)
+			break;
+		chThdSleepMilliseconds(1);
+	} while (!hydrabus_ubtn() &&
+		 chVTTimeElapsedSinceX(start) < TIME_MS2I(timeout_ms));
+
+	bsp_freq_deinit(BSP_DEV_FREQ1);
+	return count;
+}
+
+/* Duration in 1/16 tick, the counter restarts from 0 on each edge */
+static uint32_t autobaud_dur(uint16_t ticks, uint16_t scale)
+{
+	/* Edge resynchronization costs 2 timer clocks at full speed */
+	return ticks * 16 + ((scale == 1) ? 32 : 8);
+}
+
+/* Round to a number of bits, 0 when too far from a multiple of bit */
+static uint32_t autobaud_bits(uint32_t d, uint32_t bit)
+{
+	uint32_t k, err;
+
+	k = (d + bit / 2) / bit;
+	err = (d > k * bit) ? d - k * bit : k * bit - d;
+	return (err > bit / 4) ? 0 : k;
+}
+
+/*
+ * Shortest duration found often enough (histogram cluster), then refined
+ * as the approximate GCD of all durations up to AUTOBAUD_MAX_RUN bits.
+ */
+static uint32_t autobaud_bit_time(const uint16_t *buf, uint16_t nb, uint16_t scale,
+				  uint8_t *confidence)
+{
+	uint32_t best, c, d, k, bit, sum_d, sum_k, support, min_support;
+	uint32_t matched, total;
+	int i, j, iter;
+
+	min_support = nb / 32;
+	if (min_support < 2)
+		min_support = 2;
+
+	best = 0xffffffff;
+	for (i = 1; i < nb; i++) {
+		c = autobaud_dur(buf[i], scale);
+		if (c >= best || c < 2 * 16)
+			continue;
+		support = 0;
+		for (j = 1; j < nb; j++) {
+			d = autobaud_dur(buf[j], scale);
+			if (d >= c && d <= c + c / 4)
+				support++;
+		}
+		if (support >= min_support)
+			best = c;
+	}
+	if (best == 0xffffffff)
+		return 0;
+
+	bit = best;
+	matched = 0;
+	total = 0;
+	for (iter = 0; iter < 3; iter++) {
+		sum_d = 0;
+		sum_k = 0;
+		matched = 0;
+		total = 0;
+		for (i = 1; i < nb; i++) {
+			d = autobaud_dur(buf[i], scale);
+			if (d > bit * AUTOBAUD_MAX_RUN + bit / 2)
+				continue;
+			total++;
+			k = autobaud_bits(d, bit);
+			if (k == 0)
+				continue;
+			matched++;
+			sum_d += d;
+			sum_k += k;
+		}
+		if (sum_k == 0)
+			return 0;
+		bit = sum_d / sum_k;
+	}
+
+	*confidence = (total > 0) ? (matched * 100) / total : 0;
+	return bit;
+}
+
+static void autobaud_put(uint8_t *bits, uint32_t *nb_bits, uint8_t level, uint32_t k)
+{
+	while (k-- > 0 && *nb_bits < AUTOBAUD_BITS_SIZE * 8) {
+		if (level)
+			bits[*nb_bits >> 3] |= 1 << (*nb_bits & 7);
+		(*nb_bits)++;
+	}
+}
+
+#define autobaud_bit(bits, pos) (((bits)[(pos) >> 3] >> ((pos) & 7)) & 1)
+
+static uint32_t autobaud_next_start(const uint8_t *bits, uint32_t nb_bits, uint32_t pos)
+{
+	while (pos < nb_bits && autobaud_bit(bits, pos))
+		pos++;
+	return pos;
+}
+
+/*
+ * Rebuild the bit stream from the level durations. Returns the position
+ * after the first idle level, where the frames are known to be aligned.
+ */
+static uint32_t autobaud_stream(const uint16_t *buf, uint16_t nb, uint16_t scale,
+				uint32_t bit, uint8_t level0,
+				uint8_t *bits, uint32_t *nb_bits)
+{
+	uint32_t d, k, sync;
+	uint8_t level;
+	int i;
+
+	memset(bits, 0, AUTOBAUD_BITS_SIZE);
+	*nb_bits = 0;
+	sync = 0;
+
+	for (i = 1; i < nb; i++) {
+		level = level0 ^ (i & 1);
+		d = autobaud_dur(buf[i], scale);
+		k = (d + bit / 2) / bit;
+		if (k > AUTOBAUD_MAX_RUN) {
+			/* Idle line, or a wrapped duration */
+			autobaud_put(bits, nb_bits, level, AUTOBAUD_IDLE_BITS);
+			if (level && sync == 0)
+				sync = *nb_bits;
+		} else {
+			autobaud_put(bits, nb_bits, level, k);
+		}
+	}
+	/* Line is idle after the last edge */
+	autobaud_put(bits, nb_bits, level0 ^ (nb & 1), AUTOBAUD_IDLE_BITS);
+
+	return sync;
+}
+
+static uint16_t autobaud_parse(const uint8_t *bits, uint32_t nb_bits, uint32_t pos,
+			       uint8_t data_bits, uint8_t parity,
+			       uint16_t *errors, uint8_t *stop_bits)
+{
+	uint32_t frame_bits, next, ones, i;
+	uint16_t frames, one_stop, two_stops;
+	bool ok;
+
+	frame_bits = 1 + data_bits + (parity ? 1 : 0) + 1;
+	frames = 0;
+	one_stop = 0;
+	two_stops = 0;
+	*errors = 0;
+
+	pos = autobaud_next_start(bits, nb_bits, pos);
+	while (pos + frame_bits <= nb_bits) {
+		ones = 0;
+		for (i = 1; i <= data_bits; i++)
+			ones += autobaud_bit(bits, pos + i);
+		ok = autobaud_bit(bits, pos + frame_bits - 1);
+		if (parity) {
+			ones += autobaud_bit(bits, pos + data_bits + 1);
+			/* Even parity: even number of ones with the parity bit */
+			if ((ones & 1) != ((parity == 1) ? 0 : 1))
+				ok = FALSE;
+		}
+		if (!ok) {
+			(*errors)++;
+			pos = autobaud_next_start(bits, nb_bits, pos + 1);
+			continue;
+		}
+
+		frames++;
+		next = autobaud_next_start(bits, nb_bits, pos + frame_bits);
+		if (next < nb_bits) {
+			/* Stop bits between back to back frames */
+			if (next - (pos + frame_bits) == 0)
+				one_stop++;
+			else if (next - (pos + frame_bits) == 1)
+				two_stops++;
+		}
+		pos = next;
+	}
+
+	/* Frames out of sync before the first idle level may add a few one_stop */
+	*stop_bits = (two_stops >= 4 && two_stops > 8 * one_stop) ? 2 : 1;
+	return frames;
+}
+
+/** \brief Estimate the baudrate and frame format of the UART signal on PC6.
+ *
+ * \param timeout_ms uint32_t: maximum duration of each capture window
+ * \param res uart_autobaud_t*: result
+ * \return bsp_status_t: BSP_TIMEOUT without enough edges, BSP_ERROR when no
+ * bit time was found. data_bits is 0 if the frame format is unknown.
+ *
+ */
+bsp_status_t uart_autobaud(uint32_t timeout_ms, uart_autobaud_t *res)
+{
+	uint16_t *buf;
+	uint8_t *bits;
+	uint16_t nb, scale, frames, errors;
+	uint32_t bit, min, nb_bits, sync, scale32;
+	uint8_t level, stop_bits;
+	bsp_status_t status;
+	unsigned int i;
+
+	memset(res, 0, sizeof(uart_autobaud_t));
+
+	buf = pool_alloc_bytes(AUTOBAUD_EDGES * sizeof(uint16_t));
+	bits = pool_alloc_bytes(AUTOBAUD_BITS_SIZE);
+	if (buf == NULL || bits == NULL) {
+		status = BSP_ERROR;
+		goto out;
+	}
+
+	/* Coarse window: shortest level in us selects the prescaler */
+	nb = autobaud_capture(AUTOBAUD_COARSE_SCALE, buf, AUTOBAUD_COARSE_EDGES,
+			      timeout_ms, &level);
+	if (nb < AUTOBAUD_COARSE_EDGES / 2) {
+		status = BSP_TIMEOUT;
+		goto out;
+	}
+	min = 0xffff;
+	for (i = 1; i < nb; i++) {
+		if (buf[i] < min)
+			min = buf[i];
+	}
+	scale32 = (min <= 2) ? 1 :
+		  (min * AUTOBAUD_COARSE_SCALE) / AUTOBAUD_TICKS_PER_BIT;
+	scale = (scale32 > 0xffff) ? 0xffff : (scale32 ? scale32 : 1);
+
+	nb = autobaud_capture(scale, buf, AUTOBAUD_EDGES, timeout_ms, &level);
+	res->edges = nb;
+	if (nb < AUTOBAUD_MIN_EDGES) {
+		status = BSP_TIMEOUT;
+		goto out;
+	}
+
+	bit = autobaud_bit_time(buf, nb, scale, &res->confidence);
+	if (bit == 0) {
+		status = BSP_ERROR;
+		goto out;
+	}
+	res->measured = ((uint64_t)BSP_FREQ_BASE_FREQ * 16) / ((uint64_t)bit * scale);
+	res->baudrate = res->measured;
+	for (i = 0; i < sizeof(autobaud_std) / sizeof(autobaud_std[0]); i++) {
+		if ((res->measured > autobaud_std[i] ?
+		     res->measured - autobaud_std[i] :
+		     autobaud_std[i] - res->measured) * 50 <= autobaud_std[i]) {
+			res->baudrate = autobaud_std[i];
+			break;
+		}
+	}
+
+	sync = autobaud_stream(buf, nb, scale, bit, level, bits, &nb_bits);
+	for (i = 0; i < AUTOBAUD_FORMATS_NB; i++) {
+		frames = autobaud_parse(bits, nb_bits, sync,
+					autobaud_formats[i].data_bits,
+					autobaud_formats[i].parity,
+					&errors, &stop_bits);
+		if (frames >= AUTOBAUD_MIN_FRAMES && errors * 16 <= frames) {
+			res->data_bits = autobaud_formats[i].data_bits;
+			res->parity = autobaud_formats[i].parity;
+			res->stop_bits = stop_bits;
+			res->frames = frames;
+			break;
+		}
+	}
+	status = BSP_OK;
+out:
+	pool_free(buf);
+	pool_free(bits);
+	return status;
+}
+
+/** \brief Configure the UART with the autobaud result.
+ *
+ * Only 8 data bits frames are supported by bsp_uart, the speed alone is
+ * applied for other or unknown frame formats.
+ *
+ * \param proto mode_config_proto_t*: UART configuration.
+ * \param res uart_autobaud_t*: result of uart_autobaud()
+ * \return bsp_status_t: status of bsp_uart_init()
+ *
+ */
+bsp_status_t uart_autobaud_apply(mode_config_proto_t *proto, uart_autobaud_t *res)
+{
+	proto->config.uart.dev_speed = res->baudrate;
+	if (res->data_bits == 8) {
+		proto->config.uart.dev_parity = res->parity;
+		proto->config.uart.dev_stop_bit = res->stop_bits;
+	}
+	return bsp_uart_init(proto->dev_num, proto);
+}
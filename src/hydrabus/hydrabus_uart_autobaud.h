@@ -0,0 +1,39 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRABUS_UART_AUTOBAUD_H_
+#define _HYDRABUS_UART_AUTOBAUD_H_
+
+#include "common.h"
+#include "bsp.h"
+
+typedef struct {
+	uint32_t baudrate;	/* Nearest standard rate within 2%, else measured */
+	uint32_t measured;	/* Measured rate */
+	uint8_t data_bits;	/* 0 when the frame format was not found */
+	uint8_t parity;		/* 0 none, 1 even, 2 odd (as dev_parity) */
+	uint8_t stop_bits;
+	uint8_t confidence;	/* % of the levels which are a multiple of the bit time */
+	uint16_t edges;
+	uint16_t frames;
+} uart_autobaud_t;
+
+bsp_status_t uart_autobaud(uint32_t timeout_ms, uart_autobaud_t *res);
+bsp_status_t uart_autobaud_apply(mode_config_proto_t *proto, uart_autobaud_t *res);
+
+#endif /* _HYDRABUS_UART_AUTOBAUD_H_ */
@@ -22,6 +22,7 @@
 
 #include "common.h"
 #include "mcu.h"
+#include "hydranfc_emul_tag.h"
 
 #define MIFARE_DATA_MAX     20
 /* Does not managed UID > 4+BCC to be done later ... */
@@ -81,6 +82,25 @@ void hydranfc_emul_iso14443a(t_hydra_console *con);
 
 void hydranfc_emul_mf_ultralight(t_hydra_console *con);
 int hydranfc_emul_mf_ultralight_file(t_hydra_console *con, char* filename);
+void hydranfc_emul_mf_ultralight_start(void);
+void hydranfc_emul_mf_ultralight_stop(void);
+
+/* Emulation of the tag image in emul_tag from the TRF7970A IRQ */
+typedef struct {
+	uint32_t responses;
+	uint32_t late;		/* Processing longer than the response time */
+	uint32_t errors;
+	uint32_t min;		/* Cycles from the end of the FIFO read to the */
+	uint32_t max;		/* response ready to be sent */
+	uint32_t irq_max;	/* Cycles from the IRQ entry to the response */
+} emul_tag_stats_t;
+
+extern emul_tag_t emul_tag;
+extern emul_tag_stats_t emul_tag_stats;
+
+void emul_tag_trf_stats_reset(void);
+int emul_tag_trf_rx(uint32_t t_irq);
+void emul_tag_trf_print_stats(t_hydra_console *con);
 
 #endif /* _HYDRANFC_H_ */
 
@@ -20,6 +20,7 @@
 #include "common.h"
 #include "tokenline.h"
 #include "trf797x.h"
+#include "hydranfc.h"
 #include "hydrabus_bbio.h"
 #include "hydranfc_bbio_reader.h"
 
@@ -81,6 +82,65 @@ void set_mode_iso_15693(void)
 	Trf797xWriteSingle(data_buf, 2);
 }
 
+/*
+ * Emulate a MIFARE Ultralight/NTAG21x image until a byte is received or
+ * UBTN is pressed, then send back the statistics and the image which may
+ * have been modified by WRITE commands.
+ */
+static void bbio_nfc_emul_mf_ultralight(t_hydra_console *con)
+{
+	uint8_t *data = emul_tag.image.data;
+	uint32_t stats[6];
+	uint8_t buf[1 + 6 * 4];
+	uint16_t size, i;
+
+	chnRead(con->sdu, buf, 2);
+	size = (buf[0] << 8) | buf[1];
+	if (size > EMUL_TAG_DATA_MAX) {
+		/* Drop the image */
+		for (i = 0; i < size; i++)
+			chnRead(con->sdu, buf, 1);
+		buf[0] = 0;
+		cprint(con, (char *)buf, 1);
+		return;
+	}
+	chnRead(con->sdu, data, size);
+
+	if (emul_tag_load_ul(&emul_tag, data, size) != EMUL_TAG_OK) {
+		buf[0] = 0;
+		cprint(con, (char *)buf, 1);
+		return;
+	}
+	hydranfc_emul_mf_ultralight_start();
+	buf[0] = 1;
+	cprint(con, (char *)buf, 1);
+
+	while (!hydrabus_ubtn()) {
+		if (chnReadTimeout(con->sdu, buf, 1, TIME_MS2I(10)) == 1)
+			break;
+	}
+	hydranfc_emul_mf_ultralight_stop();
+
+	/*
+	 * Responses, late responses, errors, min and max processing latency
+	 * and max IRQ to response latency in cycles
+	 */
+	stats[0] = emul_tag_stats.responses;
+	stats[1] = emul_tag_stats.late;
+	stats[2] = emul_tag_stats.errors;
+	stats[3] = emul_tag_stats.min;
+	stats[4] = emul_tag_stats.max;
+	stats[5] = emul_tag_stats.irq_max;
+	buf[0] = 1;
+	for (i = 0; i < 6; i++) {
+		buf[1 + i * 4] = stats[i] >> 24;
+		buf[2 + i * 4] = stats[i] >> 16;
+		buf[3 + i * 4] = stats[i] >> 8;
+		buf[4 + i * 4] = stats[i];
+	}
+	cprint(con, (char *)buf, 1 + 6 * 4);
+	cprint(con, (char *)data, size);
+}
 
 void bbio_mode_hydranfc_reader(t_hydra_console *con)
 {
@@ -113,6 +173,10 @@ void bbio_mode_hydranfc_reader(t_hydra_console *con)
 				break;
 			}
 
+			case BBIO_NFC_EMUL_MF_ULTRALIGHT: {
+				bbio_nfc_emul_mf_ultralight(con);
+				break;
+			}
 			case BBIO_NFC_CMD_SEND_BITS: {
 				chnRead(con->sdu, rx_data, 2);
 				rlen = Trf797x_transceive_bits(rx_data[0],
@@ -29,18 +29,6 @@
 
 #define MFC_ULTRALIGHT_DATA_SIZE (16 * 4)
 
-typedef enum {
-	EMUL_RX_MF_ULTRALIGHT_REQA_WUPA, /* Wait RX REQA 0x26 or RX WUPA 0x52 */
-
-	EMUL_RX_MF_ULTRALIGHT_ANTICOL_L1, /* Wait RX ANTICOL 0x93 0x20 */
-	EMUL_RX_MF_ULTRALIGHT_SEL1_UID, /* Wait RX SEL UID 0x93 0x70 0x88(CT) + UID 0, 1, 2 + BCC */
-	EMUL_RX_MF_ULTRALIGHT_ANTICOL_L2, /* Wait RX ANTICOL 0x95 0x20 */
-	EMUL_RX_MF_ULTRALIGHT_SEL2_UID, /* Wait RX SEL UID 0x95 0x70 + UID 3, 4, 5, 6 + BCC */
-	EMUL_RX_MF_ULTRALIGHT_END_ANTICOL, /* End of Anticol */
-
-	EMUL_RX_MF_ULTRALIGHT_CMD /* Wait command */
-} emul_mf_ultralight_state;
-
 /* IRQ Status flag for NFC and Card Emulation Operation */
 typedef enum
 {
@@ -54,53 +42,6 @@ typedef enum
     IRQ_STATUS_TX_COMPLETE = 0x80
 } t_trf7970a_irq_flag;
 
-/*
-Mifare Ultralight/MF0ICU1 commands see http://cache.nxp.com/documents/data_sheet/MF0ICU1.pdf?pspll=1
-*/
-/* Emul ISO14443A */
-#define ISO14443A_REQA 0x26 /* RX REQA 7bit */
-#define ISO14443A_WUPA 0x52 /* RX WUPA 7bit */
-
-/* Cascade level 1: ANTICOLLISION and SELECT commands */
-#define ISO14443A_ANTICOL_L1_BYTE0 0x93 /* RX ANTICOLLISION Cascade Level1 Byte0 & 1 */
-#define ISO14443A_ANTICOL_L1_BYTE1 0x20
-
-#define ISO14443A_SEL_L1_BYTE0 0x93 /* RX SELECT Cascade Level1 Byte0 & 1 + CT */
-#define ISO14443A_SEL_L1_BYTE1 0x70
-#define ISO14443A_SEL_L1_CT 0x88 /* TX CT for 1st Byte */
-
-/* Cascade level 2: ANTICOLLISION and SELECT commands */
-#define ISO14443A_ANTICOL_L2_BYTE0 0x95 /* RX SELECT Cascade Level2 Byte0 & 1 */
-#define ISO14443A_ANTICOL_L2_BYTE1 0x20
-
-#define ISO14443A_SEL_L2_BYTE0 0x95 /* RX SELECT Cascade Level2 Byte0 & 1 */
-#define ISO14443A_SEL_L2_BYTE1 0x70
-
-typedef enum {
-	EMUL_MF_ULTRALIGHT_READ = 0x30, /* Read 16bytes data */
-	EMUL_MF_ULTRALIGHT_HALT = 0x50,
-	EMUL_MF_ULTRALIGHT_WRITE = 0xA2, /* Write 4 bytes data */
-	EMUL_MF_ULTRALIGHT_COMPAT_WRITE = 0xA0 /* Write 16bytes data but chipset keep only 4bytes */
-} emul_mf_ultralight_cmd;
-
-/* MIFARE Ultralight ATQA 2 Bytes */
-const uint8_t mf_ultralight_atqa[2] =
-{
-  0x44, 0x00
-};
-
-/* MIFARE Ultralight SAK1 & SAK2 2 Bytes */
-const uint8_t mf_ultralight_sak[2] =
-{
-  0x04, 0x00
-};
-
-/* MIFARE Ultralight 7Bytes UID default data */
-const uint8_t mf_ultralight_uid_default[7] =
-{
-  0x04, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06
-};
-
 /* Mifare Ultralight EEPROM emulation 512 bits, organized in 16 pages of 4 bytes per page */
 const uint8_t mf_ultralight_data_default[MFC_ULTRALIGHT_DATA_SIZE] = 
 {
@@ -114,16 +55,8 @@ const uint8_t mf_ultralight_data_default[MFC_ULTRALIGHT_DATA_SIZE] =
 	0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F
 };
 
-/* MIFARE Ultralight 7Bytes UID */
-uint8_t mf_ultralight_uid[7];
-
-/* BCC1 & BCC2 for mf_ultralight_uid 7Bytes UID */
-uint8_t mf_ultralight_uid_bcc[2];
-
-/* Mifare UltraLight Data */
-uint8_t mf_ultralight_data[MFC_ULTRALIGHT_DATA_SIZE];
-
-static emul_mf_ultralight_state emul_mf_ultralight_14443a_state = EMUL_RX_MF_ULTRALIGHT_REQA_WUPA;
+/* Current ISO Control Register value, it follows the anticollision */
+static uint8_t emul_mf_ultralight_iso_control;
 
 void  hydranfc_emul_mf_ultralight_init(void)
 {
@@ -152,6 +85,7 @@ void  hydranfc_emul_mf_ultralight_init(void)
 	data_buf[0] = ISO_CONTROL;
 	data_buf[1] = 0x21; // 106 kbps
 	Trf797xWriteSingle(data_buf, 2);
+	emul_mf_ultralight_iso_control = data_buf[1];
 
 	/* Configure RX
 		[AGC 8 subcarrier pulses]
@@ -205,248 +139,78 @@ void  hydranfc_emul_mf_ultralight_init(void)
 #endif
 }
 
-/* Return Nb data sent (0 if error) */
-int emul_mf_ultralight_tx_rawdata(uint8_t* tx_data, int tx_nb_data, int flag_crc)
-{
-	int i;
-
-	if(tx_nb_data+5 > NFC_TX_RAWDATA_BUF_SIZE)
-		return 0;
-
-	/* Send Raw Data */
-	nfc_tx_rawdata_buf[0] = 0x8F; /* Direct Command => Reset FIFO */
-	if(flag_crc==0) {
-		nfc_tx_rawdata_buf[1] = 0x90; /* Direct Command => Transmission With No CRC (0x10) */
-	} else {
-		nfc_tx_rawdata_buf[1] = 0x91; /* Direct Command => Transmission With CRC (0x11) */
-	}
-	nfc_tx_rawdata_buf[2] = 0x3D; /* Write Continuous (Start at @0x1D => TX Length Byte1 & Byte2) */
-	nfc_tx_rawdata_buf[3] = ((tx_nb_data&0xF0)>>4); /* Number of Bytes to be sent MSB 0x00 @0x1D */
-	nfc_tx_rawdata_buf[4] = ((tx_nb_data<<4)&0xF0); /* Number of Byte to be sent LSB 0x00 @0x1E = Max 7bits */
 
-	for(i=0; i<tx_nb_data; i++) {
-		/* Data (FIFO TX 1st Data @0x1F) */
-		nfc_tx_rawdata_buf[5+i] = tx_data[i];
-	}
-	Trf797xRawWrite(nfc_tx_rawdata_buf, (tx_nb_data+5));
-	return tx_nb_data;
-}
-
-void hydranfc_emul_mf_ultralight_states(void)
+/*
+ * The TRF7970A checks the RX CRC and stops delivering anticollision frames
+ * once the tag is selected, it is initialized again when the tag leaves
+ * the ACTIVE state.
+ */
+static void emul_mf_ultralight_trf_config(void)
 {
-	uint8_t data_buf[32];
-	int fifo_size;
-	int error;
-	int page_num;
-
-	error = 0;
-	/* Read FIFO Status(0x1C=>0x5C) */
-	data_buf[0] = FIFO_CONTROL;
-	Trf797xReadSingle(data_buf, 1);  // determine the number of bytes left in FIFO
-	fifo_size = data_buf[0] & 0x7F; /* Clear Flag FIFO Overflow */
-	fifo_size = fifo_size & 0x1F; /* Limit Fifo size to 31bytes */
+	uint8_t data_buf[2];
 
-	switch(emul_mf_ultralight_14443a_state) 
+	switch(emul_tag.state)
 	{
-		case EMUL_RX_MF_ULTRALIGHT_REQA_WUPA:
-			if(fifo_size == 1) {
-				data_buf[0] = FIFO;
-				Trf797xReadCont(data_buf, fifo_size);
-				if( (data_buf[0] == ISO14443A_REQA) ||
-						(data_buf[0] == ISO14443A_WUPA) ) 
-				{
-					/* Reply with ATQA */
-					data_buf[0] = mf_ultralight_atqa[0];
-					data_buf[1] = mf_ultralight_atqa[1];
-					wait_delay(3791);
-					if(emul_mf_ultralight_tx_rawdata(data_buf, 2, 0) == 2)
-						emul_mf_ultralight_14443a_state = EMUL_RX_MF_ULTRALIGHT_ANTICOL_L1;
-				} else {
-					/* Invalid/Unsupported RX data */
-					error=1;
-				}
-			} else
-				error=1;
-			break;
-
-		case EMUL_RX_MF_ULTRALIGHT_ANTICOL_L1: /* ANTICOLLISION Cascade Level 1 */
-			if(fifo_size == 2) {
-				data_buf[0] = FIFO;
-				Trf797xReadCont(data_buf, fifo_size);
-				if(
-					(data_buf[0] == ISO14443A_ANTICOL_L1_BYTE0) &&
-					(data_buf[1] == ISO14443A_ANTICOL_L1_BYTE1)) 
-				{
-					/* Reply with CT + UID 0, 1, 2 + BCC => No CRC */
-					data_buf[0] = ISO14443A_SEL_L1_CT;
-					data_buf[1] = mf_ultralight_uid[0];
-					data_buf[2] = mf_ultralight_uid[1];
-					data_buf[3] = mf_ultralight_uid[2];
-					data_buf[4] = mf_ultralight_uid_bcc[0]; // BCC1
-					wait_delay(2378);
-					if(emul_mf_ultralight_tx_rawdata(data_buf, 5, 0) == 5)
-						emul_mf_ultralight_14443a_state = EMUL_RX_MF_ULTRALIGHT_SEL1_UID;
-				} else
-					error=1;
-			} else
-				error=1;
-			break;
-
-		case EMUL_RX_MF_ULTRALIGHT_SEL1_UID: /* SELECT Cascade Level 1 */
-			if(fifo_size >= 9) 
+		case EMUL_TAG_READY1:
+		case EMUL_TAG_READY2:
+			if(emul_mf_ultralight_iso_control != 0xA4)
 			{
-				data_buf[0] = FIFO;
-				Trf797xReadCont(data_buf, fifo_size);
-				/* Read data it shall be SEL UID(2B) + CT/UID/BCC(5B) + 2B CRC */
-				/* TODO: Check CRC16 ... */
-				if(
-					(data_buf[0] == ISO14443A_SEL_L1_BYTE0) &&
-					(data_buf[1] == ISO14443A_SEL_L1_BYTE1) &&
-					(data_buf[2] == ISO14443A_SEL_L1_CT) &&
-					(data_buf[3] == mf_ultralight_uid[0]) &&
-					(data_buf[4] == mf_ultralight_uid[1]) &&
-					(data_buf[5] == mf_ultralight_uid[2]) &&
-					(data_buf[6] == mf_ultralight_uid_bcc[0])) 
-				{
-					/* Reply with SAK L1 + CRC */
-					data_buf[0] = mf_ultralight_sak[0];
-					wait_delay(324);
-					if(emul_mf_ultralight_tx_rawdata(data_buf, 1, 1) == 1) {
-						emul_mf_ultralight_14443a_state = EMUL_RX_MF_ULTRALIGHT_ANTICOL_L2;
-					} else
-						error=1;
-				} else
-					error=1;
-			} else
-				error=1;
-			break;
-
-		case EMUL_RX_MF_ULTRALIGHT_ANTICOL_L2: /* ANTICOLLISION Cascade Level 2 */
-			if(fifo_size == 2) {
-				data_buf[0] = FIFO;
-				Trf797xReadCont(data_buf, fifo_size);
-				if(
-					(data_buf[0] == ISO14443A_ANTICOL_L2_BYTE0) &&
-					(data_buf[1] == ISO14443A_ANTICOL_L2_BYTE1)) 
-				{
-					/* Reply with UID 3, 4, 5, 6 + BCC => No CRC */
-					data_buf[0] = mf_ultralight_uid[3];
-					data_buf[1] = mf_ultralight_uid[4];
-					data_buf[2] = mf_ultralight_uid[5];
-					data_buf[3] = mf_ultralight_uid[6];
-					data_buf[4] = mf_ultralight_uid_bcc[1]; // BCC2
-					wait_delay(2378);
-					if(emul_mf_ultralight_tx_rawdata(data_buf, 5, 0) == 5)
-						emul_mf_ultralight_14443a_state = EMUL_RX_MF_ULTRALIGHT_SEL2_UID;
-				} else
-					error=1;
-			} else
-				error=1;
-			break;
-
-		case EMUL_RX_MF_ULTRALIGHT_SEL2_UID: /* SELECT Cascade Level 2 */
-			if(fifo_size >= 9) 
-			{
-				data_buf[0] = FIFO;
-				Trf797xReadCont(data_buf, fifo_size);
-				/* Read data it shall be SEL UID(2B) + UID/BCC(5B) + 2B CRC */
-				/* TODO: Check CRC16 ... */
-				if(
-					(data_buf[0] == ISO14443A_SEL_L2_BYTE0) &&
-					(data_buf[1] == ISO14443A_SEL_L2_BYTE1) &&
-					(data_buf[2] == mf_ultralight_uid[3]) &&
-					(data_buf[3] == mf_ultralight_uid[4]) &&
-					(data_buf[4] == mf_ultralight_uid[5]) &&
-					(data_buf[5] == mf_ultralight_uid[6]) &&
-					(data_buf[6] == mf_ultralight_uid_bcc[1])) 
-				{
-					/* Reply with SAK L2 + CRC */
-					data_buf[0] =  mf_ultralight_sak[1];
-					wait_delay(324);
-					if(emul_mf_ultralight_tx_rawdata(data_buf, 1, 1) == 1) {
-						emul_mf_ultralight_14443a_state = EMUL_RX_MF_ULTRALIGHT_END_ANTICOL;
-					} else
-						error=1;
-				} else
-					error=1;
-			} else
-				error=1;
-			break;
-
-		case EMUL_RX_MF_ULTRALIGHT_END_ANTICOL:
-			emul_mf_ultralight_14443a_state = EMUL_RX_MF_ULTRALIGHT_CMD;
-			break;
-
-		case EMUL_RX_MF_ULTRALIGHT_CMD:
-			data_buf[0] = FIFO;
-			Trf797xReadCont(data_buf, fifo_size);
+				/*
+				 * Configure Mode ISO Control Register (0x01) to 0xA4 (no RX CRC)
+				 */
+				data_buf[0] = ISO_CONTROL;
+				data_buf[1] = 0xA4;
+				Trf797xWriteSingle(data_buf, 2);
+				emul_mf_ultralight_iso_control = data_buf[1];
+			}
+		break;
 
-			if(fifo_size >= 2)
+		case EMUL_TAG_ACTIVE:
+		case EMUL_TAG_COMPAT_WRITE:
+			if(emul_mf_ultralight_iso_control != 0x24)
 			{
-				switch(data_buf[0])
-				{
-					case EMUL_MF_ULTRALIGHT_HALT:
-						if(data_buf[1] == 0x00)
-							emul_mf_ultralight_14443a_state = EMUL_RX_MF_ULTRALIGHT_REQA_WUPA;
-						else
-							error=1;
-					break;
-
-					case EMUL_MF_ULTRALIGHT_READ:
-						/* Reply with 16bytes DATA + automatic CRC added by TRF7970A */
-						wait_delay(324); // TBD
-						/* TODO implement roll-back buffer */
-						page_num = data_buf[1] & 0xF;
-						if(page_num > 12)
-							page_num = 12; // Limit the page num to avoid buffer overflow
-
-						if(emul_mf_ultralight_tx_rawdata(&mf_ultralight_data[page_num*4], 16, 1) == 16) {
-							emul_mf_ultralight_14443a_state = EMUL_RX_MF_ULTRALIGHT_CMD;
-						} else
-							error=1;
-					break;
-
-					case EMUL_MF_ULTRALIGHT_WRITE:
-						// TODO Add write command emulation
-						error=1;
-					break;
-
-					case EMUL_MF_ULTRALIGHT_COMPAT_WRITE:
-						// TODO Add write compat command emulation
-						error=1;
-					break;
-
-					default: /* Unknown command */
-						error=1;
-					break;
-				}
-			} else
-				error=2;
-			break;
+				/*
+				 * Configure Mode ISO Control Register (0x01) to 0x24 (RX CRC)
+				 */
+				data_buf[0] = ISO_CONTROL;
+				data_buf[1] = 0x24;
+				Trf797xWriteSingle(data_buf, 2);
+				emul_mf_ultralight_iso_control = data_buf[1];
+
+				/*
+					BIT1 = Disable anticollision frames for 14443A
+					(this bit should be set to 1 after anticollision is finished)
+				*/
+				data_buf[0] = SPECIAL_FUNCTION;
+				data_buf[1] = BIT1;
+				Trf797xWriteSingle(data_buf, 2);
+			}
+		break;
 
 		default:
-			error=3;
-			break;
-	}
-
-	/* Error on Protocol */
-	if(error > 0) {
-		emul_mf_ultralight_14443a_state = EMUL_RX_MF_ULTRALIGHT_REQA_WUPA;
-		/* Re-Init TRF7970A on status error */
-		hydranfc_emul_mf_ultralight_init();
+			if(emul_mf_ultralight_iso_control == 0x24)
+				hydranfc_emul_mf_ultralight_init();
+		break;
 	}
 }
 
-static t_trf7970a_irq_flag status;
-static uint8_t nfc_target_protocol;
+/*
+ * All the protocol is handled here, responses are sent at a fixed time
+ * from the end of the FIFO read, see emul_tag_trf_rx()
+ */
 void hydranfc_emul_mf_ultralight_irq(void)
 {
 	uint8_t data_buf[2];
+	uint8_t status;
+	uint8_t nfc_target_protocol;
+	uint32_t t_irq;
 	int error = 0;
 
+	t_irq = bsp_get_cyclecounter();
+
 	/* Read NFC Target Protocol */
 	data_buf[0] = NFC_TARGET_PROTOCOL;
-	Trf797xReadSingle(data_buf, 1);  // determine the number of bytes left in FIFO
+	Trf797xReadSingle(data_buf, 1);
 	nfc_target_protocol = data_buf[0];
 
 	/* Read IRQ Status */
@@ -459,38 +223,7 @@ void hydranfc_emul_mf_ultralight_irq(void)
 		{
 			// Reset FIFO CMD
 			Trf797xResetFIFO();
-
-			switch(emul_mf_ultralight_14443a_state)
-			{
-				case EMUL_RX_MF_ULTRALIGHT_ANTICOL_L1:
-					/*
-					 * Configure Mode ISO Control Register (0x01) to 0xA4 (no RX CRC)
-					 */
-					data_buf[0] = ISO_CONTROL;
-					data_buf[1] = 0xA4;
-					Trf797xWriteSingle(data_buf, 2);
-				break;
-
-				case EMUL_RX_MF_ULTRALIGHT_END_ANTICOL:
-					/*
-					 * Configure Mode ISO Control Register (0x01) to 0x24 (RX CRC)
-					 */
-					data_buf[0] = ISO_CONTROL;
-					data_buf[1] = 0x24;
-					Trf797xWriteSingle(data_buf, 2);
-
-					/*
-						BIT1 = Disable anticollision frames for 14443A
-						(this bit should be set to 1 after anticollision is finished)
-					*/
-					data_buf[0] = SPECIAL_FUNCTION;
-					data_buf[1] = BIT1;
-					Trf797xWriteSingle(data_buf, 2);
-				break;
-
-				default:
-				break;
-			}
+			emul_mf_ultralight_trf_config();
 		}else
 		{
 			/* Read FIFO Status(0x1C=>0x5C) */
@@ -503,7 +236,10 @@ void hydranfc_emul_mf_ultralight_irq(void)
 	{
 		if(nfc_target_protocol == 0xC9) /* 106kbps RF Level OK */
 		{
-			hydranfc_emul_mf_ultralight_states();
+			if(emul_tag_trf_rx(t_irq) != EMUL_TAG_OK)
+				error = 1;
+			else if(emul_tag.state == EMUL_TAG_HALT)
+				emul_mf_ultralight_trf_config();
 		}else
 		{
 			error = 1;
@@ -518,46 +254,53 @@ void hydranfc_emul_mf_ultralight_irq(void)
 		}
 	}
 
-	if(status & IRQ_STATUS_PROTOCOL_ERROR)
-	{
-		error = 1;
-	}
-
-	if(status & IRQ_STATUS_COLLISION_ERROR)
-	{
-		error = 1;
-	}
-
-	if(status & IRQ_STATUS_COLLISION_AVOID_FINISHED)
+	if(status & (IRQ_STATUS_PROTOCOL_ERROR | IRQ_STATUS_COLLISION_ERROR |
+		     IRQ_STATUS_COLLISION_AVOID_FINISHED))
 	{
 		error = 1;
 	}
 
 	if(error > 0)
 	{
-		/* Re-Init Internal Emul 14443A state */
-		emul_mf_ultralight_14443a_state = EMUL_RX_MF_ULTRALIGHT_REQA_WUPA;
+		/* Re-Init Internal Emul 14443A state and TRF7970A */
+		emul_tag_reset(&emul_tag);
 		hydranfc_emul_mf_ultralight_init();
 	}
 }
 
-
-static void hydranfc_emul_mf_ultralight_run(t_hydra_console *con)
+/* Start emulation of the tag loaded in emul_tag, it is managed by IRQ */
+void hydranfc_emul_mf_ultralight_start(void)
 {
+	emul_tag_reset(&emul_tag);
+	emul_tag_trf_stats_reset();
+
 	/* Init TRF7970A IRQ function callback */
 	trf7970a_irq_fn = hydranfc_emul_mf_ultralight_irq;
 
 	hydranfc_emul_mf_ultralight_init();
+}
+
+void hydranfc_emul_mf_ultralight_stop(void)
+{
+	trf7970a_irq_fn = NULL;
+}
+
+static void hydranfc_emul_mf_ultralight_run(t_hydra_console *con)
+{
+	emul_tag_image_t *image = &emul_tag.image;
+
+	hydranfc_emul_mf_ultralight_start();
 
 	/* Infinite loop until UBTN is pressed */
 	/*  Emulation is managed by IRQ => hydranfc_emul_mf_ultralight_irq */
 	cprintf(con, "NFC Emulation Mifare Ultralight started\r\n");
-	cprintf(con, "7Bytes UID: %02X %02X %02X %02X %02X %02X %02X\r\n", 
-					mf_ultralight_uid[0], mf_ultralight_uid[1], mf_ultralight_uid[2], mf_ultralight_uid[3],
-					mf_ultralight_uid[4], mf_ultralight_uid[5], mf_ultralight_uid[6]);
-	cprintf(con, "ATQA: %02X %02X\r\n", mf_ultralight_atqa[0], mf_ultralight_atqa[1]);
-	cprintf(con, "SAK1: %02X\r\n", mf_ultralight_sak[0]);
-	cprintf(con, "SAK2: %02X\r\n", mf_ultralight_sak[1]);
+	cprintf(con, "7Bytes UID: %02X %02X %02X %02X %02X %02X %02X\r\n",
+					image->uid[0], image->uid[1], image->uid[2], image->uid[3],
+					image->uid[4], image->uid[5], image->uid[6]);
+	cprintf(con, "ATQA: %02X %02X\r\n", image->atqa[0], image->atqa[1]);
+	cprintf(con, "SAK1: %02X\r\n", emul_tag.sak[0].data[0]);
+	cprintf(con, "SAK2: %02X\r\n", emul_tag.sak[1].data[0]);
+	cprintf(con, "Pages: %d\r\n", image->nb_pages);
 	cprintf(con, "Press user button(UBTN) to stop.\r\n");
 	while(1) {
 		if(hydrabus_ubtn())
@@ -565,15 +308,17 @@ static void hydranfc_emul_mf_ultralight_run(t_hydra_console *con)
 		chThdSleepMilliseconds(10);
 	}
 
-	trf7970a_irq_fn = NULL;
+	hydranfc_emul_mf_ultralight_stop();
+	emul_tag_trf_print_stats(con);
 }
 
 /* Return TRUE if success or FALSE if error */
 int hydranfc_emul_mf_ultralight_file(t_hydra_console *con, char* filename)
 {
-	int i, j, filelen;
+	int i, filelen;
 	FIL fp;
 	uint32_t cnt;
+	uint8_t *data = emul_tag.image.data;
 	uint8_t expected_uid_bcc0;
 	uint8_t obtained_uid_bcc0;
 	uint8_t expected_uid_bcc1;
@@ -591,59 +336,53 @@ int hydranfc_emul_mf_ultralight_file(t_hydra_console *con, char* filename)
 		return FALSE;
 	}
 
+	/* MIFARE Ultralight or any NTAG21x/Ultralight EV1 dump */
 	filelen = f_size(&fp);
-	if(filelen != MFC_ULTRALIGHT_DATA_SIZE) {
-		cprintf(con, "Expected file size shall be equal to %d Bytes and it is %d Bytes\r\n", MFC_ULTRALIGHT_DATA_SIZE, filelen);
+	if((filelen % EMUL_TAG_PAGE_SIZE) != 0 ||
+	   filelen < MFC_ULTRALIGHT_DATA_SIZE || filelen > EMUL_TAG_DATA_MAX) {
+		cprintf(con, "Expected file size shall be a multiple of %d from %d to %d Bytes and it is %d Bytes\r\n",
+			EMUL_TAG_PAGE_SIZE, MFC_ULTRALIGHT_DATA_SIZE, EMUL_TAG_DATA_MAX, filelen);
+		file_close(&fp);
 		return FALSE;
 	}
 
-	cnt = MFC_ULTRALIGHT_DATA_SIZE;
-	cnt = file_read(&fp, mf_ultralight_data, cnt);
+	cnt = file_read(&fp, data, filelen);
 	if (!cnt)
 	{
-		cprintf(con, "Failed to read %d bytes in file (cnt %d)\r\n", MFC_ULTRALIGHT_DATA_SIZE, cnt);
+		cprintf(con, "Failed to read %d bytes in file (cnt %d)\r\n", filelen, cnt);
 		return FALSE;
 	}
 	file_close(&fp);
 
 	cprintf(con, "DATA:");
-	for (i = 0; i < MFC_ULTRALIGHT_DATA_SIZE; i++) {
+	for (i = 0; i < filelen; i++) {
 		if(i % 16 == 0)
 			cprintf(con, "\r\n");
 
-		cprintf(con, " %02X", mf_ultralight_data[i]);
+		cprintf(con, " %02X", data[i]);
 	}
 	cprintf(con, "\r\n");
 
 	/* Check Data UID with BCC */
 	cprintf(con, "DATA UID:");
 	for (i = 0; i < 3; i++)
-		cprintf(con, " %02X", mf_ultralight_data[i]);
-	for (i = 4; i < 7; i++)
-		cprintf(con, " %02X", mf_ultralight_data[i]);
+		cprintf(con, " %02X", data[i]);
+	for (i = 4; i < 8; i++)
+		cprintf(con, " %02X", data[i]);
 	cprintf(con, "\r\n");
 
-	expected_uid_bcc0 = (ISO14443A_SEL_L1_CT ^ mf_ultralight_data[0] ^ mf_ultralight_data[1] ^ mf_ultralight_data[2]); // BCC1
-	obtained_uid_bcc0 = mf_ultralight_data[3];
+	expected_uid_bcc0 = (0x88 ^ data[0] ^ data[1] ^ data[2]); // BCC1 with CT
+	obtained_uid_bcc0 = data[3];
 	cprintf(con, " (DATA BCC0 %02X %s)\r\n", expected_uid_bcc0,
 		expected_uid_bcc0 == obtained_uid_bcc0 ? "ok" : "NOT OK");
 
-	expected_uid_bcc1 = (mf_ultralight_data[4] ^ mf_ultralight_data[5] ^ mf_ultralight_data[6] ^ mf_ultralight_data[7]); // BCC2
-	obtained_uid_bcc1 = mf_ultralight_data[8];
+	expected_uid_bcc1 = (data[4] ^ data[5] ^ data[6] ^ data[7]); // BCC2
+	obtained_uid_bcc1 = data[8];
 	cprintf(con, " (DATA BCC1 %02X %s)\r\n", expected_uid_bcc1,
 		expected_uid_bcc1 == obtained_uid_bcc1 ? "ok" : "NOT OK");
 
-	if( (expected_uid_bcc0 == obtained_uid_bcc0) && (expected_uid_bcc1 == obtained_uid_bcc1) )
+	if(emul_tag_load_ul(&emul_tag, data, filelen) == EMUL_TAG_OK)
 	{
-		j = 0;
-		for (i = 0; i < 3; i++)
-			mf_ultralight_uid[j++] = mf_ultralight_data[i];
-		for (i = 4; i < 8; i++)
-			mf_ultralight_uid[j++] = mf_ultralight_data[i];
-
-		mf_ultralight_uid_bcc[0] = obtained_uid_bcc0; // BCC1
-		mf_ultralight_uid_bcc[1] = obtained_uid_bcc1; // BCC2
-
 		hydranfc_emul_mf_ultralight_run(con);
 		return TRUE;
 	}
@@ -655,11 +394,7 @@ int hydranfc_emul_mf_ultralight_file(t_hydra_console *con, char* filename)
 
 void hydranfc_emul_mf_ultralight(t_hydra_console *con)
 {
-	memcpy(mf_ultralight_uid, mf_ultralight_uid_default, sizeof(mf_ultralight_uid_default));
-	mf_ultralight_uid_bcc[0] = mf_ultralight_data[3]; // BCC1
-	mf_ultralight_uid_bcc[1] = mf_ultralight_data[8]; // BCC2
-	memcpy(mf_ultralight_data, mf_ultralight_data_default, sizeof(mf_ultralight_data_default));
+	emul_tag_load_ul(&emul_tag, mf_ultralight_data_default, sizeof(mf_ultralight_data_default));
 
 	hydranfc_emul_mf_ultralight_run(con);
 }
-
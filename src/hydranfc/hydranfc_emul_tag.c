@@ -0,0 +1,476 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hydranfc_emul_tag.h"
+#include <string.h>
+
+/* ISO14443A, REQA and WUPA are short frames of 7 bits */
+#define ISO14443A_REQA		0x26
+#define ISO14443A_WUPA		0x52
+#define ISO14443A_SEL_CL1	0x93
+#define ISO14443A_SEL_CL2	0x95
+#define ISO14443A_NVB_ANTICOL	0x20
+#define ISO14443A_NVB_SELECT	0x70
+#define ISO14443A_CT		0x88
+#define ISO14443A_SAK_CASCADE	0x04
+#define ISO14443A_HALT		0x50
+
+/*
+ * MIFARE Ultralight/MF0ICU1 and NTAG21x commands see
+ * http://cache.nxp.com/documents/data_sheet/MF0ICU1.pdf
+ */
+#define MF_UL_READ		0x30
+#define MF_UL_WRITE		0xA2
+#define MF_UL_COMPAT_WRITE	0xA0
+#define MF_UL_GET_VERSION	0x60
+#define MF_UL_ACK		0x0A
+#define MF_UL_NAK		0x00
+
+#define MF_UL_PAGE_LOCK		2	/* Bytes 2 and 3 are the static lock bytes */
+#define MF_UL_PAGE_OTP		3
+
+/* Lock byte 0: L7..L4, L-OTP, BL15-10, BL9-4, BL-OTP */
+#define MF_UL_LOCK0_OTP		0x08
+#define MF_UL_BL_OTP		0x01
+#define MF_UL_BL_9_4		0x02
+#define MF_UL_BL_15_10		0x04
+
+/* GET_VERSION of the tags with the same number of pages */
+static const struct {
+	uint16_t nb_pages;
+	uint8_t version[8];
+} emul_tag_versions[] = {
+	{ 20, { 0x00, 0x04, 0x03, 0x01, 0x01, 0x00, 0x0B, 0x03 } }, /* MF0UL11 */
+	{ 41, { 0x00, 0x04, 0x03, 0x01, 0x01, 0x00, 0x0E, 0x03 } }, /* MF0UL21 */
+	{ 45, { 0x00, 0x04, 0x04, 0x02, 0x01, 0x00, 0x0F, 0x03 } }, /* NTAG213 */
+	{ 135, { 0x00, 0x04, 0x04, 0x02, 0x01, 0x00, 0x11, 0x03 } }, /* NTAG215 */
+	{ 231, { 0x00, 0x04, 0x04, 0x02, 0x01, 0x00, 0x13, 0x03 } }, /* NTAG216 */
+};
+#define EMUL_TAG_VERSIONS_NB (sizeof(emul_tag_versions) / sizeof(emul_tag_versions[0]))
+
+static uint16_t crc_a_update(uint16_t crc, uint8_t data)
+{
+	data ^= crc & 0xff;
+	data ^= data << 4;
+	return (crc >> 8) ^ (data << 8) ^ (data << 3) ^ (data >> 4);
+}
+
+uint16_t emul_tag_crc_a(const uint8_t *data, uint32_t len)
+{
+	uint16_t crc = 0x6363;
+
+	while (len--)
+		crc = crc_a_update(crc, *data++);
+	return crc;
+}
+
+static void emul_tag_set_resp(emul_tag_resp_t *resp, emul_tag_resp_kind_t kind,
+			      const uint8_t *data, uint8_t len, int crc)
+{
+	uint16_t crc_a;
+
+	resp->kind = kind;
+	resp->bits = 0;
+	memcpy(resp->data, data, len);
+	if (crc) {
+		crc_a = emul_tag_crc_a(data, len);
+		resp->data[len++] = crc_a & 0xff;
+		resp->data[len++] = crc_a >> 8;
+	}
+	resp->len = len;
+}
+
+static void emul_tag_set_ack(emul_tag_resp_t *resp, uint8_t ack)
+{
+	resp->kind = EMUL_TAG_RESP_ACK;
+	resp->len = 0;
+	resp->bits = 4;
+	resp->data[0] = ack;
+}
+
+/* CRC_A of the 16 bytes READ returns from page, with roll over */
+static uint16_t emul_tag_read_crc(emul_tag_t *tag, uint16_t page)
+{
+	uint16_t crc = 0x6363;
+	uint16_t offset;
+	int i;
+
+	offset = page * EMUL_TAG_PAGE_SIZE;
+	for (i = 0; i < 4 * EMUL_TAG_PAGE_SIZE; i++) {
+		crc = crc_a_update(crc, tag->image.data[offset++]);
+		if (offset == tag->image.nb_pages * EMUL_TAG_PAGE_SIZE)
+			offset = 0;
+	}
+	return crc;
+}
+
+static void emul_tag_update_ro(emul_tag_t *tag)
+{
+	emul_tag_image_t *image = &tag->image;
+	uint8_t lock0, lock1;
+	int page;
+
+	memset(image->ro, 0, sizeof(image->ro));
+	if (image->nb_pages == 0)
+		return;
+
+	/* Serial number pages, page 2 is written by OR so never read only */
+	image->ro[0] = 0x03;
+
+	lock0 = image->data[MF_UL_PAGE_LOCK * EMUL_TAG_PAGE_SIZE + 2];
+	lock1 = image->data[MF_UL_PAGE_LOCK * EMUL_TAG_PAGE_SIZE + 3];
+	if (lock0 & MF_UL_LOCK0_OTP)
+		image->ro[0] |= 1 << MF_UL_PAGE_OTP;
+	for (page = 4; page < 8; page++) {
+		if (lock0 & (1 << page))
+			image->ro[0] |= 1 << page;
+	}
+	image->ro[1] = lock1;
+}
+
+static int emul_tag_write_page(emul_tag_t *tag, uint8_t page, const uint8_t *data)
+{
+	uint8_t *p, lock0, freeze0, freeze1;
+	int i;
+
+	if (page >= tag->image.nb_pages || emul_tag_page_ro(tag, page))
+		return EMUL_TAG_ERROR;
+
+	p = &tag->image.data[page * EMUL_TAG_PAGE_SIZE];
+	switch (page) {
+	case MF_UL_PAGE_LOCK:
+		/* Lock bits can only be set and the block lock bits freeze them */
+		lock0 = p[2];
+		freeze0 = 0;
+		freeze1 = 0;
+		if (lock0 & MF_UL_BL_OTP)
+			freeze0 |= MF_UL_LOCK0_OTP;
+		if (lock0 & MF_UL_BL_9_4) {
+			freeze0 |= 0xf0;
+			freeze1 |= 0x03;
+		}
+		if (lock0 & MF_UL_BL_15_10)
+			freeze1 |= 0xfc;
+		p[2] |= data[2] & ~freeze0;
+		p[3] |= data[3] & ~freeze1;
+		emul_tag_update_ro(tag);
+		break;
+
+	case MF_UL_PAGE_OTP:
+		for (i = 0; i < EMUL_TAG_PAGE_SIZE; i++)
+			p[i] |= data[i];
+		break;
+
+	default:
+		memcpy(p, data, EMUL_TAG_PAGE_SIZE);
+		break;
+	}
+
+	/* READ from the 3 previous pages also returns this page */
+	for (i = 0; i < 4; i++) {
+		tag->read_crc[page] = emul_tag_read_crc(tag, page);
+		page = (page == 0) ? tag->image.nb_pages - 1 : page - 1;
+	}
+	tag->written = 1;
+	return EMUL_TAG_OK;
+}
+
+static void emul_tag_prepare(emul_tag_t *tag)
+{
+	emul_tag_image_t *image = &tag->image;
+	uint8_t frame[8];
+	uint16_t crc;
+	unsigned int i;
+
+	emul_tag_set_resp(&tag->atqa, EMUL_TAG_RESP_ATQA, image->atqa, 2, 0);
+
+	if (image->uid_len == 7) {
+		frame[0] = ISO14443A_CT;
+		memcpy(&frame[1], image->uid, 3);
+		frame[4] = frame[0] ^ frame[1] ^ frame[2] ^ frame[3];
+		emul_tag_set_resp(&tag->cl[0], EMUL_TAG_RESP_UID, frame, 5, 0);
+
+		memcpy(frame, &image->uid[3], 4);
+		frame[4] = frame[0] ^ frame[1] ^ frame[2] ^ frame[3];
+		emul_tag_set_resp(&tag->cl[1], EMUL_TAG_RESP_UID, frame, 5, 0);
+
+		frame[0] = ISO14443A_SAK_CASCADE;
+		emul_tag_set_resp(&tag->sak[0], EMUL_TAG_RESP_SAK, frame, 1, 1);
+		emul_tag_set_resp(&tag->sak[1], EMUL_TAG_RESP_SAK, &image->sak, 1, 1);
+	} else {
+		memcpy(frame, image->uid, 4);
+		frame[4] = frame[0] ^ frame[1] ^ frame[2] ^ frame[3];
+		emul_tag_set_resp(&tag->cl[0], EMUL_TAG_RESP_UID, frame, 5, 0);
+		emul_tag_set_resp(&tag->sak[0], EMUL_TAG_RESP_SAK, &image->sak, 1, 1);
+	}
+
+	/* SELECT frames are compared with their CRC_A */
+	for (i = 0; i < (image->uid_len == 7 ? 2U : 1U); i++) {
+		tag->sel[i][0] = (i == 0) ? ISO14443A_SEL_CL1 : ISO14443A_SEL_CL2;
+		tag->sel[i][1] = ISO14443A_NVB_SELECT;
+		memcpy(&tag->sel[i][2], tag->cl[i].data, 5);
+		crc = emul_tag_crc_a(tag->sel[i], 7);
+		tag->sel[i][7] = crc & 0xff;
+		tag->sel[i][8] = crc >> 8;
+	}
+
+	tag->version.len = 0;
+	for (i = 0; i < EMUL_TAG_VERSIONS_NB; i++) {
+		if (emul_tag_versions[i].nb_pages == image->nb_pages)
+			emul_tag_set_resp(&tag->version, EMUL_TAG_RESP_DATA,
+					  emul_tag_versions[i].version, 8, 1);
+	}
+
+	memset(frame, 0, 4);
+	emul_tag_set_resp(&tag->nonce, EMUL_TAG_RESP_DATA, frame, 4, 1);
+	emul_tag_set_ack(&tag->ack, MF_UL_ACK);
+	emul_tag_set_ack(&tag->nak, MF_UL_NAK);
+
+	tag->read.kind = EMUL_TAG_RESP_DATA;
+	tag->read.len = 4 * EMUL_TAG_PAGE_SIZE + 2;
+	tag->read.bits = 0;
+	for (i = 0; i < image->nb_pages; i++)
+		tag->read_crc[i] = emul_tag_read_crc(tag, i);
+
+	emul_tag_update_ro(tag);
+	tag->written = 0;
+	emul_tag_reset(tag);
+}
+
+/** \brief Load a MIFARE Ultralight/NTAG21x dump.
+ *
+ * \param tag emul_tag_t*: emulated tag, dump can be its image data.
+ * \param dump const uint8_t*: pages starting from page 0.
+ * \param size uint32_t: multiple of 4 bytes from 64 to 1024 bytes.
+ * \return int: EMUL_TAG_OK, EMUL_TAG_ERR_SIZE or EMUL_TAG_ERR_BCC when
+ * the BCC of page 0 or 2 does not match the UID.
+ *
+ */
+int emul_tag_load_ul(emul_tag_t *tag, const uint8_t *dump, uint32_t size)
+{
+	emul_tag_image_t *image = &tag->image;
+
+	if (size % EMUL_TAG_PAGE_SIZE ||
+	    size < EMUL_TAG_PAGES_MIN * EMUL_TAG_PAGE_SIZE ||
+	    size > EMUL_TAG_DATA_MAX)
+		return EMUL_TAG_ERR_SIZE;
+
+	if (dump[3] != (ISO14443A_CT ^ dump[0] ^ dump[1] ^ dump[2]) ||
+	    dump[8] != (dump[4] ^ dump[5] ^ dump[6] ^ dump[7]))
+		return EMUL_TAG_ERR_BCC;
+
+	if (dump != image->data)
+		memcpy(image->data, dump, size);
+	image->nb_pages = size / EMUL_TAG_PAGE_SIZE;
+	memcpy(image->uid, dump, 3);
+	memcpy(&image->uid[3], &dump[4], 4);
+	image->uid_len = 7;
+	image->atqa[0] = 0x44;
+	image->atqa[1] = 0x00;
+	image->sak = 0x00;
+
+	emul_tag_prepare(tag);
+	return EMUL_TAG_OK;
+}
+
+/** \brief Load a tag which only answers to the anticollision.
+ *
+ * \param uid_len uint8_t: 4 or 7.
+ * \return int: EMUL_TAG_OK or EMUL_TAG_ERR_SIZE.
+ *
+ */
+int emul_tag_load_uid(emul_tag_t *tag, const uint8_t *uid, uint8_t uid_len,
+		      const uint8_t *atqa, uint8_t sak)
+{
+	emul_tag_image_t *image = &tag->image;
+
+	if (uid_len != 4 && uid_len != 7)
+		return EMUL_TAG_ERR_SIZE;
+
+	memcpy(image->uid, uid, uid_len);
+	image->uid_len = uid_len;
+	image->atqa[0] = atqa[0];
+	image->atqa[1] = atqa[1];
+	image->sak = sak;
+	image->nb_pages = 0;
+
+	emul_tag_prepare(tag);
+	return EMUL_TAG_OK;
+}
+
+void emul_tag_reset(emul_tag_t *tag)
+{
+	tag->state = EMUL_TAG_IDLE;
+}
+
+static int emul_tag_rx_anticol(emul_tag_t *tag, int level, const uint8_t *rx,
+			       uint32_t len, const emul_tag_resp_t **resp)
+{
+	if (len == 2 && rx[0] == tag->sel[level][0] &&
+	    rx[1] == ISO14443A_NVB_ANTICOL) {
+		*resp = &tag->cl[level];
+		return EMUL_TAG_OK;
+	}
+
+	if (len >= 9 && !memcmp(rx, tag->sel[level], 9)) {
+		*resp = &tag->sak[level];
+		if (level == 0 && tag->image.uid_len == 7)
+			tag->state = EMUL_TAG_READY2;
+		else
+			tag->state = EMUL_TAG_ACTIVE;
+		return EMUL_TAG_OK;
+	}
+	return EMUL_TAG_ERROR;
+}
+
+static int emul_tag_rx_cmd(emul_tag_t *tag, const uint8_t *rx, uint32_t len,
+			   const emul_tag_resp_t **resp)
+{
+	emul_tag_image_t *image = &tag->image;
+	uint16_t page, offset, n;
+
+	if (len < 2)
+		return EMUL_TAG_ERROR;
+
+	if (rx[0] == ISO14443A_HALT) {
+		if (rx[1] != 0x00)
+			return EMUL_TAG_ERROR;
+		tag->state = EMUL_TAG_HALT;
+		return EMUL_TAG_OK;
+	}
+
+	/* UID only tag, answer a null nonce to any command */
+	if (image->nb_pages == 0) {
+		*resp = &tag->nonce;
+		tag->state = EMUL_TAG_IDLE;
+		return EMUL_TAG_OK;
+	}
+
+	page = rx[1];
+	switch (rx[0]) {
+	case MF_UL_READ:
+		if (page >= image->nb_pages)
+			break;
+		offset = page * EMUL_TAG_PAGE_SIZE;
+		n = (image->nb_pages - page) * EMUL_TAG_PAGE_SIZE;
+		if (n >= 4 * EMUL_TAG_PAGE_SIZE) {
+			memcpy(tag->read.data, &image->data[offset], 4 * EMUL_TAG_PAGE_SIZE);
+		} else {
+			/* Roll over to page 0 */
+			memcpy(tag->read.data, &image->data[offset], n);
+			memcpy(&tag->read.data[n], image->data, 4 * EMUL_TAG_PAGE_SIZE - n);
+		}
+		tag->read.data[16] = tag->read_crc[page] & 0xff;
+		tag->read.data[17] = tag->read_crc[page] >> 8;
+		*resp = &tag->read;
+		return EMUL_TAG_OK;
+
+	case MF_UL_WRITE:
+		if (len < 2 + EMUL_TAG_PAGE_SIZE)
+			return EMUL_TAG_ERROR;
+		if (emul_tag_write_page(tag, page, &rx[2]) != EMUL_TAG_OK)
+			break;
+		*resp = &tag->ack;
+		return EMUL_TAG_OK;
+
+	case MF_UL_COMPAT_WRITE:
+		if (page >= image->nb_pages || emul_tag_page_ro(tag, page))
+			break;
+		tag->compat_page = page;
+		tag->state = EMUL_TAG_COMPAT_WRITE;
+		*resp = &tag->ack;
+		return EMUL_TAG_OK;
+
+	case MF_UL_GET_VERSION:
+		if (tag->version.len == 0)
+			break;
+		*resp = &tag->version;
+		return EMUL_TAG_OK;
+
+	default:
+		break;
+	}
+
+	/* NAK, the tag goes back to IDLE */
+	*resp = &tag->nak;
+	tag->state = EMUL_TAG_IDLE;
+	return EMUL_TAG_OK;
+}
+
+/** \brief Process a frame received from the reader.
+ *
+ * Responses are precomputed, only READ copies its 16 bytes.
+ *
+ * \param tag emul_tag_t*: emulated tag.
+ * \param rx const uint8_t*: frame, with its CRC_A when there is one.
+ * \param len uint32_t: number of bytes of the frame.
+ * \param resp const emul_tag_resp_t**: response to send or NULL.
+ * \return int: EMUL_TAG_OK or EMUL_TAG_ERROR on a frame which is not
+ * expected in the current state, then the tag is back to IDLE.
+ *
+ */
+int emul_tag_rx(emul_tag_t *tag, const uint8_t *rx, uint32_t len,
+		const emul_tag_resp_t **resp)
+{
+	int ret;
+
+	*resp = NULL;
+
+	if (len == 1 && (rx[0] == ISO14443A_WUPA ||
+			 (rx[0] == ISO14443A_REQA && tag->state != EMUL_TAG_HALT))) {
+		tag->state = EMUL_TAG_READY1;
+		*resp = &tag->atqa;
+		return EMUL_TAG_OK;
+	}
+
+	switch (tag->state) {
+	case EMUL_TAG_READY1:
+		ret = emul_tag_rx_anticol(tag, 0, rx, len, resp);
+		break;
+
+	case EMUL_TAG_READY2:
+		ret = emul_tag_rx_anticol(tag, 1, rx, len, resp);
+		break;
+
+	case EMUL_TAG_ACTIVE:
+		ret = emul_tag_rx_cmd(tag, rx, len, resp);
+		break;
+
+	case EMUL_TAG_COMPAT_WRITE:
+		/* Only the first 4 of the 16 bytes are written */
+		tag->state = EMUL_TAG_ACTIVE;
+		if (len < 4 * EMUL_TAG_PAGE_SIZE) {
+			ret = EMUL_TAG_ERROR;
+			break;
+		}
+		if (emul_tag_write_page(tag, tag->compat_page, rx) == EMUL_TAG_OK)
+			*resp = &tag->ack;
+		else
+			*resp = &tag->nak;
+		ret = EMUL_TAG_OK;
+		break;
+
+	default:
+		/* IDLE and HALT ignore anything but REQA/WUPA */
+		return EMUL_TAG_OK;
+	}
+
+	if (ret != EMUL_TAG_OK)
+		emul_tag_reset(tag);
+	return ret;
+}
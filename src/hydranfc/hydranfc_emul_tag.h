@@ -0,0 +1,112 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HYDRANFC_EMUL_TAG_H_
+#define _HYDRANFC_EMUL_TAG_H_
+
+/*
+ * ISO14443A tag emulation core, it does not depend on the TRF7970A so the
+ * state machine can be driven by any frame source.
+ */
+#include <stdint.h>
+
+#define EMUL_TAG_PAGE_SIZE	(4)
+#define EMUL_TAG_PAGES_MIN	(16)	/* MIFARE Ultralight */
+#define EMUL_TAG_PAGES_MAX	(256)	/* NTAG216 has 231 pages */
+#define EMUL_TAG_DATA_MAX	(EMUL_TAG_PAGES_MAX * EMUL_TAG_PAGE_SIZE)
+#define EMUL_TAG_RESP_MAX	(18)	/* READ: 4 pages + CRC_A */
+
+#define EMUL_TAG_OK		(0)
+#define EMUL_TAG_ERROR		(-1)	/* Protocol error, tag is back to IDLE */
+#define EMUL_TAG_ERR_SIZE	(-2)
+#define EMUL_TAG_ERR_BCC	(-3)
+
+typedef enum {
+	EMUL_TAG_IDLE,
+	EMUL_TAG_HALT,		/* Only woken up by WUPA */
+	EMUL_TAG_READY1,	/* Cascade level 1 ANTICOLLISION/SELECT */
+	EMUL_TAG_READY2,	/* Cascade level 2 ANTICOLLISION/SELECT */
+	EMUL_TAG_ACTIVE,
+	EMUL_TAG_COMPAT_WRITE	/* Wait the 16 bytes of COMPATIBILITY WRITE */
+} emul_tag_state_t;
+
+/* Response classes, each one has its own frame delay time */
+typedef enum {
+	EMUL_TAG_RESP_ATQA,
+	EMUL_TAG_RESP_UID,
+	EMUL_TAG_RESP_SAK,
+	EMUL_TAG_RESP_DATA,
+	EMUL_TAG_RESP_ACK,
+	EMUL_TAG_RESP_NB
+} emul_tag_resp_kind_t;
+
+/* Frame sent as is, CRC_A included when the response has one */
+typedef struct {
+	uint8_t kind;	/* emul_tag_resp_kind_t */
+	uint8_t len;	/* Complete bytes */
+	uint8_t bits;	/* Bits of an extra byte (4 for ACK/NAK) or 0 */
+	uint8_t data[EMUL_TAG_RESP_MAX];
+} emul_tag_resp_t;
+
+/*
+ * Tag image: UID and pages of 4 bytes, write protection of the pages comes
+ * from the static lock bytes of page 2. Tags without pages only do the
+ * anticollision (UID only MIFARE Classic).
+ */
+typedef struct {
+	uint8_t uid[7];
+	uint8_t uid_len;	/* 4 or 7 */
+	uint8_t atqa[2];
+	uint8_t sak;		/* SAK of the last cascade level */
+	uint16_t nb_pages;
+	uint8_t data[EMUL_TAG_DATA_MAX];
+	uint8_t ro[EMUL_TAG_PAGES_MAX / 8];	/* Bitmap of read only pages */
+} emul_tag_image_t;
+
+typedef struct {
+	emul_tag_image_t image;
+	emul_tag_state_t state;
+	uint8_t compat_page;
+	uint8_t written;	/* Image modified by a WRITE */
+
+	/* Precomputed frames */
+	uint8_t sel[2][9];	/* Expected SELECT with CRC_A for CL1 and CL2 */
+	emul_tag_resp_t atqa;
+	emul_tag_resp_t cl[2];
+	emul_tag_resp_t sak[2];
+	emul_tag_resp_t version;	/* len 0 when GET_VERSION is not supported */
+	emul_tag_resp_t nonce;
+	emul_tag_resp_t ack;
+	emul_tag_resp_t nak;
+	uint16_t read_crc[EMUL_TAG_PAGES_MAX];	/* CRC_A of READ from each page */
+	emul_tag_resp_t read;
+} emul_tag_t;
+
+#define emul_tag_page_ro(tag, page) \
+	(((tag)->image.ro[(page) >> 3] & (1 << ((page) & 7))) != 0)
+
+uint16_t emul_tag_crc_a(const uint8_t *data, uint32_t len);
+
+int emul_tag_load_ul(emul_tag_t *tag, const uint8_t *dump, uint32_t size);
+int emul_tag_load_uid(emul_tag_t *tag, const uint8_t *uid, uint8_t uid_len,
+		      const uint8_t *atqa, uint8_t sak);
+void emul_tag_reset(emul_tag_t *tag);
+int emul_tag_rx(emul_tag_t *tag, const uint8_t *rx, uint32_t len,
+		const emul_tag_resp_t **resp);
+
+#endif /* _HYDRANFC_EMUL_TAG_H_ */
@@ -0,0 +1,137 @@
+/*
+ * HydraBus/HydraNFC
+ *
+ * Copyright (C) 2014-2023 Benjamin VERNOUX
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ch.h"
+#include "common.h"
+#include "hydranfc.h"
+#include "trf797x.h"
+#include "bsp.h"
+#include <string.h>
+
+/* Tag emulated by hydranfc_emul_mf_ultralight and hydranfc_emul_mifare */
+emul_tag_t emul_tag;
+emul_tag_stats_t emul_tag_stats;
+
+/*
+ * Response time in cycles (168MHz) counted from the end of the FIFO read,
+ * as the busy waits of the previous state machines. Building the response
+ * is done within this time instead of being added to it.
+ */
+static const uint32_t emul_tag_trf_fdt[EMUL_TAG_RESP_NB] = {
+	3791,	/* EMUL_TAG_RESP_ATQA */
+	2378,	/* EMUL_TAG_RESP_UID */
+	324,	/* EMUL_TAG_RESP_SAK */
+	324,	/* EMUL_TAG_RESP_DATA */
+	324,	/* EMUL_TAG_RESP_ACK */
+};
+
+void emul_tag_trf_stats_reset(void)
+{
+	memset(&emul_tag_stats, 0, sizeof(emul_tag_stats));
+}
+
+/*
+ * The frame is built before waiting so that the response time only
+ * depends on the SPI transfer.
+ */
+static void emul_tag_trf_tx(const emul_tag_resp_t *resp, uint32_t t_irq, uint32_t t_rx)
+{
+	uint32_t latency, irq_latency;
+	int len;
+
+	len = resp->len + (resp->bits ? 1 : 0);
+	nfc_tx_rawdata_buf[0] = 0x8F; /* Direct Command => Reset FIFO */
+	nfc_tx_rawdata_buf[1] = 0x90; /* Direct Command => Transmission With No CRC (0x10) */
+	nfc_tx_rawdata_buf[2] = 0x3D; /* Write Continuous (Start at @0x1D => TX Length Byte1 & Byte2) */
+	nfc_tx_rawdata_buf[3] = ((resp->len & 0xF0) >> 4); /* Number of complete bytes MSB @0x1D */
+	nfc_tx_rawdata_buf[4] = ((resp->len << 4) & 0xF0); /* Number of complete bytes LSB @0x1E */
+	if (resp->bits)
+		nfc_tx_rawdata_buf[4] |= (resp->bits << 1) | BIT0; /* Broken byte */
+	memcpy(&nfc_tx_rawdata_buf[5], resp->data, len);
+
+	/* Processing time, late when it exceeds the response time */
+	latency = bsp_get_cyclecounter() - t_rx;
+	if (latency < emul_tag_trf_fdt[resp->kind]) {
+		while ((bsp_get_cyclecounter() - t_rx) < emul_tag_trf_fdt[resp->kind])
+			__asm__("nop");
+	} else {
+		emul_tag_stats.late++;
+	}
+	irq_latency = bsp_get_cyclecounter() - t_irq;
+	Trf797xRawWrite(nfc_tx_rawdata_buf, len + 5);
+
+	if (emul_tag_stats.responses == 0 || latency < emul_tag_stats.min)
+		emul_tag_stats.min = latency;
+	if (latency > emul_tag_stats.max)
+		emul_tag_stats.max = latency;
+	if (irq_latency > emul_tag_stats.irq_max)
+		emul_tag_stats.irq_max = irq_latency;
+	emul_tag_stats.responses++;
+}
+
+/** \brief Read the frame received and send the response, called from the
+ * TRF7970A IRQ on RX complete.
+ *
+ * \param t_irq uint32_t: cycle counter at the IRQ entry, only used for the
+ * statistics.
+ * \return int: EMUL_TAG_OK or EMUL_TAG_ERROR when the TRF7970A shall be
+ * initialized again.
+ *
+ */
+int emul_tag_trf_rx(uint32_t t_irq)
+{
+	const emul_tag_resp_t *resp;
+	uint8_t data_buf[32];
+	uint32_t t_rx;
+	int fifo_size, ret;
+
+	/* Read FIFO Status(0x1C=>0x5C) */
+	data_buf[0] = FIFO_CONTROL;
+	Trf797xReadSingle(data_buf, 1);
+	fifo_size = data_buf[0] & 0x1F; /* Limit Fifo size to 31bytes */
+	if (fifo_size > 0) {
+		data_buf[0] = FIFO;
+		Trf797xReadCont(data_buf, fifo_size);
+	}
+	t_rx = bsp_get_cyclecounter();
+
+	ret = emul_tag_rx(&emul_tag, data_buf, fifo_size, &resp);
+	if (resp != NULL)
+		emul_tag_trf_tx(resp, t_irq, t_rx);
+	else if (ret != EMUL_TAG_OK)
+		emul_tag_stats.errors++;
+	return ret;
+}
+
+void emul_tag_trf_print_stats(t_hydra_console *con)
+{
+	cprintf(con, "Responses: %d (%d late), errors: %d\r\n",
+		emul_tag_stats.responses, emul_tag_stats.late,
+		emul_tag_stats.errors);
+	if (emul_tag_stats.responses > 0) {
+		/* 168 cycles per us */
+		cprintf(con, "Processing latency: min %d.%02d us, max %d.%02d us\r\n",
+			emul_tag_stats.min / 168, (emul_tag_stats.min % 168) * 100 / 168,
+			emul_tag_stats.max / 168, (emul_tag_stats.max % 168) * 100 / 168);
+		cprintf(con, "IRQ to response: max %d.%02d us\r\n",
+			emul_tag_stats.irq_max / 168,
+			(emul_tag_stats.irq_max % 168) * 100 / 168);
+	}
+	if (emul_tag.written)
+		cprintf(con, "Tag image modified by WRITE commands\r\n");
+}
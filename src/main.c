@@ -34,6 +34,10 @@
 #include "usb2cfg.h"
 #endif
 
+#ifdef HYDRABUS_USB_BULK
+#include "usb_bulk.h"
+#endif
+
 #include "microsd.h"
 #include "hydrabus.h"
 #ifdef HYDRANFC
@@ -45,6 +49,7 @@
 
 #include "bsp.h"
 #include "bsp_print_dbg.h"
+#include "bsp_resource.h"
 
 #include "script.h"
 
@@ -78,6 +83,36 @@ t_hydra_console consoles[] = {
 #endif
 };
 
+#ifdef HYDRABUS_USB_BULK
+/* BBIO only console on the vendor bulk interface of USB1 */
+static THD_WORKING_AREA(bbio_bulk_wa, CONSOLE_WA_SIZE);
+t_mode_config mode_bulk  __attribute__ ((section(".ram4"))) = { .proto={ .dev_num = 0 }, .cmd={ 0 } };
+t_hydra_console console_bulk = {
+	.thread_name="BBIO USB1 bulk",
+	.bss=(BaseSequentialStream *)&usb_bulk_channel,
+	.mode = &mode_bulk
+};
+
+THD_FUNCTION(bbio_bulk, arg)
+{
+	t_hydra_console *con;
+
+	con = arg;
+	chRegSetThreadName(con->thread_name);
+
+	while (1) {
+		if (!usb_bulk_is_active()) {
+			chThdSleepMilliseconds(USB_BULK_POLL_MS);
+			continue;
+		}
+		cmd_bbio(con);
+		bsp_resource_release_all();
+		/* cmd_bbio() returns at once while UBTN is pressed */
+		chThdSleepMilliseconds(USB_BULK_POLL_MS);
+	}
+}
+#endif
+
 THD_FUNCTION(console, arg)
 {
 	t_hydra_console *con;
@@ -100,6 +135,7 @@ THD_FUNCTION(console, arg)
 		case 0:
 			if (++i == 20) {
 				cmd_bbio(con);
+				bsp_resource_release_all();
 				i=0;
 			}
 			break;
@@ -109,6 +145,7 @@ THD_FUNCTION(console, arg)
 			if(i == 5) {
 				cprintf(con, "1ALS");
 				sump(con);
+				bsp_resource_release_all();
 			}
 			break;
 		/* SERPROG identification is 8*\x00, then \x10 */
@@ -116,6 +153,7 @@ THD_FUNCTION(console, arg)
 		case 0x10:
 			if(i == 8) {
 				bbio_mode_serprog(con);
+				bsp_resource_release_all();
 			}
 			break;
 		default:
@@ -215,9 +253,16 @@ int main(void)
 	/* Wait for USB Enumeration. */
 	chThdSleepMilliseconds(100);
 
+#ifdef HYDRABUS_USB_BULK
+	chThdCreateStatic(bbio_bulk_wa, sizeof(bbio_bulk_wa), NORMALPRIO,
+			  bbio_bulk, &console_bulk);
+#endif
+
 #ifdef HYDRANFC
 	/* Check HydraNFC */
 	hydranfc_detected = hydranfc_is_detected();
+	/* Detection is not a session, leave SPI2 to the consoles */
+	bsp_resource_release_all();
 #endif
 	/*
 	 * Normal main() thread activity.
@@ -234,9 +279,11 @@ int main(void)
 						     CONSOLE_WA_SIZE, consoles[i].thread_name, NORMALPRIO,
 						     console, &consoles[i]);
 			} else {
-				if (chThdTerminatedX(consoles[i].thread))
+				if (chThdTerminatedX(consoles[i].thread)) {
 					/* This console thread terminated. */
+					bsp_resource_release_owner(consoles[i].thread);
 					consoles[i].thread = NULL;
+				}
 			}
 			if (consoles[i].sdu->config->usbp->state == USB_ACTIVE)
 				local_nb_console++;
@@ -275,6 +322,7 @@ int main(void)
 			if (K3_BUTTON) {
 				hydranfc_cleanup(NULL);
 				hydranfc_init(NULL);
+				bsp_resource_release_all();
 				chThdSleepMilliseconds(1000);
 			}
 		}